@@ -0,0 +1,71 @@
+#ifndef ALTITUDE_ESTIMATOR_H
+#define ALTITUDE_ESTIMATOR_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Two-state Kalman filter for altitude and vertical velocity.
+//
+// The state [h, v] is propagated with gravity-compensated vertical
+// acceleration as the control input at IMU rate and corrected with
+// barometric altitude when a pressure reading arrives. The covariance is
+// kept as its three unique terms, so a step is a fixed handful of float
+// operations with no allocation.
+//
+// This module has no Arduino dependencies so the ground tools can replay
+// logged flights through the exact same filter.
+
+#define STANDARD_GRAVITY 9.80665f
+#define ALT_KF_REST_ACCEL_TOLERANCE 0.05f  // |a| within this many g of 1 g
+#define ALT_KF_REST_GYRO_LIMIT 5.0f        // and every gyro axis below this (deg/s)
+#define ALT_KF_REST_FILTER 0.02f           // Low-pass weight per rest sample
+
+class AltitudeEstimator {
+public:
+  AltitudeEstimator();
+
+  // Seeds the state from a baro altitude, at rest unless a velocity is
+  // known (resuming after a reset in flight)
+  void reset(float altitude, float velocity = 0.0f);
+  bool isInitialized() const { return initialized; }
+
+  // Propagates by dt seconds with vertical acceleration in m/s^2, gravity
+  // removed, positive up
+  void predict(float verticalAccel, float dt);
+
+  // Fuses a baro altitude. Returns false if the reading was gated out as an
+  // outlier (the filter re-seeds after ALT_KF_MAX_REJECTS in a row).
+  bool correct(float baroAltitude);
+
+  float getAltitude() const { return altitude; }
+  float getVelocity() const { return velocity; }
+  float getAltitudeVariance() const { return p00; }
+  uint32_t getRejectedCount() const { return rejectedTotal; }
+
+  // Tracks the body-frame gravity direction while the vehicle is at rest
+  // (accel magnitude near 1 g, gyro quiet). Accel in g, gyro in deg/s.
+  void observeGravity(float ax, float ay, float az, float gx, float gy, float gz);
+
+  // Vertical acceleration (m/s^2, gravity removed) from body-frame accel in
+  // g: the projection onto the captured gravity direction, which keeps the
+  // sign through boost and coast while attitude stays near the pad
+  // attitude. Falls back to magnitude minus 1 g before any rest period.
+  float verticalAccel(float ax, float ay, float az) const;
+
+  // The captured gravity direction, to carry it across a reset. get
+  // returns false before any rest period.
+  bool getGravity(float up[3]) const;
+  void setGravity(const float up[3]);
+
+private:
+  bool initialized;
+  float altitude;
+  float velocity;
+  float p00, p01, p11;  // Symmetric state covariance
+  uint8_t consecutiveRejects;
+  uint32_t rejectedTotal;
+  float upX, upY, upZ;  // Low-passed rest accel (points up in body frame)
+  bool haveUp;
+};
+
+#endif
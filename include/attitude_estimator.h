@@ -0,0 +1,67 @@
+#ifndef ATTITUDE_ESTIMATOR_H
+#define ATTITUDE_ESTIMATOR_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Madgwick quaternion attitude filter (AHRS).
+//
+// Gyro rates are integrated each IMU sample and a gradient-descent step
+// pulls the estimate toward the measured gravity direction (and the
+// magnetic field, when fused). Accelerometer correction fades out while
+// |a| is away from 1 g, so thrust and drag don't tilt the estimate; the
+// gyros carry the attitude through boost and coast.
+//
+// The update is straight-line float code: no branches, divisions or libm
+// calls in the step, so its cost is the same on every sample. The ESP32-S3
+// vector unit only has integer lanes and a single quaternion step has no
+// independent float lanes to spread across anyway, so the same portable
+// kernel runs on the board and on the host.
+//
+// The quaternion rotates body-frame vectors into the earth frame (z up).
+// This module has no Arduino dependencies so the ground tools can replay
+// logged flights through the exact same filter.
+
+class AttitudeEstimator {
+public:
+  AttitudeEstimator();
+
+  // Back to identity and unaligned
+  void reset();
+
+  // Levels the attitude from a body-frame accel reading (g); yaw is zero
+  void align(float ax, float ay, float az);
+  bool isAligned() const { return aligned; }
+  // Takes over a known attitude (resuming after a reset in flight, when
+  // the accel can't level it)
+  void setQuaternion(float w, float x, float y, float z);
+
+  // One filter step: gyro in deg/s, accel in g, dt in s
+  void update(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+
+  // With magnetometer (any unit, axes aligned with the accelerometer)
+  void update(float gx, float gy, float gz, float ax, float ay, float az,
+              float mx, float my, float mz, float dt);
+
+  void getQuaternion(float& w, float& x, float& y, float& z) const;
+
+  // Roll, pitch and yaw in degrees (ZYX order)
+  void getEuler(float& roll, float& pitch, float& yaw) const;
+
+  // Angle between the body z (thrust) axis and vertical, degrees
+  float getTilt() const;
+
+  // Body-frame accel (g) rotated into the earth frame: the up component
+  // with gravity removed, in m/s^2
+  float verticalAccel(float ax, float ay, float az) const;
+
+  // The same rotation for all three axes (east, north, up in the AHRS
+  // heading frame), gravity removed, in m/s^2
+  void earthAccel(float ax, float ay, float az, float out[3]) const;
+
+private:
+  float q0, q1, q2, q3;
+  bool aligned;
+};
+
+#endif
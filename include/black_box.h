@@ -0,0 +1,106 @@
+#ifndef BLACK_BOX_H
+#define BLACK_BOX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+// Third-tier store for the SD log while both cards are down: a ring of
+// fixed-size records in an internal flash partition, which keeps them
+// through resets and power loss until a card comes back.
+//
+// Appending is one flash program at the write position, O(1) whatever
+// the ring holds. NOR flash can only clear bits, so a sector must be
+// erased before it's written again. That is slow (tens of ms), so the SD
+// manager erases sectors ahead of the writer while on the ground
+// (eraseAhead) and the ring only erases in line when it wraps. A record
+// that has been copied to SD is marked by clearing its drained byte, also
+// without an erase. At boot the ring is rebuilt from the sequence numbers
+// in flash.
+//
+// Flash access goes through BlackBoxFlash so the ground tools can run the
+// same ring on a simulated partition.
+
+#define BLACKBOX_SECTOR_SIZE 4096       // Erase unit of the ESP32 flash
+#define BLACKBOX_MAX_SECTORS 512        // Up to a 2 MB partition
+#define BLACKBOX_EMPTY_SEQ 0xFFFFFFFFUL // seq of an erased entry
+
+struct BlackBoxEntry {
+  uint32_t seq;          // Order of writing; BLACKBOX_EMPTY_SEQ in erased flash
+  uint32_t crc;          // CRC32 of seq, groups and data
+  uint8_t groups;        // SdRecordGroup bits (sd_record.h)
+  uint8_t drained;       // 0xFF until copied to SD, then cleared
+  TelemetryData data;
+};
+
+// Partition-relative flash access. erase sets one BLACKBOX_SECTOR_SIZE
+// sector to 0xFF; write can only clear bits.
+struct BlackBoxFlash {
+  void* context;
+  bool (*read)(void* context, uint32_t offset, void* buffer, size_t len);
+  bool (*write)(void* context, uint32_t offset, const void* data, size_t len);
+  bool (*erase)(void* context, uint32_t offset);
+  uint32_t size;
+};
+
+struct BlackBoxStats {
+  uint32_t appended;
+  uint32_t drained;
+  uint32_t overwritten;  // Oldest records lost to a full ring
+  uint32_t corrupt;      // Records that failed their CRC (torn by a reset)
+  uint32_t erases;       // Sector erases, in line and ahead
+  uint32_t inlineErases; // Erases the writer had to wait for
+  uint32_t flashErrors;
+};
+
+class BlackBox {
+public:
+  BlackBox();
+
+  // Takes over the partition and rebuilds the ring from what's in it.
+  // Returns false if it's too small or can't be read.
+  bool begin(const BlackBoxFlash& flashAccess);
+  bool isReady() const { return ready; }
+
+  // Stores one record after the newest, overwriting the oldest sector when
+  // the ring is full. Returns false on a flash error.
+  bool append(const TelemetryData& data, uint8_t groups);
+
+  // The oldest record not yet drained. Records that fail their CRC are
+  // skipped. Returns false when there are none.
+  bool peekOldest(BlackBoxEntry& entry);
+  // Marks the record from peekOldest() as copied to SD
+  bool markDrained();
+
+  // Erases up to maxSectors that hold nothing to drain, starting at the
+  // writer, so the next appends are programs only. Returns the count.
+  int eraseAhead(int maxSectors);
+  // Sectors the writer will reach before it needs an in-line erase
+  uint32_t getErasedAhead() const;
+
+  uint32_t getPending() const { return pending; }
+  uint32_t getCapacity() const { return capacity; }
+  uint32_t getSectorCount() const { return sectors; }
+  const BlackBoxStats& getStats() const { return stats; }
+
+private:
+  BlackBoxFlash flash;
+  bool ready;
+  uint32_t sectors;
+  uint32_t perSector;    // Entries per sector
+  uint32_t capacity;     // Entries in the ring
+  uint32_t head;         // Next entry to write
+  uint32_t tail;         // Oldest entry to drain
+  uint32_t pending;
+  uint32_t nextSeq;
+  uint8_t erased[BLACKBOX_MAX_SECTORS / 8];  // Sector is known to be blank
+  BlackBoxStats stats;
+
+  uint32_t entryOffset(uint32_t index) const;
+  bool isErased(uint32_t sector) const;
+  void setErased(uint32_t sector, bool value);
+  bool eraseSector(uint32_t sector);
+  static uint32_t entryCrc(const BlackBoxEntry& entry);
+};
+
+#endif
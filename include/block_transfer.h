@@ -0,0 +1,51 @@
+#ifndef BLOCK_TRANSFER_H
+#define BLOCK_TRANSFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+// Line formats for the radio log downlink (portable, shared with the ground
+// tools). Both lines carry the same CRC-16 trailer as command frames.
+//
+// Block:   BLK,<id>,<block>,<base64 data>*<crc16>
+// Status:  XFER,<id>,<state>,<blocks_sent>,<bytes_sent>,<elapsed_ms>,<link_pct>*<crc16>
+//
+// <id> identifies the file (CRC-16 of its name) so stale blocks from an
+// earlier transfer are never written into the wrong output. <state> is IDLE
+// once every queued range has been sent, STOP when the transfer ends, or
+// ERROR when the board could not read the file and gave up.
+
+#define BLOCK_FRAME_PREFIX "BLK,"
+#define XFER_FRAME_PREFIX "XFER,"
+#define XFER_STATE_IDLE "IDLE"
+#define XFER_STATE_STOP "STOP"
+#define XFER_STATE_ERROR "ERROR"
+
+#define BLOCK_BASE64_SIZE(n) ((((n) + 2) / 3) * 4)
+#define BLOCK_LINE_MAX_LENGTH (BLOCK_BASE64_SIZE(DOWNLINK_BLOCK_SIZE) + 40)
+
+struct BlockRange {
+  uint32_t first;
+  uint32_t last;  // Inclusive
+};
+
+class BlockTransfer {
+public:
+  static uint16_t fileId(const char* fileName);
+  static uint32_t blockCount(uint32_t fileSize);
+
+  static size_t formatBlock(char* buffer, size_t capacity, uint16_t id, uint32_t block,
+                            const uint8_t* data, size_t len);
+  // data must hold DOWNLINK_BLOCK_SIZE bytes
+  static bool parseBlock(const char* line, uint16_t& id, uint32_t& block, uint8_t* data, size_t& len);
+
+  // Parses "a-b,c-d,e" into ranges; returns the count or -1 on bad syntax
+  static int parseRanges(const char* spec, BlockRange* ranges, int maxRanges);
+  static size_t formatRanges(char* buffer, size_t capacity, const BlockRange* ranges, int count);
+
+  static size_t base64Encode(const uint8_t* data, size_t len, char* out);
+  static int base64Decode(const char* text, size_t len, uint8_t* out, size_t capacity);
+};
+
+#endif
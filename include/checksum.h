@@ -0,0 +1,16 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Portable checksums shared by the firmware and the ground tools
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+uint16_t crc16Ccitt(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF);
+
+// CRC-32/ISO-HDLC (zlib's crc32). Pass the previous result to continue
+// over the next piece of the same data.
+uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef COMMAND_PROTOCOL_H
+#define COMMAND_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+// Reliable command uplink framing (portable, shared with the ground tools).
+//
+// Command:  CMD,<seq>,<name>[,<args>]*<crc16>
+// Ack:      ACK,<seq>,<status>,<exec_us>[,<detail>]*<crc16>
+//
+// The CRC is CRC-16/CCITT over every character before '*', written as four
+// upper-case hex digits. Sequence numbers let the board execute each command
+// once and answer retransmissions with the cached ack.
+
+#define CMD_FRAME_PREFIX "CMD,"
+#define ACK_FRAME_PREFIX "ACK,"
+
+#define ACK_STATUS_OK "OK"
+#define ACK_STATUS_BUSY "BUSY"
+#define ACK_STATUS_UNKNOWN "UNKNOWN"
+#define ACK_STATUS_ERROR "ERR"
+
+struct CommandFrame {
+  uint32_t seq;
+  char name[CMD_MAX_NAME_LENGTH];
+  char args[CMD_MAX_ARGS_LENGTH];
+};
+
+struct AckFrame {
+  uint32_t seq;
+  char status[12];
+  uint32_t execMicros;
+  char detail[CMD_MAX_ARGS_LENGTH];
+};
+
+class CommandProtocol {
+public:
+  // Validates the trailing CRC and splits the frame. Returns false for
+  // anything that is not an intact CMD frame.
+  static bool parseCommand(const char* line, CommandFrame& frame);
+  static bool parseAck(const char* line, AckFrame& ack);
+
+  // Format complete frames including CRC and '\n'. Return length, 0 on overflow.
+  static size_t formatCommand(char* buffer, size_t capacity, uint32_t seq, const char* name, const char* args);
+  static size_t formatAck(char* buffer, size_t capacity, uint32_t seq, const char* status,
+                          uint32_t execMicros, const char* detail);
+
+  // Checks and strips "*XXXX"; returns the length of the protected text or -1
+  static int verifyCrc(const char* line);
+
+  // Appends "*XXXX\n" to buffer[0..len); returns the new length, 0 on overflow.
+  // Used for every CRC-protected line (commands, acks, transfer blocks, events).
+  static size_t appendCrc(char* buffer, size_t len, size_t capacity);
+};
+
+#endif
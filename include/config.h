@@ -34,25 +34,113 @@
 #define RADIO_BAUD_RATE 115200
 
 // I2C settings
-#define I2C_FREQUENCY 100000
+#define I2C_FREQUENCY 400000  // Fast mode: the IMU FIFO at 1 kHz needs ~110 kbit/s
 
 // Timing settings (in milliseconds)
-#define SENSOR_READ_INTERVAL 10      // Fast sensors (IMU) read interval
-#define PRESSURE_READ_INTERVAL 50     // Slow sensors (pressure) read interval
-#define POWER_READ_INTERVAL 50      // Power monitoring read interval
+#define SENSOR_READ_INTERVAL 10      // Fastest IMU read interval (boost and apogee)
+#define PRESSURE_READ_INTERVAL 50     // Fastest pressure read interval
+#define POWER_READ_INTERVAL 50      // Fastest power monitoring read interval
 #define GPS_READ_INTERVAL 1000       // GPS read interval (1 second)
-#define RADIO_LISTEN_INTERVAL 500
+#define SLEEP_IMU_INTERVAL 100       // IMU read interval in sleep mode (pressure and GPS off)
+#define IMU_FIFO_INTERVAL 1          // Fastest raw IMU sample interval through the FIFO (1 kHz)
+#define SLEEP_IMU_FIFO_INTERVAL 5    // Raw IMU sample interval in sleep mode
+#define WEB_IMU_INTERVAL 500         // Output interval of the web UI's IMU stream
+#define RADIO_LISTEN_INTERVAL 50     // Command polling is non-blocking, keep uplink latency low
 #define RADIO_TX_INTERVAL 100        // Radio transmission interval (100ms = 10Hz)
 #define HEARTBEAT_INTERVAL 2000
 #define MAINTENANCE_TIMEOUT 300000   // 5 minutes
 #define RSSI_QUERY_INTERVAL 10000    // 10 seconds
 
+// Altitude/vertical velocity Kalman filter (see altitude_estimator.h)
+#define ALT_KF_ACCEL_NOISE 2.0f      // Vertical acceleration uncertainty (m/s^2)
+#define ALT_KF_BARO_NOISE 1.5f       // Baro altitude noise (m)
+#define ALT_KF_GATE_SIGMA 5.0f       // Reject baro readings beyond this many sigma
+#define ALT_KF_MAX_REJECTS 10        // Consecutive rejections before re-seeding from baro
+#define ALT_KF_MAX_DT 0.1f           // Longest single prediction step (s)
+#define ALT_KF_BARO_TIMEOUT 1000     // Estimate is invalid after this long without baro (ms)
+
+// GPS/INS position and velocity filter (see nav_filter.h)
+#define NAV_ACCEL_NOISE 1.0f         // Earth-frame acceleration uncertainty (m/s^2)
+#define NAV_BIAS_NOISE 0.02f         // Accel bias random walk (m/s^2 per sqrt(s))
+#define NAV_YAW_NOISE 0.005f         // AHRS heading drift (rad per sqrt(s))
+#define NAV_GPS_H_NOISE 2.5f         // GPS horizontal position noise (m)
+#define NAV_GPS_V_NOISE 5.0f         // GPS altitude noise (m)
+#define NAV_BARO_NOISE 1.5f          // Baro altitude noise (m)
+#define NAV_INIT_VEL_SIGMA 1.0f      // Velocity uncertainty at the first fix (m/s)
+#define NAV_INIT_BIAS_SIGMA 0.3f     // Accel bias uncertainty at the first fix (m/s^2)
+#define NAV_ALIGN_DV 20.0f           // Horizontal speed change needed to align the AHRS heading (m/s)
+#define NAV_GATE_SIGMA 5.0f          // Reject fixes beyond this many sigma
+#define NAV_MAX_REJECTS 5            // Consecutive rejected fixes before restarting at the fix
+#define NAV_MAX_DT 0.1f              // Longest single prediction step (s)
+#define NAV_GPS_TIMEOUT 5000         // Estimate is invalid after this long without a fix (ms)
+
+// GPS time discipline (see time_discipline.h)
+#define GPS_PPS_PIN -1               // GPIO wired to the receiver's PPS output, -1 if not connected
+#define GPS_BURST_GAP 200            // Quiet UART time that separates two epochs' NMEA bursts (ms)
+#define TIME_NMEA_LATENCY_MS 150     // NMEA arrival after its epoch until a PPS measures it (ms)
+#define TIME_NMEA_JITTER_MS 5.0      // Receiver output jitter of the NMEA burst (ms)
+#define TIME_PPS_NOISE_US 5.0        // PPS edge timestamp jitter (us)
+#define TIME_PHASE_NOISE 1.0         // Local clock phase noise (us^2 per s)
+#define TIME_DRIFT_WANDER 0.02       // Crystal frequency random walk (ppm per sqrt(s))
+#define TIME_INIT_DRIFT_SIGMA 50.0   // Crystal frequency uncertainty at the first sync (ppm)
+#define TIME_GATE_SIGMA 5.0          // Reject time samples beyond this many sigma
+#define TIME_MAX_REJECTS 5           // Consecutive rejections before stepping to the new time
+#define TIME_PPS_WINDOW_MS 200       // Ignore PPS edges further than this from a predicted second (ms)
+#define TIME_PPS_TIMEOUT 3000        // PPS lock is lost after this long without an edge (ms)
+#define TIME_LATENCY_FILTER 0.1      // Weight per sample of the NMEA latency measured under PPS
+
+// Attitude filter (Madgwick AHRS, see attitude_estimator.h)
+#define AHRS_BETA 0.1f               // Correction gain toward gravity/field (rad/s)
+#define AHRS_ACCEL_GATE 0.15f        // Accel correction only while |a| is within this many g of 1 g
+#define AHRS_USE_MAG 0               // 1 = fuse the magnetometer for yaw (needs a calibrated mag)
+#define AHRS_MAX_DT 0.2f             // Longest single gyro integration step (s)
+
+// IMU batch acquisition and decimation (see imu_decimator.h)
+#define IMU_FIFO_ENABLED 1           // 1 = MPU9250 FIFO batches decimated per consumer, 0 = one read per cycle
+
+// Vibration spectra of the FIFO samples in flight (see vibration_analyzer.h)
+#define VIB_ANALYSIS_ENABLED 1       // 1 = FFT summaries while in flight mode (needs IMU_FIFO_ENABLED)
+#define VIB_SUMMARY_INTERVAL 1000    // Spectra averaged into one summary (ms)
+#define VIB_DOWNLINK 1               // 1 = also send each summary's peaks over the radio
+#define VIB_QUEUE_LENGTH 2           // Summaries waiting for the radio
+#define VIB_PREFIX "VIB,"
+
+// IMU full-scale ranges (see imu_range.h)
+#define IMU_ACCEL_RANGE 1            // Starting and lowest accel range: 0=2g 1=4g 2=8g 3=16g
+#define IMU_GYRO_RANGE 0             // Starting and lowest gyro range: 0=250 1=500 2=1000 3=2000 deg/s
+#define IMU_AUTO_RANGE 1             // 1 = switch ranges on saturation/headroom, 0 = fixed
+#define IMU_RANGE_UP_FRACTION 0.9f   // Step up once a reading passes this fraction of full scale
+#define IMU_RANGE_DOWN_FRACTION 0.4f // Step down after readings stay below this fraction...
+#define IMU_RANGE_DOWN_HOLD 50       // ...for this many samples in a row
+#define IMU_RANGE_SETTLE_MS 3        // Wait before re-reading a clipped sample in the new range
+
+// IMU calibration (see imu_calibration.h)
+#define IMU_CAL_GYRO_SAMPLES 200           // Samples averaged for the gyro bias
+#define IMU_CAL_ACCEL_SAMPLES 100          // Samples averaged per accelerometer face
+#define IMU_CAL_MAG_MIN_SAMPLES 300        // Samples needed before the ellipsoid fit
+#define IMU_CAL_REST_MAX_STDDEV_GYRO 1.0f  // Gyro noise above this (deg/s) means the board moved
+#define IMU_CAL_REST_MAX_STDDEV_ACCEL 0.02f  // Accel noise above this (g) means the board moved
+#define IMU_CAL_ACCEL_MIN_AXIS 0.8f        // The face axis must read at least this many g
+#define CMD_CAL_GYRO "CAL_GYRO"            // Hold still
+#define CMD_CAL_ACCEL "CAL_ACCEL"          // CAL_ACCEL,<+X|-X|+Y|-Y|+Z|-Z> with that axis up
+#define CMD_CAL_MAG_START "CAL_MAG_START"  // Then rotate through all orientations
+#define CMD_CAL_MAG_END "CAL_MAG_END"
+#define CMD_CAL_STATUS "CAL_STATUS"
+#define CMD_CAL_CANCEL "CAL_CANCEL"
+#define CMD_CAL_CLEAR "CAL_CLEAR"          // Back to uncalibrated, erases the saved values
+
+// Downlink forward error correction (Reed-Solomon, see fec_codec.h)
+#define RADIO_FEC_ENABLED 0          // 1 = wrap each telemetry line in an FEC frame
+#define FEC_PARITY_BYTES 8           // Parity bytes per codeword (corrects 4 byte errors each)
+#define FEC_BLOCK_DATA_BYTES 64      // Max payload bytes per interleaved codeword
+#define FEC_MAX_PAYLOAD 512          // Largest payload accepted by the encoder
+
 // Threading settings
-#define BACKGROUND_TASK_STACK_SIZE 4096
+#define BACKGROUND_TASK_STACK_SIZE 8192   // SD batch writes and retention run on this stack
 #define BACKGROUND_TASK_PRIORITY 1      // Lower priority than main loop (which runs at priority 1)
 #define BACKGROUND_TASK_CORE 0          // Run on core 0 (main loop typically runs on core 1)
 
-#define SENSOR_TASK_STACK_SIZE 4096
+#define SENSOR_TASK_STACK_SIZE 6144   // Vibration summaries are formatted for the SD log on this stack
 #define SENSOR_TASK_PRIORITY 2          // Higher priority than background task
 #define SENSOR_TASK_CORE 0              // Run on core 0 with background task
 
@@ -63,25 +151,104 @@
 
 // SD Card settings
 #define SD_BATCH_SIZE 100       // Number of telemetry records per batch
-#define SD_MAX_LOG_FILES 2000     // Maximum number of log files to keep
-#define SD_SPI_SPEED 4000000    // SD card SPI speed (4MHz)
+#define SD_BATCH_CAPACITY 150   // Records the sensor task can queue while the last batch is written
+#define SD_SIDE_LOG_QUEUE_LENGTH 8  // Event and vibration lines waiting for the background task
+#define SD_SIDE_LINE_LENGTH 400     // Longest event or vibration line (VIB_CSV_LINE_LENGTH)
+#define SD_BATCH_MAX_AGE 10000  // Write a partial batch after this long (slow phases log ~1 row/s)
+#define SD_KEYFRAME_INTERVAL 1000  // Full row at least this often between tagged records (ms, sd_record.h)
+#define SD_ATTITUDE_DEADBAND 0.5f  // Roll, pitch or yaw change that logs the attitude between samples (deg)
+#define SD_ALTITUDE_DEADBAND 0.2f  // Filtered altitude change that logs it between baro readings (m)
+#define SD_VELOCITY_DEADBAND 0.2f  // Filter velocity change that logs it between readings (m/s)
+#define SD_NAV_DEADBAND 45         // GPS/INS position change that logs it between fixes (1e-7 deg, ~0.5 m)
+#define SD_MAX_LOG_FILES 2000     // Logs kept by retention, oldest deleted first (log_index.h)
+#define SD_MAX_LOG_MB 4096        // Size of the logs kept, side files included (MB)
+#define SD_INDEX_SAVE_INTERVAL 10000  // Save the current log's index line this often (ms)
+#define SD_SPACE_RECONCILE_INTERVAL 60000  // Recount used space from the card this often, on the ground (ms)
+#define SD_WRITE_BUFFER_SIZE 4096  // Log staging buffer, whole 512-byte sectors (sector_writer.h)
+#define SD_BENCH_FILE "/sdbench.tmp"  // Scratch file of the SD_BENCH command, deleted after
+#define SD_BENCH_BYTES 65536      // Written per batch size and write path by SD_BENCH
+#define SD_BENCH_BATCH_SIZES {1, 10, 25, SD_BATCH_SIZE}  // Records per block tried by SD_BENCH
+#define SD_SPI_SPEED 4000000    // SD card SPI speed at mount, before the self-test (4MHz)
+#define SD_SPI_SPEEDS {1000000, 4000000, 8000000, 16000000, 20000000, 40000000}  // Clocks the self-test steps through, slowest first (Hz)
+#define SD_SPEED_TEST_FILE "/speed.tmp"  // Scratch file of the clock self-test, deleted after
+#define SD_SPEED_TEST_BYTES 16384  // Written and read back at each clock by the self-test
+#define SD_FULL_MARGIN 1048576     // A write that fails with less free than this is a full card, not the clock (bytes)
 #define SD_HEALTH_CHECK_INTERVAL 2000  // Check card health every 2 seconds
 #define SD_MAX_CONSECUTIVE_FAILURES 3   // Max failures before trying other card
 #define SD_RETRY_INTERVAL 1000  // Retry SD initialization every 10 seconds when both fail
+#define BLACKBOX_PARTITION_LABEL "blackbox"  // Flash partition that holds records while both cards are down
+#define BLACKBOX_DRAIN_RECORDS 20  // Black box records copied back to SD per update() (10 Hz, on the ground)
+#define BLACKBOX_ERASE_INTERVAL 100  // Erase one black box sector ahead this often on the ground (ms)
 
 // Radio commands
 #define CMD_FLIGHT_MODE "FLIGHT"
 #define CMD_SLEEP_MODE "SLEEP"
 #define CMD_MAINTENANCE_MODE "MAINT"
 #define CMD_CAM_TOGGLE "CAM_TOGGLE"
+#define CMD_PING "PING"                 // Ack detail carries board millis() for clock offset
+#define CMD_LINK_REPORT "LINK_REPORT"   // LINK_REPORT,<received>,<lost>,<jitter_us>,<latency_ms>
+#define CMD_SD_BENCH "SD_BENCH"         // SD write benchmark on the ground, results on Serial
+
+// Command uplink framing (see command_protocol.h)
+#define CMD_MAX_NAME_LENGTH 16
+#define CMD_MAX_ARGS_LENGTH 64
+#define CMD_MAX_LINE_LENGTH 128
+
+// Radio log downlink (post-landing bulk transfer, see log_downlink.h)
+#define RADIO_LINK_CAPACITY_BPS 64000     // RFD900x air data rate in bits/s
+#define DOWNLINK_LINK_SHARE_PERCENT 80    // Share of the link used for file blocks
+#define DOWNLINK_BLOCK_SIZE 128           // File bytes per block
+#define DOWNLINK_READ_CHUNK 1024          // SD read size (multiple of DOWNLINK_BLOCK_SIZE)
+#define DOWNLINK_MAX_RANGES 8             // Pending selective-repeat ranges
+#define DOWNLINK_TELEMETRY_INTERVAL 1000  // Telemetry interval while a transfer runs
+#define DOWNLINK_PERSIST_BLOCKS 64        // Save the transfer cursor to NVS every N blocks
+#define CMD_DOWNLINK_START "DL_START"     // DL_START,<file>[,<first>,<last>]
+#define CMD_DOWNLINK_RANGE "DL_RANGE"     // DL_RANGE,<a>-<b>[,<c>-<d>...]
+#define CMD_DOWNLINK_STOP "DL_STOP"
+#define CMD_DOWNLINK_STATUS "DL_STATUS"
 
 // Mode persistence settings
 #define PREFS_NAMESPACE "rocketESP32"
 #define PREFS_MODE_KEY "lastMode"
+#define PREFS_DOWNLINK_FILE_KEY "dlFile"
+#define PREFS_DOWNLINK_NEXT_KEY "dlNext"
+#define PREFS_DOWNLINK_LAST_KEY "dlLast"
+#define PREFS_IMU_CAL_KEY "imuCal"
+
+// Fast resume after a reset in flight (see rtc_state.h)
+#define RTC_STATE_SAVE_INTERVAL 50        // In-flight state snapshot to RTC memory (ms)
+#define RTC_STATE_MAX_RESUMES 3           // Fast resumes per flight before falling back to a full boot
 
 // Flight mode acceleration threshold (in g)
 #define FLIGHT_MODE_ACCEL_THRESHOLD 2.0  // 2G threshold for automatic flight mode activation
 
+// Flight event detection (see flight_events.h)
+#define FLIGHT_EVENT_VOTE_WINDOW 4        // Samples considered by each vote (max 32)
+#define FLIGHT_LAUNCH_VOTES 3             // Samples >= FLIGHT_MODE_ACCEL_THRESHOLD (or climbed) to launch
+#define FLIGHT_BURNOUT_VOTES 3            // Samples with negative vertical acceleration
+#define FLIGHT_APOGEE_VOTES 3             // Samples with non-positive vertical velocity
+#define FLIGHT_LAUNCH_ALTITUDE 30.0f      // Baro backup: filtered altitude above pad counts as launch (m)
+#define FLIGHT_APOGEE_DROP 10.0f          // Altitude below the peak that counts as past apogee (m)
+#define FLIGHT_LANDED_VELOCITY 2.0f       // |vertical velocity| below this counts as stopped (m/s)
+#define FLIGHT_LANDED_ACCEL_TOLERANCE 0.1f  // Without baro: |a| within this of 1 g counts as stopped
+#define FLIGHT_LANDED_HOLD 2000           // Stopped this long before LANDED (ms)
+#define FLIGHT_EVENT_QUEUE_LENGTH 8       // Events waiting for the radio
+#define FLIGHT_EVENT_PREFIX "EVENT,"
+
+// Per-phase sensor and SD log intervals in ms (see SampleRates below).
+// Boost and the apogee window run at full rate; the long descent and the
+// ground are thinned to save SD bytes and CPU. The FIFO column is the raw
+// IMU sample interval; a sensor task period must fit in the 42-sample FIFO.
+//                      IMU  pressure  power  GPS   SD log  FIFO
+#define RATES_PAD     {  25,   100,     200,  1000,  100,    5 }
+#define RATES_BOOST   { SENSOR_READ_INTERVAL, PRESSURE_READ_INTERVAL, POWER_READ_INTERVAL, GPS_READ_INTERVAL, SENSOR_READ_INTERVAL, IMU_FIFO_INTERVAL }
+#define RATES_COAST   {  25,    50,     200,  1000,   25,    1 }
+#define RATES_APOGEE  { SENSOR_READ_INTERVAL, PRESSURE_READ_INTERVAL, POWER_READ_INTERVAL, GPS_READ_INTERVAL, SENSOR_READ_INTERVAL, IMU_FIFO_INTERVAL }
+#define RATES_DESCENT {  50,   100,     500,  1000,  100,    5 }
+#define RATES_LANDED  { 100,   500,    1000,  1000, 1000,    5 }
+#define RATES_APOGEE_VELOCITY 40.0f  // Coast below this vertical speed uses RATES_APOGEE (m/s)
+#define RATES_APOGEE_HOLD 3000       // RATES_APOGEE kept this long after the apogee event (ms)
+
 // System states
 enum SystemMode {
   MODE_SLEEP,
@@ -89,10 +256,28 @@ enum SystemMode {
   MODE_MAINTENANCE
 };
 
+enum FlightPhase {
+  PHASE_PAD,
+  PHASE_BOOST,
+  PHASE_COAST,
+  PHASE_DESCENT,
+  PHASE_LANDED
+};
+
+// Sample and log intervals for one flight phase (ms)
+struct SampleRates {
+  uint16_t imu;        // Sensor task period
+  uint16_t pressure;
+  uint16_t power;
+  uint16_t gps;
+  uint16_t sdLog;      // Minimum spacing of SD log rows
+  uint16_t imuFifo;    // Raw IMU sample interval (FIFO rate)
+};
+
 // Data packet structure
 struct TelemetryData {
-  float latitude;
-  float longitude;
+  int32_t latitude;                      // 1e-7 degrees (geo_coord.h)
+  int32_t longitude;
   float altitude_gps;
   float altitude_pressure;
   float pressure;
@@ -114,6 +299,38 @@ struct TelemetryData {
   float current;                         // Current (mA)
   float power;                           // Power (mW)
   bool power_valid;                      // Power data validity
+  
+  // Kalman filtered baro + accelerometer state
+  float altitude_filtered;               // Altitude (m)
+  float vertical_velocity;               // Vertical velocity (m/s, positive up)
+  bool estimator_valid;                  // Filter has recent baro data
+  FlightPhase flight_phase;              // Flight event detector phase
+  
+  // AHRS attitude (body to earth, z up)
+  float quat_w, quat_x, quat_y, quat_z;  // Unit quaternion
+  float roll, pitch, yaw;                // Euler angles, ZYX (deg)
+  bool attitude_valid;                   // Filter aligned from a rest reading
+  
+  // IMU full-scale range of this sample
+  float accel_range;                     // Accelerometer full scale (g)
+  float gyro_range;                      // Gyroscope full scale (deg/s)
+  bool imu_clipped;                      // A raw count hit the rail
+  
+  // GPS/INS position and velocity at IMU rate
+  int32_t nav_latitude, nav_longitude;   // 1e-7 degrees
+  float velocity_east, velocity_north;   // m/s
+  bool nav_valid;                        // Filter has had a fix within NAV_GPS_TIMEOUT
+  
+  // GPS-disciplined UTC of this record
+  int64_t utc_ms;                        // ms since 1970, 0 until the first GPS time
+  uint8_t time_source;                   // TimeSource (time_discipline.h): 0 none, 1 NMEA, 2 PPS
+  
+  // When each sensor's sample in this record was taken (esp_timer us since
+  // boot, the same clock as utc_ms); 0 until the sensor has been read
+  int64_t gps_time_us;                   // Fix epoch: NMEA arrival less the NMEA latency
+  int64_t pressure_time_us;              // Conversion start
+  int64_t imu_time_us;                   // Register read / newest FIFO sample
+  int64_t power_time_us;                 // Register reads
 };
 
 #endif
@@ -0,0 +1,96 @@
+#ifndef FEC_CODEC_H
+#define FEC_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+// Reed-Solomon forward error correction for the radio downlink.
+//
+// This module has no Arduino dependencies so the ground tools can link the
+// exact same encoder/decoder as the firmware.
+//
+// Frame layout (all multi-byte fields little endian):
+//   [FEC_SYNC_0][FEC_SYNC_1][len16][len16][len16][payload...][parity...]
+//
+// The payload length is sent three times and recovered by bitwise majority
+// vote. The payload is split across D = ceil(len / FEC_BLOCK_DATA_BYTES)
+// interleaved codewords (codeword j owns payload bytes j, j+D, j+2D, ...),
+// so a burst of up to D * FEC_PARITY_BYTES / 2 bytes is correctable. The
+// payload is sent unmodified (systematic code), so a plain serial terminal
+// still shows the ASCII telemetry line.
+
+#define FEC_SYNC_0 0xA5
+#define FEC_SYNC_1 0x5A
+#define FEC_HEADER_SIZE 8
+#define FEC_MAX_CODEWORDS ((FEC_MAX_PAYLOAD + FEC_BLOCK_DATA_BYTES - 1) / FEC_BLOCK_DATA_BYTES)
+#define FEC_MAX_FRAME_SIZE (FEC_HEADER_SIZE + FEC_MAX_PAYLOAD + FEC_MAX_CODEWORDS * FEC_PARITY_BYTES)
+
+class ReedSolomon {
+public:
+  // Computes nsym parity bytes for data[0..len). len + nsym must be <= 255.
+  static void encode(const uint8_t* data, size_t len, uint8_t* parity, int nsym);
+
+  // Corrects a codeword (data followed by nsym parity bytes) in place.
+  // Returns the number of corrected bytes, or -1 if uncorrectable.
+  static int decode(uint8_t* codeword, size_t len, int nsym);
+
+private:
+  static uint8_t gfMul(uint8_t a, uint8_t b);
+  static uint8_t gfDiv(uint8_t a, uint8_t b);
+  static uint8_t gfPow2(int e);
+  static void initTables();
+  static const uint8_t* generator(int nsym);
+};
+
+class FecCodec {
+public:
+  // Total bytes on the wire for a payload of the given length
+  static size_t frameSize(size_t payloadLen);
+  static size_t codewordCount(size_t payloadLen);
+
+  // Encodes payload into frame. Returns frame length, or 0 if it doesn't fit.
+  static size_t encodeFrame(const uint8_t* payload, size_t len, uint8_t* frame, size_t frameCapacity);
+
+  // Corrects a received body (payload followed by parity) in place.
+  // Returns corrected byte count, or -1 if any codeword is uncorrectable.
+  static int decodeBody(uint8_t* body, size_t payloadLen);
+};
+
+// Streaming receiver: hunts for sync, votes on the length and decodes each
+// frame as bytes arrive. Bytes outside frames are reported as raw text.
+class FecDeframer {
+public:
+  struct Stats {
+    uint32_t framesDecoded;
+    uint32_t framesFailed;
+    uint32_t bytesCorrected;
+    uint32_t headerErrors;
+  };
+
+  typedef void (*FrameCallback)(const uint8_t* payload, size_t len, int corrected, void* context);
+  typedef void (*RawCallback)(uint8_t byte, void* context);
+
+  FecDeframer(FrameCallback onFrame, RawCallback onRaw, void* context);
+
+  void push(uint8_t byte);
+  void reset();
+  const Stats& getStats() const { return stats; }
+
+private:
+  enum State { HUNT, SYNC, HEADER, BODY };
+
+  State state;
+  uint8_t header[FEC_HEADER_SIZE - 2];
+  size_t headerPos;
+  uint8_t body[FEC_MAX_FRAME_SIZE];
+  size_t bodyPos;
+  size_t bodyLen;
+  size_t payloadLen;
+  Stats stats;
+  FrameCallback onFrame;
+  RawCallback onRaw;
+  void* context;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef FLIGHT_EVENTS_H
+#define FLIGHT_EVENTS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+// Flight-phase state machine driven by the filtered sensor streams:
+//
+//   PAD --launch--> BOOST --burnout--> COAST --apogee--> DESCENT --landing--> LANDED
+//
+// Each transition condition is voted over the last FLIGHT_EVENT_VOTE_WINDOW
+// samples, so a single bad sample cannot fire an event. An event records
+// when its condition first held (onset) and when the vote passed
+// (detection), so the debounce latency of every event is known.
+//
+// This module has no Arduino dependencies so the ground tools can replay
+// simulated and logged flights through the same detector.
+
+enum FlightEventType {
+  EVENT_LAUNCH,
+  EVENT_BURNOUT,
+  EVENT_APOGEE,
+  EVENT_LANDING
+};
+
+struct FlightEvent {
+  FlightEventType type;
+  uint32_t onsetMs;    // First sample satisfying the condition
+  uint32_t detectMs;   // Sample on which the vote passed
+  float altitude;      // Filtered altitude at detection (m)
+  float velocity;      // Filtered vertical velocity at detection (m/s)
+};
+
+struct FlightEventInput {
+  uint32_t timeMs;
+  bool imuValid;
+  float accelMagnitude;   // |a| in g
+  float verticalAccel;    // m/s^2, gravity removed, positive up
+  bool estimatorValid;
+  float altitude;         // Filtered altitude (m)
+  float velocity;         // Filtered vertical velocity (m/s)
+};
+
+class FlightEventDetector {
+public:
+  FlightEventDetector();
+
+  void reset();
+  FlightPhase getPhase() const { return phase; }
+
+  // Picks up a flight after a reset: the phase, and the pad altitude the
+  // baro backup is measured from (NAN if there wasn't one yet)
+  void resume(FlightPhase resumePhase, float resumePadAltitude, float resumeMaxAltitude);
+  float getPadAltitude() const;
+  float getMaxAltitude() const { return maxAltitude; }
+
+  // Feeds one sample. Returns true and fills event when a transition fires.
+  bool update(const FlightEventInput& input, FlightEvent& event);
+
+  static const char* eventName(FlightEventType type);
+  static const char* phaseName(FlightPhase phase);
+
+  // EVENT,<name>,<onset_ms>,<detect_ms>,<tx_ms>,<alt>,<vel>*<crc16>\n
+  static size_t formatEvent(char* buffer, size_t capacity, const FlightEvent& event, uint32_t txMs);
+
+private:
+  // M-of-N vote over the most recent samples
+  struct Vote {
+    uint32_t history;   // Bit 0 = newest sample
+    uint32_t onsetMs;
+    void clear() { history = 0; onsetMs = 0; }
+    bool add(bool condition, uint32_t timeMs, int required);
+  };
+
+  void enterPhase(FlightPhase next);
+  void fire(FlightEventType type, uint32_t onsetMs, const FlightEventInput& input, FlightEvent& event);
+
+  FlightPhase phase;
+  Vote vote;
+  float padAltitude;     // Low-passed filtered altitude while on the pad
+  bool havePadAltitude;
+  float maxAltitude;
+  uint32_t stoppedSinceMs;
+  bool stopped;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef GEO_COORD_H
+#define GEO_COORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Fixed-point coordinates shared by the firmware and the ground tools.
+//
+// Latitude and longitude are int32 in units of 1e-7 degree (1.1 cm at the
+// equator), from the NMEA parser through the filters to the SD log, radio
+// and web outputs. A float degree value only has 24 bits of mantissa, which
+// is about a metre at typical longitudes. Parsing and formatting are
+// integer-only, so no float or double formatting is needed for positions.
+
+#define COORD_SCALE 10000000L       // Units per degree
+#define COORD_TEXT_LENGTH 13        // "-180.0000000" and the terminator
+
+// Parses an NMEA ddmm.mmmm / dddmm.mmmm field with its N/S/E/W hemisphere.
+// Returns false on a malformed or out-of-range field.
+bool parseNmeaCoordinate(const char* field, char hemisphere, int32_t& value);
+
+// Writes value as signed decimal degrees with 7 decimals, terminated.
+// Returns the length, or 0 if it didn't fit.
+size_t formatCoordinate(char* buffer, size_t capacity, int32_t value);
+
+// Conversions for the ground tools and text parsing, rounded to nearest
+int32_t coordFromDegrees(double degrees);
+double coordToDegrees(int32_t value);
+
+#endif
@@ -4,23 +4,69 @@
 #include <Arduino.h>
 #include <HardwareSerial.h>
 #include "config.h"
+#include "geo_coord.h"
+#include "time_discipline.h"
+
+#define GPS_LINE_LENGTH 96   // NMEA sentences are at most 82 characters
 
 class GPSModule {
 private:
   HardwareSerial* gpsSerial;
   bool initialized;
   
+  // Sentence assembly, fed by poll()
+  char lineBuffer[GPS_LINE_LENGTH];
+  size_t lineLength;
+  int64_t lastPollUs;          // esp_timer time of the last poll
+  int64_t lastByteUs;          // Poll that last found bytes
+  int64_t burstArrivalUs;      // Estimated start of the current epoch's burst
+  float burstSigmaUs;          // and its uncertainty (the poll interval)
+  
+  // Newest fix and time, until read
+  bool fixPending;
+  int32_t fixLatitude, fixLongitude;
+  float fixAltitude;
+  int64_t fixArrivalUs;
+  bool timePending;
+  int64_t timeUtcMs;
+  int64_t timeArrivalUs;
+  float timeArrivalSigmaUs;
+  int32_t utcDay;              // Days since 1970 from the last RMC, -1 until one
+  int32_t utcDayMs;            // Time of day of that RMC
+  
+  // PPS edge captured in the interrupt
+  static volatile int64_t ppsEdgeUs;
+  static volatile uint32_t ppsCount;
+  static portMUX_TYPE ppsMux;
+  uint32_t ppsCountRead;
+  static void IRAM_ATTR onPps();
+  
   // NMEA parsing helpers
   bool parseNMEA(String nmea);
-  bool parseGGA(String gga, float& lat, float& lon, float& alt);
-  float parseCoordinate(String coord, char direction);
+  void processSentence(const String& nmea);
+  bool parseGGA(String gga, int32_t& lat, int32_t& lon, float& alt, int32_t& msOfDay);
+  bool parseRMC(String rmc, int32_t& days, int32_t& msOfDay);
+  void setTime(int32_t days, int32_t msOfDay);
 
 public:
   GPSModule();
   ~GPSModule();
   
-  void initialize();
-  bool readData(float& latitude, float& longitude, float& altitude);
+  // warmStart: the board reset but the part kept power, so the power-up
+  // waits are skipped (fast resume in flight)
+  void initialize(bool warmStart = false);
+  // Reads what the UART has without blocking; call every sensor cycle so
+  // the NMEA bursts are timestamped to within a cycle
+  void poll();
+  // Newest fix since the last call. Latitude and longitude in 1e-7
+  // degrees (geo_coord.h), altitude in m; arrivalUs is the esp_timer time
+  // its burst started arriving (the fix is older by the NMEA latency)
+  bool readData(int32_t& latitude, int32_t& longitude, float& altitude, int64_t& arrivalUs);
+  // Newest receiver UTC (ms since 1970) since the last call, with the
+  // esp_timer time its burst started arriving and that time's uncertainty
+  bool readTime(int64_t& arrivalUs, float& arrivalSigmaUs, int64_t& utcMs);
+  // Newest PPS edge (esp_timer us) since the last call
+  bool readPps(int64_t& edgeUs);
   bool isValid();
 };
 
@@ -0,0 +1,129 @@
+#ifndef IMU_CALIBRATION_H
+#define IMU_CALIBRATION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+// IMU calibration: gyro bias, six-position accelerometer bias/scale/
+// misalignment and a magnetometer ellipsoid fit (hard and soft iron).
+//
+// Correction is applied to readings in physical units (g, deg/s, uT):
+//   gyro  -= gyroBias
+//   accel  = accelMatrix * (accel - accelBias)
+//   mag    = magMatrix * (mag - magBias)
+// An uncalibrated sensor has zero bias and identity matrices, so the same
+// straight-line kernel runs on every sample either way.
+//
+// This module has no Arduino dependencies so the ground tools can check
+// the solvers against simulated sensors.
+
+#define IMU_CAL_GYRO 0x01
+#define IMU_CAL_ACCEL 0x02
+#define IMU_CAL_MAG 0x04
+#define IMU_CAL_VERSION 1
+
+struct ImuCalibration {
+  uint8_t version;
+  uint8_t flags;          // IMU_CAL_* parts that have been calibrated
+  float gyroBias[3];
+  float accelBias[3];
+  float accelMatrix[9];   // Row-major
+  float magBias[3];
+  float magMatrix[9];     // Row-major
+};
+
+// Six accelerometer positions: the named body axis points up
+enum AccelFace {
+  FACE_POS_X,
+  FACE_NEG_X,
+  FACE_POS_Y,
+  FACE_NEG_Y,
+  FACE_POS_Z,
+  FACE_NEG_Z,
+  FACE_COUNT
+};
+
+static inline void applyImuCalibration(const ImuCalibration& cal, float gyro[3], float accel[3], float mag[3]) {
+  gyro[0] -= cal.gyroBias[0];
+  gyro[1] -= cal.gyroBias[1];
+  gyro[2] -= cal.gyroBias[2];
+
+  float ax = accel[0] - cal.accelBias[0];
+  float ay = accel[1] - cal.accelBias[1];
+  float az = accel[2] - cal.accelBias[2];
+  const float* a = cal.accelMatrix;
+  accel[0] = a[0] * ax + a[1] * ay + a[2] * az;
+  accel[1] = a[3] * ax + a[4] * ay + a[5] * az;
+  accel[2] = a[6] * ax + a[7] * ay + a[8] * az;
+
+  float mx = mag[0] - cal.magBias[0];
+  float my = mag[1] - cal.magBias[1];
+  float mz = mag[2] - cal.magBias[2];
+  const float* m = cal.magMatrix;
+  mag[0] = m[0] * mx + m[1] * my + m[2] * mz;
+  mag[1] = m[3] * mx + m[4] * my + m[5] * mz;
+  mag[2] = m[6] * mx + m[7] * my + m[8] * mz;
+}
+
+class ImuCalibrator {
+public:
+  enum Step {
+    STEP_IDLE,
+    STEP_GYRO,
+    STEP_ACCEL,
+    STEP_MAG
+  };
+
+  ImuCalibrator();
+
+  // Identity correction, nothing calibrated
+  static void clear(ImuCalibration& cal);
+
+  // Collection steps. Each returns false (with a reason in getError())
+  // if another step is running.
+  bool startGyro();
+  bool startAccelFace(AccelFace face);
+  bool startMag();
+  bool finishMag();     // Fits the collected samples
+  void cancel();
+
+  // Feeds one raw (uncorrected) sample. Returns true when a step finished,
+  // successfully or not; check getError().
+  bool addSample(const float gyro[3], const float accel[3], const float mag[3]);
+
+  Step getStep() const { return step; }
+  const char* getError() const { return error; }
+  uint8_t getFacesDone() const { return facesDone; }
+
+  const ImuCalibration& getCalibration() const { return calibration; }
+  void setCalibration(const ImuCalibration& cal);
+
+  size_t formatStatus(char* buffer, size_t capacity) const;
+
+  static bool parseFace(const char* name, AccelFace& face);
+
+  // Solvers, public so the ground tools can exercise them directly.
+  // means[f] is the average accel reading in face f.
+  static bool solveSixPosition(const float means[FACE_COUNT][3], float bias[3], float matrix[9]);
+  // Fits x'Qx + 2u'x = 1 from the accumulated normal equations
+  static bool solveEllipsoid(const double normal[9][10], float bias[3], float matrix[9]);
+  static void accumulateEllipsoid(double normal[9][10], const float mag[3]);
+
+private:
+  void finishGyro();
+  void finishAccelFace();
+
+  ImuCalibration calibration;
+  Step step;
+  const char* error;
+  uint32_t sampleCount;
+  double sum[3];
+  double sumSquares[3];
+  AccelFace currentFace;
+  uint8_t facesDone;      // Bit per AccelFace
+  float faceMeans[FACE_COUNT][3];
+  double magNormal[9][10];  // Normal equations [N | b] for the ellipsoid fit
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef IMU_DECIMATOR_H
+#define IMU_DECIMATOR_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Decimation from the raw IMU rate (MPU9250 FIFO batches) to the rate each
+// consumer reads at: the estimators, the SD log, the radio and the web UI.
+// Taking the newest sample at a consumer's rate would fold motor and
+// airframe vibration into its band; each stream here is low-passed for its
+// own output rate first.
+//
+// Samples are int32 in common counts: the raw reading shifted left by its
+// range index, so every range maps onto the finest LSB (see imu_range.h)
+// and a range switch inside a batch needs no rescaling.
+//
+// The estimator stream is the mean of each batch: one output per sensor
+// task cycle with the least delay. The consumer streams run an order-3 CIC
+// decimator followed by a polyphase FIR (Blackman windowed sinc, cutoff
+// half the output rate) that decimates the last 2-5x. The CIC is integer
+// adds at the input rate; the FIR only computes the outputs that are kept,
+// so its multiplies run at the output rate. All arithmetic is fixed point (uint64 wrap-around CIC, Q15 taps
+// into int64 accumulators), so results match bit for bit on the board and
+// on the host. The ESP32-S3 vector unit has no 64-bit lanes for the CIC
+// and the FIR runs a handful of times per second, so there is no separate
+// SIMD kernel.
+//
+// A stream is primed from its first input, as if that value had been
+// constant, so reconfiguring on a rate change has no start-up transient.
+// This module has no Arduino dependencies so the ground tools can measure
+// the frequency response and throughput of the exact same code.
+
+#define DECIM_AXES 6                  // accel x,y,z then gyro x,y,z
+#define DECIM_ACCEL_UNIT (2.0f / 32768.0f)   // g per common count
+#define DECIM_GYRO_UNIT (250.0f / 32768.0f)  // deg/s per common count
+#define DECIM_CIC_ORDER 3
+#define DECIM_FIR_TAPS_PER_FACTOR 12  // FIR length per unit of FIR decimation
+#define DECIM_MAX_FIR_FACTOR 5
+#define DECIM_MAX_FIR_TAPS (DECIM_FIR_TAPS_PER_FACTOR * DECIM_MAX_FIR_FACTOR)
+
+enum ImuStream {
+  IMU_STREAM_FILTER,   // Batch mean: estimators and the telemetry snapshot
+  IMU_STREAM_SD,       // SD log rate
+  IMU_STREAM_RADIO,    // RADIO_TX_INTERVAL
+  IMU_STREAM_WEB,      // WEB_IMU_INTERVAL
+  IMU_STREAM_COUNT
+};
+
+class DecimationStage {
+public:
+  DecimationStage();
+
+  // factor: input samples per output. Restarts the stream if it changed.
+  void configure(uint16_t factor);
+  uint16_t getFactor() const { return factor; }
+  uint8_t getFirFactor() const { return firFactor; }
+  uint8_t getFirTaps() const { return firTaps; }
+
+  // Feeds count samples of DECIM_AXES values. Returns the number of outputs
+  // produced; getOutput() holds the newest. clipped marks the batch.
+  int process(const int32_t* samples, int count, bool clipped);
+  const int32_t* getOutput() const { return output; }
+  bool getOutputClipped() const { return outputClipped; }
+
+private:
+  uint16_t factor;
+  uint8_t cicOrder;
+  uint16_t cicFactor;
+  uint8_t firFactor;
+  uint8_t firTaps;
+  int64_t cicGain;                 // cicFactor ^ cicOrder
+  bool primed;
+  uint16_t cicCount;               // Inputs since the last CIC output
+  uint8_t firPhase;                // CIC outputs since the last FIR output
+  uint8_t firHead;                 // Newest slot in firHistory
+  bool pendingClipped;
+  bool outputClipped;
+  int16_t firCoeffs[DECIM_MAX_FIR_TAPS];  // Q15, sum 32768
+  uint64_t integrators[DECIM_CIC_ORDER][DECIM_AXES];
+  uint64_t combDelay[DECIM_CIC_ORDER][DECIM_AXES];
+  int32_t firHistory[DECIM_MAX_FIR_TAPS][DECIM_AXES];
+  int32_t output[DECIM_AXES];
+
+  void designFir();
+  void prime(const int32_t* sample);
+  bool pushCic(const int32_t* sample, int32_t* cicOut);
+  bool pushFir(const int32_t* sample);
+};
+
+class ImuDecimator {
+public:
+  ImuDecimator();
+
+  // Consumer streams only; the filter stream follows the batches
+  void configure(ImuStream stream, uint16_t factor);
+  uint16_t getFactor(ImuStream stream) const { return stages[stream].getFactor(); }
+
+  // Feeds a batch to every stream. Returns a bit (1 << stream) for each
+  // stream that produced a new output.
+  uint8_t process(const int32_t* samples, int count, bool clipped);
+
+  // Newest output of a stream in g and deg/s
+  void getOutput(ImuStream stream, float accel[3], float gyro[3]) const;
+  bool getOutputClipped(ImuStream stream) const;
+
+private:
+  DecimationStage stages[IMU_STREAM_COUNT];  // The filter stream's slot is unused
+  int32_t batchMean[DECIM_AXES];
+  bool batchClipped;
+};
+
+#endif
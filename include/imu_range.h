@@ -0,0 +1,62 @@
+#ifndef IMU_RANGE_H
+#define IMU_RANGE_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Full-scale range selection for the MPU9250 accelerometer and gyro.
+//
+// Each sensor has four ranges selected by the 2-bit AFS_SEL/FS_SEL field
+// (bits 4:3 of ACCEL_CONFIG/GYRO_CONFIG). The selector looks at the
+// largest raw count of each sample and:
+//   - jumps straight to the top range when a count hits the rail, since
+//     a clipped reading says nothing about how far over it went
+//   - steps up one range once a count passes IMU_RANGE_UP_FRACTION
+//   - steps down one range after IMU_RANGE_DOWN_HOLD samples in a row
+//     below IMU_RANGE_DOWN_FRACTION, never below the configured range
+// The down threshold is under half the up threshold, so a reading that
+// caused a step down still sits below the up threshold in the new range.
+//
+// The sample that triggers a switch was converted with the range it was
+// taken in; the caller writes the new range register after it. This
+// module has no Arduino dependencies so the ground tools can run it on
+// simulated flights.
+
+#define IMU_RANGE_COUNT 4
+#define IMU_RANGE_RAIL 32767  // |raw| at or above this is clipped
+
+class ImuRangeSelector {
+public:
+  // fullScales: IMU_RANGE_COUNT values, smallest first (g or deg/s)
+  ImuRangeSelector(const float* fullScales, uint8_t minIndex, bool autoRange);
+
+  // Feeds the largest |raw| count of one sample. Returns true if the
+  // range changed; the caller then writes configBits() to the sensor.
+  bool update(int32_t peakCounts);
+
+  uint8_t getIndex() const { return index; }
+  float getFullScale() const { return fullScales[index]; }
+  float getUnitsPerCount() const { return unitsPerCount; }
+  uint8_t configBits() const { return (uint8_t)(index << 3); }
+
+  // Largest |raw| of three axes; -32768 counts as clipped
+  static int32_t peak(int16_t x, int16_t y, int16_t z);
+
+private:
+  const float* fullScales;
+  uint8_t minIndex;
+  bool autoRange;
+  uint8_t index;
+  uint16_t quietSamples;   // Consecutive samples below the down threshold
+  float unitsPerCount;
+  int32_t upCounts;
+  int32_t downCounts;
+
+  void select(uint8_t newIndex);
+};
+
+// Full-scale tables in AFS_SEL/FS_SEL order
+extern const float IMU_ACCEL_FULL_SCALES[IMU_RANGE_COUNT];  // g
+extern const float IMU_GYRO_FULL_SCALES[IMU_RANGE_COUNT];   // deg/s
+
+#endif
@@ -42,6 +42,7 @@ struct PowerData {
   float voltage;    // Bus voltage in volts
   float current;    // Current in milliamps
   float power;      // Power in milliwatts
+  int64_t timestamp_us;  // esp_timer time of the register reads (us since boot)
   bool valid;       // Data validity flag
 };
 
@@ -57,7 +58,9 @@ public:
   INA260Sensor();
   ~INA260Sensor();
   
-  void initialize();
+  // warmStart: the board reset but the part kept power, so the power-up
+  // waits are skipped (fast resume in flight)
+  void initialize(bool warmStart = false);
   bool readData(PowerData& data);
   bool readVoltage(float& voltage);
   bool readCurrent(float& current);
@@ -0,0 +1,79 @@
+#ifndef LOG_BLOCK_H
+#define LOG_BLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Crash-consistent framing of the SD log, shared by the firmware and the
+// ground tools.
+//
+// Each batch of records is written as a block: its lines, then a trailer
+// line giving the block's sequence number, length in bytes and CRC32
+// (checksum.h) over those bytes:
+//
+//   $B,<seq>,<length>,<crc32 as 8 hex digits>
+//
+// A block only counts once its trailer is complete and matches, so a
+// power cut mid-batch leaves a torn tail that readers drop instead of a
+// torn row. The file's column header is block 0. Two marker lines follow
+// a reboot, each on a fresh line so a torn partial line ends before them:
+//
+//   $R,<seq>   the board resumed this file; the next block is <seq>
+//   $E,<seq>   the file was closed at boot; block <seq> was its last
+//
+// Readers drop any lines not followed by a valid trailer. At boot the SD
+// manager finds the last valid block from the end of the previous file
+// (scanLogTail), reading only the tail and one block, not the whole file.
+
+#define LOG_BLOCK_TRAILER_LENGTH 40     // Longest trailer line and the terminator
+#define LOG_SCAN_CHUNK 512              // Read size of the tail scan
+#define LOG_SCAN_MAX_BLOCKS 4           // Trailers tried from the end before giving up
+#define LOG_SCAN_MAX_BYTES 262144       // How far back from the end the scan may look
+
+// Accumulates one block's length and CRC while its lines are written
+class LogBlockWriter {
+public:
+  LogBlockWriter() : seq(0), length(0), crc(0) {}
+
+  void begin(uint32_t blockSeq);
+  void add(const uint8_t* data, size_t len);
+
+  // Writes the trailer line with its CRLF, terminated. Returns the length,
+  // or 0 if it didn't fit.
+  size_t formatTrailer(char* buffer, size_t capacity) const;
+
+  uint32_t getSeq() const { return seq; }
+  uint32_t getLength() const { return length; }
+
+private:
+  uint32_t seq;
+  uint32_t length;
+  uint32_t crc;
+};
+
+// Marker line ("$R" or "$E") with a leading CRLF, terminated. Returns the
+// length, or 0 if it didn't fit.
+size_t formatLogMarker(char* buffer, size_t capacity, char type, uint32_t seq);
+
+// Parses a trailer line (without its line ending). Returns false if it
+// isn't one.
+bool parseLogBlockTrailer(const char* line, size_t len, uint32_t& seq, uint32_t& length, uint32_t& crc);
+
+// Reads up to len bytes at offset from the file being scanned, returns the
+// count read
+typedef size_t (*LogReadFn)(void* context, uint32_t offset, uint8_t* buffer, size_t len);
+
+struct LogScanResult {
+  bool found;            // A valid block was found
+  uint32_t lastSeq;      // Its sequence number
+  uint32_t validEnd;     // File offset just past its trailer
+  uint32_t tailBytes;    // Bytes after validEnd: a torn block, or markers
+  bool sealed;           // The tail is an "$E" marker; nothing was lost
+  uint32_t bytesRead;    // Cost of the scan
+};
+
+// Finds the last complete block of a log of fileSize bytes, working back
+// from the end. Returns result.found.
+bool scanLogTail(LogReadFn read, void* context, uint32_t fileSize, LogScanResult& result);
+
+#endif
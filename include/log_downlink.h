@@ -0,0 +1,66 @@
+#ifndef LOG_DOWNLINK_H
+#define LOG_DOWNLINK_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "config.h"
+#include "block_transfer.h"
+#include "radio_module.h"
+#include "sd_manager.h"
+
+// Streams a log file from the SD card over the radio in numbered blocks.
+// The ground requests missing blocks by range (selective repeat). The block
+// rate is paced to a share of the radio link so telemetry can still be
+// interleaved. The transfer cursor is kept in NVS, so a transfer that was
+// running at power loss resumes after reboot.
+class LogDownlink {
+private:
+  SDManager& sdManager;
+  RadioModule& radioModule;
+  Preferences preferences;
+  
+  bool active;
+  String fileName;
+  uint16_t fileId;
+  uint32_t fileSize;
+  uint32_t totalBlocks;
+  
+  BlockRange ranges[DOWNLINK_MAX_RANGES];  // Pending ranges, sent in order
+  int rangeCount;
+  
+  uint8_t chunk[DOWNLINK_READ_CHUNK];      // Read-ahead so the card is opened once per chunk
+  uint32_t chunkOffset;
+  size_t chunkLength;
+  
+  unsigned long startTime;
+  unsigned long lastServiceTime;
+  float byteBudget;                         // Token bucket for link pacing
+  uint32_t blocksSent;
+  uint32_t bytesSent;
+  uint32_t blocksSinceSave;
+  
+  bool sendBlock(uint32_t block);
+  bool loadBlock(uint32_t block, const uint8_t*& data, size_t& len);
+  void sendStatus(const char* state);
+  void finish(const char* state);
+  void saveProgress();
+  void clearProgress();
+
+public:
+  LogDownlink(SDManager& sd, RadioModule& radio);
+  
+  // Starts (or restarts) a transfer of blocks first..last. Fills detail with
+  // "id=..,size=..,blocks=..,bs=.." for the ack.
+  bool start(const String& file, uint32_t first, uint32_t last, char* detail, size_t detailSize);
+  // Selective repeat request from the ground. False if it is malformed or
+  // did not fit in the queue; the ground asks again after the next pass.
+  bool queueRanges(const char* spec);
+  void stop();
+  void service();                       // Call from the main loop
+  void restore();                       // Resume a transfer interrupted by a power cycle
+  
+  bool isActive() const { return active; }
+  void formatStatus(char* detail, size_t detailSize) const;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+// Index of the logs on an SD card.
+//
+// LOG_INDEX_FILE holds a header line, then one line per closed log, oldest
+// first:
+//
+//   name,bytes,events_bytes,vib_bytes,bb_bytes,records,start_ms,end_ms,
+//   utc_end_ms,max_alt,max_speed,max_phase
+//
+// The sizes are of the log and its side files (0 if there's none). The
+// times are the first and last records' timestamps and the last one's UTC
+// (0 without GPS time). The rest sums up the flight: highest filtered
+// altitude, fastest vertical speed and furthest flight phase.
+//
+// The SD manager appends a log's line when it closes the log at boot and
+// keeps the line of the log being written in /last_log.txt. Listings and
+// retention read the index instead of walking the card's directory.
+
+#define LOG_INDEX_FILE "/logs.idx"
+#define LOG_INDEX_NAME_LENGTH 48
+#define LOG_INDEX_LINE_LENGTH 192
+
+#define SD_EVENTS_SUFFIX "_events.csv"
+#define SD_VIB_SUFFIX "_vib.csv"
+#define SD_BLACKBOX_SUFFIX "_bb.csv"   // Records drained from the flash black box
+
+// Files kept next to a log, named by replacing its ".csv"
+enum LogSideFile {
+  LOG_SIDE_EVENTS,
+  LOG_SIDE_VIB,
+  LOG_SIDE_BLACKBOX,
+  LOG_SIDE_COUNT
+};
+
+struct LogIndexEntry {
+  char name[LOG_INDEX_NAME_LENGTH];
+  uint32_t bytes;
+  uint32_t sideBytes[LOG_SIDE_COUNT];
+  uint32_t records;
+  uint32_t startMs;
+  uint32_t endMs;
+  int64_t utcEndMs;
+  float maxAltitude;
+  float maxSpeed;
+  uint8_t maxPhase;      // FlightPhase
+};
+
+const char* logSideSuffix(uint8_t side);
+
+// A new log's entry, with no records
+void beginLogIndexEntry(LogIndexEntry& entry, const char* name);
+// Counts one record written to the log
+void addLogIndexRecord(LogIndexEntry& entry, const TelemetryData& data);
+// The log and its side files
+uint32_t logIndexTotalBytes(const LogIndexEntry& entry);
+
+// Column header of the index (without line ending)
+const char* logIndexHeaderLine();
+// Writes an entry's line, terminated, without a line ending. Returns the
+// length, or 0 if it didn't fit.
+size_t formatLogIndexEntry(char* buffer, size_t capacity, const LogIndexEntry& entry);
+// Parses an entry's line (line ending allowed). Returns false if it isn't
+// one.
+bool parseLogIndexEntry(const char* line, LogIndexEntry& entry);
+
+#endif
@@ -4,6 +4,8 @@
 #include <Arduino.h>
 #include <Wire.h>
 #include "config.h"
+#include "imu_range.h"
+#include "imu_decimator.h"
 
 // MPU9250 I2C address
 #define MPU9250_I2C_ADDR 0x68
@@ -18,6 +20,10 @@
 #define MPU9250_ACCEL_CONFIG2 0x1D
 #define MPU9250_INT_PIN_CFG 0x37
 #define MPU9250_USER_CTRL 0x6A
+#define MPU9250_SMPLRT_DIV 0x19
+#define MPU9250_FIFO_EN 0x23
+#define MPU9250_FIFO_COUNTH 0x72
+#define MPU9250_FIFO_R_W 0x74
 
 // Data registers
 #define MPU9250_ACCEL_XOUT_H 0x3B
@@ -30,13 +36,20 @@
 #define AK8963_CNTL1 0x0A
 #define AK8963_XOUT_L 0x03
 
+// FIFO: accel + gyro, 12 bytes per sample in register order
+#define MPU9250_FIFO_EN_ACCEL_GYRO 0x78
+#define MPU9250_USER_CTRL_FIFO_EN 0x40
+#define MPU9250_USER_CTRL_FIFO_RST 0x04
+#define MPU9250_FIFO_SIZE 512
+#define MPU9250_FIFO_SAMPLE_BYTES 12
+#define MPU9250_FIFO_MAX_SAMPLES (MPU9250_FIFO_SIZE / MPU9250_FIFO_SAMPLE_BYTES)
+#define MPU9250_FIFO_READ_SAMPLES 10  // Per I2C read, the Wire buffer holds 128 bytes
+
 // Expected WHO_AM_I values
 #define MPU9250_WHO_AM_I_VALUE 0x71
 #define AK8963_WHO_AM_I_VALUE 0x48
 
-// Scale factors
-#define ACCEL_SCALE_2G 16384.0f
-#define GYRO_SCALE_250DPS 131.0f
+// Scale factors (accel and gyro follow the selected range, see imu_range.h)
 #define MAG_SCALE 0.6f  // µT per LSB for ±4800µT range
 
 struct IMUData {
@@ -58,13 +71,42 @@ struct IMUData {
   // Temperature (°C)
   float temperature;
   
+  // Full-scale range this sample was taken in
+  float accel_range;  // g
+  float gyro_range;   // deg/s
+  bool clipped;       // A raw accel or gyro count hit the rail
+  bool rangeChanged;  // Range switched while reading this sample
+  
+  // esp_timer time the sample was taken (us since boot): the register
+  // read, or for a FIFO batch its newest sample
+  int64_t timestamp_us;
+  
   bool valid;
 };
 
+// Raw accel/gyro samples drained from the FIFO in one sensor task cycle,
+// in the decimator's common counts (see imu_decimator.h)
+struct ImuBatch {
+  int32_t samples[MPU9250_FIFO_MAX_SAMPLES * DECIM_AXES];
+  uint16_t count;
+  bool clipped;      // A raw count in the batch hit the rail
+  bool overflow;     // The FIFO filled up and was reset, samples were lost
+};
+
 class MPU9250Sensor {
 private:
   bool initialized;
   bool magnetometerInitialized;
+  ImuRangeSelector accelRange;
+  ImuRangeSelector gyroRange;
+  uint32_t rangeCheckCycles;   // CPU cycles of the last range check
+  uint32_t rangeSwitchCount;
+  uint8_t fifoInterval;        // ms per FIFO sample, 0 = FIFO off
+  
+  bool resetFifo();
+  
+  bool writeRangeConfig();
+  bool convertSample(const uint8_t* sensorBuffer, IMUData& data);  // True if the range switched
   
   bool writeRegister(uint8_t address, uint8_t reg, uint8_t value);
   bool readRegister(uint8_t address, uint8_t reg, uint8_t& value);
@@ -76,15 +118,33 @@ private:
   bool readAccelerometer(float& x, float& y, float& z);
   bool readGyroscope(float& x, float& y, float& z);
   bool readMagnetometer(float& x, float& y, float& z);
+  bool readMagnetometerData(IMUData& data);  // Zero (and true) without a magnetometer
   bool readTemperature(float& temp);
 
 public:
   MPU9250Sensor();
   ~MPU9250Sensor();
   
-  void initialize();
+  // warmStart: the board reset but the part kept power, so the power-up
+  // waits are skipped (fast resume in flight)
+  void initialize(bool warmStart = false);
   bool readData(IMUData& data);
+  
+  // Batch acquisition through the FIFO at one sample per intervalMs (1-5
+  // ms); 0 goes back to single-sample reads. The DLPF follows the rate.
+  bool configureFifo(uint8_t intervalMs);
+  uint8_t getFifoInterval() const { return fifoInterval; }
+  
+  // Drains the FIFO into batch; data gets the temperature, magnetometer and
+  // range of the batch (accel/gyro are left to the decimator)
+  bool readBatch(ImuBatch& batch, IMUData& data);
   bool isValid();
+  
+  // Auto-ranging state and cost
+  float getAccelRange() const { return accelRange.getFullScale(); }
+  float getGyroRange() const { return gyroRange.getFullScale(); }
+  uint32_t getRangeCheckCycles() const { return rangeCheckCycles; }
+  uint32_t getRangeSwitchCount() const { return rangeSwitchCount; }
 };
 
 #endif
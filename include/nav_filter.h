@@ -0,0 +1,103 @@
+#ifndef NAV_FILTER_H
+#define NAV_FILTER_H
+
+#include <stdint.h>
+#include "config.h"
+#include "geo_coord.h"
+
+// GPS/INS error-state Kalman filter for position and velocity.
+//
+// The nominal state (position and velocity in a local east/north/up frame
+// around the first fix, earth-frame accel bias, and the heading of the
+// AHRS frame relative to east) is propagated with the AHRS earth-frame
+// acceleration at IMU rate. A 10-state error covariance is propagated
+// alongside; each GPS fix (east, north, up) and each baro altitude (up) is
+// fused as a sequence of scalar updates, so there is no matrix inversion,
+// and the estimated error is folded back into the nominal state.
+//
+// Without the magnetometer the AHRS heading is arbitrary, and a linearized
+// filter cannot recover a heading that is off by more than a few tens of
+// degrees. Until it is aligned, the horizontal channels therefore run on
+// the fixes alone, with the measured horizontal acceleration as process
+// noise. Meanwhile the second difference of every three fixes (the change
+// in average velocity) is compared with the same weighted integral of the
+// AHRS-frame acceleration; the rotation between them, accumulated as a
+// least-squares fit, gives the heading once the rocket has changed its
+// horizontal velocity by NAV_ALIGN_DV (during boost). The filter then
+// refines heading and bias from there. The vertical channel uses the
+// acceleration from the start.
+//
+// Every step is a fixed number of operations on fixed-size arrays. This
+// module has no Arduino dependencies so the ground tools can benchmark the
+// exact same filter on simulated flights.
+
+#define NAV_STATES 10
+#define NAV_EARTH_RADIUS 6371000.0   // m, local flat-earth conversion
+
+enum NavState {
+  NAV_E, NAV_N, NAV_U,        // Position (m)
+  NAV_VE, NAV_VN, NAV_VU,     // Velocity (m/s)
+  NAV_BE, NAV_BN, NAV_BU,     // Earth-frame accel bias (m/s^2)
+  NAV_YAW                     // Heading of the AHRS x axis from east (rad)
+};
+
+class NavigationFilter {
+public:
+  NavigationFilter();
+
+  // Starts over at a GPS fix with zero velocity. Coordinates are in 1e-7
+  // degrees throughout (geo_coord.h), altitudes in m.
+  void reset(int32_t latitude, int32_t longitude, float altitude);
+  bool isInitialized() const { return initialized; }
+  bool isHeadingAligned() const { return headingAligned; }
+
+  // Propagates by dt seconds with the AHRS earth-frame acceleration
+  // (m/s^2, gravity removed, z up)
+  void predict(const float accel[3], float dt);
+
+  // Fuses a GPS fix. Returns false if gated out as an outlier.
+  bool correctGps(int32_t latitude, int32_t longitude, float altitude);
+
+  // Fuses a baro altitude. The first one after reset sets the baro zero.
+  bool correctBaro(float baroAltitude);
+
+  // Current estimate
+  void getPosition(int32_t& latitude, int32_t& longitude, float& altitude) const;
+  float getState(NavState state) const { return x[state]; }
+  float getVariance(NavState state) const { return P[state][state]; }
+  uint32_t getRejectedCount() const { return rejectedTotal; }
+
+private:
+  bool initialized;
+  int32_t refLatitude;       // Origin of the local frame
+  int32_t refLongitude;
+  float refAltitude;         // GPS altitude of the origin (m)
+  float metersPerUnitLat;    // m per 1e-7 degree
+  float metersPerUnitLon;
+  float baroZero;            // Baro altitude at up = 0
+  bool haveBaroZero;
+  float x[NAV_STATES];       // Nominal state
+  float P[NAV_STATES][NAV_STATES];  // Error covariance
+  uint32_t rejectedTotal;
+  uint8_t consecutiveRejects;  // Horizontal GPS rejections in a row
+
+  // Heading alignment (horizontal, AHRS frame for the accel terms)
+  bool headingAligned;
+  uint8_t alignFixes;        // Fixes seen so far, up to 2
+  float alignLastFix[2];     // Position of the last fix
+  float alignLastRate[2];    // Average velocity over the previous fix interval
+  float alignLastRise[2];    // Accel integral over it, weighted up toward its end
+  float alignSpan;           // Time since the last fix (s)
+  float alignArea[2];        // Integral of accel since the last fix
+  float alignMoment[2];      // Integral of accel * time since the last fix
+  float alignDot;            // Least-squares sums of the accel/fix pairs
+  float alignCross;
+  float alignPower;
+
+  bool update(uint8_t state, float measurement, float variance);
+  void restartHorizontal(float east, float north);
+  void clearAlignment();
+  void alignHeading(float east, float north);
+};
+
+#endif
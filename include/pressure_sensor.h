@@ -16,15 +16,18 @@ private:
   bool initialized;
   float seaLevelPressure; // hPa, for altitude calculation
   
-  bool readRawData(uint32_t& pressure, uint32_t& temperature);
+  bool readRawData(uint32_t& pressure, uint32_t& temperature, int64_t& sampleUs);
   float calculateAltitude(float pressure);
 
 public:
   PressureSensor();
   ~PressureSensor();
   
-  void initialize();
-  bool readData(float& pressure, float& altitude);
+  // warmStart: the board reset but the part kept power, so the power-up
+  // waits are skipped (fast resume in flight)
+  void initialize(bool warmStart = false);
+  // sampleUs is the esp_timer time the conversion was started (us since boot)
+  bool readData(float& pressure, float& altitude, int64_t& sampleUs);
   void setSeaLevelPressure(float pressure) { seaLevelPressure = pressure; }
   bool isValid();
 };
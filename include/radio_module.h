@@ -4,6 +4,8 @@
 #include <Arduino.h>
 #include <HardwareSerial.h>
 #include "config.h"
+#include "fec_codec.h"
+#include "telemetry_codec.h"
 
 class RadioModule {
 private:
@@ -12,23 +14,32 @@ private:
   bool highPowerMode;
   unsigned long lastRSSIQuery;
   int16_t cachedRSSI;
+  char rxLine[CMD_MAX_LINE_LENGTH];  // Partial uplink line kept across polls
+  size_t rxLength;
+  bool rxDiscarding;                 // Dropping the rest of an overlong line
+  uint32_t telemetrySeq;             // Per-frame TELEM sequence number
   
   void sendATCommand(String command, bool addTerminator = true);
   String readATResponse(unsigned long timeout = 1000);
   bool setParameter(String param, String value);
+  void transmitLine(const char* line, size_t len);  // Applies FEC framing when enabled
 
 public:
   RadioModule();
   ~RadioModule();
   
-  void initialize();
+  // warmStart: the board reset but the part kept power, so the power-up
+  // waits are skipped (fast resume in flight)
+  void initialize(bool warmStart = false);
   void setHighPower();
   void setLowPower();
   void sendTelemetry(const TelemetryData& data);
   String receiveCommand();
   int16_t getRSSI();
   bool isValid();
-  void sendAcknowledgment(String message);    
+  void sendAcknowledgment(String message);
+  void sendLine(const char* line);  // Line must include its '\n'
+  uint32_t getTelemetrySequence() const { return telemetrySeq; }
 };
 
 #endif
@@ -0,0 +1,42 @@
+#ifndef RTC_STATE_H
+#define RTC_STATE_H
+
+#include <stdint.h>
+#include "config.h"
+
+// In-flight state kept in RTC slow memory, which a brownout, panic or
+// watchdog reset leaves alone. The sensor task saves a snapshot every
+// RTC_STATE_SAVE_INTERVAL while the rocket is off the pad; after such a
+// reset the controller boots straight back into flight mode from it
+// instead of going through the full start-up. The record is stored
+// behind a magic number (which also names the layout) and a CRC32, so a
+// power-on, where RTC memory holds garbage, never passes for state.
+
+#define RTC_STATE_MAGIC 0x52464C31  // "RFL1"; change with FlightResumeState
+
+struct FlightResumeState {
+  uint8_t mode;               // SystemMode
+  uint8_t phase;              // FlightPhase
+  uint8_t resumeCount;        // Fast resumes so far this flight
+  bool attitudeAligned;
+  bool haveGravity;
+  float padAltitude;          // Flight detector's baro baseline (m), NAN if none
+  float maxAltitude;          // Highest filtered altitude so far (m)
+  float altitude;             // Altitude filter state (m, m/s)
+  float velocity;
+  float gravity[3];           // Rest gravity direction, body frame (g)
+  float quat[4];              // AHRS attitude w, x, y, z
+  uint32_t savedMs;           // millis() of the snapshot
+};
+
+// True if the last reset was a brownout, panic or watchdog rather than
+// power-on or a deliberate restart
+bool resetWasCrash();
+
+// The saved state, if the last reset was a crash and the record is
+// intact. Anything else clears the record so it can't come back later.
+bool loadFlightResumeState(FlightResumeState& state);
+void saveFlightResumeState(const FlightResumeState& state);
+void clearFlightResumeState();
+
+#endif
@@ -4,15 +4,41 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
 #include "config.h"
+#include "time_discipline.h"
+#include "sd_record.h"
+#include "log_block.h"
+#include "black_box.h"
+#include "log_index.h"
+#include "sector_writer.h"
+
+#define SD_LAST_LOG_FILE "/last_log.txt"  // Index line of the log being written, until it's in the index
+#define SD_INDEX_TEMP_FILE "/logs.tmp"    // The index being rewritten by retention
 
 // Data structure for batch storage
 struct DataBatch {
-  TelemetryData data[SD_BATCH_SIZE];
+  TelemetryData data[SD_BATCH_CAPACITY];
+  uint8_t groups[SD_BATCH_CAPACITY];  // SdRecordGroup bits to log from each
+  int start;                       // Oldest record; moves once a full batch wraps
   int count;
   unsigned long batchStartTime;
 };
 
+// An event or vibration line on its way to its side log
+struct SideLogLine {
+  uint8_t side;                    // LogSide (log_index.h)
+  char line[SD_SIDE_LINE_LENGTH];
+};
+
+// A file written through a SectorWriter (sector_writer.h)
+struct StagedFile {
+  SectorWriter writer;
+  String path;                     // The file whose last sector writer holds
+};
+
 enum SDCardSlot {
   SD_PRIMARY = 0,
   SD_BACKUP = 1,
@@ -25,16 +51,71 @@ private:
   bool primaryCardPresent;
   bool backupCardPresent;
   SDCardSlot activeCard;
-  DataBatch currentBatch;
+  // The sensor task fills one batch while the background task writes the
+  // other; batchMutex covers only the copy in and the swap
+  DataBatch batches[2];
+  DataBatch* fillBatch;
+  DataBatch* writeBatch;
+  SemaphoreHandle_t batchMutex;
+  volatile bool flushRequested;  // Write the batch on the next pass, full or not
+  uint32_t droppedRecords;     // Overwritten before the background task got to them
+  QueueHandle_t sideLogQueue;  // SideLogLines for the background task to write
+  char vibHeader[SD_SIDE_LINE_LENGTH];  // Written at the top of a new _vib.csv
   int totalBatchesStored;
   String currentLogFile;
   unsigned long lastCardHealthCheck;
   unsigned long lastRetryAttempt;
   int consecutiveFailures;
   bool bothCardsFailed;
+  UtcMapping utcMapping;       // GPS time for file names, invalid until synced
+  static portMUX_TYPE utcMux;  // Guards utcMapping: set by the sensor task
+  volatile bool renamePending; // First GPS time: rename the log from the background task
+  int64_t logCreatedUs;        // esp_timer time the current log was created
+  bool logNamedByUtc;          // Current log name is a UTC time, not millis()
+  bool keyframeDue;            // Next record written starts a new file
+  uint32_t lastKeyframeTime;   // Timestamp of the last keyframe queued
+  SystemMode keyframeMode;     // Keyframe-only fields as of that keyframe
+  FlightPhase keyframePhase;
+  uint8_t keyframeTimeSource;
+  SdDerivedState derivedLogged;  // Filter outputs as last queued (sd_record.h)
+  LogBlockWriter blockWriter;  // Length and CRC of the block being written (log_block.h)
+  StagedFile stagedLog;        // Whole-sector writes of the current log
+  uint32_t nextBlockSeq;
+  bool blockTorn;              // The last block failed part-way; mark it before the next
+  BlackBox blackBox;           // Flash ring for records while no card works (black_box.h)
+  SemaphoreHandle_t blackBoxMutex;  // Sensor task appends, background task erases
+  uint32_t blackBoxBlockSeq;   // Next block of <log>_bb.csv, 0 until it's been opened
+  StagedFile stagedDrain;      // Its writes, from the background task
+  unsigned long lastBlackBoxErase;
+  bool inFlight;               // No flash erases or draining while set
+  LogIndexEntry currentEntry;  // Index line of the current log (log_index.h)
+  unsigned long lastEntrySave;
+  uint32_t indexedLogs;        // Logs in the active card's index
+  uint64_t indexedBytes;       // Their size with side files
+  uint64_t cardTotalBytes;     // Filesystem size and use as of the last
+  uint64_t cardUsedBytes;      // reconcile, plus what was written since
+  static portMUX_TYPE spaceMux;  // Guards both: 64-bit, and written and read from several tasks
+  bool spaceKnown;             // Counted on this card since it was mounted
+  unsigned long lastSpaceReconcile;
+  bool writeBenchPending;      // Run the write benchmark on the next update()
+  uint8_t cardSpeed[2];        // Each slot's SPI clock, an index into SD_SPI_SPEEDS
+  uint64_t cardSizes[2];       // Size of the card the clock is for; a new size is a new card
+  bool speedTested[2];         // The self-test has run on the card in the slot
+  SDCardSlot slowCard;         // Card to take a clock step down on the next update()
+  bool startDeferred;          // Black box and log index still to load, after a crash in flight
   
   bool initializeSD();
-  bool tryInitializeCard(SDCardSlot slot);
+  // Mounts the slot's card at its clock. The self-test runs only with
+  // negotiate, from initialize() or update(), never from a write path.
+  bool tryInitializeCard(SDCardSlot slot, bool negotiate);
+  // Mounts at the slot's clock, or the fastest one below it that works
+  bool mountCard(SDCardSlot slot);
+  void negotiateCardSpeed(SDCardSlot slot);
+  bool speedTestPasses(unsigned long& writeUs, unsigned long& readUs);
+  bool lowerCardSpeed(SDCardSlot slot);
+  // Puts a failed log write down to the clock, unless the card is full
+  // or gone
+  void noteWriteError();
   bool switchToBackupCard();
   bool switchToPrimaryCard();
   bool testCardHealth(SDCardSlot slot);
@@ -43,10 +124,39 @@ private:
   bool retryCardInitialization();
   void performPeriodicTasks();
   bool createLogFile();
-  String generateFileName();
+  String generateFileName(const UtcMapping& mapping);
+  UtcMapping getUtcMapping() const;
   bool writeBatchToFile(const DataBatch& batch);
+  bool flushBatch(DataBatch& batch);
+  // Opens a log for writing through staged, new or at its end
+  bool openStagedLog(StagedFile& staged, File& file, const String& path, bool create);
+  // Flushes staged, unless the block already failed, and closes the file
+  bool closeStagedLog(StagedFile& staged, File& file, bool flush);
+  bool writeBlockLine(SectorWriter& out, LogBlockWriter& writer, const char* line, size_t len);
+  bool finishBlock(SectorWriter& out, const LogBlockWriter& writer);
+  void runWriteBenchmark();
+  bool beginBlackBox();
+  // The parts of initialize() a crash in flight leaves to the first update()
+  void finishDeferredStart();
+  // Moves batch, then data if not NULL, into the black box
+  bool storeInBlackBox(DataBatch* batch, const TelemetryData* data, uint8_t groups);
+  int drainBlackBox();
+  bool recoverLastLog();
+  void rememberCurrentLog();
+  bool readLastLogEntry(LogIndexEntry& entry);
+  bool loadLogIndex();
+  bool rebuildLogIndex();
+  bool readIndexEntry(File& file, LogIndexEntry& entry);
+  bool closeLastLog();
+  void reconcileSpace();
+  void countUsedSpace(uint32_t bytes);
+  void countFreedSpace(uint32_t bytes);
+  void measureLog(LogIndexEntry& entry);
   bool writeHeader();
-  String formatTelemetryData(const TelemetryData& data);
+  bool queueSideLog(uint8_t side, const char* line);
+  void writeSideLogs();
+  bool appendSideLog(const char* suffix, const char* header, const char* line);
+  bool renameLogForUtc();
   String getCardSlotName(SDCardSlot slot) const;
 
 public:
@@ -55,20 +165,46 @@ public:
   
   bool initialize();
   bool isInitialized() const { return sdInitialized; }
+  // A card or the black box takes records
+  bool isLogging() const { return sdInitialized || blackBox.isReady(); }
   bool isCardPresent() const { return primaryCardPresent || backupCardPresent; }
   SDCardSlot getActiveCard() const { return activeCard; }
+  // SPI clock the slot's card runs at (Hz)
+  uint32_t getCardSpeed(SDCardSlot slot) const;
   bool isPrimaryCardActive() const { return activeCard == SD_PRIMARY; }
   bool isBackupCardActive() const { return activeCard == SD_BACKUP; }
   
   // Data storage methods
-  bool addData(const TelemetryData& data);
-  bool flushCurrentBatch();
-  bool forceSync();
+  // Queues a record with the SdRecordGroup bits that have new data since
+  // the last one (sd_record.h); keyframes, and filter outputs that moved
+  // past their deadbands, are added as needed. Only copies it into RAM, so
+  // it's safe from the sensor task.
+  bool addData(const TelemetryData& data, uint8_t groups);
+  // Writes the queued batch to the card once it's full or old enough.
+  // Call from the background task only; it does all the batch card I/O.
+  bool writePendingData();
+  bool forceSync();  // Has the next writePendingData() write the batch now
+  // Queued for the background task, which appends them to <log>_events.csv
+  // and <log>_vib.csv on its next pass. Never touch the card themselves.
+  bool logEvent(const char* line);
+  bool logVibration(const char* header, const char* line);
   void update();  // Call this regularly to perform health checks and retries
+  // Log files are named by UTC once it's known; the first mapping also
+  // renames the log that was started before the GPS had the time. Only
+  // stores the mapping; the rename happens in writePendingData().
+  void setUtcMapping(const UtcMapping& mapping);
+  // Set while flying: the black box then neither erases ahead nor drains,
+  // leaving the card and flash to the flight's own records
+  void setInFlight(bool flying) { inFlight = flying; }
+  // Runs the write benchmark from update(), on the ground with a card.
+  // Results go to Serial. Returns false if it can't run now.
+  bool requestWriteBenchmark();
   
   // File management methods
   bool listLogFiles();
-  bool deleteOldFiles(int maxFiles = 10);
+  // Deletes the oldest logs in the index, with their side files, until at
+  // most maxFiles and maxMB are left. The current log is never deleted.
+  bool deleteOldFiles(int maxFiles = SD_MAX_LOG_FILES, uint32_t maxMB = SD_MAX_LOG_MB);
   String getCurrentLogFile() const { return currentLogFile; }
   int getTotalBatchesStored() const { return totalBatchesStored; }
   
@@ -77,12 +213,16 @@ public:
   bool readLogFile(const String& filename, String& content);  // Read entire file content
   bool fileExists(const String& filename);  // Check if file exists
   size_t getFileSize(const String& filename);  // Get file size in bytes
+  size_t readFileChunk(const String& filename, uint32_t offset, uint8_t* buffer, size_t len);  // Random-access read
   
   // Statistics
-  size_t getAvailableSpace() const;
-  size_t getUsedSpace() const;
-  int getCurrentBatchSize() const { return currentBatch.count; }
+  // Cached, never read from the card; 0 until the first count
+  uint64_t getAvailableSpace() const;
+  uint64_t getUsedSpace() const;
+  int getCurrentBatchSize() const { return fillBatch->count; }
+  uint32_t getDroppedRecords() const { return droppedRecords; }
   int getConsecutiveFailures() const { return consecutiveFailures; }
+  uint32_t getBlackBoxPending() const { return blackBox.getPending(); }
   String getDetailedStatus() const;
 };
 
@@ -0,0 +1,81 @@
+#ifndef SD_RECORD_H
+#define SD_RECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+// Tagged SD log records shared by the firmware and the ground tools.
+//
+// Each record carries only the sensor groups that produced new data since
+// the previous record, named by one letter each in its first field:
+//
+//   G  GPS fix             P  pressure            I  IMU
+//   W  power               F  altitude filter     A  attitude
+//   N  GPS/INS position    K  keyframe
+//
+// e.g. "IFAN,123456,<I fields>,<F fields>,<A fields>,<N fields>". After the
+// tags comes the record's timestamp, then the fields of each group in tag
+// order. A keyframe is the full wide row (the column list the log used to
+// have on every line); its tags still name the groups that were fresh.
+// Keyframes start each log file and come every SD_KEYFRAME_INTERVAL and on
+// any change of mode, flight phase or time source, which are only in them.
+//
+// The log starts with one "#<tag>,<columns>" line per record type, and a
+// reader rebuilds the wide rows by carrying each column forward from the
+// last record that had it. "name=value" entries set a column that the
+// group implies (a group is only logged from a valid reading), and utc_ms
+// follows the timestamp from the last keyframe. `ground widen` does this.
+
+#define SD_RECORD_MAX_LENGTH 512
+
+enum SdRecordGroup : uint8_t {
+  SD_GROUP_GPS = 0x01,
+  SD_GROUP_PRESSURE = 0x02,
+  SD_GROUP_IMU = 0x04,
+  SD_GROUP_POWER = 0x08,
+  SD_GROUP_ALTITUDE = 0x10,
+  SD_GROUP_ATTITUDE = 0x20,
+  SD_GROUP_NAV = 0x40,
+  SD_GROUP_KEYFRAME = 0x80
+};
+
+#define SD_RECORD_COLUMNS "timestamp,mode,lat,lon,alt_gps,alt_press,pressure,gps_valid,press_valid,rssi," \
+  "accel_x,accel_y,accel_z,gyro_x,gyro_y,gyro_z,mag_x,mag_y,mag_z,imu_temp,imu_valid," \
+  "voltage,current,power,power_valid,alt_filtered,vertical_velocity,estimator_valid,flight_phase," \
+  "quat_w,quat_x,quat_y,quat_z,roll,pitch,yaw,attitude_valid," \
+  "accel_range,gyro_range,imu_clipped," \
+  "nav_lat,nav_lon,velocity_east,velocity_north,nav_valid," \
+  "utc_ms,time_source,gps_time_us,pressure_time_us,imu_time_us,power_time_us"
+
+// Header line `index` of a tagged log (without line ending), NULL past the
+// last one
+const char* sdRecordHeaderLine(uint8_t index);
+
+// Writes the record for the given groups, terminated, without a line
+// ending. Returns the length, or 0 if it didn't fit.
+size_t formatSdRecord(char* buffer, size_t capacity, const TelemetryData& data, uint8_t groups);
+
+// The full wide row alone (SD_RECORD_COLUMNS), as in a keyframe
+size_t formatSdRow(char* buffer, size_t capacity, const TelemetryData& data);
+
+// The filter outputs as last logged; zeroed to start
+struct SdDerivedState {
+  float altitude, velocity;
+  bool estimatorValid;
+  float roll, pitch, yaw;
+  bool attitudeValid;
+  int32_t navLatitude, navLongitude;
+  float velocityEast, velocityNorth;
+  bool navValid;
+};
+
+// The filters step on every IMU sample, but between the readings that
+// correct them their outputs barely move. Call as a record is logged with
+// its groups so far (ALTITUDE after a baro reading, NAV after a GPS fix,
+// KEYFRAME if it is one). Returns them plus the ALTITUDE, ATTITUDE and
+// NAV groups whose validity changed or which moved past their
+// SD_*_DEADBAND since last logged, and records what was logged in last.
+uint8_t sdDerivedGroups(const TelemetryData& data, uint8_t fresh, SdDerivedState& last);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SECTOR_WRITER_H
+#define SECTOR_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+// Staging buffer that turns the SD log's many short writes into whole
+// sectors, shared by the firmware and the ground tools.
+//
+// Lines are packed into a buffer that always starts on a sector boundary
+// of the file. Each time it fills, it goes to the card as one write of
+// whole sectors, which FatFs passes straight to the card as a multi-block
+// write. On flush the staged sectors go out in one write ending with the
+// partial last sector, since the block must be on the card before it
+// counts. That tail stays in the buffer, so the next write starts over at
+// the beginning of its sector and rewrites it whole instead of appending
+// to the middle of it. The card then only ever sees writes that start on
+// a sector boundary.
+//
+// Writes go through SectorWriteFn so the ground tools can run the writer
+// against a model of the card.
+
+#define SD_SECTOR_SIZE 512
+
+// Writes len bytes at offset in the open file. Returns false on an error.
+typedef bool (*SectorWriteFn)(void* context, uint32_t offset, const uint8_t* data, size_t len);
+
+struct SectorWriterStats {
+  uint32_t writes;       // Calls to the write function
+  uint32_t sectors;      // Whole sectors written, rewritten tails included
+  uint32_t tailWrites;   // Writes that ended in a partial sector
+};
+
+class SectorWriter {
+public:
+  SectorWriter();
+
+  // Sends writes to fn with this context from now on, for the file that
+  // was just opened
+  void attach(SectorWriteFn fn, void* context);
+  // Starts at the end of a file of fileSize bytes. tail holds its last
+  // fileSize % SD_SECTOR_SIZE bytes, the ones in its partial last sector.
+  void begin(uint32_t fileSize, const uint8_t* tail);
+  // Holds the tail of a file of this size, so it can carry on without
+  // reading it back
+  bool isAt(uint32_t fileSize) const { return valid && base + used == fileSize; }
+  // Forgets the file, after a failed write left its end unknown
+  void invalidate() { valid = false; }
+
+  // Stages len bytes, writing the buffer out whenever it fills. Returns
+  // false if a write failed.
+  bool write(const void* data, size_t len);
+  // Writes everything staged, the partial last sector included
+  bool flush();
+
+  // File size with what is staged
+  uint32_t getSize() const { return base + used; }
+  const SectorWriterStats& getStats() const { return stats; }
+  void resetStats();
+
+private:
+  uint8_t buffer[SD_WRITE_BUFFER_SIZE];
+  uint32_t base;         // File offset of buffer[0], on a sector boundary
+  size_t used;
+  size_t written;        // Bytes of the buffer already on the card
+  bool valid;
+  SectorWriteFn writeFn;
+  void* context;
+  SectorWriterStats stats;
+
+  bool writeOut(size_t len);
+};
+
+#endif
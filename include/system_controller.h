@@ -5,6 +5,7 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
+#include <freertos/queue.h>
 #include <Preferences.h>
 #include "config.h"
 #include "gps_module.h"
@@ -15,6 +16,17 @@
 #include "power_manager.h"
 #include "wifi_manager.h"
 #include "sd_manager.h"
+#include "command_protocol.h"
+#include "log_downlink.h"
+#include "altitude_estimator.h"
+#include "attitude_estimator.h"
+#include "nav_filter.h"
+#include "time_discipline.h"
+#include "imu_calibration.h"
+#include "imu_decimator.h"
+#include "vibration_analyzer.h"
+#include "flight_events.h"
+#include "rtc_state.h"
 
 class SystemController {
 private:
@@ -27,6 +39,19 @@ private:
   unsigned long lastRadioTx;         // Track last radio transmission time
   unsigned long lastHeartbeat;
   unsigned long maintenanceModeStartTime;
+  unsigned long lastEstimatorStep;   // micros() of the last filter prediction
+  unsigned long lastBaroFusion;      // millis() of the last baro correction
+  unsigned long lastAttitudeStep;    // micros() of the last AHRS update
+  unsigned long lastNavStep;         // micros() of the last GPS/INS prediction
+  unsigned long lastGpsFusion;       // millis() of the last GPS fix fused
+  unsigned long lastSdLog;           // millis() of the last SD log row
+  uint8_t sdFreshGroups;             // SdRecordGroup bits updated since then
+  unsigned long apogeeDetectedMs;    // Apogee event time, 0 before apogee
+  unsigned long lastResumeSave;      // millis() of the last RTC state snapshot
+  bool resumeStateSaved;             // RTC memory holds a snapshot of this flight
+  uint8_t resumeCount;               // Fast resumes so far this flight
+  bool firstSampleLogged;            // Boot-to-first-IMU-sample time printed
+  volatile uint16_t sensorTaskPeriod;  // Current IMU interval, follows the flight phase
   
   GPSModule gpsModule;         // Stack allocated for better performance
   PressureSensor pressureSensor;
@@ -36,6 +61,34 @@ private:
   PowerManager powerManager;
   WiFiManager wifiManager;
   SDManager sdManager;
+  LogDownlink logDownlink;     // Post-landing log transfer over the radio
+  AltitudeEstimator altitudeEstimator;  // Only touched by the sensor task
+  AttitudeEstimator attitudeEstimator;  // Only touched by the sensor task
+  NavigationFilter navFilter;           // Only touched by the sensor task
+  TimeDiscipline timeDiscipline;        // GPS UTC mapping, only touched by the sensor task
+  ImuCalibration imuCalibration;        // Correction in use, only touched by the sensor task
+  ImuCalibrator imuCalibrator;          // Guarded by calibrationMutex
+  SemaphoreHandle_t calibrationMutex;
+  volatile bool calibrationActive;      // Collecting, or a new correction to pick up
+  volatile bool calibrationSavePending; // Sensor task finished a step, main loop saves it
+  ImuDecimator imuDecimator;            // Only touched by the sensor task
+  ImuBatch imuBatch;                    // FIFO drain buffer, sensor task
+  
+  // Newest calibrated output of each consumer stream, guarded by telemetryMutex
+  struct ImuStreamSample {
+    float accel[3];
+    float gyro[3];
+    bool clipped;
+    bool valid;
+  };
+  ImuStreamSample imuStreams[IMU_STREAM_COUNT];
+  
+  VibrationAnalyzer vibrationAnalyzer;  // Only touched by the sensor task
+  QueueHandle_t vibrationQueue;         // Sensor task -> main loop for radio TX
+  
+  FlightEventDetector flightEvents;     // Only touched by the sensor task
+  QueueHandle_t flightEventQueue;       // Sensor task -> main loop for radio TX
+  volatile bool flightEventsResetRequested;
   
   TelemetryData telemetryData;
   
@@ -77,24 +130,81 @@ private:
     unsigned long maxSensorReadTime;
     unsigned long maxRadioTxTime;
     unsigned long maxSdWriteTime;
+    unsigned long commandExecTime;
+    unsigned long maxCommandExecTime;
+    unsigned long commandsExecuted;
+    unsigned long commandDuplicates;
+    unsigned long commandFrameErrors;
+    unsigned long sdRowsLogged;
+    unsigned long sdRowsSkipped;          // Samples not logged at the phase's SD rate
+    unsigned long imuFifoSamples;         // Raw IMU samples drained from the FIFO
+    unsigned long imuFifoOverflows;
+    unsigned long decimationCycles;       // CPU cycles per FIFO batch through the decimator
+    unsigned long maxDecimationCycles;
+    unsigned long vibrationBlockCycles;   // CPU cycles per FFT block (6 axes) incl. its summary
+    unsigned long maxVibrationBlockCycles;
+    unsigned long vibrationSummaries;
+    unsigned long imuRangeSwitches;
+    unsigned long imuRangeCheckCycles;    // CPU cycles per auto-range check
+    unsigned long maxImuRangeCheckCycles;
+    unsigned long imuCorrectionCycles;    // CPU cycles per calibration correction
+    unsigned long maxImuCorrectionCycles;
+    unsigned long attitudeStepCycles;     // CPU cycles per AHRS update
+    unsigned long maxAttitudeStepCycles;
+    unsigned long navStepCycles;          // CPU cycles per GPS/INS step incl. fix/baro updates
+    unsigned long maxNavStepCycles;
+    unsigned long estimatorStepTime;
+    unsigned long maxEstimatorStepTime;
+    unsigned long flightEventCount;
+    unsigned long eventDetectLatency;     // ms from condition onset to detection (debounce)
+    unsigned long maxEventDetectLatency;
+    unsigned long eventTxLatency;         // ms from detection to radio
+    unsigned long maxEventTxLatency;
+    unsigned long telemetryFramesSent;
+    unsigned long telemetrySampleAge;     // ms from sample to radio enqueue
+    unsigned long maxTelemetrySampleAge;
+    unsigned long pingsAnswered;
+    // Link quality as last measured by the ground station (LINK_REPORT)
+    unsigned long groundFramesReceived;
+    unsigned long groundFramesLost;
+    unsigned long groundJitterMicros;
+    long groundLatencyMs;                 // -1 if the ground has no clock offset yet
   };
   
   PerformanceMetrics perfMetrics;
   
+  // Command uplink state: the last ack is replayed for retransmitted frames
+  uint32_t lastCommandSeq;
+  bool hasLastCommand;
+  char lastAckFrame[CMD_MAX_LINE_LENGTH];
+  
+  void initializeModules();    // Full start-up
+  void resumeFlight(const FlightResumeState& state);  // Fast start-up after a reset in flight
+  void updateResumeState(unsigned long currentTime);
   void updateModeTransition(); // Non-blocking mode transition handler
   void completeModeTransition();
   void updateSensors();
+  void configureImuStreams(const SampleRates& rates);
+  void applyImuStream(TelemetryData& data, ImuStream stream) const;
+  const SampleRates& selectSampleRates(unsigned long currentTime) const;
   void checkRadioCommands();
+  void handleCommandFrame(const char* line);
+  const char* executeCommand(const char* name, const char* args, char* detail, size_t detailSize);
+  const char* executeDownlinkCommand(const char* name, const char* args, char* detail, size_t detailSize);
   void pulseCameraPin();
   void sendTelemetry();
   void handleMaintenanceMode();
   void handleFlightMode();
   void handleSleepMode();
-  void checkAccelerationThreshold(); // Check for 2G acceleration and auto-switch to flight mode
+  void sendFlightEvent(const FlightEvent& event);
+  void sendVibrationSummary(const VibrationSummary& summary);
   
   // Mode persistence functions
   void savePersistentMode(SystemMode mode);
   SystemMode loadPersistentMode();
+  void saveImuCalibration();
+  void loadImuCalibration();
+  void updateCalibration(float gyro[3], float accel[3], float mag[3]);
   
   // Performance monitoring
   void updatePerformanceMetrics(unsigned long duration, unsigned long* metric, unsigned long* maxMetric);
@@ -115,7 +225,10 @@ public:
   void initialize();
   void update();
   SystemMode getCurrentMode() const { return currentMode; }
-  void setMode(SystemMode mode);
+  bool setMode(SystemMode mode);  // False if another transition is in progress
+  
+  // IMU calibration commands (radio and web), safe from any task
+  const char* executeCalibrationCommand(const char* name, const char* args, char* detail, size_t detailSize);
   
   // Performance metrics access
   const PerformanceMetrics& getPerformanceMetrics() const { return perfMetrics; }
@@ -134,8 +247,8 @@ public:
   bool logFileExists(const String& filename);
   size_t getLogFileSize(const String& filename);
   
-  // Thread-safe telemetry access
-  TelemetryData getTelemetryDataCopy() const;
+  // Thread-safe telemetry access; accel/gyro come from the given stream
+  TelemetryData getTelemetryDataCopy(ImuStream stream = IMU_STREAM_FILTER) const;
 };
 
 #endif
@@ -0,0 +1,56 @@
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+// TELEM line format shared by the firmware and the ground tools.
+//
+// TELEM,timestamp,mode,lat,lon,alt_gps,alt_press,pressure,gps_valid,press_valid,
+//       accel_x,accel_y,accel_z,gyro_x,gyro_y,gyro_z,mag_x,mag_y,mag_z,imu_temp,imu_valid,
+//       voltage,current,power,power_valid,rssi,seq,enqueue_ms,
+//       alt_filtered,vertical_velocity,estimator_valid,flight_phase,
+//       quat_w,quat_x,quat_y,quat_z,roll,pitch,yaw,attitude_valid,
+//       accel_range,gyro_range,imu_clipped,
+//       nav_lat,nav_lon,velocity_east,velocity_north,nav_valid,
+//       utc_ms,time_source,gps_time_us,pressure_time_us,imu_time_us,power_time_us
+//
+// Coordinates are decimal degrees with 7 decimals, written from the 1e-7
+// degree integers (geo_coord.h). `timestamp` is when the newest sample in
+// the record was taken and `enqueue_ms` is when the frame was handed to
+// the radio (both board millis()), so their difference is the sample age
+// at transmission. `utc_ms` is `timestamp` on the GPS-disciplined UTC
+// clock (ms since 1970, 0 until the first GPS time; time_discipline.h).
+// The *_time_us fields are when each sensor's sample was taken, in board
+// microseconds (esp_timer), so the ground can align them with each other.
+// `seq` increments by one per frame, so the ground can count lost frames.
+// New fields are only ever appended.
+
+#define TELEM_FRAME_PREFIX "TELEM,"
+#define TELEM_FIELD_NAMES "timestamp,mode,lat,lon,alt_gps,alt_press,pressure,gps_valid,press_valid," \
+  "accel_x,accel_y,accel_z,gyro_x,gyro_y,gyro_z,mag_x,mag_y,mag_z,imu_temp,imu_valid," \
+  "voltage,current,power,power_valid,rssi,seq,enqueue_ms," \
+  "alt_filtered,vertical_velocity,estimator_valid,flight_phase," \
+  "quat_w,quat_x,quat_y,quat_z,roll,pitch,yaw,attitude_valid," \
+  "accel_range,gyro_range,imu_clipped," \
+  "nav_lat,nav_lon,velocity_east,velocity_north,nav_valid," \
+  "utc_ms,time_source,gps_time_us,pressure_time_us,imu_time_us,power_time_us"
+#define TELEM_LINE_MAX_LENGTH 512
+
+struct TelemetryFrameInfo {
+  uint32_t seq;
+  uint32_t enqueueMs;
+};
+
+class TelemetryCodec {
+public:
+  // Returns the line length including '\n', or 0 if it didn't fit
+  static size_t formatLine(char* buffer, size_t capacity, const TelemetryData& data, const TelemetryFrameInfo& info);
+
+  // Parses a TELEM line (with or without '\n'). Returns false if the line
+  // is not a complete TELEM record.
+  static bool parseLine(const char* line, TelemetryData& data, TelemetryFrameInfo& info);
+};
+
+#endif
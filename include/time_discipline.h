@@ -0,0 +1,106 @@
+#ifndef TIME_DISCIPLINE_H
+#define TIME_DISCIPLINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+// GPS time discipline: a drift-corrected mapping from the board's
+// monotonic microsecond clock to UTC.
+//
+// The mapping is UTC = utcRef + d * (1 + rate) for d = local - localRef,
+// kept by a two-state Kalman filter (phase at the last sample, crystal
+// frequency error) that is corrected with every time sample from the
+// receiver:
+//
+// - NMEA: the UTC of an epoch (RMC date and time, GGA time) against the
+//   local time its sentences started arriving. The receiver's output
+//   delay and the UART FIFO fill time make that a fixed latency, assumed
+//   TIME_NMEA_LATENCY_MS until a PPS has measured it. Good to a few ms.
+// - PPS: a pulse at each UTC second, timestamped in its interrupt. It is
+//   labelled with the nearest second the mapping predicts, so it needs a
+//   sync from NMEA first; while it's locked, NMEA samples only refine the
+//   latency. Good to a few us.
+//
+// Between samples (and after the receiver loses lock) the mapping coasts
+// on the estimated drift. Converting a timestamp is a few integer
+// operations on a UtcMapping snapshot, so records and file names can use
+// it freely. This module has no Arduino dependencies so the ground tools
+// can run it against simulated clocks.
+
+#define UTC_STAMP_LENGTH 16              // "YYYYMMDD_HHMMSS" and the terminator
+#define TIME_PPS_PERIOD_TOLERANCE_US 1000  // Edges this close to 1 s apart count as a pulse train
+
+enum TimeSource : uint8_t {
+  TIME_SOURCE_NONE = 0,        // No UTC yet
+  TIME_SOURCE_NMEA = 1,        // Following the NMEA sentence times
+  TIME_SOURCE_PPS = 2          // Locked to the PPS pulses
+};
+
+// Snapshot of the mapping, cheap to copy and to evaluate anywhere
+struct UtcMapping {
+  bool valid;                  // False until the first GPS time
+  int64_t localRefUs;          // Local time of the last update (us since boot)
+  int64_t utcRefUs;            // UTC at localRefUs (us since 1970)
+  int32_t ratePpb;             // UTC runs this much faster than the local clock (1e-9)
+};
+
+// UTC in ms since 1970 for a local time in us since boot, 0 if unmapped
+int64_t utcMsFromLocal(const UtcMapping& mapping, int64_t localUs);
+
+// NMEA hhmmss[.sss] to ms of the day and ddmmyy to days since 1970.
+// Return false on a malformed field.
+bool parseNmeaTime(const char* field, int32_t& msOfDay);
+bool parseNmeaDate(const char* field, int32_t& days);
+
+// Days since 1970 for a proleptic Gregorian date
+int32_t daysFromCivil(int32_t year, uint32_t month, uint32_t day);
+
+// Writes UTC as YYYYMMDD_HHMMSS (for file names), terminated.
+// Returns the length, or 0 if it didn't fit.
+size_t formatUtcStamp(char* buffer, size_t capacity, int64_t utcMs);
+
+class TimeDiscipline {
+public:
+  TimeDiscipline();
+
+  void reset();
+
+  // Fuses the UTC of an epoch (ms since 1970) with the local time its
+  // NMEA sentences started arriving and that time's uncertainty. Returns
+  // false if it was gated out or repeats the last epoch.
+  bool addNmeaTime(int64_t arrivalUs, int64_t utcMs, float arrivalSigmaUs);
+
+  // Fuses a PPS edge captured at edgeUs. Returns false if it isn't near a
+  // predicted UTC second or was gated out.
+  bool addPps(int64_t edgeUs);
+
+  bool isSynced() const { return mapping.valid; }
+  TimeSource getSource(int64_t nowUs) const;
+  const UtcMapping& getMapping() const { return mapping; }
+  int64_t toUtcMs(int64_t localUs) const { return utcMsFromLocal(mapping, localUs); }
+
+  float getDriftPpm() const { return (float)rate; }
+  float getPhaseSigmaUs() const;
+  float getNmeaLatencyMs() const { return (float)(nmeaLatencyUs / 1000.0); }
+  uint32_t getRejectedCount() const { return rejectedTotal; }
+
+private:
+  UtcMapping mapping;
+  double rate;                 // Crystal frequency error (ppm)
+  double P[2][2];              // Covariance of phase (us) and rate (ppm)
+  double nmeaLatencyUs;        // NMEA arrival after its epoch
+  bool latencyMeasured;        // nmeaLatencyUs came from a PPS, not the default
+  int64_t lastEpochMs;         // Last NMEA epoch seen
+  int64_t lastEdgeUs;          // Last PPS edge seen, accepted or not
+  int64_t lastPpsUs;           // Last PPS edge fused
+  uint32_t rejectedTotal;
+  uint8_t consecutiveRejects;
+
+  bool ppsLocked(int64_t localUs) const;
+  int64_t predictUtcUs(int64_t localUs) const;
+  void start(int64_t localUs, int64_t utcUs, double variance);
+  bool fuse(int64_t localUs, int64_t utcUs, double variance);
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef VIBRATION_ANALYZER_H
+#define VIBRATION_ANALYZER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+#include "imu_decimator.h"
+
+// Vibration spectra of the raw IMU samples (MPU9250 FIFO batches, see
+// imu_decimator.h for the sample format). Motor vibration and structural
+// modes sit far above the logged and transmitted rates, so they are
+// summarized here instead: Hann-windowed blocks of VIB_FFT_SIZE samples per
+// axis, power spectra averaged over VIB_SUMMARY_INTERVAL, then reduced to
+// the RMS, the strongest peaks and the RMS in fixed bands for the
+// accelerometer (g) and the gyro (deg/s), each summed over its three axes.
+//
+// The FFT is an in-place complex transform of fixed size: bit-reversal,
+// one radix-2 stage when log2(N) is odd, then radix-4 butterflies that each
+// merge two radix-2 stages (3 complex multiplies per 4 points instead of
+// 4). Axes are packed in pairs as real + imaginary parts, so six axes take
+// three transforms. All buffers and tables are members; nothing is
+// allocated after construction.
+//
+// The block mean is removed before windowing, so gravity and the sensor
+// biases do not leak into the low bins and the calibration is not needed.
+// This module has no Arduino dependencies so the ground tools can check
+// the spectra against a reference DFT and measure the cost per block.
+
+#define VIB_FFT_LOG2 8
+#define VIB_FFT_SIZE (1 << VIB_FFT_LOG2)  // Samples per block (256 ms at 1 kHz)
+#define VIB_BINS (VIB_FFT_SIZE / 2 + 1)    // One-sided spectrum, DC to Nyquist
+#define VIB_PEAK_COUNT 3
+#define VIB_BAND_COUNT 5
+#define VIB_CSV_LINE_LENGTH 400         // Longest SD header or row
+
+// Band edges in Hz; the last band includes the Nyquist bin
+extern const float VIB_BAND_EDGES[VIB_BAND_COUNT + 1];
+
+struct VibrationSpectrum {
+  float rms;                              // Whole band without DC
+  float peakHz[VIB_PEAK_COUNT];           // Strongest first, 0 when there is none
+  float peakAmplitude[VIB_PEAK_COUNT];    // Sine amplitude of each peak
+  float bandRms[VIB_BAND_COUNT];
+};
+
+struct VibrationSummary {
+  uint32_t timeMs;          // Sensor task time of the last block
+  float sampleRate;         // Hz
+  uint16_t blocks;          // Blocks averaged
+  bool clipped;             // A sample in the summary was on the rail
+  VibrationSpectrum accel;  // g
+  VibrationSpectrum gyro;   // deg/s
+};
+
+class VibrationFft {
+public:
+  VibrationFft();
+
+  // Forward transform of VIB_FFT_SIZE points in place
+  void transform(float* re, float* im) const;
+
+private:
+  float twiddleRe[VIB_FFT_SIZE];   // W^k = exp(-2*pi*i*k/N)
+  float twiddleIm[VIB_FFT_SIZE];
+  uint16_t bitReverse[VIB_FFT_SIZE];
+};
+
+class VibrationAnalyzer {
+public:
+  VibrationAnalyzer();
+
+  // Starts over at a new sample rate; 0 leaves the analyzer idle
+  void reset(float sampleRate);
+  // Drops the partial block after a gap in the samples (FIFO restart)
+  void restartBlock() { fill = 0; }
+  float getSampleRate() const { return sampleRate; }
+  uint32_t getBlocksAnalyzed() const { return blocksAnalyzed; }
+
+  // Feeds count samples of DECIM_AXES common counts. Returns true and fills
+  // summary when VIB_SUMMARY_INTERVAL worth of blocks has been averaged.
+  bool process(const int32_t* samples, int count, bool clipped, uint32_t timeMs, VibrationSummary& summary);
+
+  // SD rows for <log>_vib.csv: the header names the bands from VIB_BAND_EDGES
+  static size_t formatCsvHeader(char* buffer, size_t capacity);
+  static size_t formatCsv(char* buffer, size_t capacity, const VibrationSummary& summary);
+
+  // Radio line without the bands (fits CMD_MAX_LINE_LENGTH):
+  // VIB,<log_ms>,<blocks>,<clipped>,<a_rms>,<a_hz>,<a_amp>x3,<g_rms>,<g_hz>,<g_amp>x3*<crc16>\n
+  static size_t formatDownlink(char* buffer, size_t capacity, const VibrationSummary& summary);
+
+private:
+  VibrationFft fft;
+  float sampleRate;
+  uint16_t blocksPerSummary;
+  uint16_t fill;                   // Samples in the current block
+  uint16_t blocks;                 // Blocks in the running average
+  bool clipped;
+  uint32_t blocksAnalyzed;
+  float windowPower;               // Sum of the squared window
+  float window[VIB_FFT_SIZE];
+  int32_t block[VIB_FFT_SIZE][DECIM_AXES];
+  float re[VIB_FFT_SIZE];
+  float im[VIB_FFT_SIZE];
+  float accelPower[VIB_BINS];      // |X|^2 summed over axes and blocks
+  float gyroPower[VIB_BINS];
+
+  void analyzeBlock();
+  void summarize(const float* power, VibrationSpectrum& out) const;
+};
+
+#endif
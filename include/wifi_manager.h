@@ -28,6 +28,7 @@ private:
   void handleLogsList();
   void handleDownloadFile();
   void handleDownloadAll();
+  void handleCalibrate();
   String createTelemetryJSON(const TelemetryData& data);
 
 public:
@@ -0,0 +1,120 @@
+#include "altitude_estimator.h"
+#include <math.h>
+
+AltitudeEstimator::AltitudeEstimator() :
+  initialized(false),
+  altitude(0),
+  velocity(0),
+  p00(0),
+  p01(0),
+  p11(0),
+  consecutiveRejects(0),
+  rejectedTotal(0),
+  upX(0),
+  upY(0),
+  upZ(0),
+  haveUp(false) {
+}
+
+void AltitudeEstimator::reset(float baroAltitude, float initialVelocity) {
+  altitude = baroAltitude;
+  velocity = initialVelocity;
+  p00 = ALT_KF_BARO_NOISE * ALT_KF_BARO_NOISE;
+  p01 = 0;
+  p11 = 1.0f;
+  consecutiveRejects = 0;
+  initialized = true;
+}
+
+void AltitudeEstimator::predict(float verticalAccel, float dt) {
+  if (!initialized || dt <= 0) {
+    return;
+  }
+  if (dt > ALT_KF_MAX_DT) {
+    dt = ALT_KF_MAX_DT;
+  }
+
+  float dt2 = dt * dt;
+  altitude += velocity * dt + 0.5f * verticalAccel * dt2;
+  velocity += verticalAccel * dt;
+
+  // P = F P F' + Q, with Q from white acceleration noise over the step
+  float q = ALT_KF_ACCEL_NOISE * ALT_KF_ACCEL_NOISE;
+  p00 += dt * (2.0f * p01 + dt * p11) + 0.25f * q * dt2 * dt2;
+  p01 += dt * p11 + 0.5f * q * dt2 * dt;
+  p11 += q * dt2;
+}
+
+bool AltitudeEstimator::correct(float baroAltitude) {
+  if (!initialized) {
+    reset(baroAltitude);
+    return true;
+  }
+
+  float innovation = baroAltitude - altitude;
+  float s = p00 + ALT_KF_BARO_NOISE * ALT_KF_BARO_NOISE;
+
+  // Gate out pressure spikes (e.g. transonic or ejection transients), but
+  // trust the baro again if it keeps disagreeing
+  if (innovation * innovation > ALT_KF_GATE_SIGMA * ALT_KF_GATE_SIGMA * s) {
+    rejectedTotal++;
+    if (++consecutiveRejects >= ALT_KF_MAX_REJECTS) {
+      float keptVelocity = velocity;
+      reset(baroAltitude);
+      velocity = keptVelocity;
+    }
+    return false;
+  }
+  consecutiveRejects = 0;
+
+  float k0 = p00 / s;
+  float k1 = p01 / s;
+  altitude += k0 * innovation;
+  velocity += k1 * innovation;
+
+  p11 -= k1 * p01;
+  p01 -= k0 * p01;
+  p00 -= k0 * p00;
+  return true;
+}
+
+void AltitudeEstimator::observeGravity(float ax, float ay, float az, float gx, float gy, float gz) {
+  float magnitude = sqrtf(ax * ax + ay * ay + az * az);
+  if (fabsf(magnitude - 1.0f) > ALT_KF_REST_ACCEL_TOLERANCE ||
+      fabsf(gx) > ALT_KF_REST_GYRO_LIMIT || fabsf(gy) > ALT_KF_REST_GYRO_LIMIT || fabsf(gz) > ALT_KF_REST_GYRO_LIMIT) {
+    return;
+  }
+
+  if (!haveUp) {
+    upX = ax;
+    upY = ay;
+    upZ = az;
+    haveUp = true;
+    return;
+  }
+  upX += (ax - upX) * ALT_KF_REST_FILTER;
+  upY += (ay - upY) * ALT_KF_REST_FILTER;
+  upZ += (az - upZ) * ALT_KF_REST_FILTER;
+}
+
+float AltitudeEstimator::verticalAccel(float ax, float ay, float az) const {
+  if (!haveUp) {
+    return (sqrtf(ax * ax + ay * ay + az * az) - 1.0f) * STANDARD_GRAVITY;
+  }
+  float upNorm = sqrtf(upX * upX + upY * upY + upZ * upZ);
+  return ((ax * upX + ay * upY + az * upZ) / upNorm - 1.0f) * STANDARD_GRAVITY;
+}
+
+bool AltitudeEstimator::getGravity(float up[3]) const {
+  up[0] = upX;
+  up[1] = upY;
+  up[2] = upZ;
+  return haveUp;
+}
+
+void AltitudeEstimator::setGravity(const float up[3]) {
+  upX = up[0];
+  upY = up[1];
+  upZ = up[2];
+  haveUp = true;
+}
@@ -0,0 +1,212 @@
+#include "attitude_estimator.h"
+#include "altitude_estimator.h"
+#include <math.h>
+#include <string.h>
+
+#define AHRS_DEG_TO_RAD 0.017453292f
+#define AHRS_RAD_TO_DEG 57.29578f
+
+// 1/sqrt(x) with two Newton steps (relative error below 5e-6). The
+// libm sqrt/divide pair is several times slower on the ESP32 FPU.
+static inline float invSqrt(float x) {
+  float half = 0.5f * x;
+  uint32_t i;
+  memcpy(&i, &x, sizeof(i));
+  i = 0x5f3759df - (i >> 1);
+  float y;
+  memcpy(&y, &i, sizeof(y));
+  y = y * (1.5f - half * y * y);
+  y = y * (1.5f - half * y * y);
+  return y;
+}
+
+// Accel correction weight: 1 near 1 g, 0 under thrust or in free fall.
+// The comparison yields 0/1 without a branch.
+static inline float accelWeight(float normSquared) {
+  float deviation = normSquared * invSqrt(normSquared) - 1.0f;
+  return (float)(fabsf(deviation) < AHRS_ACCEL_GATE);
+}
+
+AttitudeEstimator::AttitudeEstimator() {
+  reset();
+}
+
+void AttitudeEstimator::reset() {
+  q0 = 1.0f;
+  q1 = q2 = q3 = 0.0f;
+  aligned = false;
+}
+
+void AttitudeEstimator::align(float ax, float ay, float az) {
+  float roll = atan2f(ay, az);
+  float pitch = atan2f(-ax, sqrtf(ay * ay + az * az));
+  float cr = cosf(roll * 0.5f), sr = sinf(roll * 0.5f);
+  float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+  q0 = cr * cp;
+  q1 = sr * cp;
+  q2 = cr * sp;
+  q3 = -sr * sp;
+  aligned = true;
+}
+
+void AttitudeEstimator::setQuaternion(float w, float x, float y, float z) {
+  q0 = w;
+  q1 = x;
+  q2 = y;
+  q3 = z;
+  aligned = true;
+}
+
+void AttitudeEstimator::update(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+  gx *= AHRS_DEG_TO_RAD;
+  gy *= AHRS_DEG_TO_RAD;
+  gz *= AHRS_DEG_TO_RAD;
+
+  // Rate of change of quaternion from the gyros
+  float qDot0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+  float qDot1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+  float qDot2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+  float qDot3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+  // Normalised accel; the epsilon keeps a zero reading finite (its weight
+  // is zero anyway)
+  float aNorm2 = ax * ax + ay * ay + az * az + 1e-12f;
+  float beta = AHRS_BETA * accelWeight(aNorm2);
+  float recipNorm = invSqrt(aNorm2);
+  ax *= recipNorm;
+  ay *= recipNorm;
+  az *= recipNorm;
+
+  // Gradient of the gravity direction error
+  float _2q0 = 2.0f * q0, _2q1 = 2.0f * q1, _2q2 = 2.0f * q2, _2q3 = 2.0f * q3;
+  float _4q0 = 4.0f * q0, _4q1 = 4.0f * q1, _4q2 = 4.0f * q2;
+  float _8q1 = 8.0f * q1, _8q2 = 8.0f * q2;
+  float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+
+  float s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+  float s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+  float s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+  float s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+  recipNorm = invSqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3 + 1e-12f);
+
+  qDot0 -= beta * s0 * recipNorm;
+  qDot1 -= beta * s1 * recipNorm;
+  qDot2 -= beta * s2 * recipNorm;
+  qDot3 -= beta * s3 * recipNorm;
+
+  q0 += qDot0 * dt;
+  q1 += qDot1 * dt;
+  q2 += qDot2 * dt;
+  q3 += qDot3 * dt;
+
+  recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+  q0 *= recipNorm;
+  q1 *= recipNorm;
+  q2 *= recipNorm;
+  q3 *= recipNorm;
+}
+
+void AttitudeEstimator::update(float gx, float gy, float gz, float ax, float ay, float az,
+                               float mx, float my, float mz, float dt) {
+  gx *= AHRS_DEG_TO_RAD;
+  gy *= AHRS_DEG_TO_RAD;
+  gz *= AHRS_DEG_TO_RAD;
+
+  float qDot0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+  float qDot1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+  float qDot2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+  float qDot3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+  float aNorm2 = ax * ax + ay * ay + az * az + 1e-12f;
+  float beta = AHRS_BETA * accelWeight(aNorm2);
+  float recipNorm = invSqrt(aNorm2);
+  ax *= recipNorm;
+  ay *= recipNorm;
+  az *= recipNorm;
+
+  recipNorm = invSqrt(mx * mx + my * my + mz * mz + 1e-12f);
+  mx *= recipNorm;
+  my *= recipNorm;
+  mz *= recipNorm;
+
+  float _2q0mx = 2.0f * q0 * mx, _2q0my = 2.0f * q0 * my, _2q0mz = 2.0f * q0 * mz, _2q1mx = 2.0f * q1 * mx;
+  float _2q0 = 2.0f * q0, _2q1 = 2.0f * q1, _2q2 = 2.0f * q2, _2q3 = 2.0f * q3;
+  float _2q0q2 = 2.0f * q0 * q2, _2q2q3 = 2.0f * q2 * q3;
+  float q0q0 = q0 * q0, q0q1 = q0 * q1, q0q2 = q0 * q2, q0q3 = q0 * q3;
+  float q1q1 = q1 * q1, q1q2 = q1 * q2, q1q3 = q1 * q3;
+  float q2q2 = q2 * q2, q2q3 = q2 * q3, q3q3 = q3 * q3;
+
+  // Earth field reference: the measured field rotated into the earth frame
+  // and flattened onto the x-z plane
+  float hx = mx * q0q0 - _2q0my * q3 + _2q0mz * q2 + mx * q1q1 + _2q1 * my * q2 + _2q1 * mz * q3 - mx * q2q2 - mx * q3q3;
+  float hy = _2q0mx * q3 + my * q0q0 - _2q0mz * q1 + _2q1mx * q2 - my * q1q1 + my * q2q2 + _2q2 * mz * q3 - my * q3q3;
+  float hNorm2 = hx * hx + hy * hy + 1e-12f;
+  float _2bx = hNorm2 * invSqrt(hNorm2);
+  float _2bz = -_2q0mx * q2 + _2q0my * q1 + mz * q0q0 + _2q1mx * q3 - mz * q1q1 + _2q2 * my * q3 - mz * q2q2 + mz * q3q3;
+  float _4bx = 2.0f * _2bx, _4bz = 2.0f * _2bz;
+
+  // Gradient of the combined gravity and field direction errors
+  float ex = 2.0f * q1q3 - _2q0q2 - ax;
+  float ey = 2.0f * q0q1 + _2q2q3 - ay;
+  float ez = 1.0f - 2.0f * q1q1 - 2.0f * q2q2 - az;
+  float fx = _2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx;
+  float fy = _2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my;
+  float fz = _2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz;
+
+  float s0 = -_2q2 * ex + _2q1 * ey - _2bz * q2 * fx + (-_2bx * q3 + _2bz * q1) * fy + _2bx * q2 * fz;
+  float s1 = _2q3 * ex + _2q0 * ey - 4.0f * q1 * ez + _2bz * q3 * fx + (_2bx * q2 + _2bz * q0) * fy + (_2bx * q3 - _4bz * q1) * fz;
+  float s2 = -_2q0 * ex + _2q3 * ey - 4.0f * q2 * ez + (-_4bx * q2 - _2bz * q0) * fx + (_2bx * q1 + _2bz * q3) * fy + (_2bx * q0 - _4bz * q2) * fz;
+  float s3 = _2q1 * ex + _2q2 * ey + (-_4bx * q3 + _2bz * q1) * fx + (-_2bx * q0 + _2bz * q2) * fy + _2bx * q1 * fz;
+  recipNorm = invSqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3 + 1e-12f);
+
+  qDot0 -= beta * s0 * recipNorm;
+  qDot1 -= beta * s1 * recipNorm;
+  qDot2 -= beta * s2 * recipNorm;
+  qDot3 -= beta * s3 * recipNorm;
+
+  q0 += qDot0 * dt;
+  q1 += qDot1 * dt;
+  q2 += qDot2 * dt;
+  q3 += qDot3 * dt;
+
+  recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+  q0 *= recipNorm;
+  q1 *= recipNorm;
+  q2 *= recipNorm;
+  q3 *= recipNorm;
+}
+
+void AttitudeEstimator::getQuaternion(float& w, float& x, float& y, float& z) const {
+  w = q0;
+  x = q1;
+  y = q2;
+  z = q3;
+}
+
+void AttitudeEstimator::getEuler(float& roll, float& pitch, float& yaw) const {
+  float sinPitch = 2.0f * (q0 * q2 - q1 * q3);
+  sinPitch = fminf(1.0f, fmaxf(-1.0f, sinPitch));
+  roll = atan2f(2.0f * (q0 * q1 + q2 * q3), 1.0f - 2.0f * (q1 * q1 + q2 * q2)) * AHRS_RAD_TO_DEG;
+  pitch = asinf(sinPitch) * AHRS_RAD_TO_DEG;
+  yaw = atan2f(2.0f * (q0 * q3 + q1 * q2), 1.0f - 2.0f * (q2 * q2 + q3 * q3)) * AHRS_RAD_TO_DEG;
+}
+
+float AttitudeEstimator::getTilt() const {
+  float cosTilt = 1.0f - 2.0f * (q1 * q1 + q2 * q2);
+  return acosf(fminf(1.0f, fmaxf(-1.0f, cosTilt))) * AHRS_RAD_TO_DEG;
+}
+
+float AttitudeEstimator::verticalAccel(float ax, float ay, float az) const {
+  // Third row of the body-to-earth rotation matrix
+  float up = 2.0f * (q1 * q3 - q0 * q2) * ax + 2.0f * (q0 * q1 + q2 * q3) * ay + (1.0f - 2.0f * (q1 * q1 + q2 * q2)) * az;
+  return (up - 1.0f) * STANDARD_GRAVITY;
+}
+
+void AttitudeEstimator::earthAccel(float ax, float ay, float az, float out[3]) const {
+  float x = (1.0f - 2.0f * (q2 * q2 + q3 * q3)) * ax + 2.0f * (q1 * q2 - q0 * q3) * ay + 2.0f * (q1 * q3 + q0 * q2) * az;
+  float y = 2.0f * (q1 * q2 + q0 * q3) * ax + (1.0f - 2.0f * (q1 * q1 + q3 * q3)) * ay + 2.0f * (q2 * q3 - q0 * q1) * az;
+  float z = 2.0f * (q1 * q3 - q0 * q2) * ax + 2.0f * (q0 * q1 + q2 * q3) * ay + (1.0f - 2.0f * (q1 * q1 + q2 * q2)) * az;
+  out[0] = x * STANDARD_GRAVITY;
+  out[1] = y * STANDARD_GRAVITY;
+  out[2] = (z - 1.0f) * STANDARD_GRAVITY;
+}
@@ -0,0 +1,220 @@
+#include "black_box.h"
+#include "checksum.h"
+#include <string.h>
+
+BlackBox::BlackBox()
+  : ready(false), sectors(0), perSector(0), capacity(0), head(0), tail(0), pending(0), nextSeq(0) {
+  memset(&flash, 0, sizeof(flash));
+  memset(erased, 0, sizeof(erased));
+  memset(&stats, 0, sizeof(stats));
+}
+
+uint32_t BlackBox::entryOffset(uint32_t index) const {
+  return (index / perSector) * BLACKBOX_SECTOR_SIZE + (index % perSector) * sizeof(BlackBoxEntry);
+}
+
+bool BlackBox::isErased(uint32_t sector) const {
+  return (erased[sector / 8] >> (sector % 8)) & 1;
+}
+
+void BlackBox::setErased(uint32_t sector, bool value) {
+  if (value) {
+    erased[sector / 8] |= (uint8_t)(1 << (sector % 8));
+  } else {
+    erased[sector / 8] &= (uint8_t)~(1 << (sector % 8));
+  }
+}
+
+bool BlackBox::eraseSector(uint32_t sector) {
+  if (!flash.erase(flash.context, sector * BLACKBOX_SECTOR_SIZE)) {
+    stats.flashErrors++;
+    return false;
+  }
+  stats.erases++;
+  setErased(sector, true);
+  return true;
+}
+
+uint32_t BlackBox::entryCrc(const BlackBoxEntry& entry) {
+  uint32_t crc = crc32((const uint8_t*)&entry.seq, sizeof(entry.seq));
+  crc = crc32(&entry.groups, sizeof(entry.groups), crc);
+  return crc32((const uint8_t*)&entry.data, sizeof(entry.data), crc);
+}
+
+bool BlackBox::begin(const BlackBoxFlash& flashAccess) {
+  flash = flashAccess;
+  ready = false;
+  memset(&stats, 0, sizeof(stats));
+  sectors = flash.size / BLACKBOX_SECTOR_SIZE;
+  if (sectors > BLACKBOX_MAX_SECTORS) {
+    sectors = BLACKBOX_MAX_SECTORS;
+  }
+  perSector = BLACKBOX_SECTOR_SIZE / sizeof(BlackBoxEntry);
+  capacity = sectors * perSector;
+  if (sectors < 2 || perSector == 0) {
+    return false;
+  }
+
+  // The newest record gives the write position and the oldest one not yet
+  // drained the read position. Sectors are written front to back, so the
+  // first blank entry ends a sector. Whole sectors are read at once: one
+  // flash read per entry would make this a slow part of the boot.
+  static uint8_t sectorBuffer[BLACKBOX_SECTOR_SIZE];
+  bool haveNewest = false, haveOldest = false;
+  uint32_t newestSeq = 0, oldestSeq = 0;
+  uint32_t newestIndex = 0, oldestIndex = 0;
+  uint32_t newestUsed = 0;
+  BlackBoxEntry entry;
+  for (uint32_t s = 0; s < sectors; s++) {
+    if (!flash.read(flash.context, s * BLACKBOX_SECTOR_SIZE, sectorBuffer, perSector * sizeof(entry))) {
+      return false;
+    }
+    uint32_t used = 0;
+    for (; used < perSector; used++) {
+      memcpy(&entry, sectorBuffer + used * sizeof(entry), sizeof(entry));
+      if (entry.seq == BLACKBOX_EMPTY_SEQ) {
+        break;
+      }
+      if (entry.crc != entryCrc(entry)) {
+        continue;
+      }
+      uint32_t index = s * perSector + used;
+      if (!haveNewest || entry.seq > newestSeq) {
+        haveNewest = true;
+        newestSeq = entry.seq;
+        newestIndex = index;
+      }
+      if (entry.drained == 0xFF && (!haveOldest || entry.seq < oldestSeq)) {
+        haveOldest = true;
+        oldestSeq = entry.seq;
+        oldestIndex = index;
+      }
+    }
+    if (haveNewest && newestIndex / perSector == s) {
+      newestUsed = used;
+    }
+    setErased(s, used == 0);
+  }
+
+  // Write after every used slot of the newest sector, not just after the
+  // newest record: a program torn by a reset can't be written over
+  head = haveNewest ? ((newestIndex / perSector) * perSector + newestUsed) % capacity : 0;
+  nextSeq = haveNewest ? newestSeq + 1 : 0;
+  tail = haveOldest ? oldestIndex : head;
+  pending = haveOldest ? (head + capacity - tail) % capacity : 0;
+  if (haveOldest && pending == 0) {
+    pending = capacity;
+  }
+  ready = true;
+  return true;
+}
+
+bool BlackBox::append(const TelemetryData& data, uint8_t groups) {
+  if (!ready) {
+    return false;
+  }
+
+  // Entering a sector that still holds old records: erase it now, losing
+  // whatever of the oldest wasn't drained
+  uint32_t sector = head / perSector;
+  if (head % perSector == 0 && !isErased(sector)) {
+    while (pending > 0 && tail / perSector == sector) {
+      tail = (tail + 1) % capacity;
+      pending--;
+      stats.overwritten++;
+    }
+    stats.inlineErases++;
+    if (!eraseSector(sector)) {
+      return false;
+    }
+  }
+
+  BlackBoxEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.seq = nextSeq++;
+  entry.groups = groups;
+  entry.drained = 0xFF;
+  entry.data = data;
+  entry.crc = entryCrc(entry);
+
+  // A failed program leaves the slot unusable until the next erase; the
+  // reader skips it on its CRC
+  bool written = flash.write(flash.context, entryOffset(head), &entry, sizeof(entry));
+  if (!written) {
+    stats.flashErrors++;
+  }
+  setErased(sector, false);
+  head = (head + 1) % capacity;
+  pending++;
+  stats.appended++;
+  return written;
+}
+
+bool BlackBox::peekOldest(BlackBoxEntry& entry) {
+  while (ready && pending > 0) {
+    if (!flash.read(flash.context, entryOffset(tail), &entry, sizeof(entry))) {
+      stats.flashErrors++;
+      return false;
+    }
+    if (entry.seq != BLACKBOX_EMPTY_SEQ && entry.drained == 0xFF && entry.crc == entryCrc(entry)) {
+      return true;
+    }
+    stats.corrupt++;
+    tail = (tail + 1) % capacity;
+    pending--;
+  }
+  return false;
+}
+
+bool BlackBox::markDrained() {
+  if (!ready || pending == 0) {
+    return false;
+  }
+  // Clearing bits needs no erase. If it fails the record is on SD anyway
+  // and only comes back as a duplicate after a reset.
+  uint8_t cleared = 0;
+  bool written = flash.write(flash.context, entryOffset(tail) + offsetof(BlackBoxEntry, drained), &cleared, 1);
+  if (!written) {
+    stats.flashErrors++;
+  }
+  tail = (tail + 1) % capacity;
+  pending--;
+  stats.drained++;
+  return written;
+}
+
+int BlackBox::eraseAhead(int maxSectors) {
+  if (!ready) {
+    return 0;
+  }
+  uint32_t headSector = head / perSector;
+  uint32_t first = head % perSector == 0 ? headSector : (headSector + 1) % sectors;
+  int count = 0;
+  for (uint32_t k = 0; k < sectors && count < maxSectors; k++) {
+    uint32_t s = (first + k) % sectors;
+    // Stop at records still to drain, or back at the sector being written
+    if ((pending > 0 && s == tail / perSector) || (s == headSector && head % perSector != 0)) {
+      break;
+    }
+    if (!isErased(s)) {
+      if (!eraseSector(s)) {
+        break;
+      }
+      count++;
+    }
+  }
+  return count;
+}
+
+uint32_t BlackBox::getErasedAhead() const {
+  if (!ready) {
+    return 0;
+  }
+  uint32_t headSector = head / perSector;
+  uint32_t first = head % perSector == 0 ? headSector : (headSector + 1) % sectors;
+  uint32_t count = 0;
+  while (count < sectors && isErased((first + count) % sectors)) {
+    count++;
+  }
+  return count;
+}
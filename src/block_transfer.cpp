@@ -0,0 +1,178 @@
+#include "block_transfer.h"
+#include "checksum.h"
+#include "command_protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int base64Value(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+uint16_t BlockTransfer::fileId(const char* fileName) {
+  // Ignore a leading '/' so "/flight.csv" and "flight.csv" match
+  if (fileName[0] == '/') {
+    fileName++;
+  }
+  return crc16Ccitt((const uint8_t*)fileName, strlen(fileName));
+}
+
+uint32_t BlockTransfer::blockCount(uint32_t fileSize) {
+  return (fileSize + DOWNLINK_BLOCK_SIZE - 1) / DOWNLINK_BLOCK_SIZE;
+}
+
+size_t BlockTransfer::base64Encode(const uint8_t* data, size_t len, char* out) {
+  size_t o = 0;
+  size_t i = 0;
+  for (; i + 2 < len; i += 3) {
+    uint32_t v = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+    out[o++] = base64Alphabet[(v >> 18) & 0x3F];
+    out[o++] = base64Alphabet[(v >> 12) & 0x3F];
+    out[o++] = base64Alphabet[(v >> 6) & 0x3F];
+    out[o++] = base64Alphabet[v & 0x3F];
+  }
+  if (i < len) {
+    uint32_t v = (uint32_t)data[i] << 16;
+    if (i + 1 < len) {
+      v |= (uint32_t)data[i + 1] << 8;
+    }
+    out[o++] = base64Alphabet[(v >> 18) & 0x3F];
+    out[o++] = base64Alphabet[(v >> 12) & 0x3F];
+    out[o++] = (i + 1 < len) ? base64Alphabet[(v >> 6) & 0x3F] : '=';
+    out[o++] = '=';
+  }
+  out[o] = '\0';
+  return o;
+}
+
+int BlockTransfer::base64Decode(const char* text, size_t len, uint8_t* out, size_t capacity) {
+  if (len % 4 != 0) {
+    return -1;
+  }
+
+  size_t o = 0;
+  for (size_t i = 0; i < len; i += 4) {
+    int a = base64Value(text[i]);
+    int b = base64Value(text[i + 1]);
+    int c = text[i + 2] == '=' ? 0 : base64Value(text[i + 2]);
+    int d = text[i + 3] == '=' ? 0 : base64Value(text[i + 3]);
+    if (a < 0 || b < 0 || c < 0 || d < 0) {
+      return -1;
+    }
+
+    uint32_t v = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | (uint32_t)d;
+    size_t n = text[i + 2] == '=' ? 1 : (text[i + 3] == '=' ? 2 : 3);
+    if (o + n > capacity) {
+      return -1;
+    }
+    out[o++] = (uint8_t)(v >> 16);
+    if (n > 1) out[o++] = (uint8_t)(v >> 8);
+    if (n > 2) out[o++] = (uint8_t)v;
+  }
+  return (int)o;
+}
+
+size_t BlockTransfer::formatBlock(char* buffer, size_t capacity, uint16_t id, uint32_t block,
+                                  const uint8_t* data, size_t len) {
+  if (capacity < BLOCK_LINE_MAX_LENGTH || len > DOWNLINK_BLOCK_SIZE) {
+    return 0;
+  }
+
+  int header = snprintf(buffer, capacity, BLOCK_FRAME_PREFIX "%u,%lu,", (unsigned)id, (unsigned long)block);
+  size_t encoded = base64Encode(data, len, buffer + header);
+  return CommandProtocol::appendCrc(buffer, (size_t)header + encoded, capacity);
+}
+
+bool BlockTransfer::parseBlock(const char* line, uint16_t& id, uint32_t& block, uint8_t* data, size_t& len) {
+  size_t prefixLen = strlen(BLOCK_FRAME_PREFIX);
+  if (strncmp(line, BLOCK_FRAME_PREFIX, prefixLen) != 0) {
+    return false;
+  }
+
+  int bodyEnd = CommandProtocol::verifyCrc(line);
+  if (bodyEnd < 0) {
+    return false;
+  }
+
+  const char* p = line + prefixLen;
+  char* end = NULL;
+  id = (uint16_t)strtoul(p, &end, 10);
+  if (end == p || *end != ',') {
+    return false;
+  }
+  p = end + 1;
+  block = (uint32_t)strtoul(p, &end, 10);
+  if (end == p || *end != ',') {
+    return false;
+  }
+  p = end + 1;
+
+  int decoded = base64Decode(p, (size_t)(line + bodyEnd - p), data, DOWNLINK_BLOCK_SIZE);
+  if (decoded <= 0) {
+    return false;
+  }
+  len = (size_t)decoded;
+  return true;
+}
+
+int BlockTransfer::parseRanges(const char* spec, BlockRange* ranges, int maxRanges) {
+  int count = 0;
+  const char* p = spec;
+
+  while (*p) {
+    if (count >= maxRanges) {
+      return -1;
+    }
+    char* end = NULL;
+    uint32_t first = (uint32_t)strtoul(p, &end, 10);
+    if (end == p) {
+      return -1;
+    }
+    uint32_t last = first;
+    if (*end == '-') {
+      p = end + 1;
+      last = (uint32_t)strtoul(p, &end, 10);
+      if (end == p || last < first) {
+        return -1;
+      }
+    }
+    ranges[count].first = first;
+    ranges[count].last = last;
+    count++;
+
+    if (*end == ',') {
+      end++;
+    } else if (*end != '\0') {
+      return -1;
+    }
+    p = end;
+  }
+
+  return count;
+}
+
+size_t BlockTransfer::formatRanges(char* buffer, size_t capacity, const BlockRange* ranges, int count) {
+  size_t len = 0;
+  buffer[0] = '\0';
+  for (int i = 0; i < count; i++) {
+    int n;
+    if (ranges[i].first == ranges[i].last) {
+      n = snprintf(buffer + len, capacity - len, "%s%lu", i ? "," : "", (unsigned long)ranges[i].first);
+    } else {
+      n = snprintf(buffer + len, capacity - len, "%s%lu-%lu", i ? "," : "",
+                   (unsigned long)ranges[i].first, (unsigned long)ranges[i].last);
+    }
+    if (n < 0 || len + (size_t)n >= capacity) {
+      return 0;
+    }
+    len += (size_t)n;
+  }
+  return len;
+}
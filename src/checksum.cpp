@@ -0,0 +1,28 @@
+#include "checksum.h"
+
+uint16_t crc16Ccitt(const uint8_t* data, size_t len, uint16_t crc) {
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// Four bits at a time from a 16-entry table: a fraction of the bitwise
+// cost without a 1 KB table
+static const uint32_t crc32Nibbles[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ crc32Nibbles[crc & 0x0F];
+    crc = (crc >> 4) ^ crc32Nibbles[crc & 0x0F];
+  }
+  return ~crc;
+}
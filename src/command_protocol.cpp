@@ -0,0 +1,158 @@
+#include "command_protocol.h"
+#include "checksum.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// Copies text[0..len) into dest, truncating to capacity - 1
+static void copyField(char* dest, size_t capacity, const char* text, size_t len) {
+  if (len >= capacity) {
+    len = capacity - 1;
+  }
+  memcpy(dest, text, len);
+  dest[len] = '\0';
+}
+
+int CommandProtocol::verifyCrc(const char* line) {
+  const char* star = strrchr(line, '*');
+  if (star == NULL) {
+    return -1;
+  }
+
+  uint16_t received = 0;
+  for (int i = 1; i <= 4; i++) {
+    int v = hexValue(star[i]);
+    if (v < 0) {
+      return -1;
+    }
+    received = (uint16_t)((received << 4) | v);
+  }
+
+  // Only line terminators may follow the checksum
+  for (const char* p = star + 5; *p; p++) {
+    if (*p != '\r' && *p != '\n') {
+      return -1;
+    }
+  }
+
+  size_t len = (size_t)(star - line);
+  if (crc16Ccitt((const uint8_t*)line, len) != received) {
+    return -1;
+  }
+  return (int)len;
+}
+
+size_t CommandProtocol::appendCrc(char* buffer, size_t len, size_t capacity) {
+  if (len + 7 > capacity) {
+    return 0;
+  }
+  uint16_t crc = crc16Ccitt((const uint8_t*)buffer, len);
+  snprintf(buffer + len, capacity - len, "*%04X\n", crc);
+  return len + 6;
+}
+
+bool CommandProtocol::parseCommand(const char* line, CommandFrame& frame) {
+  size_t prefixLen = strlen(CMD_FRAME_PREFIX);
+  if (strncmp(line, CMD_FRAME_PREFIX, prefixLen) != 0) {
+    return false;
+  }
+
+  int bodyEnd = verifyCrc(line);
+  if (bodyEnd < 0) {
+    return false;
+  }
+
+  const char* p = line + prefixLen;
+  const char* end = line + bodyEnd;
+  char* seqEnd = NULL;
+  frame.seq = (uint32_t)strtoul(p, &seqEnd, 10);
+  if (seqEnd == p || seqEnd >= end || *seqEnd != ',') {
+    return false;
+  }
+
+  const char* name = seqEnd + 1;
+  const char* comma = (const char*)memchr(name, ',', (size_t)(end - name));
+  const char* nameEnd = comma ? comma : end;
+  if (nameEnd == name) {
+    return false;
+  }
+
+  copyField(frame.name, sizeof(frame.name), name, (size_t)(nameEnd - name));
+  if (comma) {
+    copyField(frame.args, sizeof(frame.args), comma + 1, (size_t)(end - comma - 1));
+  } else {
+    frame.args[0] = '\0';
+  }
+  return true;
+}
+
+bool CommandProtocol::parseAck(const char* line, AckFrame& ack) {
+  size_t prefixLen = strlen(ACK_FRAME_PREFIX);
+  if (strncmp(line, ACK_FRAME_PREFIX, prefixLen) != 0) {
+    return false;
+  }
+
+  int bodyEnd = verifyCrc(line);
+  if (bodyEnd < 0) {
+    return false;
+  }
+
+  const char* p = line + prefixLen;
+  const char* end = line + bodyEnd;
+  char* fieldEnd = NULL;
+  ack.seq = (uint32_t)strtoul(p, &fieldEnd, 10);
+  if (fieldEnd == p || fieldEnd >= end || *fieldEnd != ',') {
+    return false;
+  }
+
+  const char* status = fieldEnd + 1;
+  const char* comma = (const char*)memchr(status, ',', (size_t)(end - status));
+  if (comma == NULL) {
+    return false;
+  }
+  copyField(ack.status, sizeof(ack.status), status, (size_t)(comma - status));
+
+  ack.execMicros = (uint32_t)strtoul(comma + 1, &fieldEnd, 10);
+  if (fieldEnd < end && *fieldEnd == ',') {
+    copyField(ack.detail, sizeof(ack.detail), fieldEnd + 1, (size_t)(end - fieldEnd - 1));
+  } else {
+    ack.detail[0] = '\0';
+  }
+  return true;
+}
+
+size_t CommandProtocol::formatCommand(char* buffer, size_t capacity, uint32_t seq, const char* name, const char* args) {
+  int len;
+  if (args && args[0]) {
+    len = snprintf(buffer, capacity, CMD_FRAME_PREFIX "%lu,%s,%s", (unsigned long)seq, name, args);
+  } else {
+    len = snprintf(buffer, capacity, CMD_FRAME_PREFIX "%lu,%s", (unsigned long)seq, name);
+  }
+  if (len < 0 || (size_t)len >= capacity) {
+    return 0;
+  }
+  return appendCrc(buffer, (size_t)len, capacity);
+}
+
+size_t CommandProtocol::formatAck(char* buffer, size_t capacity, uint32_t seq, const char* status,
+                                  uint32_t execMicros, const char* detail) {
+  int len;
+  if (detail && detail[0]) {
+    len = snprintf(buffer, capacity, ACK_FRAME_PREFIX "%lu,%s,%lu,%s",
+                   (unsigned long)seq, status, (unsigned long)execMicros, detail);
+  } else {
+    len = snprintf(buffer, capacity, ACK_FRAME_PREFIX "%lu,%s,%lu",
+                   (unsigned long)seq, status, (unsigned long)execMicros);
+  }
+  if (len < 0 || (size_t)len >= capacity) {
+    return 0;
+  }
+  return appendCrc(buffer, (size_t)len, capacity);
+}
@@ -0,0 +1,363 @@
+#include "fec_codec.h"
+#include <string.h>
+
+// GF(2^8) with primitive polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11D).
+// Generator roots are alpha^0 .. alpha^(nsym-1).
+static uint8_t gfExp[512];
+static uint8_t gfLog[256];
+static uint8_t gfGenerator[FEC_PARITY_BYTES + 1];
+static int gfGeneratorSize = 0;
+static bool gfTablesReady = false;
+
+void ReedSolomon::initTables() {
+  if (gfTablesReady) {
+    return;
+  }
+
+  uint16_t x = 1;
+  for (int i = 0; i < 255; i++) {
+    gfExp[i] = (uint8_t)x;
+    gfLog[x] = (uint8_t)i;
+    x <<= 1;
+    if (x & 0x100) {
+      x ^= 0x11D;
+    }
+  }
+  // Duplicate the table so gfMul never needs a modulo
+  for (int i = 255; i < 512; i++) {
+    gfExp[i] = gfExp[i - 255];
+  }
+  gfLog[0] = 0;
+  gfTablesReady = true;
+}
+
+uint8_t ReedSolomon::gfMul(uint8_t a, uint8_t b) {
+  if (a == 0 || b == 0) {
+    return 0;
+  }
+  return gfExp[gfLog[a] + gfLog[b]];
+}
+
+uint8_t ReedSolomon::gfDiv(uint8_t a, uint8_t b) {
+  if (a == 0) {
+    return 0;
+  }
+  return gfExp[gfLog[a] + 255 - gfLog[b]];
+}
+
+uint8_t ReedSolomon::gfPow2(int e) {
+  e %= 255;
+  if (e < 0) {
+    e += 255;
+  }
+  return gfExp[e];
+}
+
+const uint8_t* ReedSolomon::generator(int nsym) {
+  initTables();
+
+  if (gfGeneratorSize == nsym + 1) {
+    return gfGenerator;
+  }
+
+  // g(x) = (x - a^0)(x - a^1)...(x - a^(nsym-1)), highest degree first
+  uint8_t g[FEC_PARITY_BYTES + 1];
+  memset(g, 0, sizeof(g));
+  g[0] = 1;
+  int size = 1;
+  for (int i = 0; i < nsym; i++) {
+    uint8_t root = gfExp[i];
+    g[size] = 0;
+    for (int j = size; j > 0; j--) {
+      g[j] ^= gfMul(g[j - 1], root);
+    }
+    size++;
+  }
+
+  memcpy(gfGenerator, g, size);
+  gfGeneratorSize = size;
+  return gfGenerator;
+}
+
+void ReedSolomon::encode(const uint8_t* data, size_t len, uint8_t* parity, int nsym) {
+  const uint8_t* g = generator(nsym);
+
+  // LFSR division of data(x) * x^nsym by g(x); the remainder is the parity
+  memset(parity, 0, nsym);
+  for (size_t i = 0; i < len; i++) {
+    uint8_t feedback = data[i] ^ parity[0];
+    memmove(parity, parity + 1, nsym - 1);
+    parity[nsym - 1] = 0;
+    if (feedback != 0) {
+      uint8_t logFeedback = gfLog[feedback];
+      for (int j = 0; j < nsym; j++) {
+        if (g[j + 1] != 0) {
+          parity[j] ^= gfExp[logFeedback + gfLog[g[j + 1]]];
+        }
+      }
+    }
+  }
+}
+
+int ReedSolomon::decode(uint8_t* codeword, size_t len, int nsym) {
+  initTables();
+
+  if (len <= (size_t)nsym || len > 255 || nsym > FEC_PARITY_BYTES) {
+    return -1;
+  }
+
+  // Syndromes S_j = r(a^j); all zero means no detectable errors
+  uint8_t synd[FEC_PARITY_BYTES];
+  bool hasErrors = false;
+  for (int j = 0; j < nsym; j++) {
+    uint8_t s = 0;
+    uint8_t root = gfExp[j];
+    for (size_t i = 0; i < len; i++) {
+      s = gfMul(s, root) ^ codeword[i];
+    }
+    synd[j] = s;
+    hasErrors |= (s != 0);
+  }
+
+  if (!hasErrors) {
+    return 0;
+  }
+
+  // Berlekamp-Massey: error locator Lambda(x), lowest degree first
+  uint8_t lambda[FEC_PARITY_BYTES + 1];
+  uint8_t prev[FEC_PARITY_BYTES + 1];
+  uint8_t temp[FEC_PARITY_BYTES + 1];
+  memset(lambda, 0, sizeof(lambda));
+  memset(prev, 0, sizeof(prev));
+  lambda[0] = 1;
+  prev[0] = 1;
+  int errCount = 0;
+  int shift = 1;
+  uint8_t prevDiscrepancy = 1;
+
+  for (int n = 0; n < nsym; n++) {
+    uint8_t d = synd[n];
+    for (int i = 1; i <= errCount; i++) {
+      d ^= gfMul(lambda[i], synd[n - i]);
+    }
+
+    if (d == 0) {
+      shift++;
+      continue;
+    }
+
+    uint8_t coef = gfDiv(d, prevDiscrepancy);
+    if (2 * errCount <= n) {
+      memcpy(temp, lambda, sizeof(lambda));
+      for (int i = 0; i + shift <= nsym; i++) {
+        lambda[i + shift] ^= gfMul(coef, prev[i]);
+      }
+      errCount = n + 1 - errCount;
+      memcpy(prev, temp, sizeof(prev));
+      prevDiscrepancy = d;
+      shift = 1;
+    } else {
+      for (int i = 0; i + shift <= nsym; i++) {
+        lambda[i + shift] ^= gfMul(coef, prev[i]);
+      }
+      shift++;
+    }
+  }
+
+  if (errCount == 0 || 2 * errCount > nsym) {
+    return -1;
+  }
+
+  // Omega(x) = S(x) * Lambda(x) mod x^nsym
+  uint8_t omega[FEC_PARITY_BYTES];
+  for (int i = 0; i < nsym; i++) {
+    uint8_t v = 0;
+    for (int j = 0; j <= i && j <= errCount; j++) {
+      v ^= gfMul(lambda[j], synd[i - j]);
+    }
+    omega[i] = v;
+  }
+
+  // Chien search over the (possibly shortened) codeword, Forney for magnitudes
+  int found = 0;
+  for (size_t pos = 0; pos < len; pos++) {
+    int degree = (int)(len - 1 - pos);
+    uint8_t xInv = gfPow2(-degree);
+
+    uint8_t eval = 0;
+    for (int i = errCount; i >= 0; i--) {
+      eval = gfMul(eval, xInv) ^ lambda[i];
+    }
+    if (eval != 0) {
+      continue;
+    }
+
+    uint8_t num = 0;
+    for (int i = nsym - 1; i >= 0; i--) {
+      num = gfMul(num, xInv) ^ omega[i];
+    }
+
+    // Formal derivative keeps only odd-power terms in GF(2^m)
+    uint8_t den = 0;
+    for (int i = errCount - (errCount % 2 == 0 ? 1 : 0); i >= 1; i -= 2) {
+      den = gfMul(den, gfMul(xInv, xInv)) ^ lambda[i];
+    }
+    if (den == 0) {
+      return -1;
+    }
+
+    uint8_t magnitude = gfMul(gfPow2(degree), gfDiv(num, den));
+    codeword[pos] ^= magnitude;
+    found++;
+  }
+
+  if (found != errCount) {
+    return -1;
+  }
+
+  return found;
+}
+
+size_t FecCodec::codewordCount(size_t payloadLen) {
+  return (payloadLen + FEC_BLOCK_DATA_BYTES - 1) / FEC_BLOCK_DATA_BYTES;
+}
+
+size_t FecCodec::frameSize(size_t payloadLen) {
+  return FEC_HEADER_SIZE + payloadLen + codewordCount(payloadLen) * FEC_PARITY_BYTES;
+}
+
+size_t FecCodec::encodeFrame(const uint8_t* payload, size_t len, uint8_t* frame, size_t frameCapacity) {
+  if (len == 0 || len > FEC_MAX_PAYLOAD || frameSize(len) > frameCapacity) {
+    return 0;
+  }
+
+  frame[0] = FEC_SYNC_0;
+  frame[1] = FEC_SYNC_1;
+  for (int i = 0; i < 3; i++) {
+    frame[2 + i * 2] = (uint8_t)(len & 0xFF);
+    frame[3 + i * 2] = (uint8_t)(len >> 8);
+  }
+
+  uint8_t* body = frame + FEC_HEADER_SIZE;
+  memcpy(body, payload, len);
+
+  // Parity for codeword j follows the payload at body[len + j * FEC_PARITY_BYTES]
+  size_t depth = codewordCount(len);
+  uint8_t block[FEC_BLOCK_DATA_BYTES];
+  for (size_t j = 0; j < depth; j++) {
+    size_t n = 0;
+    for (size_t i = j; i < len; i += depth) {
+      block[n++] = payload[i];
+    }
+    ReedSolomon::encode(block, n, body + len + j * FEC_PARITY_BYTES, FEC_PARITY_BYTES);
+  }
+
+  return frameSize(len);
+}
+
+int FecCodec::decodeBody(uint8_t* body, size_t payloadLen) {
+  size_t depth = codewordCount(payloadLen);
+  uint8_t codeword[FEC_BLOCK_DATA_BYTES + FEC_PARITY_BYTES];
+  int totalCorrected = 0;
+
+  for (size_t j = 0; j < depth; j++) {
+    size_t n = 0;
+    for (size_t i = j; i < payloadLen; i += depth) {
+      codeword[n++] = body[i];
+    }
+    memcpy(codeword + n, body + payloadLen + j * FEC_PARITY_BYTES, FEC_PARITY_BYTES);
+
+    int corrected = ReedSolomon::decode(codeword, n + FEC_PARITY_BYTES, FEC_PARITY_BYTES);
+    if (corrected < 0) {
+      return -1;
+    }
+
+    if (corrected > 0) {
+      n = 0;
+      for (size_t i = j; i < payloadLen; i += depth) {
+        body[i] = codeword[n++];
+      }
+      totalCorrected += corrected;
+    }
+  }
+
+  return totalCorrected;
+}
+
+FecDeframer::FecDeframer(FrameCallback onFrame, RawCallback onRaw, void* context) :
+  onFrame(onFrame),
+  onRaw(onRaw),
+  context(context) {
+  memset(&stats, 0, sizeof(Stats));
+  reset();
+}
+
+void FecDeframer::reset() {
+  state = HUNT;
+  headerPos = 0;
+  bodyPos = 0;
+  bodyLen = 0;
+  payloadLen = 0;
+}
+
+void FecDeframer::push(uint8_t byte) {
+  switch (state) {
+    case HUNT:
+      if (byte == FEC_SYNC_0) {
+        state = SYNC;
+      } else if (onRaw) {
+        onRaw(byte, context);
+      }
+      break;
+
+    case SYNC:
+      if (byte == FEC_SYNC_1) {
+        state = HEADER;
+        headerPos = 0;
+      } else {
+        if (onRaw) {
+          onRaw(FEC_SYNC_0, context);
+        }
+        state = HUNT;
+        push(byte);
+      }
+      break;
+
+    case HEADER:
+      header[headerPos++] = byte;
+      if (headerPos == sizeof(header)) {
+        // Bitwise majority of the three length copies survives any single bad copy
+        uint8_t lo = (header[0] & header[2]) | (header[0] & header[4]) | (header[2] & header[4]);
+        uint8_t hi = (header[1] & header[3]) | (header[1] & header[5]) | (header[3] & header[5]);
+        payloadLen = (size_t)lo | ((size_t)hi << 8);
+
+        if (payloadLen == 0 || payloadLen > FEC_MAX_PAYLOAD) {
+          stats.headerErrors++;
+          state = HUNT;
+          break;
+        }
+
+        bodyLen = payloadLen + FecCodec::codewordCount(payloadLen) * FEC_PARITY_BYTES;
+        bodyPos = 0;
+        state = BODY;
+      }
+      break;
+
+    case BODY:
+      body[bodyPos++] = byte;
+      if (bodyPos == bodyLen) {
+        int corrected = FecCodec::decodeBody(body, payloadLen);
+        if (corrected >= 0) {
+          stats.framesDecoded++;
+          stats.bytesCorrected += corrected;
+          if (onFrame) {
+            onFrame(body, payloadLen, corrected, context);
+          }
+        } else {
+          stats.framesFailed++;
+        }
+        state = HUNT;
+      }
+      break;
+  }
+}
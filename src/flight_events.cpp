@@ -0,0 +1,184 @@
+#include "flight_events.h"
+#include "command_protocol.h"
+#include <math.h>
+#include <stdio.h>
+
+#define FLIGHT_EVENT_VOTE_MASK ((FLIGHT_EVENT_VOTE_WINDOW >= 32) ? 0xFFFFFFFFUL : ((1UL << FLIGHT_EVENT_VOTE_WINDOW) - 1))
+
+static int countVotes(uint32_t history) {
+  int count = 0;
+  while (history) {
+    history &= history - 1;
+    count++;
+  }
+  return count;
+}
+
+bool FlightEventDetector::Vote::add(bool condition, uint32_t timeMs, int required) {
+  if (condition && history == 0) {
+    onsetMs = timeMs;
+  }
+  history = ((history << 1) | (condition ? 1 : 0)) & FLIGHT_EVENT_VOTE_MASK;
+  if (history == 0) {
+    onsetMs = 0;
+  }
+  return countVotes(history) >= required;
+}
+
+FlightEventDetector::FlightEventDetector() {
+  reset();
+}
+
+void FlightEventDetector::reset() {
+  phase = PHASE_PAD;
+  vote.clear();
+  padAltitude = 0;
+  havePadAltitude = false;
+  maxAltitude = 0;
+  stoppedSinceMs = 0;
+  stopped = false;
+}
+
+void FlightEventDetector::resume(FlightPhase resumePhase, float resumePadAltitude, float resumeMaxAltitude) {
+  reset();
+  phase = resumePhase;
+  havePadAltitude = !isnan(resumePadAltitude);
+  padAltitude = havePadAltitude ? resumePadAltitude : 0;
+  maxAltitude = resumeMaxAltitude;
+}
+
+float FlightEventDetector::getPadAltitude() const {
+  return havePadAltitude ? padAltitude : NAN;
+}
+
+void FlightEventDetector::enterPhase(FlightPhase next) {
+  phase = next;
+  vote.clear();
+  stopped = false;
+}
+
+void FlightEventDetector::fire(FlightEventType type, uint32_t onsetMs, const FlightEventInput& input, FlightEvent& event) {
+  event.type = type;
+  event.onsetMs = onsetMs;
+  event.detectMs = input.timeMs;
+  event.altitude = input.altitude;
+  event.velocity = input.velocity;
+}
+
+bool FlightEventDetector::update(const FlightEventInput& input, FlightEvent& event) {
+  if (input.estimatorValid && input.altitude > maxAltitude) {
+    maxAltitude = input.altitude;
+  }
+
+  switch (phase) {
+    case PHASE_PAD: {
+      // Track the pad altitude so the baro backup works at any field elevation
+      if (input.estimatorValid) {
+        if (!havePadAltitude) {
+          padAltitude = input.altitude;
+          havePadAltitude = true;
+        } else {
+          padAltitude += (input.altitude - padAltitude) * 0.01f;
+        }
+      }
+
+      bool thrust = input.imuValid && input.accelMagnitude >= FLIGHT_MODE_ACCEL_THRESHOLD;
+      bool climbed = input.estimatorValid && havePadAltitude &&
+                     input.altitude - padAltitude >= FLIGHT_LAUNCH_ALTITUDE;
+      if (vote.add(thrust || climbed, input.timeMs, FLIGHT_LAUNCH_VOTES)) {
+        uint32_t onset = vote.onsetMs;
+        maxAltitude = input.altitude;
+        enterPhase(PHASE_BOOST);
+        fire(EVENT_LAUNCH, onset, input, event);
+        return true;
+      }
+      break;
+    }
+
+    case PHASE_BOOST: {
+      // Thrust gone: net deceleration along the vertical
+      bool decelerating = input.imuValid && input.verticalAccel < 0.0f;
+      if (vote.add(decelerating, input.timeMs, FLIGHT_BURNOUT_VOTES)) {
+        uint32_t onset = vote.onsetMs;
+        enterPhase(PHASE_COAST);
+        fire(EVENT_BURNOUT, onset, input, event);
+        return true;
+      }
+      break;
+    }
+
+    case PHASE_COAST: {
+      // Velocity through zero, or altitude clearly past its peak
+      bool descending = input.estimatorValid &&
+                        (input.velocity <= 0.0f || input.altitude < maxAltitude - FLIGHT_APOGEE_DROP);
+      if (vote.add(descending, input.timeMs, FLIGHT_APOGEE_VOTES)) {
+        uint32_t onset = vote.onsetMs;
+        enterPhase(PHASE_DESCENT);
+        fire(EVENT_APOGEE, onset, input, event);
+        return true;
+      }
+      break;
+    }
+
+    case PHASE_DESCENT: {
+      // Stationary for FLIGHT_LANDED_HOLD: filter velocity near zero, or
+      // without baro, an accelerometer reading steady 1 g
+      bool still;
+      if (input.estimatorValid) {
+        still = fabsf(input.velocity) < FLIGHT_LANDED_VELOCITY;
+      } else {
+        still = input.imuValid && fabsf(input.accelMagnitude - 1.0f) < FLIGHT_LANDED_ACCEL_TOLERANCE;
+      }
+
+      if (!still) {
+        stopped = false;
+      } else if (!stopped) {
+        stopped = true;
+        stoppedSinceMs = input.timeMs;
+      } else if (input.timeMs - stoppedSinceMs >= FLIGHT_LANDED_HOLD) {
+        uint32_t onset = stoppedSinceMs;
+        enterPhase(PHASE_LANDED);
+        fire(EVENT_LANDING, onset, input, event);
+        return true;
+      }
+      break;
+    }
+
+    case PHASE_LANDED:
+      break;
+  }
+
+  return false;
+}
+
+const char* FlightEventDetector::eventName(FlightEventType type) {
+  switch (type) {
+    case EVENT_LAUNCH: return "LAUNCH";
+    case EVENT_BURNOUT: return "BURNOUT";
+    case EVENT_APOGEE: return "APOGEE";
+    case EVENT_LANDING: return "LANDING";
+  }
+  return "UNKNOWN";
+}
+
+const char* FlightEventDetector::phaseName(FlightPhase phase) {
+  switch (phase) {
+    case PHASE_PAD: return "PAD";
+    case PHASE_BOOST: return "BOOST";
+    case PHASE_COAST: return "COAST";
+    case PHASE_DESCENT: return "DESCENT";
+    case PHASE_LANDED: return "LANDED";
+  }
+  return "UNKNOWN";
+}
+
+size_t FlightEventDetector::formatEvent(char* buffer, size_t capacity, const FlightEvent& event, uint32_t txMs) {
+  int len = snprintf(buffer, capacity, FLIGHT_EVENT_PREFIX "%s,%lu,%lu,%lu,%.2f,%.2f",
+                     eventName(event.type), (unsigned long)event.onsetMs,
+                     (unsigned long)event.detectMs, (unsigned long)txMs,
+                     event.altitude, event.velocity);
+  if (len < 0 || (size_t)len >= capacity) {
+    return 0;
+  }
+  return CommandProtocol::appendCrc(buffer, (size_t)len, capacity);
+}
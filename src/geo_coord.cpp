@@ -0,0 +1,109 @@
+#include "geo_coord.h"
+#include <math.h>
+
+bool parseNmeaCoordinate(const char* field, char hemisphere, int32_t& value) {
+  int32_t maxDegrees;
+  if (hemisphere == 'N' || hemisphere == 'S') {
+    maxDegrees = 90;
+  } else if (hemisphere == 'E' || hemisphere == 'W') {
+    maxDegrees = 180;
+  } else {
+    return false;
+  }
+
+  // The last two digits before the point are whole minutes, the ones
+  // before them degrees
+  const char* dot = field;
+  while (*dot >= '0' && *dot <= '9') {
+    dot++;
+  }
+  int intDigits = (int)(dot - field);
+  if (intDigits < 3 || intDigits > 5) {
+    return false;
+  }
+
+  int32_t degrees = 0;
+  for (const char* p = field; p < dot - 2; p++) {
+    degrees = degrees * 10 + (*p - '0');
+  }
+  int32_t minutes = (dot[-2] - '0') * 10 + (dot[-1] - '0');
+
+  // Fraction of a minute to 7 digits; further digits only round
+  int32_t fraction = 0;
+  int fractionDigits = 0;
+  bool roundUp = false;
+  if (*dot == '.') {
+    for (const char* p = dot + 1; *p >= '0' && *p <= '9'; p++) {
+      if (fractionDigits < 7) {
+        fraction = fraction * 10 + (*p - '0');
+        fractionDigits++;
+      } else if (fractionDigits == 7) {
+        roundUp = *p >= '5';
+        fractionDigits++;
+      }
+    }
+  }
+  for (int i = fractionDigits; i < 7; i++) {
+    fraction *= 10;
+  }
+  if (roundUp) {
+    fraction++;
+  }
+
+  if (minutes >= 60 || degrees > maxDegrees) {
+    return false;
+  }
+
+  // Minutes in 1e-7 units fit in 32 bits (< 6e8); divided by 60 with rounding
+  int32_t minuteUnits = minutes * COORD_SCALE + fraction;
+  int64_t result = (int64_t)degrees * COORD_SCALE + (minuteUnits + 30) / 60;
+  if (result > (int64_t)maxDegrees * COORD_SCALE) {
+    return false;
+  }
+  value = (int32_t)(hemisphere == 'S' || hemisphere == 'W' ? -result : result);
+  return true;
+}
+
+size_t formatCoordinate(char* buffer, size_t capacity, int32_t value) {
+  char text[COORD_TEXT_LENGTH];
+  size_t len = 0;
+  uint32_t magnitude = value < 0 ? (uint32_t)0 - (uint32_t)value : (uint32_t)value;
+  uint32_t whole = magnitude / COORD_SCALE;
+  uint32_t fraction = magnitude % COORD_SCALE;
+
+  if (value < 0) {
+    text[len++] = '-';
+  }
+  char digits[4];
+  int count = 0;
+  do {
+    digits[count++] = (char)('0' + whole % 10);
+    whole /= 10;
+  } while (whole > 0 && count < 4);
+  while (count > 0) {
+    text[len++] = digits[--count];
+  }
+  text[len++] = '.';
+  for (int i = 6; i >= 0; i--) {
+    text[len + i] = (char)('0' + fraction % 10);
+    fraction /= 10;
+  }
+  len += 7;
+
+  if (len >= capacity) {
+    return 0;
+  }
+  for (size_t i = 0; i < len; i++) {
+    buffer[i] = text[i];
+  }
+  buffer[len] = '\0';
+  return len;
+}
+
+int32_t coordFromDegrees(double degrees) {
+  return (int32_t)llround(degrees * COORD_SCALE);
+}
+
+double coordToDegrees(int32_t value) {
+  return (double)value / COORD_SCALE;
+}
@@ -1,6 +1,31 @@
 #include "gps_module.h"
+#include "esp_timer.h"
 
-GPSModule::GPSModule() : initialized(false) {
+#define GPS_MS_PER_DAY 86400000LL
+
+volatile int64_t GPSModule::ppsEdgeUs = 0;
+volatile uint32_t GPSModule::ppsCount = 0;
+portMUX_TYPE GPSModule::ppsMux = portMUX_INITIALIZER_UNLOCKED;
+
+GPSModule::GPSModule() :
+  initialized(false),
+  lineLength(0),
+  lastPollUs(0),
+  lastByteUs(0),
+  burstArrivalUs(0),
+  burstSigmaUs(0),
+  fixPending(false),
+  fixLatitude(0),
+  fixLongitude(0),
+  fixAltitude(0),
+  fixArrivalUs(0),
+  timePending(false),
+  timeUtcMs(0),
+  timeArrivalUs(0),
+  timeArrivalSigmaUs(0),
+  utcDay(-1),
+  utcDayMs(0),
+  ppsCountRead(0) {
   gpsSerial = new HardwareSerial(1);
 }
 
@@ -8,49 +33,164 @@ GPSModule::~GPSModule() {
   delete gpsSerial;
 }
 
-void GPSModule::initialize() {
+void GPSModule::initialize(bool warmStart) {
   Serial.println("Initializing GPS module...");
   
   // Initialize GPS serial communication
   gpsSerial->begin(GPS_BAUD_RATE, SERIAL_8N1, GPS_SERIAL_RX_PIN, GPS_SERIAL_TX_PIN);
   
   // Brief delay for serial to stabilize
-  delay(100);
+  if (!warmStart) {
+    delay(100);
+  }
   
   // Clear any existing data in the buffer
   while (gpsSerial->available()) {
     gpsSerial->read();
   }
   
+#if GPS_PPS_PIN >= 0
+  // PPS edges are timestamped in the interrupt, the rest happens in poll()
+  pinMode(GPS_PPS_PIN, INPUT);
+  attachInterrupt(digitalPinToInterrupt(GPS_PPS_PIN), onPps, RISING);
+  Serial.print("GPS PPS on GPIO");
+  Serial.println(GPS_PPS_PIN);
+#endif
+  
+  lastPollUs = esp_timer_get_time();
   initialized = true;
   Serial.println("GPS module initialized");
 }
 
-bool GPSModule::readData(float& latitude, float& longitude, float& altitude) {
+void IRAM_ATTR GPSModule::onPps() {
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL_ISR(&ppsMux);
+  ppsEdgeUs = now;
+  ppsCount = ppsCount + 1;
+  portEXIT_CRITICAL_ISR(&ppsMux);
+}
+
+void GPSModule::poll() {
   if (!initialized) {
-    return false;
+    return;
   }
   
-  // Read all available NMEA sentences
-  while (gpsSerial->available()) {
-    String nmea = gpsSerial->readStringUntil('\n');
-    nmea.trim();
+  int64_t now = esp_timer_get_time();
+  if (gpsSerial->available() > 0) {
+    // The first bytes after a quiet gap start an epoch's burst. They came
+    // in some time since the last poll, so take the middle of that.
+    if (now - lastByteUs > GPS_BURST_GAP * 1000LL) {
+      burstArrivalUs = lastPollUs + (now - lastPollUs) / 2;
+      burstSigmaUs = (now - lastPollUs) / 3.464f;  // Uniform over the interval: width / sqrt(12)
+    }
+    lastByteUs = now;
     
-    // Process GGA sentences (Global Positioning System Fix Data)
-    if (nmea.startsWith("$GPGGA") || nmea.startsWith("$GNGGA")) {
-      if (parseGGA(nmea, latitude, longitude, altitude)) {
-        return true;
+    while (gpsSerial->available() > 0) {
+      int c = gpsSerial->read();
+      if (c == '$') {
+        lineLength = 0;
+      }
+      if (c == '\r' || c == '\n') {
+        if (lineLength > 0) {
+          lineBuffer[lineLength] = '\0';
+          processSentence(String(lineBuffer));
+          lineLength = 0;
+        }
+      } else if (lineLength < GPS_LINE_LENGTH - 1) {
+        lineBuffer[lineLength++] = (char)c;
+      } else {
+        lineLength = 0;  // Overlong, drop it
       }
     }
   }
+  lastPollUs = now;
+}
+
+bool GPSModule::readData(int32_t& latitude, int32_t& longitude, float& altitude, int64_t& arrivalUs) {
+  if (!initialized) {
+    return false;
+  }
   
-  return false;
+  poll();
+  if (!fixPending) {
+    return false;
+  }
+  latitude = fixLatitude;
+  longitude = fixLongitude;
+  altitude = fixAltitude;
+  arrivalUs = fixArrivalUs;
+  fixPending = false;
+  return true;
+}
+
+bool GPSModule::readTime(int64_t& arrivalUs, float& arrivalSigmaUs, int64_t& utcMs) {
+  if (!timePending) {
+    return false;
+  }
+  arrivalUs = timeArrivalUs;
+  arrivalSigmaUs = timeArrivalSigmaUs;
+  utcMs = timeUtcMs;
+  timePending = false;
+  return true;
+}
+
+bool GPSModule::readPps(int64_t& edgeUs) {
+  portENTER_CRITICAL(&ppsMux);
+  uint32_t count = ppsCount;
+  int64_t edge = ppsEdgeUs;
+  portEXIT_CRITICAL(&ppsMux);
+  
+  if (count == ppsCountRead) {
+    return false;
+  }
+  ppsCountRead = count;
+  edgeUs = edge;
+  return true;
 }
 
 bool GPSModule::isValid() {
   return initialized;
 }
 
+void GPSModule::processSentence(const String& nmea) {
+  int32_t msOfDay;
+  
+  // Process GGA sentences (Global Positioning System Fix Data)
+  if (nmea.startsWith("$GPGGA") || nmea.startsWith("$GNGGA")) {
+    int32_t lat, lon;
+    float alt;
+    if (parseGGA(nmea, lat, lon, alt, msOfDay)) {
+      fixLatitude = lat;
+      fixLongitude = lon;
+      fixAltitude = alt;
+      fixArrivalUs = burstArrivalUs;
+      fixPending = true;
+      
+      // GGA has no date; it's the last RMC's, or the next day once the
+      // time of day has wrapped
+      if (msOfDay >= 0 && utcDay >= 0) {
+        setTime(msOfDay < utcDayMs - GPS_MS_PER_DAY / 2 ? utcDay + 1 : utcDay, msOfDay);
+      }
+    }
+  } else if (nmea.startsWith("$GPRMC") || nmea.startsWith("$GNRMC")) {
+    // RMC (Recommended Minimum) carries the date with the time
+    int32_t days;
+    if (parseRMC(nmea, days, msOfDay)) {
+      utcDay = days;
+      utcDayMs = msOfDay;
+      setTime(days, msOfDay);
+    }
+  }
+}
+
+void GPSModule::setTime(int32_t days, int32_t msOfDay) {
+  // The epoch's time belongs to the burst its sentences came in
+  timeUtcMs = days * GPS_MS_PER_DAY + msOfDay;
+  timeArrivalUs = burstArrivalUs;
+  timeArrivalSigmaUs = burstSigmaUs;
+  timePending = true;
+}
+
 bool GPSModule::parseNMEA(String nmea) {
   // Simple NMEA validation - check for proper format
   if (nmea.length() < 10 || !nmea.startsWith("$")) {
@@ -79,7 +219,7 @@ bool GPSModule::parseNMEA(String nmea) {
   return calculatedChecksum == expectedChecksum;
 }
 
-bool GPSModule::parseGGA(String gga, float& lat, float& lon, float& alt) {
+bool GPSModule::parseGGA(String gga, int32_t& lat, int32_t& lon, float& alt, int32_t& msOfDay) {
   if (!parseNMEA(gga)) {
     return false;
   }
@@ -105,17 +245,12 @@ bool GPSModule::parseGGA(String gga, float& lat, float& lon, float& alt) {
     return false; // No GPS fix
   }
   
-  // Parse latitude (fields 2 and 3)
-  if (fields[2].length() > 0 && fields[3].length() > 0) {
-    lat = parseCoordinate(fields[2], fields[3].charAt(0));
-  } else {
+  // Parse latitude (fields 2 and 3) and longitude (fields 4 and 5) straight
+  // to 1e-7 degrees, integer-only
+  if (fields[3].length() == 0 || !parseNmeaCoordinate(fields[2].c_str(), fields[3].charAt(0), lat)) {
     return false;
   }
-  
-  // Parse longitude (fields 4 and 5)
-  if (fields[4].length() > 0 && fields[5].length() > 0) {
-    lon = parseCoordinate(fields[4], fields[5].charAt(0));
-  } else {
+  if (fields[5].length() == 0 || !parseNmeaCoordinate(fields[4].c_str(), fields[5].charAt(0), lon)) {
     return false;
   }
   
@@ -126,34 +261,40 @@ bool GPSModule::parseGGA(String gga, float& lat, float& lon, float& alt) {
     alt = 0.0;
   }
   
+  // UTC time of the fix (field 1), -1 if missing
+  if (fields[1].length() == 0 || !parseNmeaTime(fields[1].c_str(), msOfDay)) {
+    msOfDay = -1;
+  }
+  
   return true;
 }
 
-float GPSModule::parseCoordinate(String coord, char direction) {
-  if (coord.length() < 4) {
-    return 0.0;
+bool GPSModule::parseRMC(String rmc, int32_t& days, int32_t& msOfDay) {
+  if (!parseNMEA(rmc)) {
+    return false;
   }
   
-  float degrees, minutes;
+  // Parse RMC sentence: $GPRMC,time,status,lat,N/S,lon,E/W,speed,course,date,magVar,E/W,mode*checksum
+  int commaCount = 0;
+  int startIndex = 0;
+  String fields[13];
   
-  // Determine format based on direction (latitude vs longitude)
-  if (direction == 'N' || direction == 'S') {
-    // Latitude format: DDMM.MMMM (2 digits degrees)
-    degrees = coord.substring(0, 2).toFloat();
-    minutes = coord.substring(2).toFloat();
-  } else {
-    // Longitude format: DDDMM.MMMM (3 digits degrees)
-    degrees = coord.substring(0, 3).toFloat();
-    minutes = coord.substring(3).toFloat();
+  // Split by commas
+  for (int i = 0; i <= rmc.length(); i++) {
+    if (i == rmc.length() || rmc.charAt(i) == ',') {
+      if (commaCount < 13) {
+        fields[commaCount] = rmc.substring(startIndex, i);
+      }
+      commaCount++;
+      startIndex = i + 1;
+    }
   }
   
-  // Convert to decimal degrees
-  float result = degrees + (minutes / 60.0);
-  
-  // Apply hemisphere direction
-  if (direction == 'S' || direction == 'W') {
-    result = -result;
+  // Only a valid fix (field 2: A=valid, V=warning) has a trustworthy time
+  if (commaCount < 10 || fields[2] != "A") {
+    return false;
   }
   
-  return result;
+  // UTC time (field 1) and date (field 9)
+  return parseNmeaTime(fields[1].c_str(), msOfDay) && parseNmeaDate(fields[9].c_str(), days);
 }
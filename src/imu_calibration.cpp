@@ -0,0 +1,401 @@
+#include "imu_calibration.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char* const faceNames[FACE_COUNT] = {"+X", "-X", "+Y", "-Y", "+Z", "-Z"};
+
+// Inverts a row-major 3x3 matrix. Returns false if it is singular.
+static bool invert3x3(const double m[9], double out[9]) {
+  double c0 = m[4] * m[8] - m[5] * m[7];
+  double c1 = m[5] * m[6] - m[3] * m[8];
+  double c2 = m[3] * m[7] - m[4] * m[6];
+  double det = m[0] * c0 + m[1] * c1 + m[2] * c2;
+  if (fabs(det) < 1e-12) {
+    return false;
+  }
+  double inv = 1.0 / det;
+  out[0] = c0 * inv;
+  out[1] = (m[2] * m[7] - m[1] * m[8]) * inv;
+  out[2] = (m[1] * m[5] - m[2] * m[4]) * inv;
+  out[3] = c1 * inv;
+  out[4] = (m[0] * m[8] - m[2] * m[6]) * inv;
+  out[5] = (m[2] * m[3] - m[0] * m[5]) * inv;
+  out[6] = c2 * inv;
+  out[7] = (m[1] * m[6] - m[0] * m[7]) * inv;
+  out[8] = (m[0] * m[4] - m[1] * m[3]) * inv;
+  return true;
+}
+
+// Eigen-decomposition of a symmetric 3x3 matrix by Jacobi rotations:
+// a = v * diag(values) * v'
+static void eigenSymmetric3x3(const double a[9], double values[3], double v[9]) {
+  double m[9];
+  memcpy(m, a, sizeof(m));
+  for (int i = 0; i < 9; i++) {
+    v[i] = (i % 4 == 0) ? 1.0 : 0.0;
+  }
+
+  for (int sweep = 0; sweep < 16; sweep++) {
+    double off = m[1] * m[1] + m[2] * m[2] + m[5] * m[5];
+    if (off < 1e-24) {
+      break;
+    }
+    for (int p = 0; p < 2; p++) {
+      for (int q = p + 1; q < 3; q++) {
+        double apq = m[p * 3 + q];
+        if (fabs(apq) < 1e-30) {
+          continue;
+        }
+        double theta = (m[q * 3 + q] - m[p * 3 + p]) / (2.0 * apq);
+        double t = (theta >= 0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+        double c = 1.0 / sqrt(t * t + 1.0);
+        double s = t * c;
+        // m = J' m J for the rotation in the p-q plane
+        for (int k = 0; k < 3; k++) {
+          double mkp = m[k * 3 + p];
+          double mkq = m[k * 3 + q];
+          m[k * 3 + p] = c * mkp - s * mkq;
+          m[k * 3 + q] = s * mkp + c * mkq;
+        }
+        for (int k = 0; k < 3; k++) {
+          double mpk = m[p * 3 + k];
+          double mqk = m[q * 3 + k];
+          m[p * 3 + k] = c * mpk - s * mqk;
+          m[q * 3 + k] = s * mpk + c * mqk;
+        }
+        for (int k = 0; k < 3; k++) {
+          double vkp = v[k * 3 + p];
+          double vkq = v[k * 3 + q];
+          v[k * 3 + p] = c * vkp - s * vkq;
+          v[k * 3 + q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+  values[0] = m[0];
+  values[1] = m[4];
+  values[2] = m[8];
+}
+
+ImuCalibrator::ImuCalibrator() : step(STEP_IDLE), error(NULL), sampleCount(0), currentFace(FACE_POS_X), facesDone(0) {
+  clear(calibration);
+  memset(faceMeans, 0, sizeof(faceMeans));
+  memset(magNormal, 0, sizeof(magNormal));
+}
+
+void ImuCalibrator::clear(ImuCalibration& cal) {
+  memset(&cal, 0, sizeof(cal));
+  cal.version = IMU_CAL_VERSION;
+  cal.accelMatrix[0] = cal.accelMatrix[4] = cal.accelMatrix[8] = 1.0f;
+  cal.magMatrix[0] = cal.magMatrix[4] = cal.magMatrix[8] = 1.0f;
+}
+
+void ImuCalibrator::setCalibration(const ImuCalibration& cal) {
+  calibration = cal;
+}
+
+bool ImuCalibrator::startGyro() {
+  if (step != STEP_IDLE) {
+    error = "busy";
+    return false;
+  }
+  step = STEP_GYRO;
+  error = NULL;
+  sampleCount = 0;
+  memset(sum, 0, sizeof(sum));
+  memset(sumSquares, 0, sizeof(sumSquares));
+  return true;
+}
+
+bool ImuCalibrator::startAccelFace(AccelFace face) {
+  if (step != STEP_IDLE) {
+    error = "busy";
+    return false;
+  }
+  step = STEP_ACCEL;
+  error = NULL;
+  currentFace = face;
+  sampleCount = 0;
+  memset(sum, 0, sizeof(sum));
+  memset(sumSquares, 0, sizeof(sumSquares));
+  return true;
+}
+
+bool ImuCalibrator::startMag() {
+  if (step != STEP_IDLE) {
+    error = "busy";
+    return false;
+  }
+  step = STEP_MAG;
+  error = NULL;
+  sampleCount = 0;
+  memset(magNormal, 0, sizeof(magNormal));
+  return true;
+}
+
+void ImuCalibrator::cancel() {
+  step = STEP_IDLE;
+  error = "cancelled";
+}
+
+bool ImuCalibrator::addSample(const float gyro[3], const float accel[3], const float mag[3]) {
+  switch (step) {
+    case STEP_GYRO:
+      for (int i = 0; i < 3; i++) {
+        sum[i] += gyro[i];
+        sumSquares[i] += (double)gyro[i] * gyro[i];
+      }
+      if (++sampleCount >= IMU_CAL_GYRO_SAMPLES) {
+        finishGyro();
+        return true;
+      }
+      return false;
+
+    case STEP_ACCEL:
+      for (int i = 0; i < 3; i++) {
+        sum[i] += accel[i];
+        sumSquares[i] += (double)accel[i] * accel[i];
+      }
+      if (++sampleCount >= IMU_CAL_ACCEL_SAMPLES) {
+        finishAccelFace();
+        return true;
+      }
+      return false;
+
+    case STEP_MAG:
+      // Skip dropouts (the driver reports zeros when the read fails)
+      if (mag[0] != 0.0f || mag[1] != 0.0f || mag[2] != 0.0f) {
+        accumulateEllipsoid(magNormal, mag);
+        sampleCount++;
+      }
+      return false;
+
+    case STEP_IDLE:
+      break;
+  }
+  return false;
+}
+
+void ImuCalibrator::finishGyro() {
+  step = STEP_IDLE;
+  for (int i = 0; i < 3; i++) {
+    double mean = sum[i] / sampleCount;
+    double variance = sumSquares[i] / sampleCount - mean * mean;
+    if (variance > IMU_CAL_REST_MAX_STDDEV_GYRO * IMU_CAL_REST_MAX_STDDEV_GYRO) {
+      error = "moving";
+      return;
+    }
+  }
+  for (int i = 0; i < 3; i++) {
+    calibration.gyroBias[i] = (float)(sum[i] / sampleCount);
+  }
+  calibration.flags |= IMU_CAL_GYRO;
+  error = NULL;
+}
+
+void ImuCalibrator::finishAccelFace() {
+  step = STEP_IDLE;
+  float mean[3];
+  for (int i = 0; i < 3; i++) {
+    mean[i] = (float)(sum[i] / sampleCount);
+    double variance = sumSquares[i] / sampleCount - (double)mean[i] * mean[i];
+    if (variance > IMU_CAL_REST_MAX_STDDEV_ACCEL * IMU_CAL_REST_MAX_STDDEV_ACCEL) {
+      error = "moving";
+      return;
+    }
+  }
+
+  // The named axis has to carry most of gravity, with the right sign
+  int axis = currentFace / 2;
+  float sign = (currentFace % 2 == 0) ? 1.0f : -1.0f;
+  if (mean[axis] * sign < IMU_CAL_ACCEL_MIN_AXIS) {
+    error = "wrong face";
+    return;
+  }
+
+  memcpy(faceMeans[currentFace], mean, sizeof(mean));
+  facesDone |= 1 << currentFace;
+  error = NULL;
+
+  if (facesDone == (1 << FACE_COUNT) - 1) {
+    if (solveSixPosition(faceMeans, calibration.accelBias, calibration.accelMatrix)) {
+      calibration.flags |= IMU_CAL_ACCEL;
+    } else {
+      error = "accel fit failed";
+    }
+    facesDone = 0;
+  }
+}
+
+bool ImuCalibrator::finishMag() {
+  if (step != STEP_MAG) {
+    error = "not collecting";
+    return false;
+  }
+  step = STEP_IDLE;
+  if (sampleCount < IMU_CAL_MAG_MIN_SAMPLES) {
+    error = "too few samples";
+    return false;
+  }
+  if (!solveEllipsoid(magNormal, calibration.magBias, calibration.magMatrix)) {
+    error = "mag fit failed";
+    return false;
+  }
+  calibration.flags |= IMU_CAL_MAG;
+  error = NULL;
+  return true;
+}
+
+bool ImuCalibrator::solveSixPosition(const float means[FACE_COUNT][3], float bias[3], float matrix[9]) {
+  // Reading = A * g + b with g = +/- unit axis, so each opposite pair gives
+  // a column of A (half difference) and an estimate of b (half sum)
+  double a[9];
+  double b[3] = {0, 0, 0};
+  for (int axis = 0; axis < 3; axis++) {
+    const float* up = means[axis * 2];
+    const float* down = means[axis * 2 + 1];
+    for (int row = 0; row < 3; row++) {
+      a[row * 3 + axis] = (up[row] - down[row]) * 0.5;
+      b[row] += (up[row] + down[row]) * 0.5 / 3.0;
+    }
+  }
+
+  double inverse[9];
+  if (!invert3x3(a, inverse)) {
+    return false;
+  }
+  for (int i = 0; i < 3; i++) {
+    bias[i] = (float)b[i];
+  }
+  for (int i = 0; i < 9; i++) {
+    matrix[i] = (float)inverse[i];
+  }
+  return true;
+}
+
+void ImuCalibrator::accumulateEllipsoid(double normal[9][10], const float mag[3]) {
+  double x = mag[0], y = mag[1], z = mag[2];
+  double row[9] = {x * x, y * y, z * z, 2 * x * y, 2 * x * z, 2 * y * z, 2 * x, 2 * y, 2 * z};
+  for (int i = 0; i < 9; i++) {
+    for (int j = 0; j < 9; j++) {
+      normal[i][j] += row[i] * row[j];
+    }
+    normal[i][9] += row[i];
+  }
+}
+
+bool ImuCalibrator::solveEllipsoid(const double normal[9][10], float bias[3], float matrix[9]) {
+  // Gaussian elimination with partial pivoting on [N | b]
+  double m[9][10];
+  memcpy(m, normal, sizeof(m));
+  for (int col = 0; col < 9; col++) {
+    int pivot = col;
+    for (int r = col + 1; r < 9; r++) {
+      if (fabs(m[r][col]) > fabs(m[pivot][col])) {
+        pivot = r;
+      }
+    }
+    if (fabs(m[pivot][col]) < 1e-18) {
+      return false;
+    }
+    if (pivot != col) {
+      for (int k = 0; k < 10; k++) {
+        double t = m[col][k];
+        m[col][k] = m[pivot][k];
+        m[pivot][k] = t;
+      }
+    }
+    for (int r = col + 1; r < 9; r++) {
+      double f = m[r][col] / m[col][col];
+      for (int k = col; k < 10; k++) {
+        m[r][k] -= f * m[col][k];
+      }
+    }
+  }
+  double p[9];
+  for (int r = 8; r >= 0; r--) {
+    double acc = m[r][9];
+    for (int k = r + 1; k < 9; k++) {
+      acc -= m[r][k] * p[k];
+    }
+    p[r] = acc / m[r][r];
+  }
+
+  // x'Qx + 2u'x = 1  ->  (x - c)'Q(x - c) = 1 + c'Qc with c = -Q^-1 u
+  double q[9] = {p[0], p[3], p[4],
+                 p[3], p[1], p[5],
+                 p[4], p[5], p[2]};
+  double u[3] = {p[6], p[7], p[8]};
+  double qInv[9];
+  if (!invert3x3(q, qInv)) {
+    return false;
+  }
+  double c[3];
+  for (int i = 0; i < 3; i++) {
+    c[i] = -(qInv[i * 3] * u[0] + qInv[i * 3 + 1] * u[1] + qInv[i * 3 + 2] * u[2]);
+  }
+  double k = 1.0;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      k += c[i] * q[i * 3 + j] * c[j];
+    }
+  }
+  if (k <= 0) {
+    return false;
+  }
+
+  // The correction maps the ellipsoid onto a sphere of the same mean
+  // radius: M = r * sqrt(Q / k), r = det(Q / k)^(-1/6)
+  double values[3], v[9];
+  double scaled[9];
+  for (int i = 0; i < 9; i++) {
+    scaled[i] = q[i] / k;
+  }
+  eigenSymmetric3x3(scaled, values, v);
+  if (values[0] <= 0 || values[1] <= 0 || values[2] <= 0) {
+    return false;
+  }
+  double radius = pow(values[0] * values[1] * values[2], -1.0 / 6.0);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      double acc = 0;
+      for (int e = 0; e < 3; e++) {
+        acc += v[i * 3 + e] * sqrt(values[e]) * v[j * 3 + e];
+      }
+      matrix[i * 3 + j] = (float)(radius * acc);
+    }
+    bias[i] = (float)c[i];
+  }
+  return true;
+}
+
+bool ImuCalibrator::parseFace(const char* name, AccelFace& face) {
+  for (int f = 0; f < FACE_COUNT; f++) {
+    if (strcmp(name, faceNames[f]) == 0) {
+      face = (AccelFace)f;
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t ImuCalibrator::formatStatus(char* buffer, size_t capacity) const {
+  static const char* const stepNames[] = {"idle", "gyro", "accel", "mag"};
+  char faces[3 * FACE_COUNT + 1] = "";
+  for (int f = 0; f < FACE_COUNT; f++) {
+    if (facesDone & (1 << f)) {
+      strcat(faces, faceNames[f]);
+    }
+  }
+  int len = snprintf(buffer, capacity, "step=%s,n=%lu,cal=%s%s%s,faces=%s%s%s",
+                     stepNames[step], (unsigned long)sampleCount,
+                     (calibration.flags & IMU_CAL_GYRO) ? "G" : "",
+                     (calibration.flags & IMU_CAL_ACCEL) ? "A" : "",
+                     (calibration.flags & IMU_CAL_MAG) ? "M" : "",
+                     faces, error ? ",err=" : "", error ? error : "");
+  if (len < 0) {
+    return 0;
+  }
+  return (size_t)len < capacity ? (size_t)len : capacity - 1;
+}
@@ -0,0 +1,219 @@
+#include "imu_decimator.h"
+#include <math.h>
+#include <string.h>
+
+DecimationStage::DecimationStage()
+  : factor(0), cicOrder(1), cicFactor(1), firFactor(1), firTaps(0), cicGain(1),
+    primed(false), cicCount(0), firPhase(0), firHead(0), pendingClipped(false), outputClipped(false) {
+  memset(firCoeffs, 0, sizeof(firCoeffs));
+  memset(output, 0, sizeof(output));
+  configure(1);
+}
+
+void DecimationStage::configure(uint16_t newFactor) {
+  if (newFactor < 1) {
+    newFactor = 1;
+  }
+  if (newFactor == factor) {
+    return;
+  }
+  factor = newFactor;
+
+  // The FIR takes the largest 2-5x factor that divides the total; the CIC
+  // does the rest. Without a divisor the CIC works alone.
+  firFactor = 1;
+  for (uint8_t r = DECIM_MAX_FIR_FACTOR; r >= 2; r--) {
+    if (factor % r == 0) {
+      firFactor = r;
+      break;
+    }
+  }
+  cicFactor = factor / firFactor;
+  cicOrder = cicFactor > 1 ? DECIM_CIC_ORDER : 1;
+  cicGain = 1;
+  for (uint8_t i = 0; i < cicOrder; i++) {
+    cicGain *= cicFactor;
+  }
+  firTaps = firFactor > 1 ? DECIM_FIR_TAPS_PER_FACTOR * firFactor : 0;
+  designFir();
+
+  primed = false;
+  cicCount = 0;
+  firPhase = 0;
+  firHead = 0;
+  pendingClipped = false;
+}
+
+// Blackman windowed sinc, cutoff at half the output rate
+void DecimationStage::designFir() {
+  if (firTaps == 0) {
+    return;
+  }
+  double h[DECIM_MAX_FIR_TAPS];
+  double sum = 0;
+  double cutoff = 0.5 / firFactor;  // Cycles per FIR input sample
+  double center = (firTaps - 1) / 2.0;
+  for (uint8_t k = 0; k < firTaps; k++) {
+    double x = k - center;
+    double sinc = fabs(x) < 1e-9 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+    double phase = 2.0 * M_PI * k / (firTaps - 1);
+    double window = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+    h[k] = sinc * window;
+    sum += h[k];
+  }
+
+  // Q15 with unity DC gain; rounding residue goes to the center taps
+  int32_t total = 0;
+  for (uint8_t k = 0; k < firTaps; k++) {
+    firCoeffs[k] = (int16_t)lround(32768.0 * h[k] / sum);
+    total += firCoeffs[k];
+  }
+  firCoeffs[firTaps / 2] += (int16_t)(32768 - total);
+}
+
+// Runs the CIC to steady state on the first sample and fills the FIR
+// history with it, so the stream starts as if the input had been constant
+void DecimationStage::prime(const int32_t* sample) {
+  memset(integrators, 0, sizeof(integrators));
+  memset(combDelay, 0, sizeof(combDelay));
+  int32_t cicOut[DECIM_AXES];
+  for (uint32_t i = 0; i < (uint32_t)cicOrder * cicFactor; i++) {
+    pushCic(sample, cicOut);
+  }
+  for (uint8_t k = 0; k < firTaps; k++) {
+    memcpy(firHistory[k], sample, sizeof(firHistory[k]));
+  }
+  cicCount = 0;
+  firPhase = 0;
+  primed = true;
+}
+
+bool DecimationStage::pushCic(const int32_t* sample, int32_t* cicOut) {
+  // Integrators at the input rate; unsigned wrap-around is exact as long
+  // as the true output fits, which 18-bit input + 3 * log2(1000) does
+  for (uint8_t a = 0; a < DECIM_AXES; a++) {
+    uint64_t value = (uint64_t)(int64_t)sample[a];
+    for (uint8_t s = 0; s < cicOrder; s++) {
+      integrators[s][a] += value;
+      value = integrators[s][a];
+    }
+  }
+  if (++cicCount < cicFactor) {
+    return false;
+  }
+  cicCount = 0;
+
+  // Combs at the output rate
+  for (uint8_t a = 0; a < DECIM_AXES; a++) {
+    uint64_t value = integrators[cicOrder - 1][a];
+    for (uint8_t s = 0; s < cicOrder; s++) {
+      uint64_t delayed = combDelay[s][a];
+      combDelay[s][a] = value;
+      value -= delayed;
+    }
+    cicOut[a] = (int32_t)((int64_t)value / cicGain);
+  }
+  return true;
+}
+
+bool DecimationStage::pushFir(const int32_t* sample) {
+  if (firTaps == 0) {
+    memcpy(output, sample, sizeof(output));
+    return true;
+  }
+  firHead = firHead + 1 == firTaps ? 0 : firHead + 1;
+  memcpy(firHistory[firHead], sample, sizeof(firHistory[firHead]));
+  if (++firPhase < firFactor) {
+    return false;
+  }
+  firPhase = 0;
+
+  // Only the kept output is computed (polyphase decimation)
+  int64_t acc[DECIM_AXES] = {0, 0, 0, 0, 0, 0};
+  uint8_t slot = firHead;
+  for (uint8_t k = 0; k < firTaps; k++) {
+    const int32_t* x = firHistory[slot];
+    int32_t h = firCoeffs[k];
+    for (uint8_t a = 0; a < DECIM_AXES; a++) {
+      acc[a] += (int64_t)h * x[a];
+    }
+    slot = slot == 0 ? firTaps - 1 : slot - 1;
+  }
+  for (uint8_t a = 0; a < DECIM_AXES; a++) {
+    output[a] = (int32_t)((acc[a] + 16384) >> 15);
+  }
+  return true;
+}
+
+int DecimationStage::process(const int32_t* samples, int count, bool clipped) {
+  if (count <= 0) {
+    return 0;
+  }
+  if (!primed) {
+    prime(samples);
+  }
+  pendingClipped = pendingClipped || clipped;
+
+  int outputs = 0;
+  int32_t cicOut[DECIM_AXES];
+  for (int i = 0; i < count; i++) {
+    if (pushCic(samples + i * DECIM_AXES, cicOut) && pushFir(cicOut)) {
+      outputs++;
+    }
+  }
+  if (outputs > 0) {
+    outputClipped = pendingClipped;
+    pendingClipped = false;
+  }
+  return outputs;
+}
+
+ImuDecimator::ImuDecimator() : batchClipped(false) {
+  memset(batchMean, 0, sizeof(batchMean));
+}
+
+void ImuDecimator::configure(ImuStream stream, uint16_t factor) {
+  if (stream != IMU_STREAM_FILTER) {
+    stages[stream].configure(factor);
+  }
+}
+
+uint8_t ImuDecimator::process(const int32_t* samples, int count, bool clipped) {
+  if (count <= 0) {
+    return 0;
+  }
+
+  // Filter stream: one output per batch, so the estimators step once per
+  // sensor task cycle however the FIFO timing falls
+  int64_t sum[DECIM_AXES] = {0, 0, 0, 0, 0, 0};
+  for (int i = 0; i < count; i++) {
+    const int32_t* x = samples + i * DECIM_AXES;
+    for (uint8_t a = 0; a < DECIM_AXES; a++) {
+      sum[a] += x[a];
+    }
+  }
+  for (uint8_t a = 0; a < DECIM_AXES; a++) {
+    batchMean[a] = (int32_t)(sum[a] / count);
+  }
+  batchClipped = clipped;
+  uint8_t fresh = 1 << IMU_STREAM_FILTER;
+
+  for (uint8_t s = IMU_STREAM_FILTER + 1; s < IMU_STREAM_COUNT; s++) {
+    if (stages[s].process(samples, count, clipped) > 0) {
+      fresh |= 1 << s;
+    }
+  }
+  return fresh;
+}
+
+bool ImuDecimator::getOutputClipped(ImuStream stream) const {
+  return stream == IMU_STREAM_FILTER ? batchClipped : stages[stream].getOutputClipped();
+}
+
+void ImuDecimator::getOutput(ImuStream stream, float accel[3], float gyro[3]) const {
+  const int32_t* out = stream == IMU_STREAM_FILTER ? batchMean : stages[stream].getOutput();
+  for (uint8_t i = 0; i < 3; i++) {
+    accel[i] = out[i] * DECIM_ACCEL_UNIT;
+    gyro[i] = out[3 + i] * DECIM_GYRO_UNIT;
+  }
+}
@@ -0,0 +1,61 @@
+#include "imu_range.h"
+
+const float IMU_ACCEL_FULL_SCALES[IMU_RANGE_COUNT] = {2.0f, 4.0f, 8.0f, 16.0f};
+const float IMU_GYRO_FULL_SCALES[IMU_RANGE_COUNT] = {250.0f, 500.0f, 1000.0f, 2000.0f};
+
+ImuRangeSelector::ImuRangeSelector(const float* fullScales, uint8_t minIndex, bool autoRange)
+  : fullScales(fullScales), minIndex(minIndex < IMU_RANGE_COUNT ? minIndex : IMU_RANGE_COUNT - 1),
+    autoRange(autoRange), index(0), quietSamples(0), unitsPerCount(0), upCounts(0), downCounts(0) {
+  select(this->minIndex);
+  // Thresholds are fractions of the counts span, the same in every range
+  upCounts = (int32_t)(IMU_RANGE_UP_FRACTION * 32768.0f);
+  downCounts = (int32_t)(IMU_RANGE_DOWN_FRACTION * 32768.0f);
+}
+
+void ImuRangeSelector::select(uint8_t newIndex) {
+  index = newIndex;
+  quietSamples = 0;
+  unitsPerCount = fullScales[index] / 32768.0f;
+}
+
+int32_t ImuRangeSelector::peak(int16_t x, int16_t y, int16_t z) {
+  int32_t ax = x < 0 ? -(int32_t)x : x;
+  int32_t ay = y < 0 ? -(int32_t)y : y;
+  int32_t az = z < 0 ? -(int32_t)z : z;
+  int32_t m = ax > ay ? ax : ay;
+  return m > az ? m : az;
+}
+
+bool ImuRangeSelector::update(int32_t peakCounts) {
+  if (!autoRange) {
+    return false;
+  }
+
+  if (peakCounts >= IMU_RANGE_RAIL) {
+    if (index == IMU_RANGE_COUNT - 1) {
+      return false;
+    }
+    select(IMU_RANGE_COUNT - 1);
+    return true;
+  }
+
+  if (peakCounts >= upCounts) {
+    if (index == IMU_RANGE_COUNT - 1) {
+      quietSamples = 0;
+      return false;
+    }
+    select(index + 1);
+    return true;
+  }
+
+  if (peakCounts >= downCounts || index == minIndex) {
+    quietSamples = 0;
+    return false;
+  }
+
+  if (++quietSamples < IMU_RANGE_DOWN_HOLD) {
+    return false;
+  }
+  select(index - 1);
+  return true;
+}
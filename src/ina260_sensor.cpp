@@ -1,4 +1,5 @@
 #include "ina260_sensor.h"
+#include "esp_timer.h"
 
 INA260Sensor::INA260Sensor() : initialized(false) {
 }
@@ -6,7 +7,7 @@ INA260Sensor::INA260Sensor() : initialized(false) {
 INA260Sensor::~INA260Sensor() {
 }
 
-void INA260Sensor::initialize() {
+void INA260Sensor::initialize(bool warmStart) {
   Serial.println("Initializing INA260 power sensor...");
   
 
@@ -24,7 +25,9 @@ void INA260Sensor::initialize() {
     Wire.begin(PRESSURE_SDA_PIN, PRESSURE_SCL_PIN);
     Wire.setClock(I2C_FREQUENCY);
   
-    delay(100); // Allow sensor to stabilize
+    if (!warmStart) {
+      delay(100); // Allow sensor to stabilize
+    }
 
     // Check if INA260 is present by reading manufacturer ID
     uint16_t mfgId;
@@ -111,6 +114,7 @@ bool INA260Sensor::readData(PowerData& data) {
   }
   
   bool success = true;
+  data.timestamp_us = esp_timer_get_time();
   
   // Read voltage
   if (!readVoltage(data.voltage)) {
@@ -0,0 +1,178 @@
+#include "log_block.h"
+#include "checksum.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TRAILER_PREFIX "$B,"
+
+void LogBlockWriter::begin(uint32_t blockSeq) {
+  seq = blockSeq;
+  length = 0;
+  crc = 0;
+}
+
+void LogBlockWriter::add(const uint8_t* data, size_t len) {
+  crc = crc32(data, len, crc);
+  length += (uint32_t)len;
+}
+
+size_t LogBlockWriter::formatTrailer(char* buffer, size_t capacity) const {
+  int len = snprintf(buffer, capacity, LOG_TRAILER_PREFIX "%lu,%lu,%08lx\r\n",
+                     (unsigned long)seq, (unsigned long)length, (unsigned long)crc);
+  if (len < 0 || (size_t)len >= capacity) {
+    return 0;
+  }
+  return (size_t)len;
+}
+
+size_t formatLogMarker(char* buffer, size_t capacity, char type, uint32_t seq) {
+  int len = snprintf(buffer, capacity, "\r\n$%c,%lu\r\n", type, (unsigned long)seq);
+  if (len < 0 || (size_t)len >= capacity) {
+    return 0;
+  }
+  return (size_t)len;
+}
+
+// Unsigned decimal or hex field ending at ',' or the end of the line
+static bool parseField(const char*& p, const char* end, int base, uint32_t& value) {
+  const char* start = p;
+  uint64_t v = 0;
+  for (; p < end && *p != ','; p++) {
+    int digit;
+    if (*p >= '0' && *p <= '9') {
+      digit = *p - '0';
+    } else if (base == 16 && *p >= 'a' && *p <= 'f') {
+      digit = *p - 'a' + 10;
+    } else {
+      return false;
+    }
+    v = v * base + digit;
+    if (v > 0xFFFFFFFFULL) {
+      return false;
+    }
+  }
+  value = (uint32_t)v;
+  return p > start;
+}
+
+bool parseLogBlockTrailer(const char* line, size_t len, uint32_t& seq, uint32_t& length, uint32_t& crc) {
+  size_t prefixLen = strlen(LOG_TRAILER_PREFIX);
+  if (len <= prefixLen || strncmp(line, LOG_TRAILER_PREFIX, prefixLen) != 0) {
+    return false;
+  }
+  const char* p = line + prefixLen;
+  const char* end = line + len;
+  if (!parseField(p, end, 10, seq) || p >= end || *p++ != ',') {
+    return false;
+  }
+  if (!parseField(p, end, 10, length) || p >= end || *p++ != ',') {
+    return false;
+  }
+  const char* crcStart = p;
+  return parseField(p, end, 16, crc) && p == end && p - crcStart == 8;
+}
+
+// CRC of [offset, offset + len) in scan-sized reads
+static bool crcRange(LogReadFn read, void* context, uint32_t offset, uint32_t len, uint32_t& crc,
+                     uint32_t& bytesRead) {
+  uint8_t chunk[LOG_SCAN_CHUNK];
+  crc = 0;
+  while (len > 0) {
+    size_t want = len < sizeof(chunk) ? len : sizeof(chunk);
+    size_t got = read(context, offset, chunk, want);
+    bytesRead += (uint32_t)got;
+    if (got != want) {
+      return false;
+    }
+    crc = crc32(chunk, got, crc);
+    offset += (uint32_t)got;
+    len -= (uint32_t)got;
+  }
+  return true;
+}
+
+// Offset of the last "\n$B," that starts in [floor, limit), or -1. Reads
+// back one chunk at a time, overlapping by the pattern length so a match
+// across a chunk boundary is still found.
+static int64_t findTrailerBefore(LogReadFn read, void* context, uint32_t floor, uint32_t limit,
+                                 uint32_t fileSize, uint32_t& bytesRead) {
+  static const char pattern[] = "\n" LOG_TRAILER_PREFIX;
+  const uint32_t patternLen = sizeof(pattern) - 1;
+  uint8_t chunk[LOG_SCAN_CHUNK + sizeof(pattern)];
+  uint32_t end = limit;
+  while (end > floor) {
+    uint32_t start = end - floor > LOG_SCAN_CHUNK ? end - LOG_SCAN_CHUNK : floor;
+    uint32_t readEnd = end + patternLen - 1 < fileSize ? end + patternLen - 1 : fileSize;
+    size_t got = read(context, start, chunk, readEnd - start);
+    bytesRead += (uint32_t)got;
+    for (uint32_t i = end - start; i-- > 0;) {
+      if (i + patternLen <= got && memcmp(chunk + i, pattern, patternLen) == 0) {
+        return (int64_t)(start + i);
+      }
+    }
+    end = start;
+  }
+  return -1;
+}
+
+bool scanLogTail(LogReadFn read, void* context, uint32_t fileSize, LogScanResult& result) {
+  memset(&result, 0, sizeof(result));
+  uint32_t floor = fileSize > LOG_SCAN_MAX_BYTES ? fileSize - LOG_SCAN_MAX_BYTES : 0;
+  uint32_t limit = fileSize;
+
+  for (int attempt = 0; attempt < LOG_SCAN_MAX_BLOCKS; attempt++) {
+    int64_t newline = findTrailerBefore(read, context, floor, limit, fileSize, result.bytesRead);
+    if (newline < 0) {
+      break;
+    }
+    uint32_t lineStart = (uint32_t)newline + 1;
+    limit = (uint32_t)newline;
+
+    // A trailer cut off after its last digit still counts: the CRLF that
+    // starts the next marker ends its line for readers too
+    char line[LOG_BLOCK_TRAILER_LENGTH];
+    size_t got = read(context, lineStart, (uint8_t*)line, sizeof(line) - 1);
+    result.bytesRead += (uint32_t)got;
+    line[got] = '\0';
+    size_t lineLen = strcspn(line, "\r\n");
+    size_t ending = lineLen;
+    while (line[ending] == '\r') {
+      ending++;
+    }
+    bool complete = line[ending] == '\n';
+    if (!complete && lineStart + ending < fileSize) {
+      continue;
+    }
+    uint32_t seq, length, crc;
+    if (!parseLogBlockTrailer(line, lineLen, seq, length, crc) || length > lineStart) {
+      continue;
+    }
+
+    uint32_t actual;
+    if (!crcRange(read, context, lineStart - length, length, actual, result.bytesRead) || actual != crc) {
+      continue;
+    }
+
+    result.found = true;
+    result.lastSeq = seq;
+    result.validEnd = complete ? lineStart + (uint32_t)ending + 1 : fileSize;
+    result.tailBytes = fileSize - result.validEnd;
+
+    // A seal written at an earlier boot ends the file, after any torn
+    // block it closed off; that tail isn't loss
+    char marker[LOG_BLOCK_TRAILER_LENGTH];
+    size_t markerLen = formatLogMarker(marker, sizeof(marker), 'E', seq) - 2;
+    if (result.tailBytes >= markerLen) {
+      // With the newline before it, unless it starts right at validEnd
+      size_t checkLen = result.tailBytes > markerLen ? markerLen + 1 : markerLen;
+      char tail[LOG_BLOCK_TRAILER_LENGTH];
+      size_t tailLen = read(context, fileSize - (uint32_t)checkLen, (uint8_t*)tail, checkLen);
+      result.bytesRead += (uint32_t)tailLen;
+      result.sealed = tailLen == checkLen && memcmp(tail + checkLen - markerLen, marker + 2, markerLen) == 0 &&
+                      (checkLen == markerLen || tail[0] == '\n');
+    }
+    return true;
+  }
+  return false;
+}
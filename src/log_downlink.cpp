@@ -0,0 +1,289 @@
+#include "log_downlink.h"
+#include "command_protocol.h"
+
+LogDownlink::LogDownlink(SDManager& sd, RadioModule& radio) :
+  sdManager(sd),
+  radioModule(radio),
+  active(false),
+  fileId(0),
+  fileSize(0),
+  totalBlocks(0),
+  rangeCount(0),
+  chunkOffset(0),
+  chunkLength(0),
+  startTime(0),
+  lastServiceTime(0),
+  byteBudget(0),
+  blocksSent(0),
+  bytesSent(0),
+  blocksSinceSave(0) {
+}
+
+bool LogDownlink::start(const String& file, uint32_t first, uint32_t last, char* detail, size_t detailSize) {
+  detail[0] = '\0';
+  
+  if (!sdManager.isInitialized() || !sdManager.fileExists(file)) {
+    snprintf(detail, detailSize, "no such file");
+    return false;
+  }
+  
+  fileName = file.startsWith("/") ? file : "/" + file;
+  fileId = BlockTransfer::fileId(fileName.c_str());
+  fileSize = sdManager.getFileSize(fileName);
+  totalBlocks = BlockTransfer::blockCount(fileSize);
+  
+  if (totalBlocks == 0) {
+    snprintf(detail, detailSize, "empty file");
+    return false;
+  }
+  
+  if (last >= totalBlocks) {
+    last = totalBlocks - 1;
+  }
+  
+  rangeCount = 0;
+  if (first <= last) {
+    ranges[0].first = first;
+    ranges[0].last = last;
+    rangeCount = 1;
+  }
+  
+  chunkLength = 0;
+  startTime = millis();
+  lastServiceTime = startTime;
+  byteBudget = 0;
+  blocksSent = 0;
+  bytesSent = 0;
+  blocksSinceSave = 0;
+  active = true;
+  saveProgress();
+  
+  Serial.print("Log downlink started: ");
+  Serial.print(fileName);
+  Serial.print(" (");
+  Serial.print(totalBlocks);
+  Serial.println(" blocks)");
+  
+  snprintf(detail, detailSize, "id=%u,size=%lu,blocks=%lu,bs=%d",
+           (unsigned)fileId, (unsigned long)fileSize, (unsigned long)totalBlocks, DOWNLINK_BLOCK_SIZE);
+  return true;
+}
+
+bool LogDownlink::queueRanges(const char* spec) {
+  if (!active) {
+    return false;
+  }
+  
+  BlockRange requested[DOWNLINK_MAX_RANGES];
+  int count = BlockTransfer::parseRanges(spec, requested, DOWNLINK_MAX_RANGES);
+  if (count < 0) {
+    return false;
+  }
+  
+  // Retransmissions are appended behind whatever is still queued
+  bool allQueued = true;
+  for (int i = 0; i < count; i++) {
+    if (requested[i].first >= totalBlocks) {
+      continue;
+    }
+    if (rangeCount >= DOWNLINK_MAX_RANGES) {
+      allQueued = false;
+      break;
+    }
+    if (requested[i].last >= totalBlocks) {
+      requested[i].last = totalBlocks - 1;
+    }
+    ranges[rangeCount++] = requested[i];
+  }
+  
+  saveProgress();
+  return allQueued;
+}
+
+void LogDownlink::stop() {
+  if (!active) {
+    return;
+  }
+  finish(XFER_STATE_STOP);
+  Serial.println("Log downlink stopped");
+}
+
+void LogDownlink::finish(const char* state) {
+  sendStatus(state);
+  active = false;
+  rangeCount = 0;
+  clearProgress();
+}
+
+void LogDownlink::service() {
+  if (!active) {
+    return;
+  }
+  
+  unsigned long currentTime = millis();
+  unsigned long elapsed = currentTime - lastServiceTime;
+  lastServiceTime = currentTime;
+  
+  if (rangeCount == 0) {
+    return;
+  }
+  
+  // Token bucket: refill at the configured share of the air data rate,
+  // capped at two lines so a stalled loop doesn't cause a burst
+  const float bytesPerMs = RADIO_LINK_CAPACITY_BPS / 8000.0f * DOWNLINK_LINK_SHARE_PERCENT / 100.0f;
+  byteBudget += elapsed * bytesPerMs;
+  if (byteBudget > 2 * BLOCK_LINE_MAX_LENGTH) {
+    byteBudget = 2 * BLOCK_LINE_MAX_LENGTH;
+  }
+  
+  while (rangeCount > 0 && byteBudget >= BLOCK_LINE_MAX_LENGTH) {
+    uint32_t block = ranges[0].first;
+    if (!sendBlock(block)) {
+      // A missing card fails every block the same way; stepping through the
+      // rest of the queue would only stall the loop on SD opens
+      Serial.print("Log downlink: failed to read block ");
+      Serial.print(block);
+      Serial.println(", stopping");
+      finish(XFER_STATE_ERROR);
+      return;
+    }
+    
+    if (ranges[0].first == ranges[0].last) {
+      for (int i = 1; i < rangeCount; i++) {
+        ranges[i - 1] = ranges[i];
+      }
+      rangeCount--;
+    } else {
+      ranges[0].first++;
+    }
+    
+    if (++blocksSinceSave >= DOWNLINK_PERSIST_BLOCKS) {
+      saveProgress();
+    }
+  }
+  
+  if (rangeCount == 0) {
+    // Tell the ground this pass is complete so it can request gaps
+    sendStatus(XFER_STATE_IDLE);
+    saveProgress();
+  }
+}
+
+bool LogDownlink::loadBlock(uint32_t block, const uint8_t*& data, size_t& len) {
+  uint32_t offset = block * DOWNLINK_BLOCK_SIZE;
+  
+  if (chunkLength == 0 || offset < chunkOffset || offset >= chunkOffset + chunkLength) {
+    chunkOffset = offset - (offset % DOWNLINK_READ_CHUNK);
+    chunkLength = sdManager.readFileChunk(fileName, chunkOffset, chunk, sizeof(chunk));
+    if (chunkLength == 0 || offset >= chunkOffset + chunkLength) {
+      chunkLength = 0;
+      return false;
+    }
+  }
+  
+  data = chunk + (offset - chunkOffset);
+  len = chunkOffset + chunkLength - offset;
+  if (len > DOWNLINK_BLOCK_SIZE) {
+    len = DOWNLINK_BLOCK_SIZE;
+  }
+  return true;
+}
+
+bool LogDownlink::sendBlock(uint32_t block) {
+  const uint8_t* data = NULL;
+  size_t len = 0;
+  if (!loadBlock(block, data, len)) {
+    return false;
+  }
+  
+  static char line[BLOCK_LINE_MAX_LENGTH];
+  size_t lineLen = BlockTransfer::formatBlock(line, sizeof(line), fileId, block, data, len);
+  if (lineLen == 0) {
+    return false;
+  }
+  
+  radioModule.sendLine(line);
+  byteBudget -= lineLen;
+  blocksSent++;
+  bytesSent += lineLen;
+  return true;
+}
+
+void LogDownlink::sendStatus(const char* state) {
+  unsigned long elapsed = millis() - startTime;
+  
+  // Achieved line rate as a percentage of the raw link capacity
+  unsigned long linkPercent = 0;
+  if (elapsed > 0) {
+    linkPercent = (unsigned long)((uint64_t)bytesSent * 8 * 1000 * 100 / ((uint64_t)elapsed * RADIO_LINK_CAPACITY_BPS));
+  }
+  
+  char line[96];
+  int len = snprintf(line, sizeof(line), XFER_FRAME_PREFIX "%u,%s,%lu,%lu,%lu,%lu",
+                     (unsigned)fileId, state, (unsigned long)blocksSent, (unsigned long)bytesSent,
+                     elapsed, linkPercent);
+  if (len > 0 && CommandProtocol::appendCrc(line, (size_t)len, sizeof(line)) > 0) {
+    radioModule.sendLine(line);
+  }
+}
+
+void LogDownlink::formatStatus(char* detail, size_t detailSize) const {
+  if (!active) {
+    snprintf(detail, detailSize, "idle");
+    return;
+  }
+  snprintf(detail, detailSize, "id=%u,next=%ld,ranges=%d,sent=%lu",
+           (unsigned)fileId, rangeCount > 0 ? (long)ranges[0].first : -1L,
+           rangeCount, (unsigned long)blocksSent);
+}
+
+void LogDownlink::saveProgress() {
+  blocksSinceSave = 0;
+  if (!preferences.begin(PREFS_NAMESPACE, false)) {
+    return;
+  }
+  // Only the head range is persisted; the ground re-requests any other gaps
+  preferences.putString(PREFS_DOWNLINK_FILE_KEY, fileName);
+  preferences.putUInt(PREFS_DOWNLINK_NEXT_KEY, rangeCount > 0 ? ranges[0].first : totalBlocks);
+  preferences.putUInt(PREFS_DOWNLINK_LAST_KEY, rangeCount > 0 ? ranges[0].last : totalBlocks);
+  preferences.end();
+}
+
+void LogDownlink::clearProgress() {
+  if (preferences.begin(PREFS_NAMESPACE, false)) {
+    preferences.remove(PREFS_DOWNLINK_FILE_KEY);
+    preferences.remove(PREFS_DOWNLINK_NEXT_KEY);
+    preferences.remove(PREFS_DOWNLINK_LAST_KEY);
+    preferences.end();
+  }
+}
+
+void LogDownlink::restore() {
+  if (!preferences.begin(PREFS_NAMESPACE, true)) {
+    return;
+  }
+  
+  String savedFile;
+  uint32_t next = 0;
+  uint32_t last = 0;
+  bool hasTransfer = preferences.isKey(PREFS_DOWNLINK_FILE_KEY);
+  if (hasTransfer) {
+    savedFile = preferences.getString(PREFS_DOWNLINK_FILE_KEY, "");
+    next = preferences.getUInt(PREFS_DOWNLINK_NEXT_KEY, 0);
+    last = preferences.getUInt(PREFS_DOWNLINK_LAST_KEY, 0);
+  }
+  preferences.end();
+  
+  if (!hasTransfer || savedFile.length() == 0) {
+    return;
+  }
+  
+  Serial.print("Resuming interrupted log downlink at block ");
+  Serial.println(next);
+  
+  char detail[CMD_MAX_ARGS_LENGTH];
+  if (!start(savedFile, next, last, detail, sizeof(detail))) {
+    Serial.println("Interrupted downlink file is gone, discarding transfer");
+    clearProgress();
+  }
+}
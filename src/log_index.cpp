@@ -0,0 +1,122 @@
+#include "log_index.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char* logSideSuffix(uint8_t side) {
+  switch (side) {
+    case LOG_SIDE_EVENTS: return SD_EVENTS_SUFFIX;
+    case LOG_SIDE_VIB: return SD_VIB_SUFFIX;
+    case LOG_SIDE_BLACKBOX: return SD_BLACKBOX_SUFFIX;
+    default: return NULL;
+  }
+}
+
+void beginLogIndexEntry(LogIndexEntry& entry, const char* name) {
+  memset(&entry, 0, sizeof(entry));
+  strncpy(entry.name, name, sizeof(entry.name) - 1);
+}
+
+void addLogIndexRecord(LogIndexEntry& entry, const TelemetryData& data) {
+  if (entry.records == 0) {
+    entry.startMs = data.timestamp;
+    entry.maxAltitude = data.altitude_filtered;
+  }
+  entry.records++;
+  entry.endMs = data.timestamp;
+  if (data.utc_ms > 0) {
+    entry.utcEndMs = data.utc_ms;
+  }
+  if (data.estimator_valid) {
+    entry.maxAltitude = fmaxf(entry.maxAltitude, data.altitude_filtered);
+    entry.maxSpeed = fmaxf(entry.maxSpeed, fabsf(data.vertical_velocity));
+  }
+  if ((uint8_t)data.flight_phase > entry.maxPhase) {
+    entry.maxPhase = (uint8_t)data.flight_phase;
+  }
+}
+
+uint32_t logIndexTotalBytes(const LogIndexEntry& entry) {
+  uint32_t total = entry.bytes;
+  for (int i = 0; i < LOG_SIDE_COUNT; i++) {
+    total += entry.sideBytes[i];
+  }
+  return total;
+}
+
+const char* logIndexHeaderLine() {
+  return "#name,bytes,events_bytes,vib_bytes,bb_bytes,records,start_ms,end_ms,utc_end_ms,max_alt,max_speed,max_phase";
+}
+
+size_t formatLogIndexEntry(char* buffer, size_t capacity, const LogIndexEntry& entry) {
+  int len = snprintf(buffer, capacity, "%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lld,%.1f,%.1f,%u", entry.name,
+                     (unsigned long)entry.bytes, (unsigned long)entry.sideBytes[LOG_SIDE_EVENTS],
+                     (unsigned long)entry.sideBytes[LOG_SIDE_VIB], (unsigned long)entry.sideBytes[LOG_SIDE_BLACKBOX],
+                     (unsigned long)entry.records, (unsigned long)entry.startMs, (unsigned long)entry.endMs,
+                     (long long)entry.utcEndMs, entry.maxAltitude, entry.maxSpeed, (unsigned)entry.maxPhase);
+  if (len < 0 || (size_t)len >= capacity) {
+    return 0;
+  }
+  return (size_t)len;
+}
+
+// Next comma-separated field as a number; false if it's missing or isn't
+// followed by a comma (the line's end, for the last)
+static bool parseNumber(const char*& p, bool last, double& value) {
+  char* end;
+  value = strtod(p, &end);
+  if (end == p) {
+    return false;
+  }
+  if (last) {
+    while (*end == '\r' || *end == '\n') {
+      end++;
+    }
+    p = end;
+    return *end == '\0';
+  }
+  if (*end != ',') {
+    return false;
+  }
+  p = end + 1;
+  return true;
+}
+
+bool parseLogIndexEntry(const char* line, LogIndexEntry& entry) {
+  const char* comma = strchr(line, ',');
+  if (line[0] != '/' || comma == NULL || (size_t)(comma - line) >= sizeof(entry.name)) {
+    return false;
+  }
+  memset(&entry, 0, sizeof(entry));
+  memcpy(entry.name, line, comma - line);
+
+  // utc_end_ms needs all 64 bits, the rest fit a double exactly
+  const int fieldCount = 11;
+  double fields[fieldCount];
+  const char* p = comma + 1;
+  for (int i = 0; i < fieldCount; i++) {
+    if (i == 7) {
+      char* end;
+      entry.utcEndMs = strtoll(p, &end, 10);
+      if (end == p || *end != ',') {
+        return false;
+      }
+      p = end + 1;
+      fields[i] = 0.0;
+    } else if (!parseNumber(p, i == fieldCount - 1, fields[i])) {
+      return false;
+    }
+  }
+  entry.bytes = (uint32_t)fields[0];
+  for (int i = 0; i < LOG_SIDE_COUNT; i++) {
+    entry.sideBytes[i] = (uint32_t)fields[1 + i];
+  }
+  entry.records = (uint32_t)fields[4];
+  entry.startMs = (uint32_t)fields[5];
+  entry.endMs = (uint32_t)fields[6];
+  entry.maxAltitude = (float)fields[8];
+  entry.maxSpeed = (float)fields[9];
+  entry.maxPhase = (uint8_t)fields[10];
+  return true;
+}
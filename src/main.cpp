@@ -6,13 +6,19 @@
 #include "radio_module.h"
 #include "power_manager.h"
 #include "wifi_manager.h"
+#include "rtc_state.h"
 #include "esp_task_wdt.h"
 
 SystemController systemController;
 
 void setup() {
   Serial.begin(115200);
-  delay(1000);
+  
+  // Nobody is waiting at the serial monitor after a reset in flight
+  FlightResumeState resumeState;
+  if (!loadFlightResumeState(resumeState)) {
+    delay(1000);
+  }
   
   Serial.println("Rocket Flight Computer Starting...");
   
@@ -1,19 +1,26 @@
 #include "mpu9250_sensor.h"
+#include "esp_timer.h"
 
-MPU9250Sensor::MPU9250Sensor() : initialized(false), magnetometerInitialized(false) {
+MPU9250Sensor::MPU9250Sensor()
+  : initialized(false), magnetometerInitialized(false),
+    accelRange(IMU_ACCEL_FULL_SCALES, IMU_ACCEL_RANGE, IMU_AUTO_RANGE),
+    gyroRange(IMU_GYRO_FULL_SCALES, IMU_GYRO_RANGE, IMU_AUTO_RANGE),
+    rangeCheckCycles(0), rangeSwitchCount(0), fifoInterval(0) {
 }
 
 MPU9250Sensor::~MPU9250Sensor() {
 }
 
-void MPU9250Sensor::initialize() {
+void MPU9250Sensor::initialize(bool warmStart) {
   Serial.println("Initializing MPU9250 sensor...");
   
   // Initialize I2C if not already done
   Wire.begin(PRESSURE_SDA_PIN, PRESSURE_SCL_PIN);
   Wire.setClock(I2C_FREQUENCY);
   
-  delay(100); // Allow sensor to stabilize
+  if (!warmStart) {
+    delay(100); // Allow sensor to stabilize
+  }
   
   const int maxRetries = 3;
   bool success = false;
@@ -90,13 +97,8 @@ bool MPU9250Sensor::initializeMPU9250() {
     return false;
   }
   
-  // Configure gyroscope (±250°/s)
-  if (!writeRegister(MPU9250_I2C_ADDR, MPU9250_GYRO_CONFIG, 0x00)) {
-    return false;
-  }
-  
-  // Configure accelerometer (±2g)
-  if (!writeRegister(MPU9250_I2C_ADDR, MPU9250_ACCEL_CONFIG, 0x00)) {
+  // Configure gyroscope and accelerometer full scale (current range)
+  if (!writeRangeConfig()) {
     return false;
   }
   
@@ -115,9 +117,56 @@ bool MPU9250Sensor::initializeMPU9250() {
     return false;
   }
   
+  // The reset above cleared the FIFO setup; restore it after a re-init
+  if (fifoInterval != 0 && !configureFifo(fifoInterval)) {
+    return false;
+  }
+  
+  return true;
+}
+
+bool MPU9250Sensor::configureFifo(uint8_t intervalMs) {
+  if (intervalMs == 0) {
+    // Back to the single-read setup: FIFO off, 1 kHz, 41 Hz gyro DLPF
+    bool ok = writeRegister(MPU9250_I2C_ADDR, MPU9250_USER_CTRL, 0x00) &&
+              writeRegister(MPU9250_I2C_ADDR, MPU9250_FIFO_EN, 0x00) &&
+              writeRegister(MPU9250_I2C_ADDR, MPU9250_SMPLRT_DIV, 0x00) &&
+              writeRegister(MPU9250_I2C_ADDR, MPU9250_CONFIG, 0x03) &&
+              writeRegister(MPU9250_I2C_ADDR, MPU9250_ACCEL_CONFIG2, 0x00);
+    if (ok) {
+      fifoInterval = 0;
+    }
+    return ok;
+  }
+  
+  // The on-chip DLPF is the anti-alias filter for the FIFO rate: 184 Hz
+  // gyro / 218 Hz accel at 1 kHz, 41 Hz / 45 Hz at the slower rates
+  bool fast = intervalMs <= 2;
+  bool ok = writeRegister(MPU9250_I2C_ADDR, MPU9250_CONFIG, fast ? 0x01 : 0x03) &&
+            writeRegister(MPU9250_I2C_ADDR, MPU9250_ACCEL_CONFIG2, fast ? 0x01 : 0x03) &&
+            writeRegister(MPU9250_I2C_ADDR, MPU9250_SMPLRT_DIV, intervalMs - 1) &&
+            writeRegister(MPU9250_I2C_ADDR, MPU9250_FIFO_EN, MPU9250_FIFO_EN_ACCEL_GYRO) &&
+            resetFifo();
+  if (!ok) {
+    Serial.println("Failed to configure MPU9250 FIFO");
+    return false;
+  }
+  fifoInterval = intervalMs;
   return true;
 }
 
+bool MPU9250Sensor::resetFifo() {
+  return writeRegister(MPU9250_I2C_ADDR, MPU9250_USER_CTRL, MPU9250_USER_CTRL_FIFO_RST) &&
+         writeRegister(MPU9250_I2C_ADDR, MPU9250_USER_CTRL, MPU9250_USER_CTRL_FIFO_EN);
+}
+
+bool MPU9250Sensor::writeRangeConfig() {
+  if (!writeRegister(MPU9250_I2C_ADDR, MPU9250_GYRO_CONFIG, gyroRange.configBits())) {
+    return false;
+  }
+  return writeRegister(MPU9250_I2C_ADDR, MPU9250_ACCEL_CONFIG, accelRange.configBits());
+}
+
 bool MPU9250Sensor::initializeMagnetometer() {
   // Check if magnetometer is present
   uint8_t whoAmI;
@@ -155,38 +204,43 @@ bool MPU9250Sensor::readData(IMUData& data) {
   
   // Read accelerometer, temperature, and gyroscope data in one transaction
   // MPU9250 registers are sequential: ACCEL_XOUT_H(0x3B) to GYRO_ZOUT_L(0x48)
+  data.timestamp_us = esp_timer_get_time();
   bool success = readRegisters(MPU9250_I2C_ADDR, MPU9250_ACCEL_XOUT_H, sensorBuffer, 14);
   
   if (success) {
-    // Parse accelerometer data (bytes 0-5)
-    int16_t raw_accel_x = (sensorBuffer[0] << 8) | sensorBuffer[1];
-    int16_t raw_accel_y = (sensorBuffer[2] << 8) | sensorBuffer[3];
-    int16_t raw_accel_z = (sensorBuffer[4] << 8) | sensorBuffer[5];
-    
-    data.accel_x = raw_accel_x / ACCEL_SCALE_2G;
-    data.accel_y = raw_accel_y / ACCEL_SCALE_2G;
-    data.accel_z = raw_accel_z / ACCEL_SCALE_2G;
-    
-    // Parse temperature data (bytes 6-7)
-    int16_t raw_temp = (sensorBuffer[6] << 8) | sensorBuffer[7];
-    data.temperature = (raw_temp / 333.87f) + 21.0f;
+    data.rangeChanged = convertSample(sensorBuffer, data);
     
-    // Parse gyroscope data (bytes 8-13)
-    int16_t raw_gyro_x = (sensorBuffer[8] << 8) | sensorBuffer[9];
-    int16_t raw_gyro_y = (sensorBuffer[10] << 8) | sensorBuffer[11];
-    int16_t raw_gyro_z = (sensorBuffer[12] << 8) | sensorBuffer[13];
-    
-    data.gyro_x = raw_gyro_x / GYRO_SCALE_250DPS;
-    data.gyro_y = raw_gyro_y / GYRO_SCALE_250DPS;
-    data.gyro_z = raw_gyro_z / GYRO_SCALE_250DPS;
+    // A clipped reading says nothing about how far over the rail it went;
+    // the range has already jumped to the top, so read the sample again
+    // once the new range has settled rather than pass the clip on
+    if (data.clipped && data.rangeChanged) {
+      delay(IMU_RANGE_SETTLE_MS);
+      data.timestamp_us = esp_timer_get_time();
+      if (readRegisters(MPU9250_I2C_ADDR, MPU9250_ACCEL_XOUT_H, sensorBuffer, 14)) {
+        convertSample(sensorBuffer, data);
+      }
+    }
   } else {
     // Set default values on failure
     data.accel_x = data.accel_y = data.accel_z = 0.0f;
     data.gyro_x = data.gyro_y = data.gyro_z = 0.0f;
     data.temperature = 0.0f;
+    data.accel_range = accelRange.getFullScale();
+    data.gyro_range = gyroRange.getFullScale();
+    data.clipped = false;
+    data.rangeChanged = false;
   }
   
   // Read magnetometer data separately (different I2C address)
+  if (!readMagnetometerData(data)) {
+    success = false;
+  }
+  
+  data.valid = success;
+  return success;
+}
+
+bool MPU9250Sensor::readMagnetometerData(IMUData& data) {
   if (magnetometerInitialized) {
     uint8_t magBuffer[6];
     if (readRegisters(AK8963_I2C_ADDR, AK8963_XOUT_L, magBuffer, 6)) {
@@ -197,16 +251,158 @@ bool MPU9250Sensor::readData(IMUData& data) {
       data.mag_x = raw_mag_x * MAG_SCALE;
       data.mag_y = raw_mag_y * MAG_SCALE;
       data.mag_z = raw_mag_z * MAG_SCALE;
-    } else {
-      data.mag_x = data.mag_y = data.mag_z = 0.0f;
-      success = false;
+      return true;
     }
-  } else {
     data.mag_x = data.mag_y = data.mag_z = 0.0f;
+    return false;
+  }
+  data.mag_x = data.mag_y = data.mag_z = 0.0f;
+  return true;
+}
+
+bool MPU9250Sensor::readBatch(ImuBatch& batch, IMUData& data) {
+  batch.count = 0;
+  batch.clipped = false;
+  batch.overflow = false;
+  data.valid = false;
+  data.clipped = false;
+  data.rangeChanged = false;
+  data.accel_range = accelRange.getFullScale();
+  data.gyro_range = gyroRange.getFullScale();
+  if (!initialized || fifoInterval == 0) {
+    return false;
   }
   
-  data.valid = success;
-  return success;
+  // The newest sample counted was taken within one interval before the
+  // count was read; call it half an interval
+  uint8_t countBuffer[2];
+  int64_t countUs = esp_timer_get_time();
+  if (!readRegisters(MPU9250_I2C_ADDR, MPU9250_FIFO_COUNTH, countBuffer, 2)) {
+    return false;
+  }
+  uint16_t bytes = ((countBuffer[0] & 0x1F) << 8) | countBuffer[1];
+  
+  // A full FIFO has dropped samples and may have lost its alignment
+  if (bytes > MPU9250_FIFO_SIZE - MPU9250_FIFO_SAMPLE_BYTES) {
+    batch.overflow = true;
+    resetFifo();
+    return false;
+  }
+  
+  uint16_t available = bytes / MPU9250_FIFO_SAMPLE_BYTES;
+  uint8_t accelShift = accelRange.getIndex();
+  uint8_t gyroShift = gyroRange.getIndex();
+  int32_t accelPeak = 0;
+  int32_t gyroPeak = 0;
+  uint8_t buffer[MPU9250_FIFO_READ_SAMPLES * MPU9250_FIFO_SAMPLE_BYTES];
+  
+  while (batch.count < available) {
+    uint16_t chunk = available - batch.count;
+    if (chunk > MPU9250_FIFO_READ_SAMPLES) {
+      chunk = MPU9250_FIFO_READ_SAMPLES;
+    }
+    if (!readRegisters(MPU9250_I2C_ADDR, MPU9250_FIFO_R_W, buffer, chunk * MPU9250_FIFO_SAMPLE_BYTES)) {
+      // Part of a sample may have been popped; start over clean
+      resetFifo();
+      break;
+    }
+    for (uint16_t i = 0; i < chunk; i++) {
+      const uint8_t* p = buffer + i * MPU9250_FIFO_SAMPLE_BYTES;
+      int16_t raw[6];
+      for (uint8_t a = 0; a < 6; a++) {
+        raw[a] = (p[a * 2] << 8) | p[a * 2 + 1];
+      }
+      int32_t* out = batch.samples + batch.count * DECIM_AXES;
+      for (uint8_t a = 0; a < 3; a++) {
+        out[a] = (int32_t)raw[a] * (1 << accelShift);
+        out[3 + a] = (int32_t)raw[3 + a] * (1 << gyroShift);
+      }
+      int32_t peak = ImuRangeSelector::peak(raw[0], raw[1], raw[2]);
+      accelPeak = peak > accelPeak ? peak : accelPeak;
+      peak = ImuRangeSelector::peak(raw[3], raw[4], raw[5]);
+      gyroPeak = peak > gyroPeak ? peak : gyroPeak;
+      batch.count++;
+    }
+  }
+  
+  if (batch.count == 0) {
+    return false;
+  }
+  
+  // Range check once per batch; samples still in the FIFO were taken in
+  // the old range, so a switch restarts it
+  uint32_t cycleStart = ESP.getCycleCount();
+  batch.clipped = accelPeak >= IMU_RANGE_RAIL || gyroPeak >= IMU_RANGE_RAIL;
+  bool accelChanged = accelRange.update(accelPeak);
+  bool gyroChanged = gyroRange.update(gyroPeak);
+  rangeCheckCycles = ESP.getCycleCount() - cycleStart;
+  if (accelChanged || gyroChanged) {
+    rangeSwitchCount++;
+    if (!writeRangeConfig() || !resetFifo()) {
+      Serial.println("Failed to write MPU9250 range config");
+    }
+    data.rangeChanged = true;
+  }
+  data.clipped = batch.clipped;
+  data.timestamp_us = countUs - fifoInterval * 500;
+  
+  uint8_t tempBuffer[2];
+  if (readRegisters(MPU9250_I2C_ADDR, MPU9250_TEMP_OUT_H, tempBuffer, 2)) {
+    int16_t rawTemp = (tempBuffer[0] << 8) | tempBuffer[1];
+    data.temperature = (rawTemp / 333.87f) + 21.0f;
+  }
+  readMagnetometerData(data);
+  
+  data.valid = true;
+  return true;
+}
+
+bool MPU9250Sensor::convertSample(const uint8_t* sensorBuffer, IMUData& data) {
+  // Parse accelerometer data (bytes 0-5)
+  int16_t raw_accel_x = (sensorBuffer[0] << 8) | sensorBuffer[1];
+  int16_t raw_accel_y = (sensorBuffer[2] << 8) | sensorBuffer[3];
+  int16_t raw_accel_z = (sensorBuffer[4] << 8) | sensorBuffer[5];
+  
+  float accelScale = accelRange.getUnitsPerCount();
+  data.accel_x = raw_accel_x * accelScale;
+  data.accel_y = raw_accel_y * accelScale;
+  data.accel_z = raw_accel_z * accelScale;
+  
+  // Parse temperature data (bytes 6-7)
+  int16_t raw_temp = (sensorBuffer[6] << 8) | sensorBuffer[7];
+  data.temperature = (raw_temp / 333.87f) + 21.0f;
+  
+  // Parse gyroscope data (bytes 8-13)
+  int16_t raw_gyro_x = (sensorBuffer[8] << 8) | sensorBuffer[9];
+  int16_t raw_gyro_y = (sensorBuffer[10] << 8) | sensorBuffer[11];
+  int16_t raw_gyro_z = (sensorBuffer[12] << 8) | sensorBuffer[13];
+  
+  float gyroScale = gyroRange.getUnitsPerCount();
+  data.gyro_x = raw_gyro_x * gyroScale;
+  data.gyro_y = raw_gyro_y * gyroScale;
+  data.gyro_z = raw_gyro_z * gyroScale;
+  
+  // The sample carries the range it was scaled with; a switch only
+  // applies to later reads
+  data.accel_range = accelRange.getFullScale();
+  data.gyro_range = gyroRange.getFullScale();
+  
+  uint32_t cycleStart = ESP.getCycleCount();
+  int32_t accelPeak = ImuRangeSelector::peak(raw_accel_x, raw_accel_y, raw_accel_z);
+  int32_t gyroPeak = ImuRangeSelector::peak(raw_gyro_x, raw_gyro_y, raw_gyro_z);
+  data.clipped = accelPeak >= IMU_RANGE_RAIL || gyroPeak >= IMU_RANGE_RAIL;
+  bool accelChanged = accelRange.update(accelPeak);
+  bool gyroChanged = gyroRange.update(gyroPeak);
+  rangeCheckCycles = ESP.getCycleCount() - cycleStart;
+  
+  if (!accelChanged && !gyroChanged) {
+    return false;
+  }
+  rangeSwitchCount++;
+  if (!writeRangeConfig()) {
+    Serial.println("Failed to write MPU9250 range config");
+  }
+  return true;
 }
 
 bool MPU9250Sensor::readAccelerometer(float& x, float& y, float& z) {
@@ -219,9 +415,10 @@ bool MPU9250Sensor::readAccelerometer(float& x, float& y, float& z) {
   int16_t raw_y = (buffer[2] << 8) | buffer[3];
   int16_t raw_z = (buffer[4] << 8) | buffer[5];
   
-  x = raw_x / ACCEL_SCALE_2G;
-  y = raw_y / ACCEL_SCALE_2G;
-  z = raw_z / ACCEL_SCALE_2G;
+  float scale = accelRange.getUnitsPerCount();
+  x = raw_x * scale;
+  y = raw_y * scale;
+  z = raw_z * scale;
   
   return true;
 }
@@ -236,9 +433,10 @@ bool MPU9250Sensor::readGyroscope(float& x, float& y, float& z) {
   int16_t raw_y = (buffer[2] << 8) | buffer[3];
   int16_t raw_z = (buffer[4] << 8) | buffer[5];
   
-  x = raw_x / GYRO_SCALE_250DPS;
-  y = raw_y / GYRO_SCALE_250DPS;
-  z = raw_z / GYRO_SCALE_250DPS;
+  float scale = gyroRange.getUnitsPerCount();
+  x = raw_x * scale;
+  y = raw_y * scale;
+  z = raw_z * scale;
   
   return true;
 }
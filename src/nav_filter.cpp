@@ -0,0 +1,295 @@
+#include "nav_filter.h"
+#include <math.h>
+#include <string.h>
+
+NavigationFilter::NavigationFilter() :
+  initialized(false),
+  refLatitude(0),
+  refLongitude(0),
+  refAltitude(0),
+  metersPerUnitLat(0),
+  metersPerUnitLon(0),
+  baroZero(0),
+  haveBaroZero(false),
+  rejectedTotal(0),
+  consecutiveRejects(0) {
+  memset(x, 0, sizeof(x));
+  memset(P, 0, sizeof(P));
+  clearAlignment();
+}
+
+void NavigationFilter::reset(int32_t latitude, int32_t longitude, float altitude) {
+  refLatitude = latitude;
+  refLongitude = longitude;
+  refAltitude = altitude;
+  metersPerUnitLat = (float)(NAV_EARTH_RADIUS * M_PI / 180.0 / COORD_SCALE);
+  metersPerUnitLon = (float)(NAV_EARTH_RADIUS * M_PI / 180.0 / COORD_SCALE * cos(coordToDegrees(latitude) * M_PI / 180.0));
+  haveBaroZero = false;
+  consecutiveRejects = 0;
+
+  memset(x, 0, sizeof(x));
+  memset(P, 0, sizeof(P));
+  P[NAV_E][NAV_E] = NAV_GPS_H_NOISE * NAV_GPS_H_NOISE;
+  P[NAV_N][NAV_N] = NAV_GPS_H_NOISE * NAV_GPS_H_NOISE;
+  P[NAV_U][NAV_U] = NAV_GPS_V_NOISE * NAV_GPS_V_NOISE;
+  for (uint8_t i = 0; i < 3; i++) {
+    P[NAV_VE + i][NAV_VE + i] = NAV_INIT_VEL_SIGMA * NAV_INIT_VEL_SIGMA;
+    P[NAV_BE + i][NAV_BE + i] = NAV_INIT_BIAS_SIGMA * NAV_INIT_BIAS_SIGMA;
+  }
+  clearAlignment();
+  initialized = true;
+}
+
+// Lost horizontal track: restart east/north at the fix with the velocity
+// unknown to about the alignment threshold, and align the heading again.
+// The vertical channel keeps its state.
+void NavigationFilter::restartHorizontal(float east, float north) {
+  static const uint8_t horizontal[] = {NAV_E, NAV_N, NAV_VE, NAV_VN, NAV_BE, NAV_BN, NAV_YAW};
+  for (uint8_t i = 0; i < sizeof(horizontal); i++) {
+    for (uint8_t k = 0; k < NAV_STATES; k++) {
+      P[horizontal[i]][k] = 0;
+      P[k][horizontal[i]] = 0;
+    }
+  }
+  x[NAV_E] = east;
+  x[NAV_N] = north;
+  x[NAV_BE] = 0;
+  x[NAV_BN] = 0;
+  P[NAV_E][NAV_E] = NAV_GPS_H_NOISE * NAV_GPS_H_NOISE;
+  P[NAV_N][NAV_N] = NAV_GPS_H_NOISE * NAV_GPS_H_NOISE;
+  P[NAV_VE][NAV_VE] = NAV_ALIGN_DV * NAV_ALIGN_DV;
+  P[NAV_VN][NAV_VN] = NAV_ALIGN_DV * NAV_ALIGN_DV;
+  P[NAV_BE][NAV_BE] = NAV_INIT_BIAS_SIGMA * NAV_INIT_BIAS_SIGMA;
+  P[NAV_BN][NAV_BN] = NAV_INIT_BIAS_SIGMA * NAV_INIT_BIAS_SIGMA;
+  consecutiveRejects = 0;
+  clearAlignment();
+}
+
+void NavigationFilter::clearAlignment() {
+  headingAligned = false;
+  alignFixes = 0;
+  alignSpan = 0;
+  alignDot = 0;
+  alignCross = 0;
+  alignPower = 0;
+  for (uint8_t i = 0; i < 2; i++) {
+    alignLastFix[i] = 0;
+    alignLastRate[i] = 0;
+    alignLastRise[i] = 0;
+    alignArea[i] = 0;
+    alignMoment[i] = 0;
+  }
+  x[NAV_YAW] = 0;
+  P[NAV_YAW][NAV_YAW] = 0;
+}
+
+void NavigationFilter::predict(const float accel[3], float dt) {
+  if (!initialized || dt <= 0) {
+    return;
+  }
+  if (dt > NAV_MAX_DT) {
+    dt = NAV_MAX_DT;
+  }
+
+  // AHRS frame to east/north/up, bias removed; j is d(accel)/d(yaw). Before
+  // the heading is aligned the horizontal acceleration only feeds the
+  // alignment and the process noise.
+  float q = NAV_ACCEL_NOISE * NAV_ACCEL_NOISE;
+  float qHorizontal = q;
+  float a[3];
+  float j[3] = {0.0f, 0.0f, 0.0f};
+  float b[3] = {0.0f, 0.0f, 1.0f};   // Bias terms in F, per axis
+  if (headingAligned) {
+    b[0] = 1.0f;
+    b[1] = 1.0f;
+    float c = cosf(x[NAV_YAW]);
+    float s = sinf(x[NAV_YAW]);
+    a[0] = c * accel[0] - s * accel[1] - x[NAV_BE];
+    a[1] = s * accel[0] + c * accel[1] - x[NAV_BN];
+    j[0] = -s * accel[0] - c * accel[1];
+    j[1] = c * accel[0] - s * accel[1];
+  } else {
+    a[0] = 0.0f;
+    a[1] = 0.0f;
+    // Unmodeled and correlated over the fix interval, not white
+    qHorizontal += (accel[0] * accel[0] + accel[1] * accel[1]) / dt;
+    if (alignFixes > 0) {
+      float mid = alignSpan + 0.5f * dt;
+      for (uint8_t i = 0; i < 2; i++) {
+        alignArea[i] += accel[i] * dt;
+        alignMoment[i] += accel[i] * dt * mid;
+      }
+      alignSpan += dt;
+    }
+  }
+  a[2] = accel[2] - x[NAV_BU];
+
+  float half = 0.5f * dt * dt;
+  for (uint8_t i = 0; i < 3; i++) {
+    x[NAV_E + i] += x[NAV_VE + i] * dt + a[i] * half;
+    x[NAV_VE + i] += a[i] * dt;
+  }
+
+  // P = F P F' + Q. F is the identity plus, per axis,
+  //   p += dt v - dt^2/2 b + dt^2/2 j yaw
+  //   v +=      - dt b     + dt j yaw
+  // with no horizontal bias or heading terms until the heading is aligned
+  // applied to the rows and then to the columns; position first, so each
+  // uses the velocity terms from before the step
+  for (uint8_t i = 0; i < 3; i++) {
+    for (uint8_t k = 0; k < NAV_STATES; k++) {
+      P[NAV_E + i][k] += dt * P[NAV_VE + i][k] - half * b[i] * P[NAV_BE + i][k] + half * j[i] * P[NAV_YAW][k];
+    }
+  }
+  for (uint8_t i = 0; i < 3; i++) {
+    for (uint8_t k = 0; k < NAV_STATES; k++) {
+      P[NAV_VE + i][k] += -dt * b[i] * P[NAV_BE + i][k] + dt * j[i] * P[NAV_YAW][k];
+    }
+  }
+  for (uint8_t i = 0; i < 3; i++) {
+    for (uint8_t k = 0; k < NAV_STATES; k++) {
+      P[k][NAV_E + i] += dt * P[k][NAV_VE + i] - half * b[i] * P[k][NAV_BE + i] + half * j[i] * P[k][NAV_YAW];
+    }
+  }
+  for (uint8_t i = 0; i < 3; i++) {
+    for (uint8_t k = 0; k < NAV_STATES; k++) {
+      P[k][NAV_VE + i] += -dt * b[i] * P[k][NAV_BE + i] + dt * j[i] * P[k][NAV_YAW];
+    }
+  }
+
+  // White acceleration over the step (as in the altitude filter), random
+  // walk on the bias and the heading
+  for (uint8_t i = 0; i < 3; i++) {
+    float qa = i < 2 ? qHorizontal : q;
+    P[NAV_E + i][NAV_E + i] += qa * half * half;
+    P[NAV_E + i][NAV_VE + i] += qa * half * dt;
+    P[NAV_VE + i][NAV_E + i] += qa * half * dt;
+    P[NAV_VE + i][NAV_VE + i] += qa * dt * dt;
+    P[NAV_BE + i][NAV_BE + i] += NAV_BIAS_NOISE * NAV_BIAS_NOISE * dt;
+  }
+  if (headingAligned) {
+    P[NAV_YAW][NAV_YAW] += NAV_YAW_NOISE * NAV_YAW_NOISE * dt;
+  }
+}
+
+// Over two fix intervals T1, T2 the change in average velocity is
+//   (p2 - p1)/T2 - (p1 - p0)/T1 = 1/T1 int (t - t0) a + 1/T2 int (t2 - t) a
+// whatever the velocity was, so the same integrals of the AHRS-frame accel
+// differ from it only by the heading rotation (and noise)
+void NavigationFilter::alignHeading(float east, float north) {
+  float fix[2] = {east, north};
+  if (alignFixes > 0 && alignSpan > 0) {
+    float rate[2];
+    float rise[2];
+    for (uint8_t i = 0; i < 2; i++) {
+      rate[i] = (fix[i] - alignLastFix[i]) / alignSpan;
+      rise[i] = alignMoment[i] / alignSpan;
+    }
+    if (alignFixes > 1) {
+      float earth[2];
+      float body[2];
+      for (uint8_t i = 0; i < 2; i++) {
+        earth[i] = rate[i] - alignLastRate[i];
+        body[i] = alignArea[i] - rise[i] + alignLastRise[i];
+      }
+      alignDot += body[0] * earth[0] + body[1] * earth[1];
+      alignCross += body[0] * earth[1] - body[1] * earth[0];
+      alignPower += body[0] * body[0] + body[1] * body[1];
+      if (alignPower > NAV_ALIGN_DV * NAV_ALIGN_DV) {
+        // Three fixes per velocity change, about one interval apart
+        float sigma = NAV_GPS_H_NOISE * 2.45f / alignSpan;
+        x[NAV_YAW] = atan2f(alignCross, alignDot);
+        P[NAV_YAW][NAV_YAW] = sigma * sigma / alignPower;
+        headingAligned = true;
+      }
+    }
+    for (uint8_t i = 0; i < 2; i++) {
+      alignLastRate[i] = rate[i];
+      alignLastRise[i] = rise[i];
+    }
+  }
+  for (uint8_t i = 0; i < 2; i++) {
+    alignLastFix[i] = fix[i];
+    alignArea[i] = 0;
+    alignMoment[i] = 0;
+  }
+  alignSpan = 0;
+  if (alignFixes < 2) {
+    alignFixes++;
+  }
+}
+
+// Scalar update of one directly measured state, with the error folded
+// straight back into the nominal state
+bool NavigationFilter::update(uint8_t state, float measurement, float variance) {
+  float innovation = measurement - x[state];
+  float s = P[state][state] + variance;
+  if (innovation * innovation > NAV_GATE_SIGMA * NAV_GATE_SIGMA * s) {
+    rejectedTotal++;
+    return false;
+  }
+
+  float gain[NAV_STATES];
+  float row[NAV_STATES];
+  for (uint8_t i = 0; i < NAV_STATES; i++) {
+    gain[i] = P[i][state] / s;
+    row[i] = P[state][i];
+  }
+  for (uint8_t i = 0; i < NAV_STATES; i++) {
+    x[i] += gain[i] * innovation;
+    for (uint8_t k = 0; k < NAV_STATES; k++) {
+      P[i][k] -= gain[i] * row[k];
+    }
+  }
+  if (x[NAV_YAW] > (float)M_PI) {
+    x[NAV_YAW] -= 2.0f * (float)M_PI;
+  } else if (x[NAV_YAW] < -(float)M_PI) {
+    x[NAV_YAW] += 2.0f * (float)M_PI;
+  }
+  return true;
+}
+
+bool NavigationFilter::correctGps(int32_t latitude, int32_t longitude, float altitude) {
+  if (!initialized) {
+    reset(latitude, longitude, altitude);
+    return true;
+  }
+
+  // Offsets from the origin are exact in integers before scaling
+  float east = (float)(longitude - refLongitude) * metersPerUnitLon;
+  float north = (float)(latitude - refLatitude) * metersPerUnitLat;
+  if (!headingAligned) {
+    alignHeading(east, north);
+  }
+  bool accepted = update(NAV_E, east, NAV_GPS_H_NOISE * NAV_GPS_H_NOISE);
+  accepted = update(NAV_N, north, NAV_GPS_H_NOISE * NAV_GPS_H_NOISE) && accepted;
+  update(NAV_U, altitude - refAltitude, NAV_GPS_V_NOISE * NAV_GPS_V_NOISE);
+
+  // A filter that keeps disagreeing with the receiver has lost track
+  if (!accepted && ++consecutiveRejects >= NAV_MAX_REJECTS) {
+    restartHorizontal(east, north);
+    return false;
+  }
+  if (accepted) {
+    consecutiveRejects = 0;
+  }
+  return accepted;
+}
+
+bool NavigationFilter::correctBaro(float baroAltitude) {
+  if (!initialized) {
+    return false;
+  }
+  if (!haveBaroZero) {
+    baroZero = baroAltitude - x[NAV_U];
+    haveBaroZero = true;
+    return true;
+  }
+  return update(NAV_U, baroAltitude - baroZero, NAV_BARO_NOISE * NAV_BARO_NOISE);
+}
+
+void NavigationFilter::getPosition(int32_t& latitude, int32_t& longitude, float& altitude) const {
+  latitude = refLatitude + (int32_t)lroundf(x[NAV_N] / metersPerUnitLat);
+  longitude = refLongitude + (int32_t)lroundf(x[NAV_E] / metersPerUnitLon);
+  altitude = refAltitude + x[NAV_U];
+}
@@ -1,4 +1,5 @@
 #include "pressure_sensor.h"
+#include "esp_timer.h"
 #include <math.h>
 
 PressureSensor::PressureSensor() : initialized(false), seaLevelPressure(1013.25) {
@@ -7,7 +8,7 @@ PressureSensor::PressureSensor() : initialized(false), seaLevelPressure(1013.25)
 PressureSensor::~PressureSensor() {
 }
 
-void PressureSensor::initialize() {
+void PressureSensor::initialize(bool warmStart) {
   Serial.println("Initializing pressure sensor...");
   
   // Initialize I2C
@@ -15,7 +16,9 @@ void PressureSensor::initialize() {
   Wire.setClock(I2C_FREQUENCY);
   
   // Wait for sensor to stabilize
-  delay(100);
+  if (!warmStart) {
+    delay(100);
+  }
   
   const int maxRetries = 3;
   bool success = false;
@@ -47,14 +50,14 @@ void PressureSensor::initialize() {
   }
 }
 
-bool PressureSensor::readData(float& pressure, float& altitude) {
+bool PressureSensor::readData(float& pressure, float& altitude, int64_t& sampleUs) {
   if (!initialized) {
     return false;
   }
   
   uint32_t rawPressure, rawTemperature;
   
-  if (!readRawData(rawPressure, rawTemperature)) {
+  if (!readRawData(rawPressure, rawTemperature, sampleUs)) {
     return false;
   }
   
@@ -73,8 +76,9 @@ bool PressureSensor::isValid() {
   return initialized;
 }
 
-bool PressureSensor::readRawData(uint32_t& pressure, uint32_t& temperature) {
-  // Start conversion
+bool PressureSensor::readRawData(uint32_t& pressure, uint32_t& temperature, int64_t& sampleUs) {
+  // Start conversion; the sample is taken from this command on
+  sampleUs = esp_timer_get_time();
   Wire.beginTransmission(MPRLS_I2C_ADDR);
   Wire.write(0xAA);  // Start conversion command
   Wire.write(0x00);
@@ -130,9 +134,11 @@ float PressureSensor::calculateAltitude(float pressure) {
   // where P0 is sea level pressure and P is measured pressure
   
   if (pressure <= 0) {
-    return 0.0;
+    return 0.0f;
   }
   
-  float altitude = 44330.0 * (1.0 - pow(pressure / seaLevelPressure, 0.1903));
+  // Single-precision powf: pow() promotes to double, which the ESP32-S3 FPU
+  // can't do in hardware
+  float altitude = 44330.0f * (1.0f - powf(pressure / seaLevelPressure, 0.1903f));
   return altitude;
 }
@@ -1,6 +1,6 @@
 #include "radio_module.h"
 
-RadioModule::RadioModule() : initialized(false), highPowerMode(false), lastRSSIQuery(0), cachedRSSI(-999) {
+RadioModule::RadioModule() : initialized(false), highPowerMode(false), lastRSSIQuery(0), cachedRSSI(-999), rxLength(0), rxDiscarding(false), telemetrySeq(0) {
   radioSerial = new HardwareSerial(2);
   void sendATCommand(String command, bool waitResponse);
 }
@@ -9,14 +9,16 @@ RadioModule::~RadioModule() {
   delete radioSerial;
 }
 
-void RadioModule::initialize() {
+void RadioModule::initialize(bool warmStart) {
   Serial.println("Initializing radio module...");
   
   // Initialize radio serial communication
   radioSerial->begin(RADIO_BAUD_RATE, SERIAL_8N1, RADIO_SERIAL_RX_PIN, RADIO_SERIAL_TX_PIN);
   
   // Brief delay for serial to stabilize
-  delay(100);
+  if (!warmStart) {
+    delay(100);
+  }
   
   // Clear any existing data in the buffer
   while (radioSerial->available()) {
@@ -27,7 +29,9 @@ void RadioModule::initialize() {
     initialized = true;
     Serial.println("Radio module initialized (transparent mode)");  
   // Try to exit AT command mode
-  delay(100);
+  if (!warmStart) {
+    delay(100);
+  }
 }
 
 void RadioModule::setHighPower() {
@@ -153,26 +157,21 @@ void RadioModule::setLowPower() {
 void RadioModule::sendTelemetry(const TelemetryData& data) {
   if (!initialized) return;
   
-  // Use pre-allocated buffer with sprintf for much faster performance
-  // This replaces 30+ string concatenations with a single sprintf call
-  static char packet[512]; // Pre-allocated buffer
+  // Pre-allocated buffer; the TELEM layout lives in TelemetryCodec so the
+  // ground tools parse exactly what is sent here
+  static char packet[TELEM_LINE_MAX_LENGTH];
+  
+  TelemetryFrameInfo info;
+  info.seq = telemetrySeq++;
+  info.enqueueMs = millis();
   
-  snprintf(packet, sizeof(packet),
-    "TELEM,%lu,%d,%.6f,%.6f,%.2f,%.2f,%.2f,%d,%d,"
-    "%.3f,%.3f,%.3f,%.2f,%.2f,%.2f,%.1f,%.1f,%.1f,%.1f,%d,"
-    "%.3f,%.2f,%.2f,%d,%d\n",
-    data.timestamp, data.mode, 
-    data.latitude, data.longitude, data.altitude_gps, data.altitude_pressure, data.pressure,
-    data.gps_valid ? 1 : 0, data.pressure_valid ? 1 : 0,
-    data.accel_x, data.accel_y, data.accel_z,
-    data.gyro_x, data.gyro_y, data.gyro_z,
-    data.mag_x, data.mag_y, data.mag_z, data.imu_temperature,
-    data.imu_valid ? 1 : 0,
-    data.bus_voltage, data.current, data.power,
-    data.power_valid ? 1 : 0, data.rssi
-  );
+  size_t len = TelemetryCodec::formatLine(packet, sizeof(packet), data, info);
+  if (len == 0) {
+    Serial.println("Telemetry frame too long, dropped");
+    return;
+  }
   
-  radioSerial->print(packet);
+  transmitLine(packet, len);
   
   // Debug output (commented for performance)
   // Serial.print("Sent telemetry: ");
@@ -182,17 +181,28 @@ void RadioModule::sendTelemetry(const TelemetryData& data) {
 String RadioModule::receiveCommand() {
   if (!initialized) return "";
   
-  String command = "";
-  
+  // Bytes are accumulated across calls so a command split over two polls
+  // is not lost; one complete line is returned per call
   while (radioSerial->available()) {
     char c = radioSerial->read();
     if (c == '\n' || c == '\r') {
-      if (command.length() > 0) {
+      rxDiscarding = false;
+      if (rxLength > 0) {
+        String command = String(rxLine);
+        rxLength = 0;
         command.trim();
         return command;
       }
+    } else if (rxDiscarding) {
+      continue;
+    } else if (rxLength < sizeof(rxLine) - 1) {
+      rxLine[rxLength++] = c;
+      rxLine[rxLength] = '\0';
     } else {
-      command += c;
+      // Overlong line cannot be a valid command; drop it up to the newline
+      // so its tail is not handed on as a corrupt frame
+      rxLength = 0;
+      rxDiscarding = true;
     }
   }
   
@@ -265,10 +275,31 @@ void RadioModule::sendATCommand(String command, bool addTerminator) {
     radioSerial->print("\r\n");
   }
 }
+
+void RadioModule::transmitLine(const char* line, size_t len) {
+#if RADIO_FEC_ENABLED
+  // Reed-Solomon frame around the line; the payload stays readable as ASCII
+  static uint8_t frame[FEC_MAX_FRAME_SIZE];
+  size_t frameLen = FecCodec::encodeFrame((const uint8_t*)line, len, frame, sizeof(frame));
+  if (frameLen > 0) {
+    radioSerial->write(frame, frameLen);
+    return;
+  }
+#endif
+  radioSerial->write((const uint8_t*)line, len);
+}
+
 // In RadioModule implementation
 void RadioModule::sendAcknowledgment(String message) {
-    sendATCommand(message);
+  message += "\n";
+  sendLine(message.c_str());
 }
+
+void RadioModule::sendLine(const char* line) {
+  if (!initialized) return;
+  transmitLine(line, strlen(line));
+}
+
 String RadioModule::readATResponse(unsigned long timeout) {
   String response = "";
   unsigned long startTime = millis();
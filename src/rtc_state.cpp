@@ -0,0 +1,45 @@
+#include "rtc_state.h"
+#include <Arduino.h>
+#include <stddef.h>
+#include <string.h>
+#include "esp_system.h"
+#include "checksum.h"
+
+struct RtcFlightRecord {
+  uint32_t magic;
+  FlightResumeState state;
+  uint32_t crc;               // CRC32 of magic and state
+};
+
+// Not zeroed at boot, so it outlives any reset that keeps the RTC powered
+RTC_NOINIT_ATTR static RtcFlightRecord rtcRecord;
+
+static uint32_t recordCrc(const RtcFlightRecord& record) {
+  return crc32((const uint8_t*)&record, offsetof(RtcFlightRecord, crc));
+}
+
+bool resetWasCrash() {
+  esp_reset_reason_t reason = esp_reset_reason();
+  return reason == ESP_RST_BROWNOUT || reason == ESP_RST_PANIC ||
+         reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT ||
+         reason == ESP_RST_WDT;
+}
+
+bool loadFlightResumeState(FlightResumeState& state) {
+  if (!resetWasCrash() || rtcRecord.magic != RTC_STATE_MAGIC || rtcRecord.crc != recordCrc(rtcRecord)) {
+    clearFlightResumeState();
+    return false;
+  }
+  state = rtcRecord.state;
+  return true;
+}
+
+void saveFlightResumeState(const FlightResumeState& state) {
+  rtcRecord.magic = RTC_STATE_MAGIC;
+  rtcRecord.state = state;
+  rtcRecord.crc = recordCrc(rtcRecord);
+}
+
+void clearFlightResumeState() {
+  memset(&rtcRecord, 0, sizeof(rtcRecord));
+}
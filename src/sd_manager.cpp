@@ -1,4 +1,24 @@
 #include "sd_manager.h"
+#include "esp_timer.h"
+#include "rtc_state.h"
+#include "esp_partition.h"
+#include "checksum.h"
+
+portMUX_TYPE SDManager::spaceMux = portMUX_INITIALIZER_UNLOCKED;
+portMUX_TYPE SDManager::utcMux = portMUX_INITIALIZER_UNLOCKED;
+
+static const uint32_t spiSpeeds[] = SD_SPI_SPEEDS;
+static const uint8_t spiSpeedCount = sizeof(spiSpeeds) / sizeof(spiSpeeds[0]);
+
+// Position of SD_SPI_SPEED in the ladder, where every card starts
+static uint8_t mountSpeedIndex() {
+  for (uint8_t i = 0; i < spiSpeedCount; i++) {
+    if (spiSpeeds[i] == SD_SPI_SPEED) {
+      return i;
+    }
+  }
+  return 0;
+}
 
 SDManager::SDManager() : 
   sdInitialized(false),
@@ -9,37 +29,103 @@ SDManager::SDManager() :
   lastCardHealthCheck(0),
   lastRetryAttempt(0),
   consecutiveFailures(0),
-  bothCardsFailed(false) {
-  
-  // Initialize current batch
-  memset(&currentBatch, 0, sizeof(DataBatch));
-  currentBatch.batchStartTime = millis();
+  bothCardsFailed(false),
+  logCreatedUs(0),
+  logNamedByUtc(false),
+  renamePending(false),
+  keyframeDue(true),
+  lastKeyframeTime(0),
+  keyframeMode(MODE_SLEEP),
+  keyframePhase(PHASE_PAD),
+  keyframeTimeSource(0),
+  nextBlockSeq(0),
+  blockTorn(false),
+  blackBoxMutex(NULL),
+  blackBoxBlockSeq(0),
+  lastBlackBoxErase(0),
+  inFlight(false),
+  lastEntrySave(0),
+  indexedLogs(0),
+  indexedBytes(0),
+  cardTotalBytes(0),
+  cardUsedBytes(0),
+  spaceKnown(false),
+  lastSpaceReconcile(0),
+  writeBenchPending(false),
+  slowCard(SD_NONE),
+  startDeferred(false),
+  fillBatch(&batches[0]),
+  writeBatch(&batches[1]),
+  batchMutex(NULL),
+  flushRequested(false),
+  droppedRecords(0),
+  sideLogQueue(NULL) {
+  
+  // Initialize both batches
+  memset(batches, 0, sizeof(batches));
+  vibHeader[0] = '\0';
+  fillBatch->batchStartTime = millis();
+  memset(&utcMapping, 0, sizeof(UtcMapping));
+  memset(&derivedLogged, 0, sizeof(SdDerivedState));
+  beginLogIndexEntry(currentEntry, "");
+  cardSpeed[SD_PRIMARY] = mountSpeedIndex();
+  cardSpeed[SD_BACKUP] = mountSpeedIndex();
+  cardSizes[SD_PRIMARY] = 0;
+  cardSizes[SD_BACKUP] = 0;
+  speedTested[SD_PRIMARY] = false;
+  speedTested[SD_BACKUP] = false;
 }
 
 SDManager::~SDManager() {
   if (sdInitialized) {
-    flushCurrentBatch();
+    flushRequested = true;
+    writePendingData();
     SD.end();
   }
 }
 
 bool SDManager::initialize() {
   Serial.println("Initializing dual SD card manager...");
+  if (batchMutex == NULL) {
+    batchMutex = xSemaphoreCreateMutex();
+  }
+  if (sideLogQueue == NULL) {
+    sideLogQueue = xQueueCreate(SD_SIDE_LOG_QUEUE_LENGTH, sizeof(SideLogLine));
+  }
+  
+  // After a crash in flight the sensors come first: scanning the black
+  // box and loading the log index wait for the background task. Records
+  // queue in RAM until then.
+  startDeferred = inFlight && resetWasCrash();
+  
+  // The black box first: it takes the records if no card comes up
+  if (!startDeferred) {
+    beginBlackBox();
+  }
   
   // Configure SPI pins
   SPI.begin(SD_SCK_PIN, SD_MISO_PIN, SD_MOSI_PIN, SD_CS_PIN);
   
   // Try to initialize SD card system
   if (initializeSD()) {
-    // Success! Create log file
-    if (createLogFile()) {
+    // Success! Pick up the previous log after a crash, or start a new one
+    if (!startDeferred) {
+      loadLogIndex();
+    }
+    bool resumed = recoverLastLog();
+    if (resumed || createLogFile()) {
+      // Not while a resumed flight is logging
+      if (!resumed) {
+        deleteOldFiles();
+        reconcileSpace();
+      }
       Serial.print("SD card system initialized. Active card: ");
       Serial.print(getCardSlotName(activeCard));
       Serial.print(", Log file: ");
       Serial.println(currentLogFile);
       Serial.print("Available space: ");
-      Serial.print(getAvailableSpace() / 1024);
-      Serial.println(" KB");
+      Serial.print((unsigned long)(getAvailableSpace() / 1024));
+      Serial.println(spaceKnown ? " KB" : " KB (counted after the flight)");
       return true;
     } else {
       Serial.println("Failed to create log file");
@@ -58,7 +144,7 @@ bool SDManager::initialize() {
 
 bool SDManager::initializeSD() {
   // Try to initialize primary card first
-  if (tryInitializeCard(SD_PRIMARY)) {
+  if (tryInitializeCard(SD_PRIMARY, true)) {
     activeCard = SD_PRIMARY;
     primaryCardPresent = true;
     sdInitialized = true;
@@ -69,7 +155,7 @@ bool SDManager::initializeSD() {
   }
   
   // If primary fails, try backup card
-  if (tryInitializeCard(SD_BACKUP)) {
+  if (tryInitializeCard(SD_BACKUP, true)) {
     activeCard = SD_BACKUP;
     backupCardPresent = true;
     sdInitialized = true;
@@ -87,7 +173,7 @@ bool SDManager::initializeSD() {
   return false;
 }
 
-bool SDManager::tryInitializeCard(SDCardSlot slot) {
+bool SDManager::tryInitializeCard(SDCardSlot slot, bool negotiate) {
   int csPin = (slot == SD_PRIMARY) ? SD_CS_PIN : SD_CS_BACKUP_PIN;
   
   Serial.print("Trying to initialize ");
@@ -95,58 +181,224 @@ bool SDManager::tryInitializeCard(SDCardSlot slot) {
   Serial.print(" SD card on pin ");
   Serial.println(csPin);
   
-  // Try to initialize with high speed
-  if (SD.begin(csPin, SPI, SD_SPI_SPEED)) {
+  // The clock this slot last ran at, lowered or not; a new card goes back
+  // to the safe speed below
+  if (!mountCard(slot)) {
     Serial.print(getCardSlotName(slot));
-    Serial.println(" SD card initialized at full speed");
-    
-    // Print card information
-    uint64_t cardSize = SD.cardSize() / (1024 * 1024);
-    Serial.print("SD card size: ");
-    Serial.print(cardSize);
-    Serial.println(" MB");
-    return true;
+    Serial.println(" SD card initialization failed");
+    return false;
   }
   
-  // Try with slower speed
-  if (SD.begin(csPin, SPI, 1000000)) {
-    Serial.print(getCardSlotName(slot));
-    Serial.println(" SD card initialized at reduced speed");
+  Serial.print(getCardSlotName(slot));
+  Serial.print(" SD card initialized at ");
+  Serial.print(spiSpeeds[cardSpeed[slot]] / 1000000);
+  Serial.println(" MHz");
+  
+  // Print card information
+  uint64_t cardSize = SD.cardSize();
+  Serial.print("SD card size: ");
+  Serial.print((unsigned long)(cardSize / (1024 * 1024)));
+  Serial.println(" MB");
+  
+  // Another card in the slot: its clock starts over from the safe speed
+  if (cardSize != cardSizes[slot]) {
+    if (cardSizes[slot] != 0) {
+      Serial.print(getCardSlotName(slot));
+      Serial.println(" card changed, clock back to the mount speed");
+    }
+    cardSizes[slot] = cardSize;
+    speedTested[slot] = false;
+    if (cardSpeed[slot] != mountSpeedIndex()) {
+      SD.end();
+      cardSpeed[slot] = mountSpeedIndex();
+      if (!mountCard(slot)) {
+        return false;
+      }
+    }
+  }
+  
+  // Once per card, and not in flight: the test holds the card for up to
+  // a second
+  if (negotiate && !inFlight && !speedTested[slot]) {
+    negotiateCardSpeed(slot);
+    speedTested[slot] = true;
+  }
+  return true;
+}
+
+bool SDManager::mountCard(SDCardSlot slot) {
+  int csPin = (slot == SD_PRIMARY) ? SD_CS_PIN : SD_CS_BACKUP_PIN;
+  if (SD.begin(csPin, SPI, spiSpeeds[cardSpeed[slot]])) {
     return true;
   }
   
-  Serial.print(getCardSlotName(slot));
-  Serial.println(" SD card initialization failed");
+  // Down a rung at a time; the card stays at the fastest that mounts
+  for (int i = cardSpeed[slot] - 1; i >= 0; i--) {
+    SD.end();
+    if (SD.begin(csPin, SPI, spiSpeeds[i])) {
+      cardSpeed[slot] = (uint8_t)i;
+      return true;
+    }
+  }
   return false;
 }
 
-bool SDManager::switchToBackupCard() {
-  if (!backupCardPresent && !tryInitializeCard(SD_BACKUP)) {
-    Serial.println("Backup SD card not available for switch");
+bool SDManager::speedTestPasses(unsigned long& writeUs, unsigned long& readUs) {
+  // A pattern that differs in every sector, so a shifted or repeated
+  // sector doesn't read back right
+  static uint8_t chunk[SD_SECTOR_SIZE];
+  uint32_t seed = 0x9E3779B9;
+  uint32_t writtenCrc = 0;
+  bool ok = true;
+  
+  unsigned long start = micros();
+  File file = SD.open(SD_SPEED_TEST_FILE, FILE_WRITE);
+  if (!file) {
+    return false;
+  }
+  for (uint32_t offset = 0; ok && offset < SD_SPEED_TEST_BYTES; offset += sizeof(chunk)) {
+    for (size_t i = 0; i < sizeof(chunk); i += 4) {
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      memcpy(chunk + i, &seed, 4);
+    }
+    writtenCrc = crc32(chunk, sizeof(chunk), writtenCrc);
+    ok = file.write(chunk, sizeof(chunk)) == sizeof(chunk);
+  }
+  file.close();
+  writeUs = micros() - start;
+  
+  // Read back after closing, so it comes from the card and not a buffer
+  start = micros();
+  uint32_t readCrc = 0;
+  file = SD.open(SD_SPEED_TEST_FILE, FILE_READ);
+  ok = ok && file && file.size() == SD_SPEED_TEST_BYTES;
+  for (uint32_t offset = 0; ok && offset < SD_SPEED_TEST_BYTES; offset += sizeof(chunk)) {
+    ok = file.read(chunk, sizeof(chunk)) == sizeof(chunk);
+    readCrc = crc32(chunk, sizeof(chunk), readCrc);
+  }
+  if (file) {
+    file.close();
+  }
+  readUs = micros() - start;
+  SD.remove(SD_SPEED_TEST_FILE);
+  return ok && readCrc == writtenCrc;
+}
+
+void SDManager::negotiateCardSpeed(SDCardSlot slot) {
+  int csPin = (slot == SD_PRIMARY) ? SD_CS_PIN : SD_CS_BACKUP_PIN;
+  uint8_t first = cardSpeed[slot];
+  uint8_t best = first;
+  uint8_t mounted = first;
+  
+  // Up the ladder while the scratch file reads back intact; the first
+  // speed that fails ends it
+  Serial.print("SD clock self-test, ");
+  Serial.print(getCardSlotName(slot));
+  Serial.println(" card:");
+  for (uint8_t i = first; i < spiSpeedCount; i++) {
+    if (i != mounted) {
+      SD.end();
+      mounted = i;
+      if (!SD.begin(csPin, SPI, spiSpeeds[i])) {
+        Serial.print("  ");
+        Serial.print(spiSpeeds[i] / 1000000);
+        Serial.println(" MHz: no response");
+        break;
+      }
+    }
+    unsigned long writeUs, readUs;
+    bool passed = speedTestPasses(writeUs, readUs);
+    Serial.print("  ");
+    Serial.print(spiSpeeds[i] / 1000000);
+    Serial.print(" MHz: ");
+    if (!passed) {
+      Serial.println("read-back failed");
+      break;
+    }
+    Serial.print(SD_SPEED_TEST_BYTES * 1000UL / (writeUs > 0 ? writeUs : 1));
+    Serial.print(" KB/s write, ");
+    Serial.print(SD_SPEED_TEST_BYTES * 1000UL / (readUs > 0 ? readUs : 1));
+    Serial.println(" KB/s read");
+    best = i;
+  }
+  
+  cardSpeed[slot] = best;
+  if (mounted != best) {
+    SD.end();
+    if (!mountCard(slot)) {
+      Serial.println("SD clock self-test: card lost after the test");
+      return;
+    }
+  }
+  Serial.print("SD clock for ");
+  Serial.print(getCardSlotName(slot));
+  Serial.print(" card: ");
+  Serial.print(spiSpeeds[cardSpeed[slot]] / 1000000);
+  Serial.println(" MHz");
+}
+
+bool SDManager::lowerCardSpeed(SDCardSlot slot) {
+  if (slot == SD_NONE || cardSpeed[slot] == 0) {
     return false;
   }
+  cardSpeed[slot]--;
+  Serial.print("SD: errors on ");
+  Serial.print(getCardSlotName(slot));
+  Serial.print(" card, clock down to ");
+  Serial.print(spiSpeeds[cardSpeed[slot]] / 1000000);
+  Serial.println(" MHz");
   
-  // Flush any pending data on current card
-  if (currentBatch.count > 0) {
-    flushCurrentBatch();
+  // Takes effect now if it's the mounted card
+  if (slot == activeCard) {
+    SD.end();
+    return mountCard(slot);
+  }
+  return true;
+}
+
+void SDManager::noteWriteError() {
+  if (activeCard == SD_NONE) {
+    return;
+  }
+  // Out of space: the card is fine, the clock won't help
+  if (spaceKnown && getAvailableSpace() < SD_FULL_MARGIN) {
+    return;
+  }
+  // Pulled, or the log is gone: nothing to do with the clock either
+  if (currentLogFile.length() == 0 || !SD.exists(currentLogFile)) {
+    return;
+  }
+  // The card answers and has room, so the write failed on the bus: CRC
+  // errors or timeouts. The remount is left to update().
+  slowCard = activeCard;
+}
+
+uint32_t SDManager::getCardSpeed(SDCardSlot slot) const {
+  return slot == SD_NONE ? 0 : spiSpeeds[cardSpeed[slot]];
+}
+
+bool SDManager::switchToBackupCard() {
+  if (!backupCardPresent && !tryInitializeCard(SD_BACKUP, false)) {
+    Serial.println("Backup SD card not available for switch");
+    return false;
   }
   
   // End current SD connection
   SD.end();
   
   // Reinitialize SD library with backup card's CS pin
-  if (!SD.begin(SD_CS_BACKUP_PIN, SPI, SD_SPI_SPEED)) {
+  if (!mountCard(SD_BACKUP)) {
     Serial.println("Failed to reinitialize SD library for backup card");
-    // Try with slower speed
-    if (!SD.begin(SD_CS_BACKUP_PIN, SPI, 1000000)) {
-      Serial.println("Failed to reinitialize SD library for backup card even at reduced speed");
-      return false;
-    }
+    return false;
   }
   
   // Switch to backup card
   activeCard = SD_BACKUP;
   backupCardPresent = true;
+  loadLogIndex();
+  spaceKnown = false;
   
   // Create new log file on backup card
   if (!createLogFile()) {
@@ -159,21 +411,41 @@ bool SDManager::switchToBackupCard() {
 }
 
 bool SDManager::createLogFile() {
-  currentLogFile = generateFileName();
+  // Whatever log this card was writing last goes into its index first
+  closeLastLog();
+  UtcMapping mapping = getUtcMapping();
+  currentLogFile = generateFileName(mapping);
+  beginLogIndexEntry(currentEntry, currentLogFile.c_str());
+  logCreatedUs = esp_timer_get_time();
+  logNamedByUtc = mapping.valid;
+  keyframeDue = true;
+  blackBoxBlockSeq = 0;
   
   // Create the file and write header
-  File file = SD.open(currentLogFile, FILE_WRITE);
-  if (!file) {
+  File file;
+  if (!openStagedLog(stagedLog, file, currentLogFile, true)) {
     Serial.print("Failed to create log file: ");
     Serial.println(currentLogFile);
     return false;
   }
   
-  // Write CSV header
-  file.println("timestamp,mode,lat,lon,alt_gps,alt_press,pressure,gps_valid,press_valid,rssi,"
-               "accel_x,accel_y,accel_z,gyro_x,gyro_y,gyro_z,mag_x,mag_y,mag_z,imu_temp,imu_valid,"
-               "voltage,current,power,power_valid");
-  file.close();
+  // Column lists of the record types (sd_record.h) as block 0
+  blockWriter.begin(0);
+  bool written = true;
+  for (uint8_t i = 0; sdRecordHeaderLine(i) != NULL; i++) {
+    written = writeBlockLine(stagedLog.writer, blockWriter, sdRecordHeaderLine(i),
+                             strlen(sdRecordHeaderLine(i))) && written;
+  }
+  written = finishBlock(stagedLog.writer, blockWriter) && written;
+  written = closeStagedLog(stagedLog, file, written) && written;
+  nextBlockSeq = 1;
+  blockTorn = false;
+  if (!written) {
+    Serial.print("Failed to write log header: ");
+    Serial.println(currentLogFile);
+    return false;
+  }
+  rememberCurrentLog();
   
   Serial.print("Created log file: ");
   Serial.println(currentLogFile);
@@ -181,67 +453,178 @@ bool SDManager::createLogFile() {
   return true;
 }
 
-String SDManager::generateFileName() {
-  // Generate filename based on current time
+String SDManager::generateFileName(const UtcMapping& mapping) {
+  // UTC from the GPS once it's known, otherwise time since boot
+  char filename[48];
+  char stamp[UTC_STAMP_LENGTH];
+  int64_t utcMs = utcMsFromLocal(mapping, esp_timer_get_time());
+  if (utcMs > 0 && formatUtcStamp(stamp, sizeof(stamp), utcMs) > 0) {
+    snprintf(filename, sizeof(filename), "/flight_%s.csv", stamp);
+    if (SD.exists(filename)) {
+      // A second log in the same second (card switch): keep both
+      snprintf(filename, sizeof(filename), "/flight_%s_%lu.csv", stamp, millis());
+    }
+    return String(filename);
+  }
+  
   unsigned long timestamp = millis();
-  char filename[32];
   snprintf(filename, sizeof(filename), "/flight_%08lu.csv", timestamp);
   return String(filename);
 }
 
-bool SDManager::addData(const TelemetryData& data) {
+void SDManager::setUtcMapping(const UtcMapping& mapping) {
+  // Called from the sensor task: no card I/O here
+  portENTER_CRITICAL(&utcMux);
+  bool firstSync = mapping.valid && !utcMapping.valid;
+  utcMapping = mapping;
+  portEXIT_CRITICAL(&utcMux);
+  if (firstSync) {
+    renamePending = true;
+  }
+}
+
+UtcMapping SDManager::getUtcMapping() const {
+  portENTER_CRITICAL(&utcMux);
+  UtcMapping mapping = utcMapping;
+  portEXIT_CRITICAL(&utcMux);
+  return mapping;
+}
+
+bool SDManager::renameLogForUtc() {
+  if (!sdInitialized || activeCard == SD_NONE || currentLogFile.length() == 0) {
+    return false;
+  }
+  
+  // Named for when it was created, on the clock we have now
+  char stamp[UTC_STAMP_LENGTH];
+  if (formatUtcStamp(stamp, sizeof(stamp), utcMsFromLocal(getUtcMapping(), logCreatedUs)) == 0) {
+    return false;
+  }
+  logNamedByUtc = true;
+  String oldFile = currentLogFile;
+  String newFile = String("/flight_") + stamp + ".csv";
+  if (SD.exists(newFile) || !SD.rename(oldFile, newFile)) {
+    Serial.print("Keeping log name ");
+    Serial.println(oldFile);
+    return false;
+  }
+  currentLogFile = newFile;
+  strncpy(currentEntry.name, newFile.c_str(), sizeof(currentEntry.name) - 1);
+  rememberCurrentLog();
+  
+  // The side logs follow the main log's name
+  for (uint8_t i = 0; i < LOG_SIDE_COUNT; i++) {
+    String oldSide = oldFile;
+    String newSide = newFile;
+    oldSide.replace(".csv", logSideSuffix(i));
+    newSide.replace(".csv", logSideSuffix(i));
+    if (SD.exists(oldSide)) {
+      SD.rename(oldSide, newSide);
+    }
+  }
+  
+  Serial.print("Log file renamed for UTC: ");
+  Serial.println(currentLogFile);
+  return true;
+}
+
+bool SDManager::addData(const TelemetryData& data, uint8_t groups) {
   // Always try to add data to batch, even if cards are currently failed
   // This way when cards come back online, we don't lose the most recent data
   
-  // Add data to current batch
-  if (currentBatch.count < SD_BATCH_SIZE) {
-    currentBatch.data[currentBatch.count] = data;
-    currentBatch.count++;
-    
-    // If we have a working card and batch is full, write it
-    if (sdInitialized && activeCard != SD_NONE && currentBatch.count >= SD_BATCH_SIZE) {
-      if (!flushCurrentBatch()) {
-        // Handle card failure
-        handleCardFailure();
-        // Even if card failed, we still successfully added data to batch
-        return true;
-      } else {
-        consecutiveFailures = 0; // Reset failure count on success
-      }
-    }
-    
-    return true;
+  // Mode, phase and time source are only in keyframes, so a change in
+  // any of them needs one; otherwise one per SD_KEYFRAME_INTERVAL
+  if (data.mode != keyframeMode || data.flight_phase != keyframePhase ||
+      data.time_source != keyframeTimeSource ||
+      data.timestamp - lastKeyframeTime >= SD_KEYFRAME_INTERVAL) {
+    groups |= SD_GROUP_KEYFRAME;
+  }
+  if (groups & SD_GROUP_KEYFRAME) {
+    lastKeyframeTime = data.timestamp;
+    keyframeMode = data.mode;
+    keyframePhase = data.flight_phase;
+    keyframeTimeSource = data.time_source;
   }
+  groups = sdDerivedGroups(data, groups, derivedLogged);
   
-  // Batch is full but we can't write it - this shouldn't normally happen
-  // but if it does, try to flush and then add the new data
-  if (sdInitialized && activeCard != SD_NONE) {
-    flushCurrentBatch();
-  } else {
-    // No working cards - overwrite oldest data in batch to keep most recent
-    Serial.println("SD: No working cards, overwriting oldest data in batch");
-    memmove(&currentBatch.data[0], &currentBatch.data[1], 
-           (SD_BATCH_SIZE - 1) * sizeof(TelemetryData));
-    currentBatch.data[SD_BATCH_SIZE - 1] = data;
-    return true;
+  // Only a copy into RAM here: the sensor task must never wait on the
+  // card. The background task writes the batch (writePendingData).
+  if (batchMutex == NULL || xSemaphoreTake(batchMutex, pdMS_TO_TICKS(5)) != pdTRUE) {
+    droppedRecords++;
+    return false;
   }
   
-  // Try to add the data again after flush
-  if (currentBatch.count < SD_BATCH_SIZE) {
-    currentBatch.data[currentBatch.count] = data;
-    currentBatch.count++;
+  // No working card: straight into the black box, one flash program per
+  // record, so a reset loses nothing that was logged
+  if ((!sdInitialized || activeCard == SD_NONE) && storeInBlackBox(fillBatch, &data, groups)) {
+    xSemaphoreGive(batchMutex);
     return true;
   }
   
-  return false;
+  if (fillBatch->count < SD_BATCH_CAPACITY) {
+    int index = (fillBatch->start + fillBatch->count) % SD_BATCH_CAPACITY;
+    fillBatch->data[index] = data;
+    fillBatch->groups[index] = groups;
+    fillBatch->count++;
+  } else {
+    // The background task has fallen a whole batch's headroom behind, or
+    // there's no card and no black box: overwrite the oldest record in
+    // place to keep the most recent. The new oldest record becomes a
+    // keyframe so nothing in it depends on the one dropped.
+    fillBatch->data[fillBatch->start] = data;
+    fillBatch->groups[fillBatch->start] = groups;
+    fillBatch->start = (fillBatch->start + 1) % SD_BATCH_CAPACITY;
+    fillBatch->groups[fillBatch->start] |= SD_GROUP_KEYFRAME;
+    droppedRecords++;
+  }
+  xSemaphoreGive(batchMutex);
+  return true;
 }
 
-bool SDManager::flushCurrentBatch() {
-  if (!sdInitialized || activeCard == SD_NONE || currentBatch.count == 0) {
+bool SDManager::writePendingData() {
+  if (!sdInitialized || activeCard == SD_NONE || batchMutex == NULL) {
     return false;
   }
+  writeSideLogs();
+  
+  // Between batches, with the log closed: the rename for the first GPS
+  // time, unless the log was named by UTC already
+  if (renamePending) {
+    renamePending = false;
+    if (!logNamedByUtc) {
+      renameLogForUtc();
+    }
+  }
   
-  bool success = writeBatchToFile(currentBatch);
+  // Swap the batches under the lock, then write outside it while the
+  // sensor task fills the other one
+  if (xSemaphoreTake(batchMutex, pdMS_TO_TICKS(10)) != pdTRUE) {
+    return false;
+  }
+  bool due = fillBatch->count >= SD_BATCH_SIZE ||
+             (fillBatch->count > 0 && (flushRequested || millis() - fillBatch->batchStartTime >= SD_BATCH_MAX_AGE));
+  if (due) {
+    DataBatch* full = fillBatch;
+    fillBatch = writeBatch;
+    writeBatch = full;
+    memset(fillBatch, 0, sizeof(DataBatch));
+    fillBatch->batchStartTime = millis();
+  }
+  flushRequested = false;
+  xSemaphoreGive(batchMutex);
+  
+  if (!due) {
+    return false;
+  }
+  if (flushBatch(*writeBatch)) {
+    return true;
+  }
+  handleCardFailure();
+  return false;
+}
+
+bool SDManager::flushBatch(DataBatch& batch) {
+  bool success = writeBatchToFile(batch);
   
   if (success) {
     totalBatchesStored++;
@@ -251,161 +634,965 @@ bool SDManager::flushCurrentBatch() {
     Serial.print(" written to ");
     Serial.print(getCardSlotName(activeCard));
     Serial.print(" card (");
-    Serial.print(currentBatch.count);
+    Serial.print(batch.count);
     Serial.println(" records)");
   } else {
-    consecutiveFailures++;
     Serial.print("Failed to write batch to ");
     Serial.print(getCardSlotName(activeCard));
-    Serial.print(" card. Failure #");
-    Serial.println(consecutiveFailures);
+    Serial.println(" card");
+    // Keep the records rather than drop them; they come back to SD later
+    storeInBlackBox(&batch, NULL, 0);
   }
   
-  // Reset batch for next data
-  memset(&currentBatch, 0, sizeof(DataBatch));
-  currentBatch.batchStartTime = millis();
-  
+  memset(&batch, 0, sizeof(DataBatch));
   return success;
 }
 
 bool SDManager::writeBatchToFile(const DataBatch& batch) {
-  File file = SD.open(currentLogFile, FILE_APPEND);
-  if (!file) {
+  File file;
+  if (!openStagedLog(stagedLog, file, currentLogFile, false)) {
     Serial.print("Failed to open log file for writing: ");
     Serial.println(currentLogFile);
     return false;
   }
   
-  // Write all data in the batch
+  // After a failed write the file may end in a partial line; a marker
+  // closes it off so this block reads on its own
+  if (blockTorn) {
+    char marker[LOG_BLOCK_TRAILER_LENGTH];
+    size_t len = formatLogMarker(marker, sizeof(marker), 'R', nextBlockSeq);
+    if (len == 0 || !stagedLog.writer.write(marker, len)) {
+      closeStagedLog(stagedLog, file, false);
+      noteWriteError();
+      return false;
+    }
+    countUsedSpace(len);
+    blockTorn = false;
+  }
+  
+  // Write all data in the batch as one block; a new file starts with a
+  // keyframe
+  blockWriter.begin(nextBlockSeq);
+  bool written = true;
+  char line[SD_RECORD_MAX_LENGTH];
   for (int i = 0; i < batch.count; i++) {
-    String dataLine = formatTelemetryData(batch.data[i]);
-    file.println(dataLine);
+    int index = (batch.start + i) % SD_BATCH_CAPACITY;
+    uint8_t groups = batch.groups[index];
+    if (keyframeDue) {
+      groups |= SD_GROUP_KEYFRAME;
+      keyframeDue = false;
+    }
+    size_t len = formatSdRecord(line, sizeof(line), batch.data[index], groups);
+    if (len > 0) {
+      written = writeBlockLine(stagedLog.writer, blockWriter, line, len) && written;
+    }
+  }
+  written = finishBlock(stagedLog.writer, blockWriter) && written;
+  written = closeStagedLog(stagedLog, file, written) && written;
+  
+  // A block that didn't make it whole is dropped by readers; its number
+  // isn't reused so the gap shows, and the records after it need a
+  // keyframe
+  nextBlockSeq++;
+  if (!written) {
+    blockTorn = true;
+    keyframeDue = true;
+    noteWriteError();
   }
   
+  if (written) {
+    for (int i = 0; i < batch.count; i++) {
+      addLogIndexRecord(currentEntry, batch.data[(batch.start + i) % SD_BATCH_CAPACITY]);
+    }
+    if (millis() - lastEntrySave >= SD_INDEX_SAVE_INTERVAL) {
+      rememberCurrentLog();
+    }
+  }
+  return written;
+}
+
+static size_t readLogAt(void* context, uint32_t offset, uint8_t* buffer, size_t len) {
+  File* file = (File*)context;
+  if (!file->seek(offset)) {
+    return 0;
+  }
+  int got = file->read(buffer, len);
+  return got > 0 ? (size_t)got : 0;
+}
+
+static bool writeLogAt(void* context, uint32_t offset, const uint8_t* data, size_t len) {
+  File* file = (File*)context;
+  if (file->position() != offset && !file->seek(offset)) {
+    return false;
+  }
+  return file->write(data, len) == len;
+}
+
+bool SDManager::openStagedLog(StagedFile& staged, File& file, const String& path, bool create) {
+  // Not appending: writes start at the beginning of the last sector
+  file = SD.open(path, create ? FILE_WRITE : "r+");
+  if (!file) {
+    return false;
+  }
+  staged.writer.attach(writeLogAt, &file);
+  uint32_t size = (uint32_t)file.size();
+  if (path == staged.path && staged.writer.isAt(size)) {
+    return true;
+  }
+  
+  // Another file, or this one changed behind the writer: read back its
+  // partial last sector
+  uint8_t tail[SD_SECTOR_SIZE];
+  size_t tailLen = size % SD_SECTOR_SIZE;
+  if (tailLen > 0 && readLogAt(&file, size - tailLen, tail, tailLen) != tailLen) {
+    file.close();
+    return false;
+  }
+  staged.writer.begin(size, tail);
+  staged.path = path;
+  return true;
+}
+
+bool SDManager::closeStagedLog(StagedFile& staged, File& file, bool flush) {
+  bool written = flush && staged.writer.flush();
+  if (!written) {
+    // What reached the card is unknown: read it back next time
+    staged.writer.invalidate();
+  }
   file.close();
+  return written;
+}
+
+bool SDManager::writeBlockLine(SectorWriter& out, LogBlockWriter& writer, const char* line, size_t len) {
+  bool written = out.write(line, len) && out.write("\r\n", 2);
+  writer.add((const uint8_t*)line, len);
+  writer.add((const uint8_t*)"\r\n", 2);
+  if (written) {
+    countUsedSpace(len + 2);
+  }
+  return written;
+}
+
+bool SDManager::finishBlock(SectorWriter& out, const LogBlockWriter& writer) {
+  char trailer[LOG_BLOCK_TRAILER_LENGTH];
+  size_t len = writer.formatTrailer(trailer, sizeof(trailer));
+  if (len == 0 || !out.write(trailer, len)) {
+    return false;
+  }
+  countUsedSpace(len);
   return true;
 }
 
-String SDManager::formatTelemetryData(const TelemetryData& data) {
-  char buffer[512];
-  
-  snprintf(buffer, sizeof(buffer),
-    "%lu,%d,%.6f,%.6f,%.2f,%.2f,%.2f,%d,%d,%d,"
-    "%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f,%.2f,%.2f,%.2f,%d,"
-    "%.3f,%.2f,%.2f,%d",
-    data.timestamp, data.mode,
-    data.latitude, data.longitude, data.altitude_gps, data.altitude_pressure, data.pressure,
-    data.gps_valid, data.pressure_valid, data.rssi,
-    data.accel_x, data.accel_y, data.accel_z,
-    data.gyro_x, data.gyro_y, data.gyro_z,
-    data.mag_x, data.mag_y, data.mag_z, data.imu_temperature, data.imu_valid,
-    data.bus_voltage, data.current, data.power, data.power_valid
-  );
-  
-  return String(buffer);
+void SDManager::rememberCurrentLog() {
+  lastEntrySave = millis();
+  char line[LOG_INDEX_LINE_LENGTH];
+  size_t len = formatLogIndexEntry(line, sizeof(line), currentEntry);
+  File file = SD.open(SD_LAST_LOG_FILE, FILE_WRITE);
+  if (!file) {
+    return;
+  }
+  file.write((const uint8_t*)line, len);
+  file.close();
 }
 
-bool SDManager::forceSync() {
-  if (!sdInitialized || activeCard == SD_NONE) {
+bool SDManager::readLastLogEntry(LogIndexEntry& entry) {
+  File pointer = SD.open(SD_LAST_LOG_FILE, FILE_READ);
+  if (!pointer) {
+    return false;
+  }
+  String line = pointer.readString();
+  pointer.close();
+  line.trim();
+  if (!parseLogIndexEntry(line.c_str(), entry)) {
+    // Just the name, as firmware before the index wrote it
+    beginLogIndexEntry(entry, line.c_str());
+  }
+  return entry.name[0] != '\0' && SD.exists(entry.name);
+}
+
+bool SDManager::recoverLastLog() {
+  LogIndexEntry last;
+  if (!readLastLogEntry(last)) {
+    return false;
+  }
+  String lastLog = last.name;
+  
+  File file = SD.open(lastLog, FILE_READ);
+  if (!file) {
+    return false;
+  }
+  unsigned long scanStart = micros();
+  LogScanResult scan;
+  bool found = scanLogTail(readLogAt, &file, (uint32_t)file.size(), scan);
+  unsigned long scanTime = micros() - scanStart;
+  uint32_t fileSize = (uint32_t)file.size();
+  file.close();
+  
+  Serial.print("Last log ");
+  Serial.print(lastLog);
+  Serial.print(": ");
+  if (!found) {
+    Serial.println("no valid block, starting a new log");
+    return false;
+  }
+  Serial.print("block ");
+  Serial.print(scan.lastSeq);
+  Serial.print(" ends at ");
+  Serial.print(scan.validEnd);
+  Serial.print("/");
+  Serial.print(fileSize);
+  Serial.print(" bytes (scan read ");
+  Serial.print(scan.bytesRead);
+  Serial.print(" bytes in ");
+  Serial.print(scanTime);
+  Serial.println(" us)");
+  if (scan.sealed) {
+    return false;
+  }
+  
+  // A reset the firmware didn't ask for means the flight may still be
+  // going: keep writing the same file. Anything else closes it.
+  bool crashed = resetWasCrash();
+  
+  file = SD.open(lastLog, FILE_APPEND);
+  if (!file) {
     return false;
   }
+  char marker[LOG_BLOCK_TRAILER_LENGTH];
+  size_t len = formatLogMarker(marker, sizeof(marker), crashed ? 'R' : 'E',
+                               crashed ? scan.lastSeq + 1 : scan.lastSeq);
+  bool written = len > 0 && file.write((const uint8_t*)marker, len) == len;
+  file.close();
+  countUsedSpace(written ? len : 0);
   
-  // Flush current batch even if not full
-  if (currentBatch.count > 0) {
-    return flushCurrentBatch();
+  if (!crashed || !written) {
+    Serial.println(written ? "Sealed last log" : "Failed to mark last log");
+    return false;
   }
   
+  // Carry on where it stopped; the name stays as it is. Anything else is
+  // indexed when the next log is created.
+  currentLogFile = lastLog;
+  currentEntry = last;
+  nextBlockSeq = scan.lastSeq + 1;
+  blockTorn = false;
+  keyframeDue = true;
+  blackBoxBlockSeq = 0;
+  logNamedByUtc = true;
+  Serial.print("Resuming log after reset: ");
+  Serial.println(currentLogFile);
   return true;
 }
 
-bool SDManager::listLogFiles() {
-  if (!sdInitialized || activeCard == SD_NONE) {
-    return false;
+void SDManager::measureLog(LogIndexEntry& entry) {
+  entry.bytes = getFileSize(entry.name);
+  for (uint8_t i = 0; i < LOG_SIDE_COUNT; i++) {
+    String side = entry.name;
+    side.replace(".csv", logSideSuffix(i));
+    entry.sideBytes[i] = SD.exists(side) ? getFileSize(side) : 0;
+  }
+}
+
+bool SDManager::readIndexEntry(File& file, LogIndexEntry& entry) {
+  char line[LOG_INDEX_LINE_LENGTH];
+  while (file.available()) {
+    size_t len = file.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[len] = '\0';
+    if (parseLogIndexEntry(line, entry)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SDManager::loadLogIndex() {
+  indexedLogs = 0;
+  indexedBytes = 0;
+  if (!SD.exists(LOG_INDEX_FILE)) {
+    return rebuildLogIndex();
   }
   
+  // Only the totals stay in memory; listings read the file again
+  File index = SD.open(LOG_INDEX_FILE, FILE_READ);
+  if (!index) {
+    return false;
+  }
+  // A reset in closeLastLog can index a log twice, the two lines one
+  // after the other; it counts once, at its later size
+  LogIndexEntry entry;
+  char lastName[sizeof(entry.name)] = "";
+  uint32_t lastBytes = 0;
+  int duplicates = 0;
+  while (readIndexEntry(index, entry)) {
+    if (strcmp(entry.name, lastName) == 0) {
+      indexedBytes -= lastBytes < indexedBytes ? lastBytes : indexedBytes;
+      duplicates++;
+    } else {
+      indexedLogs++;
+    }
+    lastBytes = logIndexTotalBytes(entry);
+    indexedBytes += lastBytes;
+    strcpy(lastName, entry.name);
+  }
+  index.close();
+  
+  Serial.print("Log index: ");
+  Serial.print(indexedLogs);
+  Serial.print(" logs, ");
+  Serial.print((unsigned long)(indexedBytes / 1024));
+  Serial.print(" KB");
+  if (duplicates > 0) {
+    Serial.print(", ");
+    Serial.print(duplicates);
+    Serial.print(" duplicate lines");
+  }
+  Serial.println();
+  return true;
+}
+
+bool SDManager::rebuildLogIndex() {
+  // A card written before the index, or one that lost it: the one walk of
+  // the directory, in its order (creation order until files are deleted).
+  // The log named in SD_LAST_LOG_FILE is indexed when it's closed.
+  LogIndexEntry open;
+  bool haveOpen = readLastLogEntry(open);
   File root = SD.open("/");
   if (!root) {
-    Serial.println("Failed to open root directory");
     return false;
   }
+  File index = SD.open(SD_INDEX_TEMP_FILE, FILE_WRITE);
+  if (!index) {
+    root.close();
+    return false;
+  }
+  index.println(logIndexHeaderLine());
   
-  Serial.print("Log files on ");
-  Serial.print(getCardSlotName(activeCard));
-  Serial.println(" SD card:");
+  char line[LOG_INDEX_LINE_LENGTH];
   File file = root.openNextFile();
-  int fileCount = 0;
-  
   while (file) {
-    if (!file.isDirectory() && String(file.name()).endsWith(".csv")) {
-      Serial.print("  ");
-      Serial.print(file.name());
-      Serial.print(" (");
-      Serial.print(file.size());
-      Serial.println(" bytes)");
-      fileCount++;
+    String name = file.name();
+    if (!name.startsWith("/")) {
+      name = "/" + name;
+    }
+    bool isLog = !file.isDirectory() && name.endsWith(".csv") && !(haveOpen && name == open.name);
+    for (uint8_t i = 0; i < LOG_SIDE_COUNT && isLog; i++) {
+      isLog = !name.endsWith(logSideSuffix(i));
     }
     file.close();
+    if (isLog) {
+      LogIndexEntry entry;
+      beginLogIndexEntry(entry, name.c_str());
+      measureLog(entry);
+      size_t len = formatLogIndexEntry(line, sizeof(line), entry);
+      if (len > 0) {
+        index.println(line);
+        indexedLogs++;
+        indexedBytes += logIndexTotalBytes(entry);
+      }
+    }
     file = root.openNextFile();
   }
-  
   root.close();
-  Serial.print("Total log files: ");
-  Serial.println(fileCount);
+  index.close();
   
+  if (!SD.rename(SD_INDEX_TEMP_FILE, LOG_INDEX_FILE)) {
+    Serial.println("Failed to write log index");
+    return false;
+  }
+  Serial.print("Log index rebuilt from the directory: ");
+  Serial.print(indexedLogs);
+  Serial.println(" logs");
   return true;
 }
 
-bool SDManager::deleteOldFiles(int maxFiles) {
-  if (!sdInitialized || activeCard == SD_NONE) {
+bool SDManager::closeLastLog() {
+  LogIndexEntry entry;
+  if (!readLastLogEntry(entry)) {
+    if (SD.exists(SD_LAST_LOG_FILE)) {
+      SD.remove(SD_LAST_LOG_FILE);
+    }
     return false;
   }
+  measureLog(entry);
   
-  // This is a simplified implementation
-  // In a production system, you'd want to sort by date and delete oldest files
-  File root = SD.open("/");
-  if (!root) {
+  bool isNew = !SD.exists(LOG_INDEX_FILE);
+  File index = SD.open(LOG_INDEX_FILE, FILE_APPEND);
+  if (!index) {
+    Serial.println("Failed to open log index");
+    return false;
+  }
+  if (isNew) {
+    index.println(logIndexHeaderLine());
+  }
+  char line[LOG_INDEX_LINE_LENGTH];
+  size_t len = formatLogIndexEntry(line, sizeof(line), entry);
+  bool written = len > 0 && index.println(line) == len + 2;
+  index.close();
+  countUsedSpace(written ? len + 2 : 0);
+  if (!written) {
+    Serial.println("Failed to write log index");
     return false;
   }
   
-  int fileCount = 0;
-  File file = root.openNextFile();
+  // A reset between the two leaves the log indexed twice rather than not
+  // at all; retention copes with either
+  SD.remove(SD_LAST_LOG_FILE);
+  indexedLogs++;
+  indexedBytes += logIndexTotalBytes(entry);
+  Serial.print("Indexed log ");
+  Serial.print(entry.name);
+  Serial.print(" (");
+  Serial.print(entry.records);
+  Serial.print(" records, ");
+  Serial.print(logIndexTotalBytes(entry));
+  Serial.println(" bytes)");
+  return true;
+}
+
+static bool readBlackBoxFlash(void* context, uint32_t offset, void* buffer, size_t len) {
+  return esp_partition_read((const esp_partition_t*)context, offset, buffer, len) == ESP_OK;
+}
+
+static bool writeBlackBoxFlash(void* context, uint32_t offset, const void* data, size_t len) {
+  return esp_partition_write((const esp_partition_t*)context, offset, data, len) == ESP_OK;
+}
+
+static bool eraseBlackBoxFlash(void* context, uint32_t offset) {
+  return esp_partition_erase_range((const esp_partition_t*)context, offset, BLACKBOX_SECTOR_SIZE) == ESP_OK;
+}
+
+bool SDManager::beginBlackBox() {
+  const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                              BLACKBOX_PARTITION_LABEL);
+  if (partition == NULL) {
+    Serial.println("Black box: no " BLACKBOX_PARTITION_LABEL " partition, records are dropped while no card works");
+    return false;
+  }
+  if (blackBoxMutex == NULL) {
+    blackBoxMutex = xSemaphoreCreateMutex();
+  }
   
-  // Count CSV files first
-  while (file) {
-    if (!file.isDirectory() && String(file.name()).endsWith(".csv")) {
-      fileCount++;
+  BlackBoxFlash flash = {(void*)partition, readBlackBoxFlash, writeBlackBoxFlash, eraseBlackBoxFlash,
+                         (uint32_t)partition->size};
+  unsigned long scanStart = millis();
+  if (blackBoxMutex == NULL || xSemaphoreTake(blackBoxMutex, portMAX_DELAY) != pdTRUE) {
+    return false;
+  }
+  bool started = blackBox.begin(flash);
+  xSemaphoreGive(blackBoxMutex);
+  if (!started) {
+    Serial.println("Black box: failed to read flash partition");
+    return false;
+  }
+  Serial.print("Black box: ");
+  Serial.print(blackBox.getPending());
+  Serial.print(" records to drain, ");
+  Serial.print(blackBox.getCapacity());
+  Serial.print(" capacity, ");
+  Serial.print(blackBox.getErasedAhead());
+  Serial.print(" sectors erased ahead (scan ");
+  Serial.print(millis() - scanStart);
+  Serial.println(" ms)");
+  return true;
+}
+
+void SDManager::finishDeferredStart() {
+  unsigned long start = millis();
+  beginBlackBox();
+  if (sdInitialized && activeCard != SD_NONE) {
+    loadLogIndex();
+  }
+  Serial.print("SD: deferred start-up done in ");
+  Serial.print(millis() - start);
+  Serial.println(" ms");
+}
+
+bool SDManager::storeInBlackBox(DataBatch* batch, const TelemetryData* data, uint8_t groups) {
+  if (!blackBox.isReady()) {
+    return false;
+  }
+  // The background task only holds it for one sector erase
+  if (xSemaphoreTake(blackBoxMutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return false;
+  }
+  // What was batched for the card goes first
+  int batched = batch != NULL ? batch->count : 0;
+  for (int i = 0; i < batched; i++) {
+    int index = (batch->start + i) % SD_BATCH_CAPACITY;
+    blackBox.append(batch->data[index], batch->groups[index]);
+  }
+  if (data != NULL) {
+    blackBox.append(*data, groups);
+  }
+  xSemaphoreGive(blackBoxMutex);
+  
+  if (batched > 0) {
+    Serial.print("SD: No working card, ");
+    Serial.print(batched);
+    Serial.print(" batched records to black box (");
+    Serial.print(blackBox.getPending());
+    Serial.println(" held)");
+    memset(batch, 0, sizeof(DataBatch));
+    batch->batchStartTime = millis();
+  }
+  // The SD log skips these records, so the next one written needs a keyframe
+  keyframeDue = true;
+  return true;
+}
+
+int SDManager::drainBlackBox() {
+  if (!blackBox.isReady() || blackBox.getPending() == 0 || currentLogFile.length() == 0) {
+    return 0;
+  }
+  if (xSemaphoreTake(blackBoxMutex, 0) != pdTRUE) {
+    return 0;
+  }
+  
+  // A log of its own next to the main one, framed the same way. Each record
+  // is a keyframe in a block of its own, and is only marked drained once
+  // its block is complete, so a reset here loses nothing.
+  String drainFile = currentLogFile;
+  drainFile.replace(".csv", SD_BLACKBOX_SUFFIX);
+  bool isNew = !SD.exists(drainFile);
+  bool resumed = false;
+  if (!isNew && blackBoxBlockSeq == 0) {
+    // Left by an earlier boot: carry on after its last block
+    File existing = SD.open(drainFile, FILE_READ);
+    LogScanResult scan;
+    bool found = existing && scanLogTail(readLogAt, &existing, (uint32_t)existing.size(), scan);
+    if (existing) {
+      existing.close();
     }
-    file.close();
-    file = root.openNextFile();
+    blackBoxBlockSeq = found ? scan.lastSeq + 1 : 1;
+    resumed = true;
   }
   
-  root.close();
+  File file;
+  if (!openStagedLog(stagedDrain, file, drainFile, isNew)) {
+    xSemaphoreGive(blackBoxMutex);
+    Serial.print("Failed to open log: ");
+    Serial.println(drainFile);
+    return 0;
+  }
   
-  if (fileCount > maxFiles) {
-    Serial.print("Too many log files on ");
-    Serial.print(getCardSlotName(activeCard));
-    Serial.print(" card (");
-    Serial.print(fileCount);
-    Serial.println("), cleanup needed but not implemented in this simple version");
+  bool written = true;
+  LogBlockWriter writer;
+  if (isNew) {
+    writer.begin(0);
+    for (uint8_t i = 0; sdRecordHeaderLine(i) != NULL; i++) {
+      written = writeBlockLine(stagedDrain.writer, writer, sdRecordHeaderLine(i),
+                               strlen(sdRecordHeaderLine(i))) && written;
+    }
+    written = finishBlock(stagedDrain.writer, writer) && written;
+    blackBoxBlockSeq = 1;
+  } else if (resumed) {
+    // Closes off whatever the last boot left half-written
+    char marker[LOG_BLOCK_TRAILER_LENGTH];
+    size_t len = formatLogMarker(marker, sizeof(marker), 'R', blackBoxBlockSeq);
+    written = len > 0 && stagedDrain.writer.write(marker, len);
+    countUsedSpace(written ? len : 0);
   }
   
+  int drained = 0;
+  BlackBoxEntry entry;
+  char line[SD_RECORD_MAX_LENGTH];
+  while (written && drained < BLACKBOX_DRAIN_RECORDS && blackBox.peekOldest(entry)) {
+    writer.begin(blackBoxBlockSeq++);
+    size_t len = formatSdRecord(line, sizeof(line), entry.data, entry.groups | SD_GROUP_KEYFRAME);
+    // On the card before it's marked: a flush per record, as this runs
+    // on the ground only
+    written = len > 0 && writeBlockLine(stagedDrain.writer, writer, line, len) &&
+              finishBlock(stagedDrain.writer, writer) && stagedDrain.writer.flush();
+    if (written) {
+      blackBox.markDrained();
+      drained++;
+    }
+  }
+  if (!written) {
+    // The next call rescans the file and marks the torn block
+    blackBoxBlockSeq = 0;
+  }
+  closeStagedLog(stagedDrain, file, written);
+  xSemaphoreGive(blackBoxMutex);
+  
+  if (drained > 0 && blackBox.getPending() == 0) {
+    Serial.print("Black box: all records drained to ");
+    Serial.println(drainFile);
+  }
+  return drained;
+}
+
+bool SDManager::logEvent(const char* line) {
+  // Events are rare and matter most when the flight ends badly, so they
+  // bypass the batch and reach the card on the background task's next pass
+  return queueSideLog(LOG_SIDE_EVENTS, line);
+}
+
+bool SDManager::logVibration(const char* header, const char* line) {
+  // The header never changes; keep the first one for new files
+  if (vibHeader[0] == '\0') {
+    strncpy(vibHeader, header, sizeof(vibHeader) - 1);
+    vibHeader[sizeof(vibHeader) - 1] = '\0';
+  }
+  return queueSideLog(LOG_SIDE_VIB, line);
+}
+
+bool SDManager::queueSideLog(uint8_t side, const char* line) {
+  if (!sdInitialized || sideLogQueue == NULL) {
+    return false;
+  }
+  SideLogLine entry;
+  entry.side = side;
+  strncpy(entry.line, line, sizeof(entry.line) - 1);
+  entry.line[sizeof(entry.line) - 1] = '\0';
+  if (xQueueSend(sideLogQueue, &entry, 0) != pdTRUE) {
+    Serial.println("Warning: SD side log queue full, line dropped");
+    return false;
+  }
   return true;
 }
 
-size_t SDManager::getAvailableSpace() const {
+void SDManager::writeSideLogs() {
+  SideLogLine entry;
+  while (sideLogQueue != NULL && xQueueReceive(sideLogQueue, &entry, 0) == pdTRUE) {
+    if (entry.side == LOG_SIDE_EVENTS) {
+      appendSideLog(SD_EVENTS_SUFFIX, "event,onset_ms,detect_ms,log_ms,altitude,velocity", entry.line);
+    } else {
+      appendSideLog(SD_VIB_SUFFIX, vibHeader, entry.line);
+    }
+  }
+}
+
+bool SDManager::appendSideLog(const char* suffix, const char* header, const char* line) {
+  if (!sdInitialized || activeCard == SD_NONE || currentLogFile.length() == 0) {
+    return false;
+  }
+  
+  String sideFile = currentLogFile;
+  sideFile.replace(".csv", suffix);
+  bool isNew = !SD.exists(sideFile);
+  
+  File file = SD.open(sideFile, FILE_APPEND);
+  if (!file) {
+    Serial.print("Failed to open log: ");
+    Serial.println(sideFile);
+    return false;
+  }
+  if (isNew) {
+    countUsedSpace(file.println(header));
+  }
+  countUsedSpace(file.println(line));
+  file.close();
+  return true;
+}
+
+bool SDManager::forceSync() {
   if (!sdInitialized || activeCard == SD_NONE) {
-    return 0;
+    return false;
   }
   
-  return SD.totalBytes() - SD.usedBytes();
+  // The background task writes the batch, full or not, on its next pass
+  flushRequested = true;
+  return true;
 }
 
-size_t SDManager::getUsedSpace() const {
+static void printLogEntry(const LogIndexEntry& entry, bool open) {
+  Serial.print("  ");
+  Serial.print(entry.name);
+  Serial.print(" (");
+  Serial.print(entry.bytes);
+  Serial.print(" bytes, ");
+  Serial.print(entry.records);
+  Serial.print(" records, max alt ");
+  Serial.print(entry.maxAltitude, 1);
+  Serial.print(" m");
+  for (uint8_t i = 0; i < LOG_SIDE_COUNT; i++) {
+    if (entry.sideBytes[i] > 0) {
+      Serial.print(", ");
+      Serial.print(logSideSuffix(i));
+      Serial.print(" ");
+      Serial.print(entry.sideBytes[i]);
+    }
+  }
+  Serial.println(open ? ", open)" : ")");
+}
+
+bool SDManager::listLogFiles() {
   if (!sdInitialized || activeCard == SD_NONE) {
-    return 0;
+    return false;
+  }
+  
+  Serial.print("Log files on ");
+  Serial.print(getCardSlotName(activeCard));
+  Serial.println(" SD card:");
+  
+  // From the index, then the log being written, which isn't in it yet
+  File index = SD.open(LOG_INDEX_FILE, FILE_READ);
+  LogIndexEntry entry;
+  while (index && readIndexEntry(index, entry)) {
+    printLogEntry(entry, false);
+  }
+  if (index) {
+    index.close();
+  }
+  if (currentLogFile.length() > 0) {
+    entry = currentEntry;
+    measureLog(entry);
+    printLogEntry(entry, true);
   }
   
-  return SD.usedBytes();
+  Serial.print("Total logs: ");
+  Serial.print(indexedLogs + (currentLogFile.length() > 0 ? 1 : 0));
+  Serial.print(" (");
+  Serial.print((unsigned long)(indexedBytes / 1024));
+  Serial.println(" KB indexed)");
+  return true;
+}
+
+bool SDManager::deleteOldFiles(int maxFiles, uint32_t maxMB) {
+  if (!sdInitialized || activeCard == SD_NONE) {
+    return false;
+  }
+  
+  // The index totals say whether anything has to go without reading it
+  uint64_t maxBytes = (uint64_t)maxMB * 1024 * 1024;
+  if (indexedLogs <= (uint32_t)maxFiles && indexedBytes <= maxBytes) {
+    return true;
+  }
+  
+  File index = SD.open(LOG_INDEX_FILE, FILE_READ);
+  if (!index) {
+    return false;
+  }
+  File kept = SD.open(SD_INDEX_TEMP_FILE, FILE_WRITE);
+  if (!kept) {
+    index.close();
+    return false;
+  }
+  kept.println(logIndexHeaderLine());
+  
+  // Oldest first until both limits hold; the rest of the index is copied.
+  // A log indexed twice in a row is one log, kept at its later line, as
+  // loadLogIndex() counted it.
+  uint32_t logs = indexedLogs;
+  uint64_t bytes = indexedBytes;
+  int deleted = 0;
+  LogIndexEntry entry;
+  LogIndexEntry next;
+  char line[LOG_INDEX_LINE_LENGTH];
+  bool haveEntry = readIndexEntry(index, entry);
+  while (haveEntry) {
+    bool haveNext = readIndexEntry(index, next);
+    if (haveNext && strcmp(next.name, entry.name) == 0) {
+      entry = next;
+      continue;
+    }
+    
+    uint32_t size = logIndexTotalBytes(entry);
+    if (currentLogFile == entry.name) {
+      // A resumed log indexed before the reset: never deleted, and left
+      // out here since it's indexed again when it's closed
+      logs -= logs > 0 ? 1 : 0;
+      bytes -= size < bytes ? size : bytes;
+    } else if (logs > (uint32_t)maxFiles || bytes > maxBytes) {
+      SD.remove(entry.name);
+      for (uint8_t i = 0; i < LOG_SIDE_COUNT; i++) {
+        if (entry.sideBytes[i] > 0) {
+          String side = entry.name;
+          side.replace(".csv", logSideSuffix(i));
+          SD.remove(side);
+        }
+      }
+      logs--;
+      bytes -= size < bytes ? size : bytes;
+      countFreedSpace(size);
+      deleted++;
+    } else {
+      size_t len = formatLogIndexEntry(line, sizeof(line), entry);
+      if (len > 0) {
+        kept.println(line);
+      }
+    }
+    entry = next;
+    haveEntry = haveNext;
+  }
+  index.close();
+  kept.close();
+  
+  SD.remove(LOG_INDEX_FILE);
+  if (!SD.rename(SD_INDEX_TEMP_FILE, LOG_INDEX_FILE)) {
+    Serial.println("Failed to write log index");
+    return false;
+  }
+  indexedLogs = logs;
+  indexedBytes = bytes;
+  
+  Serial.print("Deleted ");
+  Serial.print(deleted);
+  Serial.print(" oldest logs from ");
+  Serial.print(getCardSlotName(activeCard));
+  Serial.print(" card, ");
+  Serial.print(logs);
+  Serial.print(" left (");
+  Serial.print((unsigned long)(bytes / (1024 * 1024)));
+  Serial.println(" MB)");
+  return true;
+}
+
+bool SDManager::requestWriteBenchmark() {
+  if (!sdInitialized || activeCard == SD_NONE || inFlight) {
+    return false;
+  }
+  writeBenchPending = true;
+  return true;
+}
+
+void SDManager::runWriteBenchmark() {
+  writeBenchPending = false;
+  
+  // Blocks of log-like records, each opened, written and closed the way
+  // writeBatchToFile() does: once with a write per line as the log was
+  // written before, once through a SectorWriter
+  TelemetryData data;
+  memset(&data, 0, sizeof(data));
+  data.mode = MODE_MAINTENANCE;
+  data.imu_valid = true;
+  data.attitude_valid = true;
+  data.estimator_valid = true;
+  data.accel_z = 1.0f;
+  data.quat_w = 1.0f;
+  static const int batchSizes[] = SD_BENCH_BATCH_SIZES;
+  static StagedFile staged;  // Its buffer is too big for the task's stack
+  char line[SD_RECORD_MAX_LENGTH];
+  
+  Serial.print("SD write benchmark, ");
+  Serial.print(getCardSlotName(activeCard));
+  Serial.print(" card, ");
+  Serial.print(SD_BENCH_BYTES / 1024);
+  Serial.println(" KB per run:");
+  for (size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); b++) {
+    for (int staging = 0; staging < 2; staging++) {
+      SD.remove(SD_BENCH_FILE);
+      File file = SD.open(SD_BENCH_FILE, FILE_WRITE);
+      if (!file) {
+        Serial.println("SD write benchmark: can't create " SD_BENCH_FILE);
+        return;
+      }
+      file.close();
+      
+      uint32_t bytes = 0, batches = 0;
+      unsigned long totalUs = 0, maxUs = 0;
+      bool written = true;
+      LogBlockWriter writer;
+      while (written && bytes < SD_BENCH_BYTES) {
+        unsigned long start = micros();
+        writer.begin(batches + 1);
+        if (staging) {
+          written = openStagedLog(staged, file, SD_BENCH_FILE, false);
+        } else {
+          file = SD.open(SD_BENCH_FILE, FILE_APPEND);
+          written = (bool)file;
+        }
+        for (int i = 0; written && i < batchSizes[b]; i++) {
+          data.timestamp += 10;
+          data.accel_x = (float)(data.timestamp % 97) * 0.001f;
+          size_t len = formatSdRecord(line, sizeof(line), data, i == 0 ? SD_GROUP_KEYFRAME : SD_GROUP_IMU | SD_GROUP_ATTITUDE);
+          if (staging) {
+            written = writeBlockLine(staged.writer, writer, line, len);
+          } else {
+            written = file.write((const uint8_t*)line, len) == len && file.write((const uint8_t*)"\r\n", 2) == 2;
+            writer.add((const uint8_t*)line, len);
+            writer.add((const uint8_t*)"\r\n", 2);
+          }
+          bytes += len + 2;
+        }
+        char trailer[LOG_BLOCK_TRAILER_LENGTH];
+        size_t len = writer.formatTrailer(trailer, sizeof(trailer));
+        if (staging) {
+          written = written && staged.writer.write(trailer, len);
+          written = closeStagedLog(staged, file, written) && written;
+        } else if (written) {
+          written = file.write((const uint8_t*)trailer, len) == len;
+          file.close();
+        }
+        bytes += len;
+        
+        unsigned long elapsed = micros() - start;
+        totalUs += elapsed;
+        maxUs = elapsed > maxUs ? elapsed : maxUs;
+        batches++;
+      }
+      
+      Serial.printf("  %3d records/batch, %-7s %8.0f B/s, %6lu us mean, %6lu us max%s\n", batchSizes[b],
+                    staging ? "sectors" : "lines", totalUs > 0 ? bytes * 1e6 / totalUs : 0.0,
+                    batches > 0 ? totalUs / batches : 0, maxUs, written ? "" : " (write failed)");
+    }
+  }
+  SD.remove(SD_BENCH_FILE);
+  reconcileSpace();
+}
+
+uint64_t SDManager::getAvailableSpace() const {
+  if (!sdInitialized || activeCard == SD_NONE || !spaceKnown) {
+    return 0;
+  }
+  portENTER_CRITICAL(&spaceMux);
+  uint64_t available = cardUsedBytes < cardTotalBytes ? cardTotalBytes - cardUsedBytes : 0;
+  portEXIT_CRITICAL(&spaceMux);
+  return available;
+}
+
+uint64_t SDManager::getUsedSpace() const {
+  if (!sdInitialized || activeCard == SD_NONE || !spaceKnown) {
+    return 0;
+  }
+  portENTER_CRITICAL(&spaceMux);
+  uint64_t used = cardUsedBytes;
+  portEXIT_CRITICAL(&spaceMux);
+  return used;
+}
+
+void SDManager::countUsedSpace(uint32_t bytes) {
+  portENTER_CRITICAL(&spaceMux);
+  cardUsedBytes += bytes;
+  portEXIT_CRITICAL(&spaceMux);
+}
+
+void SDManager::countFreedSpace(uint32_t bytes) {
+  portENTER_CRITICAL(&spaceMux);
+  cardUsedBytes -= bytes < cardUsedBytes ? bytes : cardUsedBytes;
+  portEXIT_CRITICAL(&spaceMux);
+}
+
+void SDManager::reconcileSpace() {
+  // usedBytes() can walk the whole FAT, holding the bus for a long time
+  // on a big card, so the count only comes from the card at mount and in
+  // the background on the ground. Writes and deletes keep it in between.
+  unsigned long start = millis();
+  uint64_t estimate = getUsedSpace();
+  bool hadEstimate = spaceKnown;
+  uint64_t total = SD.totalBytes();
+  uint64_t used = SD.usedBytes();
+  portENTER_CRITICAL(&spaceMux);
+  cardTotalBytes = total;
+  cardUsedBytes = used;
+  portEXIT_CRITICAL(&spaceMux);
+  spaceKnown = true;
+  lastSpaceReconcile = millis();
+  
+  Serial.print("SD space: ");
+  Serial.print((unsigned long)(used / (1024 * 1024)));
+  Serial.print(" of ");
+  Serial.print((unsigned long)(total / (1024 * 1024)));
+  Serial.print(" MB used");
+  if (hadEstimate) {
+    Serial.print(", estimate was off by ");
+    Serial.print((long)(((int64_t)used - (int64_t)estimate) / 1024));
+    Serial.print(" KB");
+  }
+  Serial.print(" (");
+  Serial.print(lastSpaceReconcile - start);
+  Serial.println(" ms to count)");
 }
 
 String SDManager::getCardSlotName(SDCardSlot slot) const {
@@ -433,37 +1620,25 @@ bool SDManager::testCardHealth(SDCardSlot slot) {
   SD.end();
   delay(10); // Small delay to ensure clean disconnection
   
-  // Try to initialize the card we're testing
+  // Try to initialize the card we're testing, at its own clock
   bool cardHealthy = false;
-  if (SD.begin(csPin, SPI, SD_SPI_SPEED)) {
+  if (mountCard(slot)) {
     // Try to open root directory as a health check
     File root = SD.open("/");
     if (root) {
       cardHealthy = true;
       root.close();
       Serial.print(getCardSlotName(slot));
-      Serial.println(" card is healthy");
+      Serial.print(" card is healthy at ");
+      Serial.print(spiSpeeds[cardSpeed[slot]] / 1000000);
+      Serial.println(" MHz");
     } else {
       Serial.print(getCardSlotName(slot));
       Serial.println(" card failed directory test");
     }
   } else {
-    // Try with slower speed
-    if (SD.begin(csPin, SPI, 1000000)) {
-      File root = SD.open("/");
-      if (root) {
-        cardHealthy = true;
-        root.close();
-        Serial.print(getCardSlotName(slot));
-        Serial.println(" card is healthy (slow speed)");
-      } else {
-        Serial.print(getCardSlotName(slot));
-        Serial.println(" card failed directory test (slow speed)");
-      }
-    } else {
-      Serial.print(getCardSlotName(slot));
-      Serial.println(" card is not responding");
-    }
+    Serial.print(getCardSlotName(slot));
+    Serial.println(" card is not responding");
   }
   
   // Restore the original active card connection if we had one
@@ -472,8 +1647,7 @@ bool SDManager::testCardHealth(SDCardSlot slot) {
     delay(10);
     
     // Restore connection to originally active card
-    if (SD.begin(originalCsPin, SPI, SD_SPI_SPEED) || 
-        SD.begin(originalCsPin, SPI, 1000000)) {
+    if (mountCard(originalActiveCard)) {
       Serial.print("Restored connection to ");
       Serial.print(getCardSlotName(originalActiveCard));
       Serial.println(" card");
@@ -554,32 +1728,25 @@ bool SDManager::handleCardFailure() {
 }
 
 bool SDManager::switchToPrimaryCard() {
-  if (!primaryCardPresent && !tryInitializeCard(SD_PRIMARY)) {
+  if (!primaryCardPresent && !tryInitializeCard(SD_PRIMARY, false)) {
     Serial.println("Primary SD card not available for switch");
     return false;
   }
   
-  // Flush any pending data on current card
-  if (currentBatch.count > 0) {
-    flushCurrentBatch();
-  }
-  
   // End current SD connection
   SD.end();
   
   // Reinitialize SD library with primary card's CS pin
-  if (!SD.begin(SD_CS_PIN, SPI, SD_SPI_SPEED)) {
+  if (!mountCard(SD_PRIMARY)) {
     Serial.println("Failed to reinitialize SD library for primary card");
-    // Try with slower speed
-    if (!SD.begin(SD_CS_PIN, SPI, 1000000)) {
-      Serial.println("Failed to reinitialize SD library for primary card even at reduced speed");
-      return false;
-    }
+    return false;
   }
   
   // Switch to primary card
   activeCard = SD_PRIMARY;
   primaryCardPresent = true;
+  loadLogIndex();
+  spaceKnown = false;
   
   // Create new log file on primary card
   if (!createLogFile()) {
@@ -595,8 +1762,9 @@ String SDManager::getDetailedStatus() const {
   if (bothCardsFailed) {
     char status[256];
     snprintf(status, sizeof(status),
-      "SD: Both cards failed, will retry in %d seconds, P:%s B:%s",
+      "SD: Both cards failed, will retry in %d seconds, %lu in black box, P:%s B:%s",
       (int)((SD_RETRY_INTERVAL - (millis() - lastRetryAttempt)) / 1000),
+      (unsigned long)blackBox.getPending(),
       primaryCardPresent ? "OK" : "FAIL",
       backupCardPresent ? "OK" : "FAIL"
     );
@@ -607,17 +1775,27 @@ String SDManager::getDetailedStatus() const {
     return "SD: No cards available";
   }
   
+  // From the cached count: a status call never goes to the card
+  char freeSpace[24];
+  if (spaceKnown) {
+    snprintf(freeSpace, sizeof(freeSpace), "%luKB", (unsigned long)(getAvailableSpace() / 1024));
+  } else {
+    snprintf(freeSpace, sizeof(freeSpace), "?KB");
+  }
   char status[256];
   snprintf(status, sizeof(status),
-    "SD: %s card active, %d batches, %d/%d current, %dKB free, %d failures, P:%s B:%s",
+    "SD: %s card active, %d batches, %d/%d current, %lu dropped, %s free, %d failures, P:%s@%luMHz B:%s@%luMHz",
     getCardSlotName(activeCard).c_str(),
     totalBatchesStored,
-    currentBatch.count,
+    fillBatch->count,
     SD_BATCH_SIZE,
-    (int)(getAvailableSpace() / 1024),
+    (unsigned long)droppedRecords,
+    freeSpace,
     consecutiveFailures,
     primaryCardPresent ? "OK" : "FAIL",
-    backupCardPresent ? "OK" : "FAIL"
+    (unsigned long)(getCardSpeed(SD_PRIMARY) / 1000000),
+    backupCardPresent ? "OK" : "FAIL",
+    (unsigned long)(getCardSpeed(SD_BACKUP) / 1000000)
   );
   
   return String(status);
@@ -630,6 +1808,17 @@ void SDManager::update() {
 void SDManager::performPeriodicTasks() {
   unsigned long currentTime = millis();
   
+  // Blank black box sectors ahead of its writer while on the ground, so
+  // that if the cards fail in flight it only programs flash; each erase
+  // holds the flash for tens of ms
+  if (!inFlight && blackBox.isReady() && currentTime - lastBlackBoxErase >= BLACKBOX_ERASE_INTERVAL) {
+    lastBlackBoxErase = currentTime;
+    if (xSemaphoreTake(blackBoxMutex, 0) == pdTRUE) {
+      blackBox.eraseAhead(1);
+      xSemaphoreGive(blackBoxMutex);
+    }
+  }
+  
   // If both cards failed, try to reinitialize periodically
   if (bothCardsFailed) {
     unsigned long timeSinceLastRetry = currentTime - lastRetryAttempt;
@@ -664,12 +1853,43 @@ void SDManager::performPeriodicTasks() {
     return;  // Skip health checks if both cards failed
   }
   
+  if (startDeferred) {
+    startDeferred = false;
+    finishDeferredStart();
+  }
+  
+  // A log write failed on the bus: a step down the clock ladder, here
+  // rather than in the write path
+  if (slowCard != SD_NONE) {
+    SDCardSlot slot = slowCard;
+    slowCard = SD_NONE;
+    if (sdInitialized) {
+      lowerCardSpeed(slot);
+    }
+  }
+  
   // Perform regular health checks if we have an active card
   if (sdInitialized && activeCard != SD_NONE) {
     if (currentTime - lastCardHealthCheck >= SD_HEALTH_CHECK_INTERVAL) {
       performCardHealthCheck();
       lastCardHealthCheck = currentTime;
     }
+    
+    // With a card back, copy over what the black box kept meanwhile, a
+    // little at a time
+    if (!inFlight) {
+      drainBlackBox();
+    }
+    
+    if (writeBenchPending && !inFlight) {
+      runWriteBenchmark();
+    }
+    
+    // Correct the space count for cluster rounding and anything written
+    // outside this class
+    if (!inFlight && (!spaceKnown || currentTime - lastSpaceReconcile >= SD_SPACE_RECONCILE_INTERVAL)) {
+      reconcileSpace();
+    }
   }
 }
 
@@ -678,8 +1898,42 @@ bool SDManager::retryCardInitialization() {
   primaryCardPresent = false;
   backupCardPresent = false;
   
-  // Try to initialize the SD system again
-  return initializeSD();
+  // Try to initialize the SD system again; if no log was started at
+  // boot, start one now
+  if (!initializeSD()) {
+    return false;
+  }
+  loadLogIndex();
+  spaceKnown = false;
+  if (currentLogFile.length() == 0 && !recoverLastLog() && !createLogFile()) {
+    return false;
+  }
+  if (!inFlight) {
+    deleteOldFiles();
+    reconcileSpace();
+  }
+  return true;
+}
+
+// A log and its side files as entries of the file list
+static void appendLogJson(String& json, bool& firstFile, const LogIndexEntry& entry) {
+  char item[LOG_INDEX_LINE_LENGTH + 64];
+  snprintf(item, sizeof(item),
+           "%s{\"name\":\"%s\",\"size\":%lu,\"records\":%lu,\"max_alt\":%.1f,\"max_speed\":%.1f,"
+           "\"max_phase\":%u,\"utc_end_ms\":%lld}",
+           firstFile ? "" : ",", entry.name, (unsigned long)entry.bytes, (unsigned long)entry.records,
+           entry.maxAltitude, entry.maxSpeed, (unsigned)entry.maxPhase, (long long)entry.utcEndMs);
+  json += item;
+  firstFile = false;
+  for (uint8_t i = 0; i < LOG_SIDE_COUNT; i++) {
+    if (entry.sideBytes[i] > 0) {
+      String side = entry.name;
+      side.replace(".csv", logSideSuffix(i));
+      snprintf(item, sizeof(item), ",{\"name\":\"%s\",\"size\":%lu}", side.c_str(),
+               (unsigned long)entry.sideBytes[i]);
+      json += item;
+    }
+  }
 }
 
 String SDManager::getLogFilesList() {
@@ -691,29 +1945,21 @@ String SDManager::getLogFilesList() {
     return json;
   }
   
-  File root = SD.open("/");
-  if (!root) {
-    json += "],\"error\":\"Failed to open root directory\"}";
-    return json;
+  // One read of the index instead of opening every file on the card
+  File index = SD.open(LOG_INDEX_FILE, FILE_READ);
+  LogIndexEntry entry;
+  while (index && readIndexEntry(index, entry)) {
+    appendLogJson(json, firstFile, entry);
   }
-  
-  File file = root.openNextFile();
-  while (file) {
-    if (!file.isDirectory() && String(file.name()).endsWith(".csv")) {
-      if (!firstFile) {
-        json += ",";
-      }
-      json += "{";
-      json += "\"name\":\"" + String(file.name()) + "\",";
-      json += "\"size\":" + String(file.size());
-      json += "}";
-      firstFile = false;
-    }
-    file.close();
-    file = root.openNextFile();
+  if (index) {
+    index.close();
+  }
+  if (currentLogFile.length() > 0) {
+    entry = currentEntry;
+    measureLog(entry);
+    appendLogJson(json, firstFile, entry);
   }
   
-  root.close();
   json += "],\"active_card\":\"" + getCardSlotName(activeCard) + "\"}";
   return json;
 }
@@ -769,3 +2015,24 @@ size_t SDManager::getFileSize(const String& filename) {
   file.close();
   return size;
 }
+
+size_t SDManager::readFileChunk(const String& filename, uint32_t offset, uint8_t* buffer, size_t len) {
+  if (!sdInitialized || activeCard == SD_NONE) {
+    return 0;
+  }
+  
+  // Ensure filename starts with "/"
+  String fullPath = filename.startsWith("/") ? filename : "/" + filename;
+  
+  File file = SD.open(fullPath, FILE_READ);
+  if (!file) {
+    return 0;
+  }
+  
+  size_t bytesRead = 0;
+  if (file.seek(offset)) {
+    bytesRead = file.read(buffer, len);
+  }
+  file.close();
+  return bytesRead;
+}
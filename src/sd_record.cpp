@@ -0,0 +1,199 @@
+#include "sd_record.h"
+#include "geo_coord.h"
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+
+struct SdGroupSpec {
+  uint8_t group;
+  char tag;
+  const char* header;          // "#<tag>,<columns>" with implied columns last
+};
+
+// In the order their fields appear in a record
+static const SdGroupSpec groupSpecs[] = {
+  {SD_GROUP_KEYFRAME, 'K', "#K," SD_RECORD_COLUMNS},
+  {SD_GROUP_GPS, 'G', "#G,lat,lon,alt_gps,gps_time_us,gps_valid=1"},
+  {SD_GROUP_PRESSURE, 'P', "#P,alt_press,pressure,pressure_time_us,press_valid=1"},
+  {SD_GROUP_IMU, 'I', "#I,accel_x,accel_y,accel_z,gyro_x,gyro_y,gyro_z,mag_x,mag_y,mag_z,imu_temp,"
+                      "accel_range,gyro_range,imu_clipped,imu_time_us,imu_valid=1"},
+  {SD_GROUP_POWER, 'W', "#W,voltage,current,power,power_time_us,power_valid=1"},
+  {SD_GROUP_ALTITUDE, 'F', "#F,alt_filtered,vertical_velocity,estimator_valid"},
+  {SD_GROUP_ATTITUDE, 'A', "#A,quat_w,quat_x,quat_y,quat_z,roll,pitch,yaw,attitude_valid"},
+  {SD_GROUP_NAV, 'N', "#N,nav_lat,nav_lon,velocity_east,velocity_north,nav_valid"},
+};
+static const uint8_t groupSpecCount = sizeof(groupSpecs) / sizeof(groupSpecs[0]);
+
+const char* sdRecordHeaderLine(uint8_t index) {
+  return index < groupSpecCount ? groupSpecs[index].header : NULL;
+}
+
+// snprintf at an offset; a failed or truncated write sets len to the
+// capacity so the caller reports it once
+static void append(size_t capacity, size_t& len, int written) {
+  if (written < 0 || len + (size_t)written >= capacity) {
+    len = capacity;
+  } else {
+    len += (size_t)written;
+  }
+}
+
+size_t formatSdRow(char* buffer, size_t capacity, const TelemetryData& data) {
+  char lat[COORD_TEXT_LENGTH], lon[COORD_TEXT_LENGTH];
+  char navLat[COORD_TEXT_LENGTH], navLon[COORD_TEXT_LENGTH];
+  formatCoordinate(lat, sizeof(lat), data.latitude);
+  formatCoordinate(lon, sizeof(lon), data.longitude);
+  formatCoordinate(navLat, sizeof(navLat), data.nav_latitude);
+  formatCoordinate(navLon, sizeof(navLon), data.nav_longitude);
+
+  int len = snprintf(buffer, capacity,
+    "%lu,%d,%s,%s,%.2f,%.2f,%.2f,%d,%d,%d,"
+    "%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f,%.2f,%.2f,%.2f,%d,"
+    "%.3f,%.2f,%.2f,%d,%.2f,%.2f,%d,%d,"
+    "%.4f,%.4f,%.4f,%.4f,%.1f,%.1f,%.1f,%d,"
+    "%.0f,%.0f,%d,"
+    "%s,%s,%.2f,%.2f,%d,"
+    "%lld,%d,%lld,%lld,%lld,%lld",
+    (unsigned long)data.timestamp, data.mode,
+    lat, lon, data.altitude_gps, data.altitude_pressure, data.pressure,
+    data.gps_valid, data.pressure_valid, data.rssi,
+    data.accel_x, data.accel_y, data.accel_z,
+    data.gyro_x, data.gyro_y, data.gyro_z,
+    data.mag_x, data.mag_y, data.mag_z, data.imu_temperature, data.imu_valid,
+    data.bus_voltage, data.current, data.power, data.power_valid,
+    data.altitude_filtered, data.vertical_velocity, data.estimator_valid, data.flight_phase,
+    data.quat_w, data.quat_x, data.quat_y, data.quat_z,
+    data.roll, data.pitch, data.yaw, data.attitude_valid,
+    data.accel_range, data.gyro_range, data.imu_clipped,
+    navLat, navLon, data.velocity_east, data.velocity_north, data.nav_valid,
+    (long long)data.utc_ms, data.time_source,
+    (long long)data.gps_time_us, (long long)data.pressure_time_us,
+    (long long)data.imu_time_us, (long long)data.power_time_us
+  );
+
+  if (len < 0 || (size_t)len >= capacity) {
+    return 0;
+  }
+  return (size_t)len;
+}
+
+size_t formatSdRecord(char* buffer, size_t capacity, const TelemetryData& data, uint8_t groups) {
+  if (capacity == 0) {
+    return 0;
+  }
+  // A record with nothing in it would lose its timestamp; write it whole
+  if ((groups & ~SD_GROUP_KEYFRAME) == 0) {
+    groups |= SD_GROUP_KEYFRAME;
+  }
+
+  size_t len = 0;
+  for (uint8_t i = 0; i < groupSpecCount && len + 1 < capacity; i++) {
+    if (groups & groupSpecs[i].group) {
+      buffer[len++] = groupSpecs[i].tag;
+    }
+  }
+  append(capacity, len, snprintf(buffer + len, capacity - len, ","));
+
+  if (groups & SD_GROUP_KEYFRAME) {
+    if (len >= capacity) {
+      return 0;
+    }
+    size_t rowLen = formatSdRow(buffer + len, capacity - len, data);
+    return rowLen > 0 ? len + rowLen : 0;
+  }
+
+  append(capacity, len, snprintf(buffer + len, capacity - len, "%lu", (unsigned long)data.timestamp));
+
+  if ((groups & SD_GROUP_GPS) && len < capacity) {
+    char lat[COORD_TEXT_LENGTH], lon[COORD_TEXT_LENGTH];
+    formatCoordinate(lat, sizeof(lat), data.latitude);
+    formatCoordinate(lon, sizeof(lon), data.longitude);
+    append(capacity, len, snprintf(buffer + len, capacity - len, ",%s,%s,%.2f,%lld",
+                                   lat, lon, data.altitude_gps, (long long)data.gps_time_us));
+  }
+  if ((groups & SD_GROUP_PRESSURE) && len < capacity) {
+    append(capacity, len, snprintf(buffer + len, capacity - len, ",%.2f,%.2f,%lld",
+                                   data.altitude_pressure, data.pressure,
+                                   (long long)data.pressure_time_us));
+  }
+  if ((groups & SD_GROUP_IMU) && len < capacity) {
+    append(capacity, len, snprintf(buffer + len, capacity - len,
+                                   ",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f,%.2f,%.2f,%.2f,%.0f,%.0f,%d,%lld",
+                                   data.accel_x, data.accel_y, data.accel_z,
+                                   data.gyro_x, data.gyro_y, data.gyro_z,
+                                   data.mag_x, data.mag_y, data.mag_z, data.imu_temperature,
+                                   data.accel_range, data.gyro_range, data.imu_clipped,
+                                   (long long)data.imu_time_us));
+  }
+  if ((groups & SD_GROUP_POWER) && len < capacity) {
+    append(capacity, len, snprintf(buffer + len, capacity - len, ",%.3f,%.2f,%.2f,%lld",
+                                   data.bus_voltage, data.current, data.power,
+                                   (long long)data.power_time_us));
+  }
+  if ((groups & SD_GROUP_ALTITUDE) && len < capacity) {
+    append(capacity, len, snprintf(buffer + len, capacity - len, ",%.2f,%.2f,%d",
+                                   data.altitude_filtered, data.vertical_velocity,
+                                   data.estimator_valid));
+  }
+  if ((groups & SD_GROUP_ATTITUDE) && len < capacity) {
+    append(capacity, len, snprintf(buffer + len, capacity - len, ",%.4f,%.4f,%.4f,%.4f,%.1f,%.1f,%.1f,%d",
+                                   data.quat_w, data.quat_x, data.quat_y, data.quat_z,
+                                   data.roll, data.pitch, data.yaw, data.attitude_valid));
+  }
+  if ((groups & SD_GROUP_NAV) && len < capacity) {
+    char navLat[COORD_TEXT_LENGTH], navLon[COORD_TEXT_LENGTH];
+    formatCoordinate(navLat, sizeof(navLat), data.nav_latitude);
+    formatCoordinate(navLon, sizeof(navLon), data.nav_longitude);
+    append(capacity, len, snprintf(buffer + len, capacity - len, ",%s,%s,%.2f,%.2f,%d",
+                                   navLat, navLon, data.velocity_east, data.velocity_north,
+                                   data.nav_valid));
+  }
+
+  return len < capacity ? len : 0;
+}
+
+uint8_t sdDerivedGroups(const TelemetryData& data, uint8_t fresh, SdDerivedState& last) {
+  uint8_t groups = fresh;
+
+  if (data.estimator_valid != last.estimatorValid ||
+      fabsf(data.altitude_filtered - last.altitude) >= SD_ALTITUDE_DEADBAND ||
+      fabsf(data.vertical_velocity - last.velocity) >= SD_VELOCITY_DEADBAND) {
+    groups |= SD_GROUP_ALTITUDE;
+  }
+  // Yaw wraps at +-180
+  if (data.attitude_valid != last.attitudeValid ||
+      fabsf(data.roll - last.roll) >= SD_ATTITUDE_DEADBAND ||
+      fabsf(data.pitch - last.pitch) >= SD_ATTITUDE_DEADBAND ||
+      fabsf(remainderf(data.yaw - last.yaw, 360.0f)) >= SD_ATTITUDE_DEADBAND) {
+    groups |= SD_GROUP_ATTITUDE;
+  }
+  if (data.nav_valid != last.navValid ||
+      llabs((int64_t)data.nav_latitude - last.navLatitude) >= SD_NAV_DEADBAND ||
+      llabs((int64_t)data.nav_longitude - last.navLongitude) >= SD_NAV_DEADBAND ||
+      fabsf(data.velocity_east - last.velocityEast) >= SD_VELOCITY_DEADBAND ||
+      fabsf(data.velocity_north - last.velocityNorth) >= SD_VELOCITY_DEADBAND) {
+    groups |= SD_GROUP_NAV;
+  }
+
+  // A keyframe has them all without naming them
+  uint8_t logged = (fresh & SD_GROUP_KEYFRAME) ? 0xFF : groups;
+  if (logged & SD_GROUP_ALTITUDE) {
+    last.altitude = data.altitude_filtered;
+    last.velocity = data.vertical_velocity;
+    last.estimatorValid = data.estimator_valid;
+  }
+  if (logged & SD_GROUP_ATTITUDE) {
+    last.roll = data.roll;
+    last.pitch = data.pitch;
+    last.yaw = data.yaw;
+    last.attitudeValid = data.attitude_valid;
+  }
+  if (logged & SD_GROUP_NAV) {
+    last.navLatitude = data.nav_latitude;
+    last.navLongitude = data.nav_longitude;
+    last.velocityEast = data.velocity_east;
+    last.velocityNorth = data.velocity_north;
+    last.navValid = data.nav_valid;
+  }
+  return groups;
+}
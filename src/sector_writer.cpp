@@ -0,0 +1,84 @@
+#include "sector_writer.h"
+#include <string.h>
+
+SectorWriter::SectorWriter()
+  : base(0), used(0), written(0), valid(false), writeFn(NULL), context(NULL) {
+  memset(&stats, 0, sizeof(stats));
+}
+
+void SectorWriter::attach(SectorWriteFn fn, void* fnContext) {
+  writeFn = fn;
+  context = fnContext;
+}
+
+void SectorWriter::begin(uint32_t fileSize, const uint8_t* tail) {
+  used = fileSize % SD_SECTOR_SIZE;
+  base = fileSize - (uint32_t)used;
+  if (used > 0) {
+    memcpy(buffer, tail, used);
+  }
+  written = used;
+  valid = true;
+}
+
+void SectorWriter::resetStats() {
+  memset(&stats, 0, sizeof(stats));
+}
+
+bool SectorWriter::writeOut(size_t len) {
+  stats.writes++;
+  stats.sectors += (uint32_t)(len / SD_SECTOR_SIZE);
+  if (len % SD_SECTOR_SIZE != 0) {
+    stats.tailWrites++;
+  }
+  if (writeFn == NULL || !writeFn(context, base, buffer, len)) {
+    valid = false;
+    return false;
+  }
+  return true;
+}
+
+bool SectorWriter::write(const void* data, size_t len) {
+  if (!valid) {
+    return false;
+  }
+  const uint8_t* bytes = (const uint8_t*)data;
+  while (len > 0) {
+    size_t count = sizeof(buffer) - used < len ? sizeof(buffer) - used : len;
+    memcpy(buffer + used, bytes, count);
+    used += count;
+    bytes += count;
+    len -= count;
+
+    // Full: the buffer is whole sectors from a sector boundary
+    if (used == sizeof(buffer)) {
+      if (!writeOut(used)) {
+        return false;
+      }
+      base += (uint32_t)used;
+      used = 0;
+      written = 0;
+    }
+  }
+  return true;
+}
+
+bool SectorWriter::flush() {
+  if (!valid) {
+    return false;
+  }
+  if (used == written) {
+    return true;
+  }
+  if (!writeOut(used)) {
+    return false;
+  }
+
+  // Keep the partial last sector to start the next write with
+  size_t whole = used - used % SD_SECTOR_SIZE;
+  memmove(buffer, buffer + whole, used - whole);
+  base += (uint32_t)whole;
+  used -= whole;
+  written = used;
+  return true;
+}
@@ -1,4 +1,20 @@
 #include "system_controller.h"
+#include "esp_timer.h"
+
+// Indexed by FlightPhase
+static const SampleRates phaseRates[] = {
+  RATES_PAD,
+  RATES_BOOST,
+  RATES_COAST,
+  RATES_DESCENT,
+  RATES_LANDED
+};
+static const SampleRates apogeeRates = RATES_APOGEE;
+
+// Interval check that tolerates the sensor task waking a tick early
+static bool intervalElapsed(unsigned long now, unsigned long last, uint16_t interval, uint16_t period) {
+  return now - last + period / 2 >= interval;
+}
 
 SystemController::SystemController() : 
   currentMode(MODE_SLEEP),
@@ -10,6 +26,25 @@ SystemController::SystemController() :
   lastRadioTx(0),
   lastHeartbeat(0),
   maintenanceModeStartTime(0),
+  lastEstimatorStep(0),
+  lastBaroFusion(0),
+  lastAttitudeStep(0),
+  lastNavStep(0),
+  lastGpsFusion(0),
+  lastSdLog(0),
+  sdFreshGroups(0),
+  apogeeDetectedMs(0),
+  lastResumeSave(0),
+  resumeStateSaved(false),
+  resumeCount(0),
+  firstSampleLogged(false),
+  sensorTaskPeriod(SENSOR_READ_INTERVAL),
+  vibrationQueue(NULL),
+  flightEventQueue(NULL),
+  flightEventsResetRequested(false),
+  calibrationMutex(NULL),
+  calibrationActive(false),
+  calibrationSavePending(false),
   backgroundTaskHandle(NULL),
   sensorTaskHandle(NULL),
   telemetryMutex(NULL),
@@ -19,6 +54,8 @@ SystemController::SystemController() :
   transitionState(TRANSITION_IDLE),
   pendingMode(MODE_SLEEP),
   transitionStartTime(0),
+  lastCommandSeq(0),
+  hasLastCommand(false),
   // Initialize modules with member initializer list (stack allocated)
   gpsModule(),
   pressureSensor(),
@@ -27,19 +64,26 @@ SystemController::SystemController() :
   radioModule(),
   powerManager(),
   wifiManager(),
-  sdManager() {
+  sdManager(),
+  logDownlink(sdManager, radioModule) {
   
   // Store main task handle for synchronization
   mainTaskHandle = xTaskGetCurrentTaskHandle();
   
   // Initialize telemetry data
   memset(&telemetryData, 0, sizeof(TelemetryData));
+  memset(imuStreams, 0, sizeof(imuStreams));
   
   // Initialize performance metrics
   memset(&perfMetrics, 0, sizeof(PerformanceMetrics));
+  lastAckFrame[0] = '\0';
   
   // Create mutex for telemetry data access
   telemetryMutex = xSemaphoreCreateMutex();
+  flightEventQueue = xQueueCreate(FLIGHT_EVENT_QUEUE_LENGTH, sizeof(FlightEvent));
+  vibrationQueue = xQueueCreate(VIB_QUEUE_LENGTH, sizeof(VibrationSummary));
+  calibrationMutex = xSemaphoreCreateMutex();
+  ImuCalibrator::clear(imuCalibration);
 }
 
 SystemController::~SystemController() {
@@ -85,6 +129,20 @@ SystemController::~SystemController() {
     telemetryMutex = NULL;
   }
   
+  if (flightEventQueue != NULL) {
+    vQueueDelete(flightEventQueue);
+    flightEventQueue = NULL;
+  }
+  if (vibrationQueue != NULL) {
+    vQueueDelete(vibrationQueue);
+    vibrationQueue = NULL;
+  }
+  
+  if (calibrationMutex != NULL) {
+    vSemaphoreDelete(calibrationMutex);
+    calibrationMutex = NULL;
+  }
+  
   // No need to delete modules - they're stack allocated and will be destroyed automatically
 }
 
@@ -99,35 +157,20 @@ void SystemController::initialize() {
   pinMode(CAMERA_POWER_PIN, OUTPUT);
   digitalWrite(CAMERA_POWER_PIN, LOW); // Start with camera off (will be set by mode)
   
-  // Initialize power manager first
-  powerManager.initialize();
-  yield(); // Feed watchdog
-  delay(100); // Small delay between initializations
-  
-  // Initialize communication modules with watchdog feeding
-  radioModule.initialize();
-  yield(); // Feed watchdog
-  delay(100); // Small delay
-  
-  wifiManager.initialize();
-  yield(); // Feed watchdog
-  powerSensor.initialize();
-  
-  // Set system controller reference in WiFi manager for SD card status
-  wifiManager.setSystemController(this);
-  
-  // Initialize SD card storage
-  sdManager.initialize();
-  yield(); // Feed watchdog
-  delay(100); // Small delay
-  
-  // Load and restore the persistent mode from previous session
-  SystemMode savedMode = loadPersistentMode();
-  Serial.print("Restoring to saved mode: ");
-  Serial.println(savedMode);
-  
-  // Set system to the restored mode
-  setMode(savedMode);
+  // After a reset in flight, straight back to logging and transmitting.
+  // A board that keeps resetting gets the full start-up instead.
+  FlightResumeState resume;
+  bool fastResume = loadFlightResumeState(resume);
+  if (fastResume && resume.resumeCount >= RTC_STATE_MAX_RESUMES) {
+    Serial.println("Reset in flight again, full start-up this time");
+    clearFlightResumeState();
+    fastResume = false;
+  }
+  if (fastResume) {
+    resumeFlight(resume);
+  } else {
+    initializeModules();
+  }
   
   // Create and start background task
   backgroundTaskRunning = true;
@@ -168,6 +211,128 @@ void SystemController::initialize() {
   Serial.println("System controller initialized");
 }
 
+void SystemController::initializeModules() {
+  // Initialize power manager first
+  powerManager.initialize();
+  yield(); // Feed watchdog
+  delay(100); // Small delay between initializations
+  
+  // Initialize communication modules with watchdog feeding
+  radioModule.initialize();
+  yield(); // Feed watchdog
+  delay(100); // Small delay
+  
+  wifiManager.initialize();
+  yield(); // Feed watchdog
+  powerSensor.initialize();
+  
+  // Set system controller reference in WiFi manager for SD card status
+  wifiManager.setSystemController(this);
+  
+  // Initialize SD card storage
+  sdManager.initialize();
+  yield(); // Feed watchdog
+  delay(100); // Small delay
+  
+  // IMU correction from the last calibration (before the sensor task starts)
+  loadImuCalibration();
+  
+  // Load and restore the persistent mode from previous session
+  SystemMode savedMode = loadPersistentMode();
+  Serial.print("Restoring to saved mode: ");
+  Serial.println(savedMode);
+  
+  // Set system to the restored mode
+  setMode(savedMode);
+  
+  // Pick up a log downlink that was interrupted by a power cycle
+  if (savedMode != MODE_FLIGHT) {
+    logDownlink.restore();
+  }
+}
+
+void SystemController::resumeFlight(const FlightResumeState& state) {
+  Serial.print("Reset in flight (");
+  Serial.print(FlightEventDetector::phaseName((FlightPhase)state.phase));
+  Serial.println("), fast resume");
+  resumeCount = state.resumeCount + 1;
+  
+  // Flight hardware only, without the power-up waits: the sensors and the
+  // radio kept power through the reset. WiFi stays off and the 250 ms
+  // mode transition steps are skipped.
+  powerManager.initialize();
+  radioModule.initialize(true);
+  imuSensor.initialize(true);
+  pressureSensor.initialize(true);
+  gpsModule.initialize(true);
+  powerSensor.initialize(true);
+  wifiManager.setSystemController(this);
+  // Flying before the SD manager starts, so it skips the clock self-test
+  // and leaves the black box scan and the log index to the background task
+  sdManager.setInFlight(true);
+  sdManager.initialize(); // Picks the log file up where it stopped
+  loadImuCalibration();
+  digitalWrite(CAMERA_POWER_PIN, HIGH);
+  powerManager.enableSensors();
+  
+  // Filters and flight phase from the snapshot (the sensor task isn't
+  // running yet). The restored altitude counts as fresh, so the first
+  // baro reading corrects it rather than starting over at rest.
+  altitudeEstimator.reset(state.altitude, state.velocity);
+  if (state.haveGravity) {
+    altitudeEstimator.setGravity(state.gravity);
+  }
+  if (state.attitudeAligned) {
+    attitudeEstimator.setQuaternion(state.quat[0], state.quat[1], state.quat[2], state.quat[3]);
+  }
+  flightEvents.resume((FlightPhase)state.phase, state.padAltitude, state.maxAltitude);
+  lastBaroFusion = millis();
+  lastEstimatorStep = micros();
+  lastAttitudeStep = lastEstimatorStep;
+  telemetryData.flight_phase = (FlightPhase)state.phase;
+  
+  currentMode = MODE_FLIGHT;
+  pendingMode = MODE_FLIGHT;
+  
+  Serial.print("Flight resumed ");
+  Serial.print(millis());
+  Serial.println(" ms after reset");
+}
+
+void SystemController::updateResumeState(unsigned long currentTime) {
+  // Only a reset off the pad is worth the fast path; on the ground the
+  // full start-up restores the mode as before
+  FlightPhase phase = flightEvents.getPhase();
+  if (currentMode != MODE_FLIGHT || phase == PHASE_PAD || phase == PHASE_LANDED) {
+    if (resumeStateSaved) {
+      clearFlightResumeState();
+      resumeStateSaved = false;
+      resumeCount = 0;
+    }
+    return;
+  }
+  if (resumeStateSaved && currentTime - lastResumeSave < RTC_STATE_SAVE_INTERVAL) {
+    return;
+  }
+  
+  FlightResumeState state;
+  memset(&state, 0, sizeof(state));
+  state.mode = currentMode;
+  state.phase = phase;
+  state.resumeCount = resumeCount;
+  state.padAltitude = flightEvents.getPadAltitude();
+  state.maxAltitude = flightEvents.getMaxAltitude();
+  state.altitude = altitudeEstimator.getAltitude();
+  state.velocity = altitudeEstimator.getVelocity();
+  state.haveGravity = altitudeEstimator.getGravity(state.gravity);
+  state.attitudeAligned = attitudeEstimator.isAligned();
+  attitudeEstimator.getQuaternion(state.quat[0], state.quat[1], state.quat[2], state.quat[3]);
+  state.savedMs = currentTime;
+  saveFlightResumeState(state);
+  lastResumeSave = currentTime;
+  resumeStateSaved = true;
+}
+
 void SystemController::update() {
   unsigned long currentTime = millis();
 
@@ -183,6 +348,29 @@ void SystemController::update() {
     lastRadioListen = currentTime;
   }
   
+  // Persist calibration steps finished by the sensor task (NVS writes are
+  // slow, so they stay out of the sensor loop)
+  if (calibrationSavePending) {
+    calibrationSavePending = false;
+    saveImuCalibration();
+  }
+  
+  // Flight events go out as soon as they are detected, ahead of telemetry pacing
+  FlightEvent flightEvent;
+  while (flightEventQueue != NULL && xQueueReceive(flightEventQueue, &flightEvent, 0) == pdTRUE) {
+    sendFlightEvent(flightEvent);
+  }
+  
+  VibrationSummary vibrationSummary;
+  while (vibrationQueue != NULL && xQueueReceive(vibrationQueue, &vibrationSummary, 0) == pdTRUE) {
+    sendVibrationSummary(vibrationSummary);
+  }
+  
+  // Stream log blocks between telemetry frames (never during flight)
+  if (currentMode != MODE_FLIGHT) {
+    logDownlink.service();
+  }
+  
   // Handle current mode (focused on telemetry transmission)
   switch (currentMode) {
     case MODE_SLEEP:
@@ -197,8 +385,13 @@ void SystemController::update() {
   }
 }
 
-void SystemController::setMode(SystemMode mode) {
-  if (mode != currentMode && transitionState == TRANSITION_IDLE) {
+bool SystemController::setMode(SystemMode mode) {
+  if (transitionState != TRANSITION_IDLE) {
+    // Re-requesting the mode already being entered is not an error
+    return mode == pendingMode;
+  }
+  
+  if (mode != currentMode) {
     Serial.print("Mode transition requested: ");
     Serial.print(currentMode);
     Serial.print(" -> ");
@@ -212,6 +405,8 @@ void SystemController::setMode(SystemMode mode) {
       maintenanceModeStartTime = millis();
     }
   }
+  
+  return true;
 }
 
 void SystemController::updateModeTransition() {
@@ -307,10 +502,12 @@ void SystemController::completeModeTransition() {
   // Handle power management and WiFi based on mode
   switch (pendingMode) {
     case MODE_FLIGHT:
+      logDownlink.stop(); // Flight telemetry owns the link
       powerManager.enableSensors();
       wifiManager.powerOff(); // Turn off WiFi during flight for power saving
       break;
     case MODE_MAINTENANCE:
+      flightEventsResetRequested = true; // Back on the ground, re-arm launch detection
       powerManager.enableSensors();
       wifiManager.powerOn(); // Turn on WiFi for maintenance
       wifiManager.connect(WIFI_SSID, WIFI_PASSWORD);
@@ -320,6 +517,7 @@ void SystemController::completeModeTransition() {
       }
       break;
     case MODE_SLEEP:
+      flightEventsResetRequested = true;
       // Ensure all data is written before sleep
       if (sdManager.isInitialized()) {
         sdManager.forceSync();
@@ -332,6 +530,7 @@ void SystemController::completeModeTransition() {
   // Transition complete
   currentMode = pendingMode;
   transitionState = TRANSITION_IDLE;
+  sdManager.setInFlight(currentMode == MODE_FLIGHT);
   
   // Save the new mode to persistent storage
   savePersistentMode(currentMode);
@@ -352,8 +551,10 @@ void SystemController::handleFlightMode() {
 void SystemController::handleMaintenanceMode() {
   unsigned long currentTime = millis();
   
-  // Send telemetry at radio transmission interval using latest sensor data
-  if (currentTime - lastRadioTx >= RADIO_TX_INTERVAL) {
+  // Send telemetry at radio transmission interval using latest sensor data,
+  // dropping to a low rate while a log downlink is using the link
+  unsigned long txInterval = logDownlink.isActive() ? DOWNLINK_TELEMETRY_INTERVAL : RADIO_TX_INTERVAL;
+  if (currentTime - lastRadioTx >= txInterval) {
     sendTelemetry();
   }
   
@@ -376,103 +577,341 @@ void SystemController::handleSleepMode() {
   // Power management is handled in mode transitions
 }
 
-void SystemController::checkAccelerationThreshold() {
-  // Only check acceleration in non-flight modes
-  if (currentMode == MODE_FLIGHT) {
-    return; // Already in flight mode, no need to check
-  }
-  
-  // Get a thread-safe copy of current telemetry data
-  TelemetryData telemetryCopy = getTelemetryDataCopy();
-  
-  // Only proceed if IMU data is valid
-  if (!telemetryCopy.imu_valid) {
-    return; // No valid IMU data to check
-  }
-  
-  // Calculate total acceleration magnitude (vector magnitude)
-  float totalAccel = sqrt(telemetryCopy.accel_x * telemetryCopy.accel_x + 
-                         telemetryCopy.accel_y * telemetryCopy.accel_y + 
-                         telemetryCopy.accel_z * telemetryCopy.accel_z);
-  
-  // Check if acceleration exceeds 2G threshold
-  if (totalAccel >= FLIGHT_MODE_ACCEL_THRESHOLD) {
-    Serial.print("High acceleration detected: ");
-    Serial.print(totalAccel);
-    Serial.println("g - Automatically switching to FLIGHT mode!");
-    setMode(MODE_FLIGHT);
-  }
-}
-
 void SystemController::updateSensors() {
   unsigned long currentTime = millis();
   unsigned long sensorStart = micros();
   
-  // Multi-rate sensor reading strategy for optimal performance
-  // Priority 1: High-speed sensors (IMU) - 40Hz (25ms interval)
-  // Priority 2: Medium-speed sensors (Pressure) - 10Hz (100ms interval) 
-  // Priority 3: Low-speed sensors (Power) - 5Hz (200ms interval)
-  // Priority 4: Very slow sensors (GPS) - 1Hz (1000ms interval)
+  // Multi-rate sensor reading strategy: the intervals follow the flight
+  // phase (see RATES_* in config.h). The sensor task period is the IMU
+  // interval, so the IMU is read on every cycle.
+  const SampleRates& rates = selectSampleRates(currentTime);
+  uint16_t period = sensorTaskPeriod;
   
   bool readGPS = false;
   bool readPressure = false; 
   bool readPower = false;
-  bool readIMU = false;
+  bool readIMU = true;
   bool anyDataUpdated = false;
   
   // Determine which sensors to read this cycle based on their individual timers
-  if (currentMode != MODE_SLEEP && (currentTime - lastGPSRead >= GPS_READ_INTERVAL)) {
+  if (currentMode != MODE_SLEEP && intervalElapsed(currentTime, lastGPSRead, rates.gps, period)) {
     readGPS = true;
     lastGPSRead = currentTime;
   }
   
-  if (currentMode != MODE_SLEEP && (currentTime - lastPressureRead >= PRESSURE_READ_INTERVAL)) {
+  if (currentMode != MODE_SLEEP && intervalElapsed(currentTime, lastPressureRead, rates.pressure, period)) {
     readPressure = true;
     lastPressureRead = currentTime;
   }
   
-  if (currentTime - lastPowerRead >= POWER_READ_INTERVAL) {
+  if (intervalElapsed(currentTime, lastPowerRead, rates.power, period)) {
     readPower = true; // Always read power for battery monitoring
     lastPowerRead = currentTime;
   }
   
-  // IMU should be read for acceleration detection in all modes
-  // In sleep mode, read at lower frequency; in active modes, read at high frequency
-  if (currentMode != MODE_SLEEP) {
-    readIMU = true; // Always read IMU at high frequency when not sleeping
-  } else {
-    // In sleep mode, read IMU at lower frequency for acceleration detection
-    if (currentTime - lastSensorRead >= 100) { // 10Hz in sleep mode vs 40Hz in active modes
-      readIMU = true;
-      lastSensorRead = currentTime;
-    }
-  }
+  // IMU is read in all modes for launch detection, at a low rate in sleep
+  lastSensorRead = currentTime;
+  sensorTaskPeriod = currentMode == MODE_SLEEP ? SLEEP_IMU_INTERVAL : rates.imu;
   
   // Pre-read sensor data outside of mutex to minimize lock time
   bool gpsValid = false;
-  float lat = 0, lon = 0, altGps = 0;
+  int32_t lat = 0, lon = 0;   // 1e-7 degrees
+  float altGps = 0;
+  int64_t gpsArrivalUs = 0;
   bool pressureValid = false;
   float pressure = 0, altPressure = 0;
+  int64_t pressureSampleUs = 0;
   PowerData powerData = {0};
   bool powerValid = false;
   IMUData imuData = {0};
   bool imuValid = false;
   
+  // GPS time: the UART is drained every cycle so each NMEA burst is
+  // timestamped to within a cycle. Times and PPS edges go to the time
+  // discipline in the order they happened; the SD manager names log
+  // files from its mapping.
+  if (currentMode != MODE_SLEEP) {
+    gpsModule.poll();
+    int64_t ppsUs = 0, arrivalUs = 0, utcMs = 0;
+    float arrivalSigmaUs = 0;
+    bool havePps = gpsModule.readPps(ppsUs);
+    bool haveTime = gpsModule.readTime(arrivalUs, arrivalSigmaUs, utcMs);
+    bool wasSynced = timeDiscipline.isSynced();
+    bool ppsFirst = havePps && (!haveTime || ppsUs <= arrivalUs);
+    if (ppsFirst) {
+      timeDiscipline.addPps(ppsUs);
+    }
+    if (haveTime) {
+      timeDiscipline.addNmeaTime(arrivalUs, utcMs, arrivalSigmaUs);
+    }
+    if (havePps && !ppsFirst) {
+      timeDiscipline.addPps(ppsUs);
+    }
+    if ((havePps || haveTime) && timeDiscipline.isSynced()) {
+      if (!wasSynced) {
+        char stamp[UTC_STAMP_LENGTH];
+        formatUtcStamp(stamp, sizeof(stamp), timeDiscipline.toUtcMs(esp_timer_get_time()));
+        Serial.print("GPS time synced: ");
+        Serial.println(stamp);
+      }
+      sdManager.setUtcMapping(timeDiscipline.getMapping());
+    }
+  }
+  
   // Read sensors based on their schedules (non-blocking approach)
   if (readGPS) {
-    gpsValid = gpsModule.readData(lat, lon, altGps);
+    gpsValid = gpsModule.readData(lat, lon, altGps, gpsArrivalUs);
   }
   
   if (readPressure) {
-    pressureValid = pressureSensor.readData(pressure, altPressure);
+    pressureValid = pressureSensor.readData(pressure, altPressure, pressureSampleUs);
   }
   
   if (readPower) {
     powerValid = powerSensor.readData(powerData);
   }
   
+  // IMU: drain the FIFO and decimate it per consumer; the estimators
+  // get the batch mean
+  uint8_t freshStreams = 0;
+  bool vibrationReady = false;
+  VibrationSummary vibrationSummary;
   if (readIMU) {
+#if IMU_FIFO_ENABLED
+    if (imuSensor.isValid()) {
+      configureImuStreams(rates);
+    }
+    imuValid = imuSensor.readBatch(imuBatch, imuData);
+    if (imuBatch.overflow) {
+      perfMetrics.imuFifoOverflows++;
+    }
+    if (imuValid) {
+      uint32_t cycleStart = ESP.getCycleCount();
+      freshStreams = imuDecimator.process(imuBatch.samples, imuBatch.count, imuBatch.clipped);
+      float accel[3], gyro[3];
+      imuDecimator.getOutput(IMU_STREAM_FILTER, accel, gyro);
+      imuData.accel_x = accel[0];
+      imuData.accel_y = accel[1];
+      imuData.accel_z = accel[2];
+      imuData.gyro_x = gyro[0];
+      imuData.gyro_y = gyro[1];
+      imuData.gyro_z = gyro[2];
+      uint32_t cycles = ESP.getCycleCount() - cycleStart;
+      updatePerformanceMetrics(cycles, &perfMetrics.decimationCycles, &perfMetrics.maxDecimationCycles);
+      perfMetrics.imuFifoSamples += imuBatch.count;
+    }
+    
+#if VIB_ANALYSIS_ENABLED
+    // Vibration spectra in flight only, restarted on a FIFO rate change
+    // and after any gap in the samples
+    float vibrationRate = currentMode == MODE_FLIGHT && imuSensor.getFifoInterval() > 0 ?
+                          1000.0f / imuSensor.getFifoInterval() : 0.0f;
+    if (vibrationRate != vibrationAnalyzer.getSampleRate()) {
+      vibrationAnalyzer.reset(vibrationRate);
+    }
+    if (imuValid && vibrationRate > 0) {
+      uint32_t blocksBefore = vibrationAnalyzer.getBlocksAnalyzed();
+      uint32_t cycleStart = ESP.getCycleCount();
+      vibrationReady = vibrationAnalyzer.process(imuBatch.samples, imuBatch.count, imuBatch.clipped,
+                                                 currentTime, vibrationSummary);
+      uint32_t cycles = ESP.getCycleCount() - cycleStart;
+      if (vibrationAnalyzer.getBlocksAnalyzed() != blocksBefore) {
+        updatePerformanceMetrics(cycles, &perfMetrics.vibrationBlockCycles, &perfMetrics.maxVibrationBlockCycles);
+      }
+    }
+    if (imuBatch.overflow || (imuValid && imuData.rangeChanged)) {
+      vibrationAnalyzer.restartBlock();
+    }
+#endif
+#else
     imuValid = imuSensor.readData(imuData);
+#endif
+  }
+  
+  bool imuSampleValid = readIMU && imuValid && imuData.valid;
+  
+  // How long the board was blind after the reset, fast resume or not
+  if (imuSampleValid && !firstSampleLogged) {
+    firstSampleLogged = true;
+    Serial.print("First IMU sample ");
+    Serial.print(millis());
+    Serial.println(" ms after boot");
+  }
+  
+  if (imuSampleValid) {
+    updatePerformanceMetrics(imuSensor.getRangeCheckCycles(), &perfMetrics.imuRangeCheckCycles,
+                             &perfMetrics.maxImuRangeCheckCycles);
+    if (imuData.rangeChanged) {
+      perfMetrics.imuRangeSwitches++;
+    }
+  }
+  
+  // Calibration: collection steps see the raw reading, everything
+  // downstream sees the corrected one
+  ImuStreamSample streamSamples[IMU_STREAM_COUNT];
+  if (imuSampleValid) {
+    uint32_t cycleStart = ESP.getCycleCount();
+    float gyro[3] = {imuData.gyro_x, imuData.gyro_y, imuData.gyro_z};
+    float accel[3] = {imuData.accel_x, imuData.accel_y, imuData.accel_z};
+    float mag[3] = {imuData.mag_x, imuData.mag_y, imuData.mag_z};
+    if (calibrationActive) {
+      updateCalibration(gyro, accel, mag);
+    }
+    for (uint8_t s = IMU_STREAM_FILTER + 1; s < IMU_STREAM_COUNT; s++) {
+      if (!(freshStreams & (1 << s))) {
+        continue;
+      }
+      ImuStreamSample& sample = streamSamples[s];
+      float streamMag[3] = {mag[0], mag[1], mag[2]};
+      imuDecimator.getOutput((ImuStream)s, sample.accel, sample.gyro);
+      applyImuCalibration(imuCalibration, sample.gyro, sample.accel, streamMag);
+      sample.clipped = imuDecimator.getOutputClipped((ImuStream)s);
+      sample.valid = true;
+    }
+    applyImuCalibration(imuCalibration, gyro, accel, mag);
+    imuData.gyro_x = gyro[0];
+    imuData.gyro_y = gyro[1];
+    imuData.gyro_z = gyro[2];
+    imuData.accel_x = accel[0];
+    imuData.accel_y = accel[1];
+    imuData.accel_z = accel[2];
+    imuData.mag_x = mag[0];
+    imuData.mag_y = mag[1];
+    imuData.mag_z = mag[2];
+    uint32_t cycles = ESP.getCycleCount() - cycleStart;
+    updatePerformanceMetrics(cycles, &perfMetrics.imuCorrectionCycles, &perfMetrics.maxImuCorrectionCycles);
+  }
+  
+  // Attitude filter at IMU rate, aligned from the first reading near 1 g
+  if (imuSampleValid) {
+    unsigned long attitudeStart = micros();
+    uint32_t cycleStart = ESP.getCycleCount();
+    
+    if (!attitudeEstimator.isAligned()) {
+      float accelMagnitude = sqrtf(imuData.accel_x * imuData.accel_x +
+                                   imuData.accel_y * imuData.accel_y +
+                                   imuData.accel_z * imuData.accel_z);
+      if (fabsf(accelMagnitude - 1.0f) < AHRS_ACCEL_GATE) {
+        attitudeEstimator.align(imuData.accel_x, imuData.accel_y, imuData.accel_z);
+      }
+    } else {
+      float dt = (attitudeStart - lastAttitudeStep) / 1000000.0f;
+      if (dt > AHRS_MAX_DT) {
+        dt = AHRS_MAX_DT;
+      }
+#if AHRS_USE_MAG
+      // AK8963 axes: x and y swapped and z inverted relative to the accel
+      attitudeEstimator.update(imuData.gyro_x, imuData.gyro_y, imuData.gyro_z,
+                               imuData.accel_x, imuData.accel_y, imuData.accel_z,
+                               imuData.mag_y, imuData.mag_x, -imuData.mag_z, dt);
+#else
+      attitudeEstimator.update(imuData.gyro_x, imuData.gyro_y, imuData.gyro_z,
+                               imuData.accel_x, imuData.accel_y, imuData.accel_z, dt);
+#endif
+    }
+    lastAttitudeStep = attitudeStart;
+    
+    uint32_t cycles = ESP.getCycleCount() - cycleStart;
+    updatePerformanceMetrics(cycles, &perfMetrics.attitudeStepCycles, &perfMetrics.maxAttitudeStepCycles);
+  }
+  
+  // Altitude/velocity filter: predict at IMU rate, correct on each baro reading
+  float verticalAccel = 0.0f;
+  bool estimatorStepped = false;
+  bool estimatorValid = false;
+  if (readIMU || (readPressure && pressureValid)) {
+    unsigned long estimatorStart = micros();
+    
+    if (imuSampleValid) {
+      altitudeEstimator.observeGravity(imuData.accel_x, imuData.accel_y, imuData.accel_z,
+                                       imuData.gyro_x, imuData.gyro_y, imuData.gyro_z);
+      // Gravity removal through the AHRS attitude; the rest-vector
+      // projection covers the time before the AHRS has aligned
+      if (attitudeEstimator.isAligned()) {
+        verticalAccel = attitudeEstimator.verticalAccel(imuData.accel_x, imuData.accel_y, imuData.accel_z);
+      } else {
+        verticalAccel = altitudeEstimator.verticalAccel(imuData.accel_x, imuData.accel_y, imuData.accel_z);
+      }
+    }
+    
+    if (readPressure && pressureValid && currentTime - lastBaroFusion >= ALT_KF_BARO_TIMEOUT) {
+      // First reading, or the state went stale while the baro was off
+      altitudeEstimator.reset(altPressure);
+    } else {
+      altitudeEstimator.predict(verticalAccel, (estimatorStart - lastEstimatorStep) / 1000000.0f);
+      if (readPressure && pressureValid) {
+        altitudeEstimator.correct(altPressure);
+      }
+    }
+    if (readPressure && pressureValid) {
+      lastBaroFusion = currentTime;
+    }
+    lastEstimatorStep = estimatorStart;
+    
+    estimatorStepped = true;
+    estimatorValid = altitudeEstimator.isInitialized() && currentTime - lastBaroFusion < ALT_KF_BARO_TIMEOUT;
+    unsigned long estimatorTime = micros() - estimatorStart;
+    updatePerformanceMetrics(estimatorTime, &perfMetrics.estimatorStepTime, &perfMetrics.maxEstimatorStepTime);
+  }
+  
+  // GPS/INS position: predict at IMU rate with the AHRS earth-frame accel,
+  // correct on each fix and baro reading. A fix after a long gap starts over.
+  bool navStepped = false;
+  bool navValid = false;
+  if (readIMU || (readGPS && gpsValid) || (readPressure && pressureValid)) {
+    unsigned long navStart = micros();
+    uint32_t cycleStart = ESP.getCycleCount();
+    
+    float earthAccel[3] = {0.0f, 0.0f, 0.0f};
+    if (imuSampleValid && attitudeEstimator.isAligned()) {
+      attitudeEstimator.earthAccel(imuData.accel_x, imuData.accel_y, imuData.accel_z, earthAccel);
+    }
+    if (readGPS && gpsValid && (!navFilter.isInitialized() || currentTime - lastGpsFusion >= NAV_GPS_TIMEOUT)) {
+      navFilter.reset(lat, lon, altGps);
+    } else {
+      navFilter.predict(earthAccel, (navStart - lastNavStep) / 1000000.0f);
+      if (readGPS && gpsValid) {
+        navFilter.correctGps(lat, lon, altGps);
+      }
+    }
+    if (readPressure && pressureValid) {
+      navFilter.correctBaro(altPressure);
+    }
+    if (readGPS && gpsValid) {
+      lastGpsFusion = currentTime;
+    }
+    lastNavStep = navStart;
+    
+    navStepped = true;
+    navValid = navFilter.isInitialized() && currentTime - lastGpsFusion < NAV_GPS_TIMEOUT;
+    uint32_t cycles = ESP.getCycleCount() - cycleStart;
+    updatePerformanceMetrics(cycles, &perfMetrics.navStepCycles, &perfMetrics.maxNavStepCycles);
+  }
+  
+  // Flight phase tracking on the same samples as the filter
+  if (flightEventsResetRequested) {
+    flightEvents.reset();
+    apogeeDetectedMs = 0;
+    flightEventsResetRequested = false;
+  }
+  bool eventFired = false;
+  FlightEvent flightEvent;
+  if (estimatorStepped) {
+    FlightEventInput input;
+    input.timeMs = currentTime;
+    input.imuValid = imuSampleValid;
+    input.accelMagnitude = imuSampleValid ? sqrtf(imuData.accel_x * imuData.accel_x +
+                                                  imuData.accel_y * imuData.accel_y +
+                                                  imuData.accel_z * imuData.accel_z) : 0.0f;
+    input.verticalAccel = verticalAccel;
+    input.estimatorValid = estimatorValid;
+    input.altitude = altitudeEstimator.getAltitude();
+    input.velocity = altitudeEstimator.getVelocity();
+    eventFired = flightEvents.update(input, flightEvent);
+    if (eventFired && flightEvent.type == EVENT_APOGEE) {
+      apogeeDetectedMs = flightEvent.detectMs;
+    }
+    updateResumeState(currentTime);
   }
   
   // Quick mutex lock to update telemetry data
@@ -483,6 +922,8 @@ void SystemController::updateSensors() {
       telemetryData.longitude = lon;
       telemetryData.altitude_gps = altGps;
       telemetryData.gps_valid = true;
+      telemetryData.gps_time_us = gpsArrivalUs - (int64_t)lroundf(timeDiscipline.getNmeaLatencyMs() * 1000.0f);
+      sdFreshGroups |= SD_GROUP_GPS;
       anyDataUpdated = true;
     }
     
@@ -491,6 +932,8 @@ void SystemController::updateSensors() {
       telemetryData.pressure = pressure;
       telemetryData.altitude_pressure = altPressure;
       telemetryData.pressure_valid = true;
+      telemetryData.pressure_time_us = pressureSampleUs;
+      sdFreshGroups |= SD_GROUP_PRESSURE;
       anyDataUpdated = true;
     }
     
@@ -507,7 +950,23 @@ void SystemController::updateSensors() {
       telemetryData.mag_z = imuData.mag_z;
       telemetryData.imu_temperature = imuData.temperature;
       telemetryData.imu_valid = true;
+      telemetryData.accel_range = imuData.accel_range;
+      telemetryData.gyro_range = imuData.gyro_range;
+      telemetryData.imu_clipped = imuData.clipped;
+      telemetryData.imu_time_us = imuData.timestamp_us;
+      sdFreshGroups |= SD_GROUP_IMU;
       anyDataUpdated = true;
+      
+      for (uint8_t s = IMU_STREAM_FILTER + 1; s < IMU_STREAM_COUNT; s++) {
+        if (freshStreams & (1 << s)) {
+          imuStreams[s] = streamSamples[s];
+        }
+      }
+      
+      attitudeEstimator.getQuaternion(telemetryData.quat_w, telemetryData.quat_x,
+                                      telemetryData.quat_y, telemetryData.quat_z);
+      attitudeEstimator.getEuler(telemetryData.roll, telemetryData.pitch, telemetryData.yaw);
+      telemetryData.attitude_valid = attitudeEstimator.isAligned();
     }
     
     // Update power data (only when read and valid)
@@ -516,29 +975,124 @@ void SystemController::updateSensors() {
       telemetryData.current = powerData.current * -1.66;
       telemetryData.power = powerData.power * 1.66;
       telemetryData.power_valid = true;
+      telemetryData.power_time_us = powerData.timestamp_us;
+      sdFreshGroups |= SD_GROUP_POWER;
       anyDataUpdated = true;
     }
     
+    // Update filtered altitude/velocity (follows every filter step)
+    if (estimatorStepped) {
+      telemetryData.altitude_filtered = altitudeEstimator.getAltitude();
+      telemetryData.vertical_velocity = altitudeEstimator.getVelocity();
+      telemetryData.estimator_valid = estimatorValid;
+      telemetryData.flight_phase = flightEvents.getPhase();
+      // Fresh on a baro correction; in between, past a deadband when logged
+      if (readPressure && pressureValid) {
+        sdFreshGroups |= SD_GROUP_ALTITUDE;
+      }
+    }
+    
+    // Update GPS/INS position and velocity (follows every filter step)
+    if (navStepped) {
+      float navAltitude;
+      navFilter.getPosition(telemetryData.nav_latitude, telemetryData.nav_longitude, navAltitude);
+      telemetryData.velocity_east = navFilter.getState(NAV_VE);
+      telemetryData.velocity_north = navFilter.getState(NAV_VN);
+      telemetryData.nav_valid = navValid;
+      // Fresh on a GPS fix; in between, past a deadband when logged
+      if (readGPS && gpsValid) {
+        sdFreshGroups |= SD_GROUP_NAV;
+      }
+    }
+    
+    // Events bypass the SD batch so they survive a crash right after; only
+    // queued here, the background task writes them
+    if (eventFired && sdManager.isInitialized()) {
+      char eventLine[96];
+      snprintf(eventLine, sizeof(eventLine), "%s,%lu,%lu,%lu,%.2f,%.2f",
+               FlightEventDetector::eventName(flightEvent.type), (unsigned long)flightEvent.onsetMs,
+               (unsigned long)flightEvent.detectMs, millis(), flightEvent.altitude, flightEvent.velocity);
+      sdManager.logEvent(eventLine);
+    }
+    
+    // Range switches go to the same event log; the row names the new
+    // ranges, onset and detection are the sample that caused the switch
+    if (imuSampleValid && imuData.rangeChanged) {
+      char rangeLine[96];
+      snprintf(rangeLine, sizeof(rangeLine), "RANGE_%.0fG_%.0fDPS,%lu,%lu,%lu,%.2f,%.2f",
+               imuSensor.getAccelRange(), imuSensor.getGyroRange(), currentTime, currentTime, millis(),
+               altitudeEstimator.getAltitude(), altitudeEstimator.getVelocity());
+      Serial.print("IMU range switch: ");
+      Serial.println(rangeLine);
+      if (sdManager.isInitialized()) {
+        sdManager.logEvent(rangeLine);
+      }
+    }
+    
+    // Vibration summaries go to their own file on the card, written by the
+    // background task; the radio copy is queued for the main loop
+    if (vibrationReady && sdManager.isInitialized()) {
+      char header[VIB_CSV_LINE_LENGTH];
+      char line[VIB_CSV_LINE_LENGTH];
+      if (VibrationAnalyzer::formatCsvHeader(header, sizeof(header)) > 0 &&
+          VibrationAnalyzer::formatCsv(line, sizeof(line), vibrationSummary) > 0) {
+        sdManager.logVibration(header, line);
+      }
+    }
+    
     // Always update timestamp and mode when any data is updated
     if (anyDataUpdated) {
+      int64_t nowUs = esp_timer_get_time();
       telemetryData.timestamp = millis();
+      telemetryData.utc_ms = timeDiscipline.toUtcMs(nowUs);
+      telemetryData.time_source = timeDiscipline.getSource(nowUs);
       telemetryData.mode = currentMode;
       
-      // Log to SD card immediately when any new sensor data is available
-      if (sdManager.isInitialized()) {
-        unsigned long sdStart = micros();
-        sdManager.addData(telemetryData);
-        unsigned long sdTime = micros() - sdStart;
-        updatePerformanceMetrics(sdTime, &perfMetrics.sdWriteTime, &perfMetrics.maxSdWriteTime);
+      // Log to SD card at the phase's log rate; a record carries the
+      // latest value of each group updated since the last one, so skipped
+      // samples show up in the next record
+      if (sdManager.isLogging()) {
+        if (intervalElapsed(currentTime, lastSdLog, rates.sdLog, period)) {
+          unsigned long sdStart = micros();
+          TelemetryData row = telemetryData;
+          applyImuStream(row, IMU_STREAM_SD);
+          sdManager.addData(row, sdFreshGroups);
+          sdFreshGroups = 0;
+          unsigned long sdTime = micros() - sdStart;
+          updatePerformanceMetrics(sdTime, &perfMetrics.sdWriteTime, &perfMetrics.maxSdWriteTime);
+          lastSdLog = currentTime;
+          perfMetrics.sdRowsLogged++;
+        } else {
+          perfMetrics.sdRowsSkipped++;
+        }
       }
     }
     
     xSemaphoreGive(telemetryMutex);
     
-    // Check acceleration threshold for automatic flight mode activation
-    // (Only check when IMU data was updated and is valid)
-    if (readIMU && imuValid) {
-      checkAccelerationThreshold();
+    if (vibrationReady) {
+      perfMetrics.vibrationSummaries++;
+#if VIB_DOWNLINK
+      if (xQueueSend(vibrationQueue, &vibrationSummary, 0) != pdTRUE) {
+        Serial.println("Warning: Vibration queue full, summary not sent");
+      }
+#endif
+    }
+    
+    if (eventFired) {
+      Serial.printf("Flight event %s at %lu ms (onset %lu ms), alt %.1f m, vel %.1f m/s\n",
+                    FlightEventDetector::eventName(flightEvent.type),
+                    (unsigned long)flightEvent.detectMs, (unsigned long)flightEvent.onsetMs,
+                    flightEvent.altitude, flightEvent.velocity);
+      if (xQueueSend(flightEventQueue, &flightEvent, 0) != pdTRUE) {
+        Serial.println("Warning: Flight event queue full, event not sent");
+      }
+      
+      // Launch detection replaces the old single-sample 2 g check
+      if (flightEvent.type == EVENT_LAUNCH && currentMode != MODE_FLIGHT) {
+        Serial.println("Launch detected - Automatically switching to FLIGHT mode!");
+        setMode(MODE_FLIGHT);
+      }
     }
     
     // Update performance metrics
@@ -565,23 +1119,283 @@ void SystemController::updateSensors() {
   }
 }
 
+// FIFO rate follows the flight phase; each consumer stream decimates it
+// down to the rate that consumer reads at
+void SystemController::configureImuStreams(const SampleRates& rates) {
+  uint8_t interval = currentMode == MODE_SLEEP ? SLEEP_IMU_FIFO_INTERVAL : rates.imuFifo;
+  if (interval != imuSensor.getFifoInterval() && !imuSensor.configureFifo(interval)) {
+    return;
+  }
+  imuDecimator.configure(IMU_STREAM_SD, rates.sdLog / interval);
+  imuDecimator.configure(IMU_STREAM_RADIO, RADIO_TX_INTERVAL / interval);
+  imuDecimator.configure(IMU_STREAM_WEB, WEB_IMU_INTERVAL / interval);
+}
+
+// Swaps the batch-mean IMU values for a consumer stream's output; caller
+// holds telemetryMutex
+void SystemController::applyImuStream(TelemetryData& data, ImuStream stream) const {
+  const ImuStreamSample& sample = imuStreams[stream];
+  if (stream == IMU_STREAM_FILTER || !sample.valid) {
+    return;
+  }
+  data.accel_x = sample.accel[0];
+  data.accel_y = sample.accel[1];
+  data.accel_z = sample.accel[2];
+  data.gyro_x = sample.gyro[0];
+  data.gyro_y = sample.gyro[1];
+  data.gyro_z = sample.gyro[2];
+  data.imu_clipped = sample.clipped;
+}
+
+void SystemController::updateCalibration(float gyro[3], float accel[3], float mag[3]) {
+  if (xSemaphoreTake(calibrationMutex, 0) != pdTRUE) {
+    return; // A command is changing the calibrator, catch the next sample
+  }
+  
+  bool collecting = imuCalibrator.getStep() != ImuCalibrator::STEP_IDLE;
+  if (collecting && imuCalibrator.addSample(gyro, accel, mag)) {
+    const char* error = imuCalibrator.getError();
+    Serial.print("IMU calibration step finished: ");
+    Serial.println(error ? error : "OK");
+    if (!error) {
+      calibrationSavePending = true;
+    }
+  }
+  imuCalibration = imuCalibrator.getCalibration();
+  calibrationActive = imuCalibrator.getStep() != ImuCalibrator::STEP_IDLE;
+  
+  xSemaphoreGive(calibrationMutex);
+}
+
+const char* SystemController::executeCalibrationCommand(const char* name, const char* args, char* detail, size_t detailSize) {
+  detail[0] = '\0';
+  
+  bool isStatus = strcmp(name, CMD_CAL_STATUS) == 0;
+  if (!isStatus && (currentMode == MODE_FLIGHT || pendingMode == MODE_FLIGHT)) {
+    snprintf(detail, detailSize, "in flight");
+    return ACK_STATUS_BUSY;
+  }
+  
+  if (xSemaphoreTake(calibrationMutex, pdMS_TO_TICKS(50)) != pdTRUE) {
+    snprintf(detail, detailSize, "locked");
+    return ACK_STATUS_BUSY;
+  }
+  
+  const char* status = ACK_STATUS_OK;
+  bool known = true;
+  bool clearSaved = false;
+  if (isStatus) {
+    // Report only
+  } else if (strcmp(name, CMD_CAL_GYRO) == 0) {
+    status = imuCalibrator.startGyro() ? ACK_STATUS_OK : ACK_STATUS_BUSY;
+  } else if (strcmp(name, CMD_CAL_ACCEL) == 0) {
+    AccelFace face;
+    if (!ImuCalibrator::parseFace(args, face)) {
+      snprintf(detail, detailSize, "bad face");
+      status = ACK_STATUS_ERROR;
+    } else {
+      status = imuCalibrator.startAccelFace(face) ? ACK_STATUS_OK : ACK_STATUS_BUSY;
+    }
+  } else if (strcmp(name, CMD_CAL_MAG_START) == 0) {
+    status = imuCalibrator.startMag() ? ACK_STATUS_OK : ACK_STATUS_BUSY;
+  } else if (strcmp(name, CMD_CAL_MAG_END) == 0) {
+    if (imuCalibrator.finishMag()) {
+      calibrationSavePending = true;
+    } else {
+      status = ACK_STATUS_ERROR;
+    }
+  } else if (strcmp(name, CMD_CAL_CANCEL) == 0) {
+    imuCalibrator.cancel();
+  } else if (strcmp(name, CMD_CAL_CLEAR) == 0) {
+    imuCalibrator.cancel();
+    ImuCalibration cleared;
+    ImuCalibrator::clear(cleared);
+    imuCalibrator.setCalibration(cleared);
+    clearSaved = true;
+  } else {
+    known = false;
+    status = ACK_STATUS_UNKNOWN;
+  }
+  
+  // The sensor task picks up new steps and corrections on its next sample
+  if (known && !isStatus) {
+    calibrationActive = true;
+  }
+  if (known && detail[0] == '\0') {
+    imuCalibrator.formatStatus(detail, detailSize);
+  }
+  xSemaphoreGive(calibrationMutex);
+  
+  if (clearSaved && preferences.begin(PREFS_NAMESPACE, false)) {
+    preferences.remove(PREFS_IMU_CAL_KEY);
+    preferences.end();
+  }
+  return status;
+}
+
+const SampleRates& SystemController::selectSampleRates(unsigned long currentTime) const {
+  FlightPhase phase = flightEvents.getPhase();
+  
+  // Full rate from the slow end of coast until shortly after apogee
+  if (phase == PHASE_COAST && altitudeEstimator.getVelocity() < RATES_APOGEE_VELOCITY) {
+    return apogeeRates;
+  }
+  if (phase == PHASE_DESCENT && currentTime - apogeeDetectedMs < RATES_APOGEE_HOLD) {
+    return apogeeRates;
+  }
+  return phaseRates[phase];
+}
+
 void SystemController::checkRadioCommands() {
   String command = radioModule.receiveCommand();
   
-  if (command.length() > 0) {
-    Serial.print("Received command: ");
-    Serial.println(command);
-    radioModule.sendAcknowledgment("Received command: " + command);
-    if (command == CMD_FLIGHT_MODE) {
-      setMode(MODE_FLIGHT);
-    } else if (command == CMD_SLEEP_MODE) {
-      setMode(MODE_SLEEP);
-    } else if (command == CMD_MAINTENANCE_MODE) {
-      setMode(MODE_MAINTENANCE);
-    } else if (command == CMD_CAM_TOGGLE) {
-      pulseCameraPin();
+  if (command.length() == 0) {
+    return;
+  }
+  
+  if (command.startsWith(CMD_FRAME_PREFIX)) {
+    handleCommandFrame(command.c_str());
+    return;
+  }
+  
+  // Legacy bare commands: no sequencing or integrity check
+  Serial.print("Received command: ");
+  Serial.println(command);
+  radioModule.sendAcknowledgment("Received command: " + command);
+  char detail[CMD_MAX_ARGS_LENGTH];
+  executeCommand(command.c_str(), "", detail, sizeof(detail));
+}
+
+void SystemController::handleCommandFrame(const char* line) {
+  CommandFrame frame;
+  if (!CommandProtocol::parseCommand(line, frame)) {
+    perfMetrics.commandFrameErrors++;
+    Serial.println("Dropped corrupt command frame");
+    return;
+  }
+  
+  // Retransmission of a command we already executed: replay the ack only
+  if (hasLastCommand && frame.seq == lastCommandSeq) {
+    perfMetrics.commandDuplicates++;
+    radioModule.sendLine(lastAckFrame);
+    return;
+  }
+  
+  Serial.print("Received command #");
+  Serial.print(frame.seq);
+  Serial.print(": ");
+  Serial.println(frame.name);
+  
+  char detail[CMD_MAX_ARGS_LENGTH];
+  detail[0] = '\0';
+  unsigned long execStart = micros();
+  const char* status = executeCommand(frame.name, frame.args, detail, sizeof(detail));
+  unsigned long execTime = micros() - execStart;
+  updatePerformanceMetrics(execTime, &perfMetrics.commandExecTime, &perfMetrics.maxCommandExecTime);
+  perfMetrics.commandsExecuted++;
+  
+  if (CommandProtocol::formatAck(lastAckFrame, sizeof(lastAckFrame), frame.seq, status, execTime, detail) == 0) {
+    lastAckFrame[0] = '\0';
+    return;
+  }
+  lastCommandSeq = frame.seq;
+  hasLastCommand = true;
+  radioModule.sendLine(lastAckFrame);
+}
+
+const char* SystemController::executeCommand(const char* name, const char* args, char* detail, size_t detailSize) {
+  detail[0] = '\0';
+  
+  SystemMode requestedMode;
+  if (strcmp(name, CMD_FLIGHT_MODE) == 0) {
+    requestedMode = MODE_FLIGHT;
+  } else if (strcmp(name, CMD_SLEEP_MODE) == 0) {
+    requestedMode = MODE_SLEEP;
+  } else if (strcmp(name, CMD_MAINTENANCE_MODE) == 0) {
+    requestedMode = MODE_MAINTENANCE;
+  } else if (strcmp(name, CMD_CAM_TOGGLE) == 0) {
+    pulseCameraPin();
+    return ACK_STATUS_OK;
+  } else if (strcmp(name, CMD_PING) == 0) {
+    // The ground takes the offset from the midpoint of its send/receive times
+    snprintf(detail, detailSize, "ms=%lu,seq=%lu", millis(), (unsigned long)radioModule.getTelemetrySequence());
+    perfMetrics.pingsAnswered++;
+    return ACK_STATUS_OK;
+  } else if (strcmp(name, CMD_LINK_REPORT) == 0) {
+    unsigned long received, lost, jitter;
+    long latency;
+    if (sscanf(args, "%lu,%lu,%lu,%ld", &received, &lost, &jitter, &latency) != 4) {
+      snprintf(detail, detailSize, "bad args");
+      return ACK_STATUS_ERROR;
+    }
+    perfMetrics.groundFramesReceived = received;
+    perfMetrics.groundFramesLost = lost;
+    perfMetrics.groundJitterMicros = jitter;
+    perfMetrics.groundLatencyMs = latency;
+    return ACK_STATUS_OK;
+  } else if (strcmp(name, CMD_SD_BENCH) == 0) {
+    // Runs from the background task on its next update
+    if (currentMode == MODE_FLIGHT || pendingMode == MODE_FLIGHT || !sdManager.requestWriteBenchmark()) {
+      snprintf(detail, detailSize, "in flight or no card");
+      return ACK_STATUS_BUSY;
+    }
+    return ACK_STATUS_OK;
+  } else if (strncmp(name, "DL_", 3) == 0) {
+    return executeDownlinkCommand(name, args, detail, detailSize);
+  } else if (strncmp(name, "CAL_", 4) == 0) {
+    return executeCalibrationCommand(name, args, detail, detailSize);
+  } else {
+    return ACK_STATUS_UNKNOWN;
+  }
+  
+  bool accepted = setMode(requestedMode);
+  snprintf(detail, detailSize, "mode=%d,pending=%d", currentMode,
+           transitionState == TRANSITION_IDLE ? currentMode : pendingMode);
+  return accepted ? ACK_STATUS_OK : ACK_STATUS_BUSY;
+}
+
+const char* SystemController::executeDownlinkCommand(const char* name, const char* args, char* detail, size_t detailSize) {
+  if (strcmp(name, CMD_DOWNLINK_STATUS) == 0) {
+    logDownlink.formatStatus(detail, detailSize);
+    return ACK_STATUS_OK;
+  }
+  
+  if (strcmp(name, CMD_DOWNLINK_STOP) == 0) {
+    logDownlink.stop();
+    return ACK_STATUS_OK;
+  }
+  
+  if (currentMode == MODE_FLIGHT || pendingMode == MODE_FLIGHT) {
+    snprintf(detail, detailSize, "in flight");
+    return ACK_STATUS_BUSY;
+  }
+  
+  if (strcmp(name, CMD_DOWNLINK_START) == 0) {
+    // DL_START,<file>[,<first>,<last>]
+    char file[CMD_MAX_ARGS_LENGTH];
+    strncpy(file, args, sizeof(file) - 1);
+    file[sizeof(file) - 1] = '\0';
+    uint32_t first = 0;
+    uint32_t last = UINT32_MAX;
+    char* comma = strchr(file, ',');
+    if (comma) {
+      *comma = '\0';
+      char* end = NULL;
+      first = strtoul(comma + 1, &end, 10);
+      if (end && *end == ',') {
+        last = strtoul(end + 1, NULL, 10);
+      }
     }
+    return logDownlink.start(String(file), first, last, detail, detailSize) ? ACK_STATUS_OK : ACK_STATUS_ERROR;
   }
+  
+  if (strcmp(name, CMD_DOWNLINK_RANGE) == 0) {
+    bool queued = logDownlink.queueRanges(args);
+    logDownlink.formatStatus(detail, detailSize);
+    return queued ? ACK_STATUS_OK : ACK_STATUS_ERROR;
+  }
+  
+  return ACK_STATUS_UNKNOWN;
 }
 
 void SystemController::pulseCameraPin() {
@@ -646,8 +1460,13 @@ void SystemController::sendTelemetry() {
     return; // Skip transmission if interval hasn't elapsed
   }
   
-  // Get a thread-safe copy of the latest sensor data
-  TelemetryData telemetryCopy = getTelemetryDataCopy();
+  // Get a thread-safe copy of the latest sensor data, IMU at the radio rate
+  TelemetryData telemetryCopy = getTelemetryDataCopy(IMU_STREAM_RADIO);
+  
+  // Sample age at enqueue; the ground adds the air/queue leg from the frame stamps
+  unsigned long sampleAge = millis() - telemetryCopy.timestamp;
+  updatePerformanceMetrics(sampleAge, &perfMetrics.telemetrySampleAge, &perfMetrics.maxTelemetrySampleAge);
+  perfMetrics.telemetryFramesSent++;
   
   // Send telemetry over radio (time critical) with performance monitoring
   unsigned long radioStart = micros();
@@ -661,6 +1480,27 @@ void SystemController::sendTelemetry() {
   // Note: SD card logging is now handled in updateSensors() for higher frequency logging
 }
 
+void SystemController::sendFlightEvent(const FlightEvent& event) {
+  char line[CMD_MAX_LINE_LENGTH];
+  uint32_t txMs = millis();
+  if (FlightEventDetector::formatEvent(line, sizeof(line), event, txMs) == 0) {
+    return;
+  }
+  radioModule.sendLine(line);
+  
+  perfMetrics.flightEventCount++;
+  updatePerformanceMetrics(event.detectMs - event.onsetMs, &perfMetrics.eventDetectLatency, &perfMetrics.maxEventDetectLatency);
+  updatePerformanceMetrics(txMs - event.detectMs, &perfMetrics.eventTxLatency, &perfMetrics.maxEventTxLatency);
+}
+
+void SystemController::sendVibrationSummary(const VibrationSummary& summary) {
+  char line[CMD_MAX_LINE_LENGTH];
+  if (VibrationAnalyzer::formatDownlink(line, sizeof(line), summary) == 0) {
+    return;
+  }
+  radioModule.sendLine(line);
+}
+
 bool SystemController::isSDCardAvailable() const {
   return sdManager.isInitialized();
 }
@@ -726,6 +1566,9 @@ void SystemController::runBackgroundTasks() {
       lastHeartbeat = currentTime;
     }
     
+    // All batch card I/O happens here, never in the sensor task
+    sdManager.writePendingData();
+    
     // Handle SD card operations (health checks, retries, etc.)
     if (currentTime - lastSDUpdate >= 100) { // 10Hz update rate
       sdManager.update();
@@ -734,8 +1577,8 @@ void SystemController::runBackgroundTasks() {
     
     // WiFi operations in maintenance mode (can be slow/blocking)
     if (currentMode == MODE_MAINTENANCE && wifiManager.isValid()) {
-      // Get a thread-safe copy of telemetry data
-      TelemetryData telemetryCopy = getTelemetryDataCopy();
+      // Get a thread-safe copy of telemetry data, IMU at the web UI rate
+      TelemetryData telemetryCopy = getTelemetryDataCopy(IMU_STREAM_WEB);
       wifiManager.broadcastData(telemetryCopy);
     }
     
@@ -749,10 +1592,11 @@ void SystemController::runBackgroundTasks() {
   vTaskDelete(NULL);
 }
 
-TelemetryData SystemController::getTelemetryDataCopy() const {
+TelemetryData SystemController::getTelemetryDataCopy(ImuStream stream) const {
   TelemetryData copy;
   if (xSemaphoreTake(telemetryMutex, pdMS_TO_TICKS(10)) == pdTRUE) {
     copy = telemetryData;
+    applyImuStream(copy, stream);
     xSemaphoreGive(telemetryMutex);
   } else {
     // If we can't get the mutex, return a zeroed structure
@@ -764,15 +1608,15 @@ TelemetryData SystemController::getTelemetryDataCopy() const {
 void SystemController::runSensorTasks() {
   Serial.println("Sensor task started");
   
+  TickType_t lastWake = xTaskGetTickCount();
   while (sensorTaskRunning) {
-    unsigned long currentTime = millis();
-    
     // Use the consolidated updateSensors method
     updateSensors();
     
-    // Run sensor task at high frequency (40Hz = 25ms) to capture IMU data
-    // Individual sensors will be read at their own rates within updateSensors()
-    vTaskDelay(pdMS_TO_TICKS(25)); // 40Hz for high-speed IMU logging
+    // Run at the current phase's IMU rate (100 Hz in boost, down to 10 Hz
+    // on the ground); other sensors are read at their own rates within
+    // updateSensors()
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(sensorTaskPeriod));
   }
   
   Serial.println("Sensor task stopping");
@@ -817,6 +1661,57 @@ SystemMode SystemController::loadPersistentMode() {
   return savedMode;
 }
 
+void SystemController::saveImuCalibration() {
+  ImuCalibration cal;
+  if (xSemaphoreTake(calibrationMutex, pdMS_TO_TICKS(50)) != pdTRUE) {
+    calibrationSavePending = true; // Try again on the next loop
+    return;
+  }
+  cal = imuCalibrator.getCalibration();
+  xSemaphoreGive(calibrationMutex);
+  
+  if (preferences.begin(PREFS_NAMESPACE, false)) {
+    size_t bytesWritten = preferences.putBytes(PREFS_IMU_CAL_KEY, &cal, sizeof(cal));
+    preferences.end();
+    
+    if (bytesWritten == sizeof(cal)) {
+      Serial.print("Saved IMU calibration, flags 0x");
+      Serial.println(cal.flags, HEX);
+    } else {
+      Serial.println("Warning: Failed to save IMU calibration");
+    }
+  } else {
+    Serial.println("Error: Could not open preferences for writing IMU calibration");
+  }
+}
+
+void SystemController::loadImuCalibration() {
+  ImuCalibration cal;
+  ImuCalibrator::clear(cal);
+  
+  if (preferences.begin(PREFS_NAMESPACE, true)) {
+    if (preferences.getBytesLength(PREFS_IMU_CAL_KEY) == sizeof(cal)) {
+      ImuCalibration saved;
+      preferences.getBytes(PREFS_IMU_CAL_KEY, &saved, sizeof(saved));
+      if (saved.version == IMU_CAL_VERSION) {
+        cal = saved;
+        Serial.print("Loaded IMU calibration, flags 0x");
+        Serial.println(cal.flags, HEX);
+      } else {
+        Serial.println("Ignoring IMU calibration from an older firmware");
+      }
+    } else {
+      Serial.println("No IMU calibration found, using raw readings");
+    }
+    preferences.end();
+  } else {
+    Serial.println("Error: Could not open preferences for reading IMU calibration");
+  }
+  
+  imuCalibrator.setCalibration(cal);
+  imuCalibration = cal;
+}
+
 String SystemController::getLogFilesList() {
   return sdManager.getLogFilesList();
 }
@@ -0,0 +1,137 @@
+#include "telemetry_codec.h"
+#include "geo_coord.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TELEM_FIELD_COUNT 53
+
+size_t TelemetryCodec::formatLine(char* buffer, size_t capacity, const TelemetryData& data, const TelemetryFrameInfo& info) {
+  char lat[COORD_TEXT_LENGTH], lon[COORD_TEXT_LENGTH];
+  char navLat[COORD_TEXT_LENGTH], navLon[COORD_TEXT_LENGTH];
+  formatCoordinate(lat, sizeof(lat), data.latitude);
+  formatCoordinate(lon, sizeof(lon), data.longitude);
+  formatCoordinate(navLat, sizeof(navLat), data.nav_latitude);
+  formatCoordinate(navLon, sizeof(navLon), data.nav_longitude);
+
+  int len = snprintf(buffer, capacity,
+    TELEM_FRAME_PREFIX "%lu,%d,%s,%s,%.2f,%.2f,%.2f,%d,%d,"
+    "%.3f,%.3f,%.3f,%.2f,%.2f,%.2f,%.1f,%.1f,%.1f,%.1f,%d,"
+    "%.3f,%.2f,%.2f,%d,%d,%lu,%lu,"
+    "%.2f,%.2f,%d,%d,"
+    "%.4f,%.4f,%.4f,%.4f,%.1f,%.1f,%.1f,%d,"
+    "%.0f,%.0f,%d,"
+    "%s,%s,%.2f,%.2f,%d,"
+    "%lld,%d,%lld,%lld,%lld,%lld\n",
+    (unsigned long)data.timestamp, data.mode,
+    lat, lon, data.altitude_gps, data.altitude_pressure, data.pressure,
+    data.gps_valid ? 1 : 0, data.pressure_valid ? 1 : 0,
+    data.accel_x, data.accel_y, data.accel_z,
+    data.gyro_x, data.gyro_y, data.gyro_z,
+    data.mag_x, data.mag_y, data.mag_z, data.imu_temperature,
+    data.imu_valid ? 1 : 0,
+    data.bus_voltage, data.current, data.power,
+    data.power_valid ? 1 : 0, data.rssi,
+    (unsigned long)info.seq, (unsigned long)info.enqueueMs,
+    data.altitude_filtered, data.vertical_velocity, data.estimator_valid ? 1 : 0,
+    data.flight_phase,
+    data.quat_w, data.quat_x, data.quat_y, data.quat_z,
+    data.roll, data.pitch, data.yaw, data.attitude_valid ? 1 : 0,
+    data.accel_range, data.gyro_range, data.imu_clipped ? 1 : 0,
+    navLat, navLon, data.velocity_east, data.velocity_north,
+    data.nav_valid ? 1 : 0,
+    (long long)data.utc_ms, data.time_source,
+    (long long)data.gps_time_us, (long long)data.pressure_time_us,
+    (long long)data.imu_time_us, (long long)data.power_time_us
+  );
+
+  if (len < 0 || (size_t)len >= capacity) {
+    return 0;
+  }
+  return (size_t)len;
+}
+
+bool TelemetryCodec::parseLine(const char* line, TelemetryData& data, TelemetryFrameInfo& info) {
+  size_t prefixLen = strlen(TELEM_FRAME_PREFIX);
+  if (strncmp(line, TELEM_FRAME_PREFIX, prefixLen) != 0) {
+    return false;
+  }
+
+  // Split into numeric fields without copying the line
+  double fields[TELEM_FIELD_COUNT];
+  const char* p = line + prefixLen;
+  int count = 0;
+  while (count < TELEM_FIELD_COUNT) {
+    char* end = NULL;
+    fields[count] = strtod(p, &end);
+    if (end == p) {
+      return false;
+    }
+    count++;
+    if (*end != ',') {
+      break;
+    }
+    p = end + 1;
+  }
+
+  if (count < TELEM_FIELD_COUNT) {
+    return false;
+  }
+
+  memset(&data, 0, sizeof(TelemetryData));
+  int i = 0;
+  data.timestamp = (uint32_t)fields[i++];
+  data.mode = (SystemMode)(int)fields[i++];
+  data.latitude = coordFromDegrees(fields[i++]);
+  data.longitude = coordFromDegrees(fields[i++]);
+  data.altitude_gps = (float)fields[i++];
+  data.altitude_pressure = (float)fields[i++];
+  data.pressure = (float)fields[i++];
+  data.gps_valid = fields[i++] != 0;
+  data.pressure_valid = fields[i++] != 0;
+  data.accel_x = (float)fields[i++];
+  data.accel_y = (float)fields[i++];
+  data.accel_z = (float)fields[i++];
+  data.gyro_x = (float)fields[i++];
+  data.gyro_y = (float)fields[i++];
+  data.gyro_z = (float)fields[i++];
+  data.mag_x = (float)fields[i++];
+  data.mag_y = (float)fields[i++];
+  data.mag_z = (float)fields[i++];
+  data.imu_temperature = (float)fields[i++];
+  data.imu_valid = fields[i++] != 0;
+  data.bus_voltage = (float)fields[i++];
+  data.current = (float)fields[i++];
+  data.power = (float)fields[i++];
+  data.power_valid = fields[i++] != 0;
+  data.rssi = (int16_t)fields[i++];
+  info.seq = (uint32_t)fields[i++];
+  info.enqueueMs = (uint32_t)fields[i++];
+  data.altitude_filtered = (float)fields[i++];
+  data.vertical_velocity = (float)fields[i++];
+  data.estimator_valid = fields[i++] != 0;
+  data.flight_phase = (FlightPhase)(int)fields[i++];
+  data.quat_w = (float)fields[i++];
+  data.quat_x = (float)fields[i++];
+  data.quat_y = (float)fields[i++];
+  data.quat_z = (float)fields[i++];
+  data.roll = (float)fields[i++];
+  data.pitch = (float)fields[i++];
+  data.yaw = (float)fields[i++];
+  data.attitude_valid = fields[i++] != 0;
+  data.accel_range = (float)fields[i++];
+  data.gyro_range = (float)fields[i++];
+  data.imu_clipped = fields[i++] != 0;
+  data.nav_latitude = coordFromDegrees(fields[i++]);
+  data.nav_longitude = coordFromDegrees(fields[i++]);
+  data.velocity_east = (float)fields[i++];
+  data.velocity_north = (float)fields[i++];
+  data.nav_valid = fields[i++] != 0;
+  data.utc_ms = (int64_t)fields[i++];
+  data.time_source = (uint8_t)fields[i++];
+  data.gps_time_us = (int64_t)fields[i++];
+  data.pressure_time_us = (int64_t)fields[i++];
+  data.imu_time_us = (int64_t)fields[i++];
+  data.power_time_us = (int64_t)fields[i++];
+  return true;
+}
@@ -0,0 +1,264 @@
+#include "time_discipline.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MS_PER_DAY 86400000LL
+
+int64_t utcMsFromLocal(const UtcMapping& mapping, int64_t localUs) {
+  if (!mapping.valid) {
+    return 0;
+  }
+  int64_t d = localUs - mapping.localRefUs;
+  int64_t utcUs = mapping.utcRefUs + d + d * mapping.ratePpb / 1000000000LL;
+  return utcUs / 1000;
+}
+
+static bool parseDigits(const char* p, int count, int32_t& value) {
+  value = 0;
+  for (int i = 0; i < count; i++) {
+    if (p[i] < '0' || p[i] > '9') {
+      return false;
+    }
+    value = value * 10 + (p[i] - '0');
+  }
+  return true;
+}
+
+bool parseNmeaTime(const char* field, int32_t& msOfDay) {
+  int32_t hours, minutes, seconds;
+  if (!parseDigits(field, 2, hours) || !parseDigits(field + 2, 2, minutes) ||
+      !parseDigits(field + 4, 2, seconds)) {
+    return false;
+  }
+  // Seconds up to 60 for a leap second
+  if (hours >= 24 || minutes >= 60 || seconds > 60) {
+    return false;
+  }
+
+  // Fraction to ms; further digits are dropped
+  int32_t ms = 0;
+  const char* p = field + 6;
+  if (*p == '.') {
+    int32_t scale = 100;
+    for (p++; *p >= '0' && *p <= '9'; p++) {
+      ms += (*p - '0') * scale;
+      scale /= 10;
+    }
+  }
+  msOfDay = ((hours * 60 + minutes) * 60 + seconds) * 1000 + ms;
+  return true;
+}
+
+bool parseNmeaDate(const char* field, int32_t& days) {
+  int32_t day, month, year;
+  if (!parseDigits(field, 2, day) || !parseDigits(field + 2, 2, month) ||
+      !parseDigits(field + 4, 2, year)) {
+    return false;
+  }
+  if (day < 1 || day > 31 || month < 1 || month > 12) {
+    return false;
+  }
+  days = daysFromCivil(year < 80 ? 2000 + year : 1900 + year, (uint32_t)month, (uint32_t)day);
+  return true;
+}
+
+// Civil calendar to day count and back, valid for any Gregorian date
+int32_t daysFromCivil(int32_t year, uint32_t month, uint32_t day) {
+  year -= month <= 2 ? 1 : 0;
+  int32_t era = (year >= 0 ? year : year - 399) / 400;
+  uint32_t yearOfEra = (uint32_t)(year - era * 400);
+  uint32_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + (int32_t)dayOfEra - 719468;
+}
+
+static void civilFromDays(int32_t days, int32_t& year, uint32_t& month, uint32_t& day) {
+  days += 719468;
+  int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+  uint32_t dayOfEra = (uint32_t)(days - era * 146097);
+  uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  uint32_t monthIndex = (5 * dayOfYear + 2) / 153;
+  day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+  month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+  year = (int32_t)yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+}
+
+size_t formatUtcStamp(char* buffer, size_t capacity, int64_t utcMs) {
+  if (utcMs < 0) {
+    return 0;
+  }
+  int32_t year;
+  uint32_t month, day;
+  civilFromDays((int32_t)(utcMs / MS_PER_DAY), year, month, day);
+  uint32_t secondOfDay = (uint32_t)(utcMs % MS_PER_DAY / 1000);
+
+  int len = snprintf(buffer, capacity, "%04ld%02lu%02lu_%02lu%02lu%02lu",
+                     (long)year, (unsigned long)month, (unsigned long)day,
+                     (unsigned long)(secondOfDay / 3600), (unsigned long)(secondOfDay / 60 % 60),
+                     (unsigned long)(secondOfDay % 60));
+  if (len < 0 || (size_t)len >= capacity) {
+    return 0;
+  }
+  return (size_t)len;
+}
+
+TimeDiscipline::TimeDiscipline() {
+  reset();
+}
+
+void TimeDiscipline::reset() {
+  mapping.valid = false;
+  mapping.localRefUs = 0;
+  mapping.utcRefUs = 0;
+  mapping.ratePpb = 0;
+  rate = 0.0;
+  P[0][0] = P[0][1] = P[1][0] = 0.0;
+  P[1][1] = TIME_INIT_DRIFT_SIGMA * TIME_INIT_DRIFT_SIGMA;
+  nmeaLatencyUs = TIME_NMEA_LATENCY_MS * 1000.0;
+  latencyMeasured = false;
+  lastEpochMs = -1;
+  lastEdgeUs = -1;
+  lastPpsUs = -1;
+  rejectedTotal = 0;
+  consecutiveRejects = 0;
+}
+
+TimeSource TimeDiscipline::getSource(int64_t nowUs) const {
+  if (!mapping.valid) {
+    return TIME_SOURCE_NONE;
+  }
+  return ppsLocked(nowUs) ? TIME_SOURCE_PPS : TIME_SOURCE_NMEA;
+}
+
+float TimeDiscipline::getPhaseSigmaUs() const {
+  return (float)sqrt(P[0][0]);
+}
+
+bool TimeDiscipline::ppsLocked(int64_t localUs) const {
+  return lastPpsUs >= 0 && localUs - lastPpsUs < TIME_PPS_TIMEOUT * 1000LL;
+}
+
+int64_t TimeDiscipline::predictUtcUs(int64_t localUs) const {
+  int64_t d = localUs - mapping.localRefUs;
+  return mapping.utcRefUs + d + llround(d * rate * 1e-6);
+}
+
+// Sets the phase to a sample. The frequency estimate and its uncertainty
+// carry over, so a step doesn't lose the drift.
+void TimeDiscipline::start(int64_t localUs, int64_t utcUs, double variance) {
+  mapping.valid = true;
+  mapping.localRefUs = localUs;
+  mapping.utcRefUs = utcUs;
+  mapping.ratePpb = (int32_t)lround(rate * 1000.0);
+  P[0][0] = variance;
+  P[0][1] = P[1][0] = 0.0;
+  consecutiveRejects = 0;
+}
+
+bool TimeDiscipline::fuse(int64_t localUs, int64_t utcUs, double variance) {
+  if (!mapping.valid) {
+    start(localUs, utcUs, variance);
+    return true;
+  }
+  int64_t d = localUs - mapping.localRefUs;
+  if (d < 0) {
+    return false;
+  }
+
+  // Predict: phase runs on with the rate, both pick up noise
+  double dt = d / 1000000.0;
+  double p00 = P[0][0] + 2.0 * dt * P[0][1] + dt * dt * P[1][1] + TIME_PHASE_NOISE * dt;
+  double p01 = P[0][1] + dt * P[1][1];
+  double p11 = P[1][1] + TIME_DRIFT_WANDER * TIME_DRIFT_WANDER * dt;
+
+  // Update with the phase measurement, gated on the innovation
+  int64_t predicted = predictUtcUs(localUs);
+  double innovation = (double)(utcUs - predicted);
+  double s = p00 + variance;
+  if (innovation * innovation > TIME_GATE_SIGMA * TIME_GATE_SIGMA * s) {
+    rejectedTotal++;
+    if (++consecutiveRejects >= TIME_MAX_REJECTS) {
+      // The receiver's time has moved (or ours has); follow it
+      start(localUs, utcUs, variance);
+      return true;
+    }
+    return false;
+  }
+  consecutiveRejects = 0;
+
+  double k0 = p00 / s;
+  double k1 = p01 / s;
+  mapping.localRefUs = localUs;
+  mapping.utcRefUs = predicted + llround(k0 * innovation);
+  rate += k1 * innovation;
+  mapping.ratePpb = (int32_t)lround(rate * 1000.0);
+  P[0][0] = (1.0 - k0) * p00;
+  P[0][1] = P[1][0] = (1.0 - k0) * p01;
+  P[1][1] = p11 - k1 * p01;
+  return true;
+}
+
+bool TimeDiscipline::addNmeaTime(int64_t arrivalUs, int64_t utcMs, float arrivalSigmaUs) {
+  if (utcMs == lastEpochMs) {
+    return false;
+  }
+  lastEpochMs = utcMs;
+  int64_t epochUs = utcMs * 1000;
+
+  // Under PPS the phase is known much better than NMEA can tell; the
+  // sample measures the latency instead
+  if (mapping.valid && ppsLocked(arrivalUs)) {
+    double latency = (double)(predictUtcUs(arrivalUs) - epochUs);
+    if (fabs(latency - nmeaLatencyUs) > TIME_PPS_WINDOW_MS * 1000.0) {
+      return false;
+    }
+    nmeaLatencyUs += TIME_LATENCY_FILTER * (latency - nmeaLatencyUs);
+    return true;
+  }
+
+  double jitter = TIME_NMEA_JITTER_MS * 1000.0;
+  double variance = (double)arrivalSigmaUs * arrivalSigmaUs + jitter * jitter;
+  return fuse(arrivalUs, epochUs + llround(nmeaLatencyUs), variance);
+}
+
+bool TimeDiscipline::addPps(int64_t edgeUs) {
+  bool periodic = lastEdgeUs >= 0 &&
+                  llabs(edgeUs - lastEdgeUs - 1000000) < TIME_PPS_PERIOD_TOLERANCE_US;
+  lastEdgeUs = edgeUs;
+  if (!mapping.valid) {
+    return false;
+  }
+
+  // The edge is the UTC second nearest to the prediction
+  int64_t predicted = predictUtcUs(edgeUs);
+  int64_t second = (predicted + 500000) / 1000000 * 1000000;
+  int64_t offset = predicted - second;
+  if (llabs(offset) > TIME_PPS_WINDOW_MS * 1000LL) {
+    return false;
+  }
+
+  double variance = TIME_PPS_NOISE_US * TIME_PPS_NOISE_US;
+  if (!ppsLocked(edgeUs)) {
+    // Acquiring the pulse takes two edges a second apart, so a glitch
+    // can't step the clock. The step is the error of the NMEA latency the
+    // mapping ran on, which is measured from then on.
+    if (!periodic) {
+      return false;
+    }
+    if (!latencyMeasured) {
+      nmeaLatencyUs -= (double)offset;
+      latencyMeasured = true;
+    }
+    start(edgeUs, second, variance);
+    lastPpsUs = edgeUs;
+    return true;
+  }
+
+  if (!fuse(edgeUs, second, variance)) {
+    return false;
+  }
+  lastPpsUs = edgeUs;
+  return true;
+}
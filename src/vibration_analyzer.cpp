@@ -0,0 +1,304 @@
+#include "vibration_analyzer.h"
+#include "command_protocol.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+const float VIB_BAND_EDGES[VIB_BAND_COUNT + 1] = {0.0f, 20.0f, 50.0f, 100.0f, 200.0f, 500.0f};
+
+VibrationFft::VibrationFft() {
+  for (uint16_t k = 0; k < VIB_FFT_SIZE; k++) {
+    double angle = -2.0 * M_PI * k / VIB_FFT_SIZE;
+    twiddleRe[k] = (float)cos(angle);
+    twiddleIm[k] = (float)sin(angle);
+    uint16_t r = 0;
+    for (uint8_t b = 0; b < VIB_FFT_LOG2; b++) {
+      r |= ((k >> b) & 1) << (VIB_FFT_LOG2 - 1 - b);
+    }
+    bitReverse[k] = r;
+  }
+}
+
+void VibrationFft::transform(float* re, float* im) const {
+  for (uint16_t i = 0; i < VIB_FFT_SIZE; i++) {
+    uint16_t j = bitReverse[i];
+    if (i < j) {
+      float t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+
+  uint16_t h = 1;
+#if VIB_FFT_LOG2 & 1
+  // Odd size: one radix-2 stage with unit twiddles first
+  for (uint16_t i = 0; i < VIB_FFT_SIZE; i += 2) {
+    float r1 = re[i + 1], i1 = im[i + 1];
+    re[i + 1] = re[i] - r1;
+    im[i + 1] = im[i] - i1;
+    re[i] += r1;
+    im[i] += i1;
+  }
+  h = 2;
+#endif
+
+  // Each radix-4 pass does the radix-2 stages of span h and 2h at once:
+  // x1 takes W_4h^2k, x2 W_4h^k and x3 W_4h^3k, then two butterfly levels
+  for (; h < VIB_FFT_SIZE; h *= 4) {
+    uint16_t stride = VIB_FFT_SIZE / (4 * h);
+    for (uint16_t k = 0; k < h; k++) {
+      float w1r = twiddleRe[k * stride], w1i = twiddleIm[k * stride];
+      float w2r = twiddleRe[2 * k * stride], w2i = twiddleIm[2 * k * stride];
+      float w3r = twiddleRe[3 * k * stride], w3i = twiddleIm[3 * k * stride];
+      for (uint16_t i0 = k; i0 < VIB_FFT_SIZE; i0 += 4 * h) {
+        uint16_t i1 = i0 + h, i2 = i1 + h, i3 = i2 + h;
+        float t1r = re[i1] * w2r - im[i1] * w2i;
+        float t1i = re[i1] * w2i + im[i1] * w2r;
+        float t2r = re[i2] * w1r - im[i2] * w1i;
+        float t2i = re[i2] * w1i + im[i2] * w1r;
+        float t3r = re[i3] * w3r - im[i3] * w3i;
+        float t3i = re[i3] * w3i + im[i3] * w3r;
+
+        float a0r = re[i0] + t1r, a0i = im[i0] + t1i;
+        float a1r = re[i0] - t1r, a1i = im[i0] - t1i;
+        float b0r = t2r + t3r, b0i = t2i + t3i;
+        float b1r = t2r - t3r, b1i = t2i - t3i;
+
+        re[i0] = a0r + b0r;
+        im[i0] = a0i + b0i;
+        re[i2] = a0r - b0r;
+        im[i2] = a0i - b0i;
+        // a1 -/+ j*b1
+        re[i1] = a1r + b1i;
+        im[i1] = a1i - b1r;
+        re[i3] = a1r - b1i;
+        im[i3] = a1i + b1r;
+      }
+    }
+  }
+}
+
+VibrationAnalyzer::VibrationAnalyzer()
+  : sampleRate(0), blocksPerSummary(1), fill(0), blocks(0), clipped(false), blocksAnalyzed(0), windowPower(0) {
+  for (uint16_t i = 0; i < VIB_FFT_SIZE; i++) {
+    window[i] = 0.5f - 0.5f * (float)cos(2.0 * M_PI * i / VIB_FFT_SIZE);
+    windowPower += window[i] * window[i];
+  }
+  memset(block, 0, sizeof(block));
+  reset(0);
+}
+
+void VibrationAnalyzer::reset(float newSampleRate) {
+  sampleRate = newSampleRate;
+  blocksPerSummary = 1;
+  if (sampleRate > 0) {
+    float blockMs = VIB_FFT_SIZE * 1000.0f / sampleRate;
+    blocksPerSummary = (uint16_t)ceilf(VIB_SUMMARY_INTERVAL / blockMs);
+    if (blocksPerSummary < 1) {
+      blocksPerSummary = 1;
+    }
+  }
+  fill = 0;
+  blocks = 0;
+  clipped = false;
+  memset(accelPower, 0, sizeof(accelPower));
+  memset(gyroPower, 0, sizeof(gyroPower));
+}
+
+bool VibrationAnalyzer::process(const int32_t* samples, int count, bool batchClipped, uint32_t timeMs,
+                                VibrationSummary& summary) {
+  if (sampleRate <= 0 || count <= 0) {
+    return false;
+  }
+  clipped = clipped || batchClipped;
+
+  bool ready = false;
+  for (int i = 0; i < count; i++) {
+    memcpy(block[fill], samples + i * DECIM_AXES, sizeof(block[fill]));
+    if (++fill < VIB_FFT_SIZE) {
+      continue;
+    }
+    fill = 0;
+    analyzeBlock();
+    if (++blocks < blocksPerSummary) {
+      continue;
+    }
+
+    summary.timeMs = timeMs;
+    summary.sampleRate = sampleRate;
+    summary.blocks = blocks;
+    summary.clipped = clipped;
+    summarize(accelPower, summary.accel);
+    summarize(gyroPower, summary.gyro);
+    blocks = 0;
+    clipped = false;
+    memset(accelPower, 0, sizeof(accelPower));
+    memset(gyroPower, 0, sizeof(gyroPower));
+    ready = true;
+  }
+  return ready;
+}
+
+void VibrationAnalyzer::analyzeBlock() {
+  // Axes in pairs: (ax, ay), (az, gx), (gy, gz)
+  for (uint8_t a = 0; a < DECIM_AXES; a += 2) {
+    float unitRe = a < 3 ? DECIM_ACCEL_UNIT : DECIM_GYRO_UNIT;
+    float unitIm = a + 1 < 3 ? DECIM_ACCEL_UNIT : DECIM_GYRO_UNIT;
+    int64_t sumRe = 0, sumIm = 0;
+    for (uint16_t i = 0; i < VIB_FFT_SIZE; i++) {
+      sumRe += block[i][a];
+      sumIm += block[i][a + 1];
+    }
+    float meanRe = (float)sumRe / VIB_FFT_SIZE;
+    float meanIm = (float)sumIm / VIB_FFT_SIZE;
+    for (uint16_t i = 0; i < VIB_FFT_SIZE; i++) {
+      re[i] = (block[i][a] - meanRe) * unitRe * window[i];
+      im[i] = (block[i][a + 1] - meanIm) * unitIm * window[i];
+    }
+
+    fft.transform(re, im);
+
+    // Split the packed spectra: X = (Z[k] + conj Z[N-k]) / 2,
+    // Y = (Z[k] - conj Z[N-k]) / 2j
+    float* powerRe = a < 3 ? accelPower : gyroPower;
+    float* powerIm = a + 1 < 3 ? accelPower : gyroPower;
+    for (uint16_t k = 0; k < VIB_BINS; k++) {
+      uint16_t n = (VIB_FFT_SIZE - k) & (VIB_FFT_SIZE - 1);
+      float xr = 0.5f * (re[k] + re[n]);
+      float xi = 0.5f * (im[k] - im[n]);
+      float yr = 0.5f * (im[k] + im[n]);
+      float yi = 0.5f * (re[n] - re[k]);
+      powerRe[k] += xr * xr + xi * xi;
+      powerIm[k] += yr * yr + yi * yi;
+    }
+  }
+  blocksAnalyzed++;
+}
+
+void VibrationAnalyzer::summarize(const float* power, VibrationSpectrum& out) const {
+  // Mean square per bin, one-sided and corrected for the window
+  float meanSquare[VIB_BINS];
+  float scale = 1.0f / (blocks * VIB_FFT_SIZE * windowPower);
+  float binHz = sampleRate / VIB_FFT_SIZE;
+  float total = 0;
+  meanSquare[0] = 0;  // Block mean removed
+  for (uint16_t k = 1; k < VIB_BINS; k++) {
+    meanSquare[k] = power[k] * scale * (k == VIB_BINS - 1 ? 1.0f : 2.0f);
+    total += meanSquare[k];
+  }
+  out.rms = sqrtf(total);
+
+  for (uint8_t b = 0; b < VIB_BAND_COUNT; b++) {
+    float sum = 0;
+    for (uint16_t k = 1; k < VIB_BINS; k++) {
+      float f = k * binHz;
+      bool last = b == VIB_BAND_COUNT - 1;
+      if (f >= VIB_BAND_EDGES[b] && (f < VIB_BAND_EDGES[b + 1] || (last && f <= VIB_BAND_EDGES[b + 1]))) {
+        sum += meanSquare[k];
+      }
+    }
+    out.bandRms[b] = sqrtf(sum);
+  }
+
+  // Strongest local maxima. The Hann main lobe puts a tone's power in the
+  // peak bin and its neighbours, so those three bins give its amplitude;
+  // the frequency is interpolated on the log of the lobe.
+  uint16_t peaks[VIB_PEAK_COUNT] = {0};
+  for (uint16_t k = 2; k < VIB_BINS - 1; k++) {
+    if (meanSquare[k] < meanSquare[k - 1] || meanSquare[k] <= meanSquare[k + 1]) {
+      continue;
+    }
+    for (uint8_t p = 0; p < VIB_PEAK_COUNT; p++) {
+      if (peaks[p] == 0 || meanSquare[k] > meanSquare[peaks[p]]) {
+        for (uint8_t q = VIB_PEAK_COUNT - 1; q > p; q--) {
+          peaks[q] = peaks[q - 1];
+        }
+        peaks[p] = k;
+        break;
+      }
+    }
+  }
+  for (uint8_t p = 0; p < VIB_PEAK_COUNT; p++) {
+    uint16_t k = peaks[p];
+    if (k == 0 || meanSquare[k] <= 0) {
+      out.peakHz[p] = 0;
+      out.peakAmplitude[p] = 0;
+      continue;
+    }
+    float offset = 0;
+    if (meanSquare[k - 1] > 0 && meanSquare[k + 1] > 0) {
+      float l = logf(meanSquare[k - 1]), c = logf(meanSquare[k]), r = logf(meanSquare[k + 1]);
+      float denom = l - 2.0f * c + r;
+      if (denom < 0) {
+        offset = 0.5f * (l - r) / denom;
+      }
+    }
+    out.peakHz[p] = (k + offset) * binHz;
+    out.peakAmplitude[p] = sqrtf(2.0f * (meanSquare[k - 1] + meanSquare[k] + meanSquare[k + 1]));
+  }
+}
+
+size_t VibrationAnalyzer::formatCsvHeader(char* buffer, size_t capacity) {
+  int len = snprintf(buffer, capacity, "log_ms,rate_hz,blocks,clipped");
+  static const char* const sensors[2] = {"accel", "gyro"};
+  for (uint8_t s = 0; s < 2 && len >= 0 && (size_t)len < capacity; s++) {
+    len += snprintf(buffer + len, capacity - len, ",%s_rms", sensors[s]);
+    for (uint8_t p = 0; p < VIB_PEAK_COUNT && (size_t)len < capacity; p++) {
+      len += snprintf(buffer + len, capacity - len, ",%s_peak%u_hz,%s_peak%u", sensors[s], p + 1, sensors[s], p + 1);
+    }
+    for (uint8_t b = 0; b < VIB_BAND_COUNT && (size_t)len < capacity; b++) {
+      len += snprintf(buffer + len, capacity - len, ",%s_%.0f_%.0fhz", sensors[s], VIB_BAND_EDGES[b],
+                      VIB_BAND_EDGES[b + 1]);
+    }
+  }
+  if (len < 0 || (size_t)len >= capacity) {
+    return 0;
+  }
+  return (size_t)len;
+}
+
+static int appendSpectrum(char* buffer, size_t capacity, const VibrationSpectrum& spectrum, bool bands) {
+  int len = snprintf(buffer, capacity, ",%.4f", spectrum.rms);
+  for (uint8_t p = 0; p < VIB_PEAK_COUNT && len >= 0 && (size_t)len < capacity; p++) {
+    len += snprintf(buffer + len, capacity - len, ",%.1f,%.4f", spectrum.peakHz[p], spectrum.peakAmplitude[p]);
+  }
+  for (uint8_t b = 0; bands && b < VIB_BAND_COUNT && len >= 0 && (size_t)len < capacity; b++) {
+    len += snprintf(buffer + len, capacity - len, ",%.4f", spectrum.bandRms[b]);
+  }
+  return len;
+}
+
+size_t VibrationAnalyzer::formatCsv(char* buffer, size_t capacity, const VibrationSummary& summary) {
+  int len = snprintf(buffer, capacity, "%lu,%.0f,%u,%d", (unsigned long)summary.timeMs, summary.sampleRate,
+                     (unsigned)summary.blocks, summary.clipped ? 1 : 0);
+  if (len >= 0 && (size_t)len < capacity) {
+    len += appendSpectrum(buffer + len, capacity - len, summary.accel, true);
+  }
+  if (len >= 0 && (size_t)len < capacity) {
+    len += appendSpectrum(buffer + len, capacity - len, summary.gyro, true);
+  }
+  if (len < 0 || (size_t)len >= capacity) {
+    return 0;
+  }
+  return (size_t)len;
+}
+
+size_t VibrationAnalyzer::formatDownlink(char* buffer, size_t capacity, const VibrationSummary& summary) {
+  // Shorter fields than the SD row: whole Hz, mg and 0.1 deg/s
+  int len = snprintf(buffer, capacity, VIB_PREFIX "%lu,%u,%d", (unsigned long)summary.timeMs,
+                     (unsigned)summary.blocks, summary.clipped ? 1 : 0);
+  const VibrationSpectrum* spectra[2] = {&summary.accel, &summary.gyro};
+  static const char* const formats[2] = {",%.3f", ",%.1f"};
+  for (uint8_t s = 0; s < 2 && len >= 0 && (size_t)len < capacity; s++) {
+    len += snprintf(buffer + len, capacity - len, formats[s], spectra[s]->rms);
+    for (uint8_t p = 0; p < VIB_PEAK_COUNT && (size_t)len < capacity; p++) {
+      len += snprintf(buffer + len, capacity - len, ",%.0f", spectra[s]->peakHz[p]);
+      if ((size_t)len < capacity) {
+        len += snprintf(buffer + len, capacity - len, formats[s], spectra[s]->peakAmplitude[p]);
+      }
+    }
+  }
+  if (len < 0 || (size_t)len >= capacity) {
+    return 0;
+  }
+  return CommandProtocol::appendCrc(buffer, (size_t)len, capacity);
+}
@@ -20,6 +20,7 @@ const char WebContent::index_html[] PROGMEM = R"HTML(
                 <h3>System Status</h3>
                 <p>Last Update: <span id="timestamp" class="data-value">--</span></p>
                 <p>Mode: <span id="mode" class="data-value">--</span></p>
+                <p>Flight Phase: <span id="flight_phase" class="data-value">--</span></p>
             </div>
             
             <div class="data-card">
@@ -28,15 +29,45 @@ const char WebContent::index_html[] PROGMEM = R"HTML(
                 <p>Longitude: <span id="longitude" class="data-value">--</span></p>
                 <p>Altitude: <span id="altitude_gps" class="data-value">--</span></p>
                 <p>Status: <span id="gps_status" class="data-value">--</span></p>
+                <p>Filtered: <span id="nav_position" class="data-value">--</span></p>
+                <p>Ground Speed: <span id="nav_velocity" class="data-value">--</span></p>
+                <p>UTC: <span id="utc_time" class="data-value">--</span></p>
             </div>
             
             <div class="data-card">
                 <h3>Pressure Data</h3>
                 <p>Pressure: <span id="pressure" class="data-value">--</span></p>
                 <p>Altitude: <span id="altitude_pressure" class="data-value">--</span></p>
+                <p>Filtered Altitude: <span id="altitude_filtered" class="data-value">--</span></p>
+                <p>Vertical Velocity: <span id="vertical_velocity" class="data-value">--</span></p>
                 <p>Status: <span id="pressure_status" class="data-value">--</span></p>
             </div>
             
+            <div class="data-card">
+                <h3>Attitude</h3>
+                <p>Roll: <span id="roll" class="data-value">--</span></p>
+                <p>Pitch: <span id="pitch" class="data-value">--</span></p>
+                <p>Yaw: <span id="yaw" class="data-value">--</span></p>
+                <p>IMU Range: <span id="imu_range" class="data-value">--</span></p>
+            </div>
+            
+            <div class="data-card">
+                <h3>IMU Calibration</h3>
+                <p>Status: <span id="cal_status" class="data-value">--</span></p>
+                <button class="download-btn" onclick="calibrate('CAL_GYRO')">Gyro (hold still)</button>
+                <p>Accelerometer, with this axis up:</p>
+                <button class="download-btn" onclick="calibrate('CAL_ACCEL', '+X')">+X</button>
+                <button class="download-btn" onclick="calibrate('CAL_ACCEL', '-X')">-X</button>
+                <button class="download-btn" onclick="calibrate('CAL_ACCEL', '+Y')">+Y</button>
+                <button class="download-btn" onclick="calibrate('CAL_ACCEL', '-Y')">-Y</button>
+                <button class="download-btn" onclick="calibrate('CAL_ACCEL', '+Z')">+Z</button>
+                <button class="download-btn" onclick="calibrate('CAL_ACCEL', '-Z')">-Z</button>
+                <p>Magnetometer, rotate through all orientations:</p>
+                <button class="download-btn" onclick="calibrate('CAL_MAG_START')">Start</button>
+                <button class="download-btn" onclick="calibrate('CAL_MAG_END')">Finish</button>
+                <button class="download-btn" onclick="calibrate('CAL_STATUS')">Refresh</button>
+            </div>
+            
             <div class="data-card">
                 <h3>Radio Data</h3>
                 <p>RSSI: <span id="rssi" class="data-value">--</span></p>
@@ -203,13 +234,23 @@ function refreshData() {
         .then(data => {
             document.getElementById('timestamp').textContent = new Date(data.timestamp).toLocaleString();
             document.getElementById('mode').textContent = getModeString(data.mode);
-            document.getElementById('latitude').textContent = data.latitude.toFixed(6);
-            document.getElementById('longitude').textContent = data.longitude.toFixed(6);
+            document.getElementById('flight_phase').textContent = getPhaseString(data.flight_phase);
+            document.getElementById('latitude').textContent = data.latitude.toFixed(7);
+            document.getElementById('longitude').textContent = data.longitude.toFixed(7);
             document.getElementById('altitude_gps').textContent = data.altitude_gps.toFixed(2) + ' m';
             document.getElementById('altitude_pressure').textContent = data.altitude_pressure.toFixed(2) + ' m';
             document.getElementById('pressure').textContent = data.pressure.toFixed(2) + ' hPa';
             document.getElementById('gps_status').textContent = data.gps_valid ? 'Valid' : 'Invalid';
+            document.getElementById('nav_position').textContent = data.nav_valid ? data.nav_latitude.toFixed(7) + ', ' + data.nav_longitude.toFixed(7) : '--';
+            document.getElementById('nav_velocity').textContent = data.nav_valid ? Math.hypot(data.velocity_east, data.velocity_north).toFixed(1) + ' m/s' : '--';
+            document.getElementById('utc_time').textContent = data.time_source > 0 ? new Date(data.utc_ms).toISOString().substring(11, 23) + (data.time_source == 2 ? ' (PPS)' : ' (NMEA)') : '--';
             document.getElementById('pressure_status').textContent = data.pressure_valid ? 'Valid' : 'Invalid';
+            document.getElementById('altitude_filtered').textContent = data.estimator_valid ? data.altitude_filtered.toFixed(2) + ' m' : '--';
+            document.getElementById('vertical_velocity').textContent = data.estimator_valid ? data.vertical_velocity.toFixed(2) + ' m/s' : '--';
+            document.getElementById('roll').textContent = data.attitude_valid ? data.roll.toFixed(1) + '°' : '--';
+            document.getElementById('pitch').textContent = data.attitude_valid ? data.pitch.toFixed(1) + '°' : '--';
+            document.getElementById('yaw').textContent = data.attitude_valid ? data.yaw.toFixed(1) + '°' : '--';
+            document.getElementById('imu_range').textContent = data.imu_valid ? '±' + data.accel_range + ' g / ±' + data.gyro_range + ' °/s' + (data.imu_clipped ? ' (clipped)' : '') : '--';
             document.getElementById('rssi').textContent = data.rssi + ' dBm';
             document.getElementById('signal_quality').textContent = getSignalQuality(data.rssi);
         })
@@ -219,6 +260,23 @@ function refreshData() {
         });
 }
 
+function calibrate(cmd, args) {
+    let url = '/calibrate?cmd=' + cmd;
+    if (args) {
+        url += '&args=' + encodeURIComponent(args);
+    }
+    fetch(url)
+        .then(response => response.json())
+        .then(data => {
+            const text = data.error ? data.error : data.status + ' ' + data.detail;
+            document.getElementById('cal_status').textContent = text;
+        })
+        .catch(error => {
+            console.error('Error:', error);
+            document.getElementById('cal_status').textContent = 'Connection Error';
+        });
+}
+
 function refreshLogsList() {
     fetch('/logs')
         .then(response => response.json())
@@ -278,6 +336,17 @@ function getModeString(mode) {
     }
 }
 
+function getPhaseString(phase) {
+    switch(phase) {
+        case 0: return 'Pad';
+        case 1: return 'Boost';
+        case 2: return 'Coast';
+        case 3: return 'Descent';
+        case 4: return 'Landed';
+        default: return 'Unknown';
+    }
+}
+
 function getSignalQuality(rssi) {
     if (rssi >= -50) return 'Excellent';
     else if (rssi >= -60) return 'Very Good';
@@ -1,5 +1,6 @@
 #include "wifi_manager.h"
 #include "web_content.h"
+#include "geo_coord.h"
 #include "system_controller.h"
 #include "esp_wifi.h"
 #include "esp_sleep.h"
@@ -11,7 +12,7 @@ WiFiManager::WiFiManager() :
   serverRunning(false),
   systemController(nullptr) {
   // Initialize with default telemetry data
-  latestData = {0.0, 0.0, 0.0, 0.0, 1013.25, 0, MODE_MAINTENANCE, false, false, -999,
+  latestData = {0, 0, 0.0, 0.0, 1013.25, 0, MODE_MAINTENANCE, false, false, -999,
                0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, false,
                0.0, 0.0, 0.0, false};
 }
@@ -66,6 +67,7 @@ bool WiFiManager::connect(const char* ssid, const char* password) {
     webServer->on("/logs", [this]() { handleLogsList(); });
     webServer->on("/download", [this]() { handleDownloadFile(); });
     webServer->on("/download/all", [this]() { handleDownloadAll(); });
+    webServer->on("/calibrate", [this]() { handleCalibrate(); });
     webServer->on("/style.css", [this]() { handleStyle(); });
     webServer->on("/script.js", [this]() { handleScript(); });
     webServer->onNotFound([this]() { handleNotFound(); });
@@ -193,13 +195,43 @@ String WiFiManager::createTelemetryJSON(const TelemetryData& data) {
   String json = "{";
   json += "\"timestamp\":" + String(data.timestamp) + ",";
   json += "\"mode\":" + String(data.mode) + ",";
-  json += "\"latitude\":" + String(data.latitude, 6) + ",";
-  json += "\"longitude\":" + String(data.longitude, 6) + ",";
+  char coord[COORD_TEXT_LENGTH];
+  formatCoordinate(coord, sizeof(coord), data.latitude);
+  json += "\"latitude\":" + String(coord) + ",";
+  formatCoordinate(coord, sizeof(coord), data.longitude);
+  json += "\"longitude\":" + String(coord) + ",";
   json += "\"altitude_gps\":" + String(data.altitude_gps, 2) + ",";
   json += "\"altitude_pressure\":" + String(data.altitude_pressure, 2) + ",";
   json += "\"pressure\":" + String(data.pressure, 2) + ",";
   json += "\"gps_valid\":" + String(data.gps_valid ? "true" : "false") + ",";
   json += "\"pressure_valid\":" + String(data.pressure_valid ? "true" : "false") + ",";
+  json += "\"altitude_filtered\":" + String(data.altitude_filtered, 2) + ",";
+  json += "\"vertical_velocity\":" + String(data.vertical_velocity, 2) + ",";
+  json += "\"estimator_valid\":" + String(data.estimator_valid ? "true" : "false") + ",";
+  json += "\"flight_phase\":" + String(data.flight_phase) + ",";
+  json += "\"roll\":" + String(data.roll, 1) + ",";
+  json += "\"pitch\":" + String(data.pitch, 1) + ",";
+  json += "\"yaw\":" + String(data.yaw, 1) + ",";
+  json += "\"attitude_valid\":" + String(data.attitude_valid ? "true" : "false") + ",";
+  formatCoordinate(coord, sizeof(coord), data.nav_latitude);
+  json += "\"nav_latitude\":" + String(coord) + ",";
+  formatCoordinate(coord, sizeof(coord), data.nav_longitude);
+  json += "\"nav_longitude\":" + String(coord) + ",";
+  json += "\"velocity_east\":" + String(data.velocity_east, 2) + ",";
+  json += "\"velocity_north\":" + String(data.velocity_north, 2) + ",";
+  json += "\"nav_valid\":" + String(data.nav_valid ? "true" : "false") + ",";
+  char stamp[24];
+  snprintf(stamp, sizeof(stamp), "%lld", (long long)data.utc_ms);
+  json += "\"utc_ms\":" + String(stamp) + ",";
+  json += "\"time_source\":" + String(data.time_source) + ",";
+  snprintf(stamp, sizeof(stamp), "%lld", (long long)data.gps_time_us);
+  json += "\"gps_time_us\":" + String(stamp) + ",";
+  snprintf(stamp, sizeof(stamp), "%lld", (long long)data.pressure_time_us);
+  json += "\"pressure_time_us\":" + String(stamp) + ",";
+  snprintf(stamp, sizeof(stamp), "%lld", (long long)data.imu_time_us);
+  json += "\"imu_time_us\":" + String(stamp) + ",";
+  snprintf(stamp, sizeof(stamp), "%lld", (long long)data.power_time_us);
+  json += "\"power_time_us\":" + String(stamp) + ",";
   
   // Add IMU data
   json += "\"accel_x\":" + String(data.accel_x, 3) + ",";
@@ -213,6 +245,9 @@ String WiFiManager::createTelemetryJSON(const TelemetryData& data) {
   json += "\"mag_z\":" + String(data.mag_z, 1) + ",";
   json += "\"imu_temperature\":" + String(data.imu_temperature, 1) + ",";
   json += "\"imu_valid\":" + String(data.imu_valid ? "true" : "false") + ",";
+  json += "\"accel_range\":" + String(data.accel_range, 0) + ",";
+  json += "\"gyro_range\":" + String(data.gyro_range, 0) + ",";
+  json += "\"imu_clipped\":" + String(data.imu_clipped ? "true" : "false") + ",";
   
   // Add power sensor data
   json += "\"bus_voltage\":" + String(data.bus_voltage, 3) + ",";
@@ -241,6 +276,28 @@ void WiFiManager::handleLogsList() {
   webServer->send(200, "application/json", logsJson);
 }
 
+void WiFiManager::handleCalibrate() {
+  // /calibrate?cmd=CAL_ACCEL&args=%2BZ - same commands as the radio uplink
+  String cmd = webServer->arg("cmd");
+  String args = webServer->arg("args");
+  
+  if (!cmd.startsWith("CAL_")) {
+    webServer->send(400, "application/json", "{\"error\":\"Use: /calibrate?cmd=CAL_...&args=...\"}");
+    return;
+  }
+  
+  if (!systemController) {
+    webServer->send(500, "application/json", "{\"error\":\"System controller not available\"}");
+    return;
+  }
+  
+  char detail[CMD_MAX_ARGS_LENGTH];
+  const char* status = systemController->executeCalibrationCommand(cmd.c_str(), args.c_str(), detail, sizeof(detail));
+  
+  String json = "{\"status\":\"" + String(status) + "\",\"detail\":\"" + String(detail) + "\"}";
+  webServer->send(200, "application/json", json);
+}
+
 void WiFiManager::handleDownloadFile() {
   String filename = webServer->arg("file");
   
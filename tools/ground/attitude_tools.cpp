@@ -0,0 +1,263 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "attitude_estimator.h"
+#include "ground_commands.h"
+#include "serial_port.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define AHRS_BENCH_HAVE_TSC 1
+#endif
+
+// Host benchmark for the AHRS: cost per update (ns and, on x86, TSC
+// cycles) and tilt/yaw accuracy on a simulated tumbling body with known
+// attitude, against plain gyro integration.
+
+#define AHRS_BENCH_RATE 100.0        // Updates per second
+#define AHRS_BENCH_DURATION 120.0    // Seconds per run
+#define AHRS_BENCH_GYRO_BIAS 0.5     // deg/s on every axis
+#define AHRS_BENCH_GYRO_NOISE 0.1    // deg/s
+#define AHRS_BENCH_ACCEL_NOISE 0.01  // g
+#define AHRS_BENCH_MAG_NOISE 0.5     // uT
+
+struct Quat {
+  double w, x, y, z;
+};
+
+static Quat multiply(const Quat& a, const Quat& b) {
+  Quat r;
+  r.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+  r.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+  r.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+  r.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+  return r;
+}
+
+static void normalize(Quat& q) {
+  double n = sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+  q.w /= n;
+  q.x /= n;
+  q.y /= n;
+  q.z /= n;
+}
+
+// Rotates an earth-frame vector into the body frame (q is body to earth)
+static void toBody(const Quat& q, const double e[3], double b[3]) {
+  Quat v = {0, e[0], e[1], e[2]};
+  Quat conj = {q.w, -q.x, -q.y, -q.z};
+  Quat r = multiply(multiply(conj, v), q);
+  b[0] = r.x;
+  b[1] = r.y;
+  b[2] = r.z;
+}
+
+// Advances q by body rates (rad/s) over dt
+static void integrate(Quat& q, const double w[3], double dt) {
+  double angle = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]) * dt;
+  if (angle < 1e-12) {
+    return;
+  }
+  double s = sin(angle / 2) / (angle / dt);
+  Quat dq = {cos(angle / 2), w[0] * s, w[1] * s, w[2] * s};
+  q = multiply(q, dq);
+  normalize(q);
+}
+
+// Angle between the true and estimated earth-up directions in the body frame
+static double tiltError(const Quat& truth, float w, float x, float y, float z) {
+  double up[3] = {0, 0, 1};
+  double a[3], b[3];
+  toBody(truth, up, a);
+  Quat est = {w, x, y, z};
+  toBody(est, up, b);
+  double dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+  return acos(fmin(1.0, fmax(-1.0, dot))) * 180.0 / M_PI;
+}
+
+static double yawOf(double w, double x, double y, double z) {
+  return atan2(2 * (w * z + x * y), 1 - 2 * (y * y + z * z)) * 180.0 / M_PI;
+}
+
+static double wrapDegrees(double a) {
+  while (a > 180) a -= 360;
+  while (a < -180) a += 360;
+  return a;
+}
+
+struct ImuSample {
+  float gyro[3];
+  float accel[3];
+  float mag[3];
+  Quat truth;
+};
+
+// Slow coning and spinning with gravity and a dipping earth field
+static std::vector<ImuSample> simulateMotion(unsigned seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> gyroNoise(0.0, AHRS_BENCH_GYRO_NOISE);
+  std::normal_distribution<double> accelNoise(0.0, AHRS_BENCH_ACCEL_NOISE);
+  std::normal_distribution<double> magNoise(0.0, AHRS_BENCH_MAG_NOISE);
+  const double gravityUp[3] = {0, 0, 1};
+  const double field[3] = {20.0, 0.0, -45.0};  // uT, north and down
+  const double dt = 1.0 / AHRS_BENCH_RATE;
+
+  std::vector<ImuSample> samples;
+  Quat q = {1, 0, 0, 0};
+  for (int i = 0; i < (int)(AHRS_BENCH_DURATION * AHRS_BENCH_RATE); i++) {
+    double t = i * dt;
+    double rates[3] = {
+      30.0 * sin(0.5 * t) * M_PI / 180.0,
+      20.0 * cos(0.3 * t) * M_PI / 180.0,
+      45.0 * sin(0.1 * t) * M_PI / 180.0
+    };
+    ImuSample s;
+    double up[3], mag[3];
+    toBody(q, gravityUp, up);
+    toBody(q, field, mag);
+    for (int k = 0; k < 3; k++) {
+      s.gyro[k] = (float)(rates[k] * 180.0 / M_PI + AHRS_BENCH_GYRO_BIAS + gyroNoise(rng));
+      s.accel[k] = (float)(up[k] + accelNoise(rng));
+      s.mag[k] = (float)(mag[k] + magNoise(rng));
+    }
+    s.truth = q;
+    samples.push_back(s);
+
+    // Truth advances in fine steps over the sample interval
+    for (int sub = 0; sub < 10; sub++) {
+      integrate(q, rates, dt / 10);
+    }
+  }
+  return samples;
+}
+
+struct Accuracy {
+  double tiltRms;
+  double tiltMax;
+  double yawRms;
+};
+
+// Runs the filter (or plain gyro integration) over samples and scores it
+// after a 5 s settling period
+static Accuracy score(const std::vector<ImuSample>& samples, int mode) {
+  AttitudeEstimator ahrs;
+  Quat gyroOnly = {1, 0, 0, 0};
+  const float dt = (float)(1.0 / AHRS_BENCH_RATE);
+  double tiltSum = 0, tiltMax = 0, yawSum = 0;
+  size_t count = 0;
+
+  for (size_t i = 0; i < samples.size(); i++) {
+    const ImuSample& s = samples[i];
+    float w, x, y, z;
+    if (mode == 0) {
+      double rates[3] = {s.gyro[0] * M_PI / 180.0, s.gyro[1] * M_PI / 180.0, s.gyro[2] * M_PI / 180.0};
+      if (i > 0) {
+        integrate(gyroOnly, rates, dt);
+      }
+      w = (float)gyroOnly.w; x = (float)gyroOnly.x; y = (float)gyroOnly.y; z = (float)gyroOnly.z;
+    } else {
+      if (i == 0) {
+        ahrs.align(s.accel[0], s.accel[1], s.accel[2]);
+      } else if (mode == 1) {
+        ahrs.update(s.gyro[0], s.gyro[1], s.gyro[2], s.accel[0], s.accel[1], s.accel[2], dt);
+      } else {
+        ahrs.update(s.gyro[0], s.gyro[1], s.gyro[2], s.accel[0], s.accel[1], s.accel[2],
+                    s.mag[0], s.mag[1], s.mag[2], dt);
+      }
+      ahrs.getQuaternion(w, x, y, z);
+    }
+
+    if (i < (size_t)(5 * AHRS_BENCH_RATE)) {
+      continue;
+    }
+    double tilt = tiltError(s.truth, w, x, y, z);
+    // Yaw against magnetic north, which is earth x in the simulation
+    double yaw = wrapDegrees(yawOf(w, x, y, z) - yawOf(s.truth.w, s.truth.x, s.truth.y, s.truth.z));
+    tiltSum += tilt * tilt;
+    tiltMax = fmax(tiltMax, tilt);
+    yawSum += yaw * yaw;
+    count++;
+  }
+
+  Accuracy a;
+  a.tiltRms = sqrt(tiltSum / count);
+  a.tiltMax = tiltMax;
+  a.yawRms = sqrt(yawSum / count);
+  return a;
+}
+
+// Cost of one update, averaged over many passes over the samples
+static void measureCost(const std::vector<ImuSample>& samples, bool useMag, double& ns, double& cycles) {
+  const int runs = 20;
+  const float dt = (float)(1.0 / AHRS_BENCH_RATE);
+  AttitudeEstimator ahrs;
+  volatile float sink = 0;
+
+  uint64_t start = groundMicros();
+#ifdef AHRS_BENCH_HAVE_TSC
+  uint64_t tscStart = __rdtsc();
+#endif
+  for (int r = 0; r < runs; r++) {
+    for (size_t i = 0; i < samples.size(); i++) {
+      const ImuSample& s = samples[i];
+      if (useMag) {
+        ahrs.update(s.gyro[0], s.gyro[1], s.gyro[2], s.accel[0], s.accel[1], s.accel[2],
+                    s.mag[0], s.mag[1], s.mag[2], dt);
+      } else {
+        ahrs.update(s.gyro[0], s.gyro[1], s.gyro[2], s.accel[0], s.accel[1], s.accel[2], dt);
+      }
+    }
+  }
+#ifdef AHRS_BENCH_HAVE_TSC
+  cycles = (double)(__rdtsc() - tscStart) / ((double)runs * samples.size());
+#else
+  cycles = 0;
+#endif
+  ns = (groundMicros() - start) * 1000.0 / ((double)runs * samples.size());
+
+  float w, x, y, z;
+  ahrs.getQuaternion(w, x, y, z);
+  sink = w;
+  (void)sink;
+}
+
+int runAhrsBench(int argc, char** argv) {
+  int runs = argc > 0 ? atoi(argv[0]) : 5;
+  if (runs <= 0) {
+    fprintf(stderr, "ahrs-bench: usage: ahrs-bench [runs]\n");
+    return 1;
+  }
+
+  Accuracy sum[3] = {};
+  double tiltMax[3] = {0, 0, 0};
+  std::vector<ImuSample> samples;
+  for (int r = 0; r < runs; r++) {
+    samples = simulateMotion(3000 + r);
+    for (int mode = 0; mode < 3; mode++) {
+      Accuracy a = score(samples, mode);
+      sum[mode].tiltRms += a.tiltRms / runs;
+      sum[mode].yawRms += a.yawRms / runs;
+      tiltMax[mode] = fmax(tiltMax[mode], a.tiltMax);
+    }
+  }
+
+  double imuNs, imuCycles, margNs, margCycles;
+  measureCost(samples, false, imuNs, imuCycles);
+  measureCost(samples, true, margNs, margCycles);
+
+  printf("AHRS on %d simulated runs (%.0f Hz, %.0f s tumbling, %.1f deg/s gyro bias, %.2f g accel noise)\n",
+         runs, AHRS_BENCH_RATE, AHRS_BENCH_DURATION, AHRS_BENCH_GYRO_BIAS, AHRS_BENCH_ACCEL_NOISE);
+  printf("  %-22s %12s %12s %12s\n", "", "tilt RMS", "tilt max", "yaw RMS");
+  const char* names[3] = {"gyro integration", "AHRS (gyro + accel)", "AHRS (+ mag)"};
+  for (int mode = 0; mode < 3; mode++) {
+    printf("  %-22s %10.2f deg %10.2f deg %10.2f deg\n", names[mode], sum[mode].tiltRms, tiltMax[mode], sum[mode].yawRms);
+  }
+  printf("  update cost (host): gyro + accel %.1f ns", imuNs);
+  if (imuCycles > 0) printf(" / %.0f TSC cycles", imuCycles);
+  printf(", + mag %.1f ns", margNs);
+  if (margCycles > 0) printf(" / %.0f TSC cycles", margCycles);
+  printf("\n  on the board see perfMetrics.attitudeStepCycles (CPU cycles per update)\n");
+  return 0;
+}
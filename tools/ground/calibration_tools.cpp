@@ -0,0 +1,255 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "ground_commands.h"
+#include "imu_calibration.h"
+#include "serial_port.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CAL_BENCH_HAVE_TSC 1
+#endif
+
+// Host check of the IMU calibration: runs the firmware's collection steps
+// and solvers on a simulated sensor with known errors, then reports the
+// residual error and the per-sample cost of the correction kernel.
+
+struct SimulatedImu {
+  float gyroBias[3];
+  double accelA[9];   // Reading = A * g + b
+  float accelBias[3];
+  double magS[9];     // Reading = S * field + h
+  float magBias[3];
+};
+
+static void multiply3(const double m[9], const double v[3], double out[3]) {
+  for (int i = 0; i < 3; i++) {
+    out[i] = m[i * 3] * v[0] + m[i * 3 + 1] * v[1] + m[i * 3 + 2] * v[2];
+  }
+}
+
+static SimulatedImu makeImu(std::mt19937& rng) {
+  std::uniform_real_distribution<double> small(-1.0, 1.0);
+  SimulatedImu imu;
+  for (int i = 0; i < 3; i++) {
+    imu.gyroBias[i] = (float)(3.0 * small(rng));     // deg/s
+    imu.accelBias[i] = (float)(0.05 * small(rng));   // g
+    imu.magBias[i] = (float)(30.0 * small(rng));     // uT hard iron
+  }
+  for (int i = 0; i < 9; i++) {
+    bool diagonal = i % 4 == 0;
+    imu.accelA[i] = (diagonal ? 1.0 : 0.0) + (diagonal ? 0.03 : 0.01) * small(rng);
+    // Symmetric soft iron
+    imu.magS[i] = diagonal ? 1.0 + 0.2 * small(rng) : 0.0;
+  }
+  double offDiagonal[3] = {0.1 * small(rng), 0.1 * small(rng), 0.1 * small(rng)};
+  imu.magS[1] = imu.magS[3] = offDiagonal[0];
+  imu.magS[2] = imu.magS[6] = offDiagonal[1];
+  imu.magS[5] = imu.magS[7] = offDiagonal[2];
+  return imu;
+}
+
+static void randomUnit(std::mt19937& rng, double v[3]) {
+  std::normal_distribution<double> n(0.0, 1.0);
+  double len;
+  do {
+    v[0] = n(rng);
+    v[1] = n(rng);
+    v[2] = n(rng);
+    len = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  } while (len < 1e-6);
+  v[0] /= len;
+  v[1] /= len;
+  v[2] /= len;
+}
+
+struct CalResult {
+  bool ok;
+  double gyroErr;      // deg/s, max axis after correction
+  double accelBefore;  // g RMS over random orientations
+  double accelAfter;
+  double magBefore;    // RMS |m| deviation from the mean, percent
+  double magAfter;
+};
+
+static CalResult calibrateOnce(unsigned seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> gyroNoise(0.0, 0.1);
+  std::normal_distribution<double> accelNoise(0.0, 0.005);
+  std::normal_distribution<double> magNoise(0.0, 0.3);
+  SimulatedImu imu = makeImu(rng);
+  ImuCalibrator calibrator;
+  CalResult result = {};
+
+  float gyro[3], accel[3], mag[3] = {0, 0, 0};
+
+  // Gyro bias at rest
+  calibrator.startGyro();
+  bool done = false;
+  while (!done) {
+    for (int i = 0; i < 3; i++) {
+      gyro[i] = (float)(imu.gyroBias[i] + gyroNoise(rng));
+      accel[i] = 0;
+    }
+    done = calibrator.addSample(gyro, accel, mag);
+  }
+
+  // Six positions
+  for (int face = 0; face < FACE_COUNT; face++) {
+    double g[3] = {0, 0, 0};
+    g[face / 2] = (face % 2 == 0) ? 1.0 : -1.0;
+    double reading[3];
+    multiply3(imu.accelA, g, reading);
+    calibrator.startAccelFace((AccelFace)face);
+    done = false;
+    while (!done) {
+      for (int i = 0; i < 3; i++) {
+        accel[i] = (float)(reading[i] + imu.accelBias[i] + accelNoise(rng));
+        gyro[i] = (float)(imu.gyroBias[i] + gyroNoise(rng));
+      }
+      done = calibrator.addSample(gyro, accel, mag);
+    }
+  }
+
+  // Magnetometer tumble
+  const double fieldStrength = 50.0;
+  calibrator.startMag();
+  for (int n = 0; n < 1000; n++) {
+    double dir[3], reading[3];
+    randomUnit(rng, dir);
+    for (int i = 0; i < 3; i++) dir[i] *= fieldStrength;
+    multiply3(imu.magS, dir, reading);
+    for (int i = 0; i < 3; i++) {
+      mag[i] = (float)(reading[i] + imu.magBias[i] + magNoise(rng));
+    }
+    calibrator.addSample(gyro, accel, mag);
+  }
+  calibrator.finishMag();
+
+  const ImuCalibration& cal = calibrator.getCalibration();
+  result.ok = cal.flags == (IMU_CAL_GYRO | IMU_CAL_ACCEL | IMU_CAL_MAG);
+  if (!result.ok) {
+    fprintf(stderr, "cal-bench: seed %u failed: %s\n", seed, calibrator.getError() ? calibrator.getError() : "?");
+    return result;
+  }
+
+  // Score on fresh random orientations
+  double accelSumBefore = 0, accelSumAfter = 0;
+  std::vector<double> magBefore, magAfter;
+  const int trials = 2000;
+  for (int n = 0; n < trials; n++) {
+    double g[3], reading[3];
+    randomUnit(rng, g);
+    multiply3(imu.accelA, g, reading);
+    float rawGyro[3], rawAccel[3], rawMag[3];
+    for (int i = 0; i < 3; i++) {
+      rawAccel[i] = (float)(reading[i] + imu.accelBias[i]);
+      rawGyro[i] = imu.gyroBias[i];
+    }
+    double dir[3];
+    randomUnit(rng, dir);
+    for (int i = 0; i < 3; i++) dir[i] *= fieldStrength;
+    multiply3(imu.magS, dir, reading);
+    for (int i = 0; i < 3; i++) {
+      rawMag[i] = (float)(reading[i] + imu.magBias[i]);
+    }
+
+    float cg[3], ca[3], cm[3];
+    memcpy(cg, rawGyro, sizeof(cg));
+    memcpy(ca, rawAccel, sizeof(ca));
+    memcpy(cm, rawMag, sizeof(cm));
+    applyImuCalibration(cal, cg, ca, cm);
+
+    for (int i = 0; i < 3; i++) {
+      accelSumBefore += (rawAccel[i] - g[i]) * (rawAccel[i] - g[i]);
+      accelSumAfter += (ca[i] - g[i]) * (ca[i] - g[i]);
+      result.gyroErr = fmax(result.gyroErr, fabs(cg[i]));
+    }
+    magBefore.push_back(sqrt(rawMag[0] * rawMag[0] + rawMag[1] * rawMag[1] + rawMag[2] * rawMag[2]));
+    magAfter.push_back(sqrt(cm[0] * cm[0] + cm[1] * cm[1] + cm[2] * cm[2]));
+  }
+  result.accelBefore = sqrt(accelSumBefore / (3.0 * trials));
+  result.accelAfter = sqrt(accelSumAfter / (3.0 * trials));
+
+  for (int pass = 0; pass < 2; pass++) {
+    std::vector<double>& v = pass == 0 ? magBefore : magAfter;
+    double mean = 0, sq = 0;
+    for (size_t i = 0; i < v.size(); i++) mean += v[i] / v.size();
+    for (size_t i = 0; i < v.size(); i++) sq += (v[i] - mean) * (v[i] - mean) / v.size();
+    (pass == 0 ? result.magBefore : result.magAfter) = 100.0 * sqrt(sq) / mean;
+  }
+  return result;
+}
+
+static void measureCost(double& ns, double& cycles) {
+  ImuCalibration cal;
+  ImuCalibrator::clear(cal);
+  cal.accelMatrix[1] = 0.01f;
+  cal.magMatrix[5] = 0.02f;
+  const int count = 2000000;
+  float g[3] = {0.1f, 0.2f, 0.3f}, a[3] = {0.0f, 0.0f, 1.0f}, m[3] = {20.0f, 5.0f, -40.0f};
+  volatile float sink = 0;
+
+  uint64_t start = groundMicros();
+#ifdef CAL_BENCH_HAVE_TSC
+  uint64_t tscStart = __rdtsc();
+#endif
+  for (int i = 0; i < count; i++) {
+    float cg[3] = {g[0] + i * 1e-7f, g[1], g[2]};
+    float ca[3] = {a[0], a[1] + i * 1e-7f, a[2]};
+    float cm[3] = {m[0], m[1], m[2] + i * 1e-7f};
+    applyImuCalibration(cal, cg, ca, cm);
+    sink = cg[0] + ca[1] + cm[2];
+  }
+#ifdef CAL_BENCH_HAVE_TSC
+  cycles = (double)(__rdtsc() - tscStart) / count;
+#else
+  cycles = 0;
+#endif
+  ns = (groundMicros() - start) * 1000.0 / count;
+  (void)sink;
+}
+
+int runCalBench(int argc, char** argv) {
+  int runs = argc > 0 ? atoi(argv[0]) : 20;
+  if (runs <= 0) {
+    fprintf(stderr, "cal-bench: usage: cal-bench [runs]\n");
+    return 1;
+  }
+
+  int failures = 0;
+  double gyroErr = 0, accelBefore = 0, accelAfter = 0, magBefore = 0, magAfter = 0;
+  for (int r = 0; r < runs; r++) {
+    CalResult result = calibrateOnce(4000 + r);
+    if (!result.ok) {
+      failures++;
+      continue;
+    }
+    gyroErr = fmax(gyroErr, result.gyroErr);
+    accelBefore += result.accelBefore;
+    accelAfter += result.accelAfter;
+    magBefore += result.magBefore;
+    magAfter += result.magAfter;
+  }
+  int good = runs - failures;
+  if (good == 0) {
+    fprintf(stderr, "cal-bench: every calibration failed\n");
+    return 1;
+  }
+
+  double ns, cycles;
+  measureCost(ns, cycles);
+
+  printf("IMU calibration on %d simulated sensors (3 deg/s gyro bias, 3%% accel scale + 1%% cross-axis, "
+         "30 uT hard iron, 20%% soft iron)\n", runs);
+  printf("  fits: %d ok, %d failed\n", good, failures);
+  printf("  gyro bias residual: max %.3f deg/s\n", gyroErr);
+  printf("  accel error RMS: %.4f g raw -> %.4f g corrected\n", accelBefore / good, accelAfter / good);
+  printf("  mag |field| spread: %.2f%% raw -> %.2f%% corrected\n", magBefore / good, magAfter / good);
+  printf("  correction kernel (host): %.1f ns", ns);
+  if (cycles > 0) printf(" / %.0f TSC cycles", cycles);
+  printf(" per sample; on the board see perfMetrics.imuCorrectionCycles\n");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+#include "command_link.h"
+#include <stdio.h>
+#include <string.h>
+
+CommandLink::CommandLink(SerialPort& port) :
+  port(port),
+  receiver(handleLine, this),
+  lineHandler(NULL),
+  lineContext(NULL),
+  maxAttempts(5),
+  timeoutMs(1000),
+  awaitingSeq(0),
+  ackReceived(false) {
+  // Start from a time-derived sequence so a restarted tool never collides
+  // with the board's cached last sequence number
+  nextSeq = (uint32_t)(groundMicros() & 0x3FFFFFFF) + 1;
+  memset(&lastAck, 0, sizeof(lastAck));
+}
+
+void CommandLink::setLineHandler(LineHandler handler, void* context) {
+  lineHandler = handler;
+  lineContext = context;
+}
+
+void CommandLink::setRetryPolicy(int attempts, int timeout) {
+  maxAttempts = attempts > 0 ? attempts : 1;
+  timeoutMs = timeout > 0 ? timeout : 1;
+}
+
+void CommandLink::handleLine(const char* line, bool fromFec, int corrected, void* context) {
+  (void)fromFec;
+  (void)corrected;
+  CommandLink* self = static_cast<CommandLink*>(context);
+
+  AckFrame ack;
+  if (CommandProtocol::parseAck(line, ack)) {
+    if (ack.seq == self->awaitingSeq) {
+      self->lastAck = ack;
+      self->ackReceived = true;
+    }
+    return;
+  }
+
+  if (self->lineHandler) {
+    self->lineHandler(line, self->lineContext);
+  }
+}
+
+bool CommandLink::poll(int waitMs) {
+  uint8_t buffer[256];
+  long n = port.read(buffer, sizeof(buffer), waitMs);
+  if (n < 0) {
+    return false;
+  }
+  receiver.push(buffer, (size_t)n);
+  return true;
+}
+
+bool CommandLink::execute(const char* name, const char* args, Result& result) {
+  memset(&result.ack, 0, sizeof(result.ack));
+  result.attempts = 0;
+  result.rttMs = 0;
+  result.failure = NONE;
+
+  char frame[CMD_MAX_LINE_LENGTH];
+  uint32_t seq = nextSeq++;
+  if (CommandProtocol::formatCommand(frame, sizeof(frame), seq, name, args) == 0) {
+    result.failure = BAD_FRAME;
+    return false;
+  }
+
+  awaitingSeq = seq;
+  ackReceived = false;
+
+  for (int attempt = 1; attempt <= maxAttempts; attempt++) {
+    uint64_t sentAt = groundMicros();
+    if (!port.write((const uint8_t*)frame, strlen(frame))) {
+      result.failure = IO_ERROR;
+      return false;
+    }
+    result.attempts = attempt;
+
+    uint64_t deadline = sentAt + (uint64_t)timeoutMs * 1000ULL;
+    while (!ackReceived) {
+      uint64_t now = groundMicros();
+      if (now >= deadline) {
+        break;
+      }
+      int remainingMs = (int)((deadline - now + 999) / 1000);
+      if (!poll(remainingMs)) {
+        result.failure = IO_ERROR;
+        return false;
+      }
+    }
+
+    if (ackReceived) {
+      result.ack = lastAck;
+      result.rttMs = (groundMicros() - sentAt) / 1000.0;
+      return true;
+    }
+  }
+
+  result.failure = TIMEOUT;
+  return false;
+}
@@ -0,0 +1,55 @@
+#ifndef GROUND_COMMAND_LINK_H
+#define GROUND_COMMAND_LINK_H
+
+#include <stdint.h>
+#include "command_protocol.h"
+#include "line_receiver.h"
+#include "serial_port.h"
+
+// Ground side of the reliable command uplink: sends sequence-numbered CMD
+// frames and retransmits until the matching ACK arrives. Downlink lines that
+// are not acks are forwarded to an optional handler.
+class CommandLink {
+public:
+  typedef void (*LineHandler)(const char* line, void* context);
+
+  // Why execute() returned false
+  enum Failure { NONE, TIMEOUT, BAD_FRAME, IO_ERROR };
+
+  struct Result {
+    AckFrame ack;
+    int attempts;  // Transmissions made, 0 if the frame never went out
+    double rttMs;  // From the last transmission to the ack
+    Failure failure;
+  };
+
+  CommandLink(SerialPort& port);
+
+  void setLineHandler(LineHandler handler, void* context);
+  void setRetryPolicy(int maxAttempts, int timeoutMs);
+
+  // Returns true once acked; false after all attempts timed out, if the
+  // command does not fit in a frame, or on a serial port error
+  bool execute(const char* name, const char* args, Result& result);
+
+  // Services the downlink for up to timeoutMs (forwarding lines)
+  bool poll(int timeoutMs);
+
+  const FecDeframer::Stats& getFecStats() const { return receiver.getFecStats(); }
+
+private:
+  static void handleLine(const char* line, bool fromFec, int corrected, void* context);
+
+  SerialPort& port;
+  LineReceiver receiver;
+  LineHandler lineHandler;
+  void* lineContext;
+  int maxAttempts;
+  int timeoutMs;
+  uint32_t nextSeq;
+  uint32_t awaitingSeq;
+  bool ackReceived;
+  AckFrame lastAck;
+};
+
+#endif
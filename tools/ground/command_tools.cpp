@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command_link.h"
+#include "ground_commands.h"
+
+static void printDownlinkLine(const char* line, void* context) {
+  (void)context;
+  // Keep the terminal readable: telemetry is noise while waiting for an ack
+  if (strncmp(line, "TELEM,", 6) != 0) {
+    printf("  < %s\n", line);
+  }
+}
+
+int runCommand(int argc, char** argv) {
+  const char* device = NULL;
+  const char* name = NULL;
+  const char* args = "";
+  unsigned long baud = 57600;
+  int attempts = 5;
+  int timeoutMs = 1000;
+
+  for (int i = 0; i < argc; i++) {
+    if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      baud = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      attempts = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      timeoutMs = atoi(argv[++i]);
+    } else if (!device) {
+      device = argv[i];
+    } else if (!name) {
+      name = argv[i];
+    } else {
+      args = argv[i];
+    }
+  }
+
+  if (!device || !name) {
+    fprintf(stderr, "cmd: usage: cmd <device> <NAME> [args] [-b baud] [-r attempts] [-t timeout_ms]\n");
+    return 1;
+  }
+
+  SerialPort port;
+  if (!port.open(device, baud)) {
+    fprintf(stderr, "cmd: cannot open %s\n", device);
+    return 1;
+  }
+
+  CommandLink link(port);
+  link.setRetryPolicy(attempts, timeoutMs);
+  link.setLineHandler(printDownlinkLine, NULL);
+
+  CommandLink::Result result;
+  if (!link.execute(name, args, result)) {
+    if (result.failure == CommandLink::BAD_FRAME) {
+      fprintf(stderr, "%s: command too long for one frame\n", name);
+      return 1;
+    }
+    if (result.failure == CommandLink::IO_ERROR) {
+      fprintf(stderr, "%s: serial I/O error on %s after %d attempts\n", name, device, result.attempts);
+    } else {
+      fprintf(stderr, "%s: no ack after %d attempts\n", name, result.attempts);
+    }
+    return 2;
+  }
+
+  printf("%s: %s (seq %lu) rtt %.1f ms, exec %lu us, attempts %d%s%s\n",
+         name, result.ack.status, (unsigned long)result.ack.seq, result.rttMs,
+         (unsigned long)result.ack.execMicros, result.attempts,
+         result.ack.detail[0] ? ", " : "", result.ack.detail);
+
+  return strcmp(result.ack.status, ACK_STATUS_OK) == 0 ? 0 : 3;
+}
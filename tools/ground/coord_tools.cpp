@@ -0,0 +1,159 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "ground_commands.h"
+#include "geo_coord.h"
+#include "telemetry_codec.h"
+#include "serial_port.h"
+
+// Host check of the fixed-point coordinates: NMEA parse error against an
+// exact reference for the float path the firmware used before and for the
+// 1e-7 degree integers, and the formatting cost per record (the position
+// fields as %.6f floats vs. the integer formatter, and a whole TELEM line).
+
+#define COORD_BENCH_EARTH_RADIUS 6371000.0
+#define COORD_BENCH_REPEATS 20
+
+struct CoordSample {
+  char latField[24];
+  char lonField[24];
+  char latHemisphere;
+  char lonHemisphere;
+  double latitude;     // Exact value of the NMEA text
+  double longitude;
+};
+
+// The parser the firmware had: degrees + minutes / 60 in float
+static float parseFloatCoordinate(const char* coord, char direction) {
+  int degreeDigits = (direction == 'N' || direction == 'S') ? 2 : 3;
+  char degrees[4] = {0};
+  memcpy(degrees, coord, degreeDigits);
+  float result = (float)atof(degrees) + (float)atof(coord + degreeDigits) / 60.0f;
+  return (direction == 'S' || direction == 'W') ? -result : result;
+}
+
+static void makeSample(std::mt19937& rng, CoordSample& s) {
+  std::uniform_real_distribution<double> latDist(-80.0, 80.0);
+  std::uniform_real_distribution<double> lonDist(-179.9, 179.9);
+  double lat = latDist(rng);
+  double lon = lonDist(rng);
+  s.latHemisphere = lat < 0 ? 'S' : 'N';
+  s.lonHemisphere = lon < 0 ? 'W' : 'E';
+
+  // Receivers print minutes with 5 decimals; the exact value is the text
+  double latAbs = fabs(lat), lonAbs = fabs(lon);
+  int latDeg = (int)latAbs, lonDeg = (int)lonAbs;
+  int latMin = (int)lround((latAbs - latDeg) * 60.0 * 100000.0);
+  int lonMin = (int)lround((lonAbs - lonDeg) * 60.0 * 100000.0);
+  if (latMin >= 6000000) latMin = 5999999;
+  if (lonMin >= 6000000) lonMin = 5999999;
+  snprintf(s.latField, sizeof(s.latField), "%02d%02d.%05d", latDeg % 100, latMin / 100000, latMin % 100000);
+  snprintf(s.lonField, sizeof(s.lonField), "%03d%02d.%05d", lonDeg % 1000, lonMin / 100000, lonMin % 100000);
+  s.latitude = (latDeg + latMin / 6000000.0) * (lat < 0 ? -1 : 1);
+  s.longitude = (lonDeg + lonMin / 6000000.0) * (lon < 0 ? -1 : 1);
+}
+
+static double errorMeters(double latitude, double dLat, double dLon) {
+  double mPerDeg = COORD_BENCH_EARTH_RADIUS * M_PI / 180.0;
+  return hypot(dLat * mPerDeg, dLon * mPerDeg * cos(latitude * M_PI / 180.0));
+}
+
+int runCoordBench(int argc, char** argv) {
+  int records = argc > 0 ? atoi(argv[0]) : 100000;
+  if (records <= 0) {
+    fprintf(stderr, "coord-bench: usage: coord-bench [records]\n");
+    return 1;
+  }
+
+  std::mt19937 rng(40);
+  std::vector<CoordSample> samples(records);
+  for (int i = 0; i < records; i++) {
+    makeSample(rng, samples[i]);
+  }
+
+  // Parse precision
+  std::vector<float> floatLat(records), floatLon(records);
+  std::vector<int32_t> fixedLat(records), fixedLon(records);
+  double floatSq = 0, floatMax = 0, fixedSq = 0, fixedMax = 0;
+  int parseFailures = 0;
+  for (int i = 0; i < records; i++) {
+    const CoordSample& s = samples[i];
+    floatLat[i] = parseFloatCoordinate(s.latField, s.latHemisphere);
+    floatLon[i] = parseFloatCoordinate(s.lonField, s.lonHemisphere);
+    if (!parseNmeaCoordinate(s.latField, s.latHemisphere, fixedLat[i]) ||
+        !parseNmeaCoordinate(s.lonField, s.lonHemisphere, fixedLon[i])) {
+      parseFailures++;
+      continue;
+    }
+    double floatErr = errorMeters(s.latitude, floatLat[i] - s.latitude, floatLon[i] - s.longitude);
+    double fixedErr = errorMeters(s.latitude, coordToDegrees(fixedLat[i]) - s.latitude,
+                                  coordToDegrees(fixedLon[i]) - s.longitude);
+    floatSq += floatErr * floatErr;
+    fixedSq += fixedErr * fixedErr;
+    if (floatErr > floatMax) floatMax = floatErr;
+    if (fixedErr > fixedMax) fixedMax = fixedErr;
+  }
+
+  // Round trip through the text: formatted, parsed back by the ground
+  int roundTripErrors = 0;
+  for (int i = 0; i < records; i++) {
+    char text[COORD_TEXT_LENGTH];
+    formatCoordinate(text, sizeof(text), fixedLat[i]);
+    if (coordFromDegrees(strtod(text, NULL)) != fixedLat[i]) roundTripErrors++;
+    formatCoordinate(text, sizeof(text), fixedLon[i]);
+    if (coordFromDegrees(strtod(text, NULL)) != fixedLon[i]) roundTripErrors++;
+  }
+
+  // Formatting cost of the two position fields per record
+  char line[TELEM_LINE_MAX_LENGTH];
+  unsigned long sink = 0;
+  uint64_t start = groundMicros();
+  for (int r = 0; r < COORD_BENCH_REPEATS; r++) {
+    for (int i = 0; i < records; i++) {
+      sink += snprintf(line, sizeof(line), "%.6f,%.6f,", floatLat[i], floatLon[i]);
+    }
+  }
+  double floatNs = (groundMicros() - start) * 1000.0 / ((double)records * COORD_BENCH_REPEATS);
+
+  start = groundMicros();
+  for (int r = 0; r < COORD_BENCH_REPEATS; r++) {
+    for (int i = 0; i < records; i++) {
+      size_t len = formatCoordinate(line, sizeof(line), fixedLat[i]);
+      line[len++] = ',';
+      len += formatCoordinate(line + len, sizeof(line) - len, fixedLon[i]);
+      line[len++] = ',';
+      sink += len;
+    }
+  }
+  double fixedNs = (groundMicros() - start) * 1000.0 / ((double)records * COORD_BENCH_REPEATS);
+
+  // Whole TELEM record (four coordinates) for scale
+  TelemetryData data;
+  memset(&data, 0, sizeof(data));
+  TelemetryFrameInfo info = {1, 1000};
+  start = groundMicros();
+  for (int i = 0; i < records; i++) {
+    data.latitude = fixedLat[i];
+    data.longitude = fixedLon[i];
+    data.nav_latitude = fixedLat[i] + 17;
+    data.nav_longitude = fixedLon[i] - 17;
+    data.timestamp = i;
+    sink += TelemetryCodec::formatLine(line, sizeof(line), data, info);
+  }
+  double recordNs = (groundMicros() - start) * 1000.0 / records;
+
+  printf("Coordinates on %d random NMEA fixes (5-decimal minutes)\n", records);
+  printf("  parse error vs. the NMEA text:\n");
+  printf("    %-24s RMS %7.3f m  max %7.3f m\n", "float degrees (before)", sqrt(floatSq / records), floatMax);
+  printf("    %-24s RMS %7.3f m  max %7.3f m\n", "int32 1e-7 degrees", sqrt(fixedSq / records), fixedMax);
+  printf("  %d parse failures, %d text round-trip mismatches\n", parseFailures, roundTripErrors);
+  printf("  lat,lon formatting per record (host): %%.6f float %.0f ns, integer %.0f ns (%.1fx)\n",
+         floatNs, fixedNs, fixedNs > 0 ? floatNs / fixedNs : 0.0);
+  printf("  whole TELEM line %.0f ns; the SD row and web JSON format the same fields\n", recordNs);
+  if (sink == 0) printf("\n");
+
+  return parseFailures == 0 && roundTripErrors == 0 && fixedMax < floatMax && fixedNs < floatNs ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "ground_commands.h"
+#include "imu_decimator.h"
+#include "serial_port.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define DECIM_BENCH_HAVE_TSC 1
+#endif
+
+// Host check of the IMU decimation streams: frequency response of each
+// configuration the firmware uses (sine sweeps through the exact fixed-point
+// code, against plain subsampling, which passes every alias at 0 dB) and
+// the throughput of the whole bank in samples per second on one core.
+
+#define DECIM_BENCH_AMPLITUDE 8000.0  // Common counts (about 0.5 g)
+
+struct DecimConfig {
+  const char* name;
+  double inputRate;   // Hz
+  uint16_t factor;
+};
+
+// Output rates from the RATES_* table, the radio and the web UI
+static const DecimConfig configs[] = {
+  {"boost SD 100 Hz", 1000.0, 10},
+  {"coast SD 40 Hz", 1000.0, 25},
+  {"radio 10 Hz", 1000.0, 100},
+  {"web 2 Hz", 1000.0, 500},
+  {"pad SD 10 Hz", 200.0, 20},
+  {"landed SD 1 Hz", 200.0, 200},
+};
+
+// Test frequencies as multiples of the output rate; >= 0.5 alias
+static const double sweep[] = {0.1, 0.25, 0.4, 0.6, 0.8, 1.3, 2.7, 4.9};
+#define SWEEP_COUNT (sizeof(sweep) / sizeof(sweep[0]))
+#define PASSBAND_LIMIT 0.25   // Passband edge (x output rate) checked for flatness
+#define STOPBAND_LIMIT 0.75   // Alias band start checked for attenuation
+
+// Output RMS over input RMS for a sine at f, in dB. antiAlias false runs
+// the filter stream (batch mean) with batches of `factor` samples.
+static double measureGain(uint16_t factor, bool antiAlias, double inputRate, double f) {
+  DecimationStage stage;
+  stage.configure(factor);
+  ImuDecimator batchMean;
+  std::vector<int32_t> batch((size_t)factor * DECIM_AXES);
+  double outputRate = inputRate / factor;
+  // Long enough for 40 output periods and 20 cycles of the tone
+  int outputs = (int)fmax(40.0, 20.0 * outputRate / f);
+  int settle = 2 * DECIM_MAX_FIR_TAPS;
+  int total = (outputs + settle) * factor;
+
+  double sum = 0;
+  int counted = 0, produced = 0;
+  int32_t sample[DECIM_AXES];
+  for (int n = 0; n < total; n++) {
+    int32_t v = (int32_t)lround(DECIM_BENCH_AMPLITUDE * sin(2.0 * M_PI * f * n / inputRate + 0.3));
+    for (int a = 0; a < DECIM_AXES; a++) {
+      sample[a] = v;
+      batch[(size_t)(n % factor) * DECIM_AXES + a] = v;
+    }
+    double y;
+    if (antiAlias) {
+      if (stage.process(sample, 1, false) == 0) continue;
+      y = stage.getOutput()[0];
+    } else {
+      if (n % factor != factor - 1) continue;
+      batchMean.process(batch.data(), factor, false);
+      float accel[3], gyro[3];
+      batchMean.getOutput(IMU_STREAM_FILTER, accel, gyro);
+      y = accel[0] / DECIM_ACCEL_UNIT;
+    }
+    if (produced++ >= settle) {
+      sum += y * y;
+      counted++;
+    }
+  }
+  double rms = sqrt(sum / counted);
+  double inputRms = DECIM_BENCH_AMPLITUDE / sqrt(2.0);
+  return 20.0 * log10(fmax(rms, 1e-3) / inputRms);
+}
+
+// Whole bank at the boost configuration, single thread
+static void measureThroughput(double& samplesPerSec, double& cycles) {
+  const int count = 1000000;
+  const int batch = 10;
+  std::vector<int32_t> samples((size_t)count * DECIM_AXES);
+  std::mt19937 rng(7);
+  std::normal_distribution<double> noise(0.0, 4000.0);
+  for (size_t i = 0; i < samples.size(); i++) {
+    samples[i] = (int32_t)noise(rng);
+  }
+
+  ImuDecimator bank;
+  bank.configure(IMU_STREAM_SD, 10);
+  bank.configure(IMU_STREAM_RADIO, 100);
+  bank.configure(IMU_STREAM_WEB, 500);
+
+  volatile unsigned sink = 0;
+  uint64_t start = groundMicros();
+#ifdef DECIM_BENCH_HAVE_TSC
+  uint64_t tscStart = __rdtsc();
+#endif
+  for (int i = 0; i < count; i += batch) {
+    sink = sink + bank.process(&samples[(size_t)i * DECIM_AXES], batch, false);
+  }
+#ifdef DECIM_BENCH_HAVE_TSC
+  cycles = (double)(__rdtsc() - tscStart) / count;
+#else
+  cycles = 0;
+#endif
+  uint64_t elapsed = groundMicros() - start;
+  samplesPerSec = count * 1e6 / (double)(elapsed ? elapsed : 1);
+  (void)sink;
+}
+
+int runDecimBench(int argc, char** argv) {
+  (void)argc;
+  (void)argv;
+  int failures = 0;
+
+  printf("IMU decimation frequency response (gain in dB at multiples of the output rate)\n");
+  printf("  %-18s %5s %4s %4s", "stream", "CIC", "FIR", "taps");
+  for (size_t i = 0; i < SWEEP_COUNT; i++) {
+    printf(" %7.2fx", sweep[i]);
+  }
+  printf("\n");
+
+  for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+    const DecimConfig& cfg = configs[c];
+    DecimationStage stage;
+    stage.configure(cfg.factor);
+    printf("  %-18s %4ux %3ux %4u", cfg.name, (unsigned)(cfg.factor / stage.getFirFactor()),
+           (unsigned)stage.getFirFactor(), (unsigned)stage.getFirTaps());
+    for (size_t i = 0; i < SWEEP_COUNT; i++) {
+      double f = sweep[i] * cfg.inputRate / cfg.factor;
+      if (f >= cfg.inputRate / 2) {
+        printf(" %8s", "-");
+        continue;
+      }
+      double gain = measureGain(cfg.factor, true, cfg.inputRate, f);
+      printf(" %8.1f", gain);
+      if (sweep[i] <= PASSBAND_LIMIT && fabs(gain) > 1.0) failures++;
+      if (sweep[i] >= STOPBAND_LIMIT && gain > -40.0) failures++;
+    }
+    printf("\n");
+
+    // Same output rate as the batch mean (estimator stream)
+    printf("  %-18s %4ux %3s %4s", "  batch mean", (unsigned)cfg.factor, "-", "-");
+    for (size_t i = 0; i < SWEEP_COUNT; i++) {
+      double f = sweep[i] * cfg.inputRate / cfg.factor;
+      if (f >= cfg.inputRate / 2) {
+        printf(" %8s", "-");
+        continue;
+      }
+      printf(" %8.1f", measureGain(cfg.factor, false, cfg.inputRate, f));
+    }
+    printf("\n");
+  }
+  printf("  plain subsampling passes every frequency at 0 dB (aliases fold into the band)\n");
+  printf("  limits: |gain| <= 1 dB up to %.2fx, <= -40 dB from %.2fx\n", PASSBAND_LIMIT, STOPBAND_LIMIT);
+
+  double samplesPerSec, cycles;
+  measureThroughput(samplesPerSec, cycles);
+  printf("Bank throughput (batch mean + 3 streams, boost factors 10/100/500, 6 axes, one core): %.1f M samples/s",
+         samplesPerSec / 1e6);
+  if (cycles > 0) printf(", %.0f TSC cycles per sample", cycles);
+  printf("\n  on the board see perfMetrics.decimationCycles (CPU cycles per FIFO batch)\n");
+
+  if (failures > 0) {
+    printf("FAIL: %d response points outside the limits\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,329 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "block_transfer.h"
+#include "command_link.h"
+#include "ground_commands.h"
+
+// Ground side of the radio log downlink. Received blocks are written in
+// place into the output file; a "<output>.part" file holds the block bitmap
+// so an interrupted download (either end losing power) resumes with only the
+// missing ranges.
+
+struct DownloadState {
+  FILE* out;
+  uint16_t id;
+  uint32_t size;
+  uint32_t blocks;
+  std::vector<uint8_t> received;  // One flag per block
+  uint32_t receivedCount;
+  uint64_t payloadBytes;
+  uint64_t lineBytes;
+  uint32_t duplicates;
+  bool passDone;
+  bool failed;  // The board gave up reading the file
+  uint64_t lastActivity;
+};
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handleInterrupt(int signum) {
+  (void)signum;
+  interrupted = 1;
+}
+
+static bool loadPartFile(const char* path, DownloadState& state) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    return false;
+  }
+
+  unsigned id = 0;
+  unsigned long size = 0, blocks = 0;
+  unsigned blockSize = 0;
+  bool ok = fscanf(f, "RDL1 %u %lu %lu %u\n", &id, &size, &blocks, &blockSize) == 4 &&
+            blockSize == DOWNLINK_BLOCK_SIZE;
+  if (ok) {
+    state.id = (uint16_t)id;
+    state.size = (uint32_t)size;
+    state.blocks = (uint32_t)blocks;
+    state.received.assign(state.blocks, 0);
+    state.receivedCount = 0;
+    for (uint32_t i = 0; i < state.blocks; i += 8) {
+      int byte = fgetc(f);
+      if (byte == EOF) {
+        ok = false;
+        break;
+      }
+      for (uint32_t bit = 0; bit < 8 && i + bit < state.blocks; bit++) {
+        if (byte & (1 << bit)) {
+          state.received[i + bit] = 1;
+          state.receivedCount++;
+        }
+      }
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+static void savePartFile(const char* path, const DownloadState& state) {
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    return;
+  }
+  fprintf(f, "RDL1 %u %lu %lu %u\n", (unsigned)state.id, (unsigned long)state.size,
+          (unsigned long)state.blocks, (unsigned)DOWNLINK_BLOCK_SIZE);
+  for (uint32_t i = 0; i < state.blocks; i += 8) {
+    uint8_t byte = 0;
+    for (uint32_t bit = 0; bit < 8 && i + bit < state.blocks; bit++) {
+      if (state.received[i + bit]) {
+        byte |= (uint8_t)(1 << bit);
+      }
+    }
+    fputc(byte, f);
+  }
+  fclose(f);
+}
+
+static int findMissingRanges(const DownloadState& state, BlockRange* ranges, int maxRanges) {
+  int count = 0;
+  uint32_t i = 0;
+  while (i < state.blocks && count < maxRanges) {
+    if (state.received[i]) {
+      i++;
+      continue;
+    }
+    ranges[count].first = i;
+    while (i < state.blocks && !state.received[i]) {
+      i++;
+    }
+    ranges[count].last = i - 1;
+    count++;
+  }
+  return count;
+}
+
+static void handleDownlinkLine(const char* line, void* context) {
+  DownloadState* state = static_cast<DownloadState*>(context);
+
+  uint16_t id;
+  uint32_t block;
+  uint8_t data[DOWNLINK_BLOCK_SIZE];
+  size_t len;
+  if (BlockTransfer::parseBlock(line, id, block, data, len)) {
+    // Blocks that race the DL_START ack are dropped and requested again later
+    if (!state->out || id != state->id || block >= state->blocks) {
+      return;
+    }
+    state->lastActivity = groundMillis();
+    state->lineBytes += strlen(line) + 1;
+    if (state->received[block]) {
+      state->duplicates++;
+      return;
+    }
+    fseek(state->out, (long)block * DOWNLINK_BLOCK_SIZE, SEEK_SET);
+    fwrite(data, 1, len, state->out);
+    state->received[block] = 1;
+    state->receivedCount++;
+    state->payloadBytes += len;
+    return;
+  }
+
+  char prefix[32];
+  char errorPrefix[32];
+  snprintf(prefix, sizeof(prefix), XFER_FRAME_PREFIX "%u," XFER_STATE_IDLE ",", (unsigned)state->id);
+  snprintf(errorPrefix, sizeof(errorPrefix), XFER_FRAME_PREFIX "%u," XFER_STATE_ERROR ",", (unsigned)state->id);
+  if (strncmp(line, prefix, strlen(prefix)) == 0 && CommandProtocol::verifyCrc(line) >= 0) {
+    state->passDone = true;
+    state->lastActivity = groundMillis();
+  } else if (strncmp(line, errorPrefix, strlen(errorPrefix)) == 0 && CommandProtocol::verifyCrc(line) >= 0) {
+    state->failed = true;
+  } else if (strncmp(line, "TELEM,", 6) != 0 && strncmp(line, BLOCK_FRAME_PREFIX, strlen(BLOCK_FRAME_PREFIX)) != 0) {
+    printf("  < %s\n", line);
+  }
+}
+
+static unsigned long detailValue(const char* detail, const char* key) {
+  const char* p = strstr(detail, key);
+  return p ? strtoul(p + strlen(key), NULL, 10) : 0;
+}
+
+int runDownload(int argc, char** argv) {
+  const char* device = NULL;
+  const char* remoteFile = NULL;
+  const char* outputPath = NULL;
+  unsigned long baud = 57600;
+  unsigned long capacityBps = RADIO_LINK_CAPACITY_BPS;
+
+  for (int i = 0; i < argc; i++) {
+    if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      baud = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      capacityBps = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outputPath = argv[++i];
+    } else if (!device) {
+      device = argv[i];
+    } else if (!remoteFile) {
+      remoteFile = argv[i];
+    }
+  }
+
+  if (!device || !remoteFile) {
+    fprintf(stderr, "download: usage: download <device> <file> [-o output] [-b baud] [-c link_bps]\n");
+    return 1;
+  }
+
+  std::string output = outputPath ? outputPath : (remoteFile[0] == '/' ? remoteFile + 1 : remoteFile);
+  std::string partPath = output + ".part";
+
+  SerialPort port;
+  if (!port.open(device, baud)) {
+    fprintf(stderr, "download: cannot open %s\n", device);
+    return 1;
+  }
+
+  DownloadState state;
+  state.out = NULL;
+  state.id = 0;
+  state.size = state.blocks = state.receivedCount = state.duplicates = 0;
+  state.payloadBytes = state.lineBytes = 0;
+  state.passDone = false;
+  state.failed = false;
+  bool resuming = loadPartFile(partPath.c_str(), state);
+
+  CommandLink link(port);
+  link.setLineHandler(handleDownlinkLine, &state);
+
+  // A resumed download starts with its first gap; later gaps go via DL_RANGE
+  char args[CMD_MAX_ARGS_LENGTH];
+  BlockRange firstGap;
+  if (resuming && findMissingRanges(state, &firstGap, 1) == 1) {
+    snprintf(args, sizeof(args), "%s,%lu,%lu", remoteFile, (unsigned long)firstGap.first, (unsigned long)firstGap.last);
+    printf("Resuming %s: %lu of %lu blocks already received\n", remoteFile,
+           (unsigned long)state.receivedCount, (unsigned long)state.blocks);
+  } else {
+    snprintf(args, sizeof(args), "%s", remoteFile);
+    resuming = false;
+  }
+
+  CommandLink::Result result;
+  if (!link.execute(CMD_DOWNLINK_START, args, result)) {
+    fprintf(stderr, "download: no ack for %s\n", CMD_DOWNLINK_START);
+    return 2;
+  }
+  if (strcmp(result.ack.status, ACK_STATUS_OK) != 0) {
+    fprintf(stderr, "download: %s refused: %s %s\n", CMD_DOWNLINK_START, result.ack.status, result.ack.detail);
+    return 3;
+  }
+
+  uint16_t id = (uint16_t)detailValue(result.ack.detail, "id=");
+  uint32_t size = (uint32_t)detailValue(result.ack.detail, "size=");
+  uint32_t blocks = (uint32_t)detailValue(result.ack.detail, "blocks=");
+  if (detailValue(result.ack.detail, "bs=") != DOWNLINK_BLOCK_SIZE) {
+    fprintf(stderr, "download: block size mismatch (%s)\n", result.ack.detail);
+    return 3;
+  }
+
+  if (resuming && (state.id != id || state.size != size || state.blocks != blocks)) {
+    // The file changed on the card; start over
+    fprintf(stderr, "download: remote file changed, restarting\n");
+    resuming = false;
+  }
+
+  state.out = fopen(output.c_str(), resuming ? "r+b" : "w+b");
+  if (!state.out) {
+    fprintf(stderr, "download: cannot write %s\n", output.c_str());
+    return 1;
+  }
+  if (!resuming) {
+    state.id = id;
+    state.size = size;
+    state.blocks = blocks;
+    state.received.assign(blocks, 0);
+    state.receivedCount = 0;
+  }
+
+  printf("Downloading %s: %lu bytes, %lu blocks\n", remoteFile, (unsigned long)size, (unsigned long)blocks);
+
+  // Ctrl-C leaves a consistent .part file behind for the next run
+  signal(SIGINT, handleInterrupt);
+
+  uint64_t startTime = groundMillis();
+  uint64_t lastSave = startTime;
+  uint64_t lastReport = startTime;
+  state.lastActivity = startTime;
+
+  while (state.receivedCount < state.blocks && !interrupted && !state.failed) {
+    if (!link.poll(200)) {
+      break;
+    }
+    uint64_t now = groundMillis();
+
+    // End of a pass (or a silent link): ask for the gaps
+    if (state.passDone || now - state.lastActivity > 3000) {
+      BlockRange missing[DOWNLINK_MAX_RANGES];
+      int count = findMissingRanges(state, missing, DOWNLINK_MAX_RANGES);
+      if (count == 0) {
+        break;
+      }
+      char spec[CMD_MAX_ARGS_LENGTH];
+      // Fewer ranges if the list doesn't fit in one command
+      while (count > 0 && BlockTransfer::formatRanges(spec, sizeof(spec), missing, count) == 0) {
+        count--;
+      }
+      // A refusal (queue full) is not fatal: the next pass asks again
+      if (link.execute(CMD_DOWNLINK_RANGE, spec, result) && strcmp(result.ack.status, ACK_STATUS_OK) != 0) {
+        printf("\n  %s refused: %s\n", CMD_DOWNLINK_RANGE, result.ack.detail);
+      }
+      state.passDone = false;
+      state.lastActivity = groundMillis();
+    }
+
+    if (now - lastSave >= 2000) {
+      fflush(state.out);
+      savePartFile(partPath.c_str(), state);
+      lastSave = now;
+    }
+
+    if (now - lastReport >= 1000) {
+      double seconds = (now - startTime) / 1000.0;
+      printf("\r%lu/%lu blocks, %.0f B/s", (unsigned long)state.receivedCount, (unsigned long)state.blocks,
+             seconds > 0 ? state.payloadBytes / seconds : 0.0);
+      fflush(stdout);
+      lastReport = now;
+    }
+  }
+
+  fflush(state.out);
+  fclose(state.out);
+
+  if (state.receivedCount < state.blocks) {
+    savePartFile(partPath.c_str(), state);
+    if (state.failed) {
+      fprintf(stderr, "\ndownload: board could not read %s", remoteFile);
+    }
+    fprintf(stderr, "\ndownload: interrupted at %lu/%lu blocks, rerun to resume\n",
+            (unsigned long)state.receivedCount, (unsigned long)state.blocks);
+    return 2;
+  }
+
+  link.execute(CMD_DOWNLINK_STOP, "", result);
+  remove(partPath.c_str());
+
+  double seconds = (groundMillis() - startTime) / 1000.0;
+  if (seconds <= 0) {
+    seconds = 0.001;
+  }
+  double payloadBps = state.payloadBytes * 8 / seconds;
+  printf("\nSaved %s (%lu bytes) in %.1f s\n", output.c_str(), (unsigned long)size, seconds);
+  printf("Payload throughput: %.0f bit/s = %.1f%% of %lu bit/s link capacity\n",
+         payloadBps, 100.0 * payloadBps / capacityBps, capacityBps);
+  printf("Line efficiency: %.1f%% (base64 + framing), duplicate blocks: %lu\n",
+         state.lineBytes ? 100.0 * state.payloadBytes / state.lineBytes : 0.0, (unsigned long)state.duplicates);
+  return 0;
+}
@@ -0,0 +1,162 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "flight_replay.h"
+#include "ground_commands.h"
+#include "serial_port.h"
+
+// Host benchmark for the altitude/velocity Kalman filter: step cost and
+// accuracy on a simulated flight with known truth, or a replay of a logged
+// flight (SD card CSV) through the same filter the firmware runs.
+
+// Runs the filter over samples, storing the estimate for each step
+static void runFilter(const std::vector<FlightSample>& samples, std::vector<float>& altitude, std::vector<float>& velocity,
+                      AltitudeEstimator& estimator) {
+  altitude.resize(samples.size());
+  velocity.resize(samples.size());
+  AttitudeEstimator attitude;
+  double lastT = samples.empty() ? 0 : samples[0].t;
+  for (size_t i = 0; i < samples.size(); i++) {
+    stepEstimator(estimator, attitude, samples[i], samples[i].t - lastT);
+    lastT = samples[i].t;
+    altitude[i] = estimator.getAltitude();
+    velocity[i] = estimator.getVelocity();
+  }
+}
+
+static double measureStepNs(const std::vector<FlightSample>& samples) {
+  std::vector<float> altitude, velocity;
+  const int runs = 200;
+  uint64_t start = groundMicros();
+  for (int r = 0; r < runs; r++) {
+    AltitudeEstimator estimator;
+    runFilter(samples, altitude, velocity, estimator);
+  }
+  return (groundMicros() - start) * 1000.0 / ((double)runs * samples.size());
+}
+
+static int benchSimulated(int flights) {
+  double sumAlt = 0, sumVel = 0, sumBaroAlt = 0, sumDiffVel = 0;
+  double apogeeErrKf = 0, apogeeErrBaro = 0;
+  size_t count = 0;
+  uint32_t rejected = 0;
+  double stepNs = 0;
+
+  for (int f = 0; f < flights; f++) {
+    std::vector<FlightSample> samples = simulateFlight(1000 + f).samples;
+    std::vector<float> altitude, velocity;
+    AltitudeEstimator estimator;
+    runFilter(samples, altitude, velocity, estimator);
+    rejected += estimator.getRejectedCount();
+    if (f == 0) {
+      stepNs = measureStepNs(samples);
+    }
+
+    // Baseline: raw baro altitude and its finite-difference velocity
+    double trueApogee = -1, kfApogee = -1, baroApogee = -1;
+    float lastBaro = samples[0].baroAltitude;
+    double lastBaroT = samples[0].t;
+    float diffVel = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+      const FlightSample& s = samples[i];
+      if (s.hasBaro && i > 0) {
+        diffVel = (float)((s.baroAltitude - lastBaro) / (s.t - lastBaroT));
+        lastBaro = s.baroAltitude;
+        lastBaroT = s.t;
+      }
+      double dAlt = altitude[i] - s.trueAltitude;
+      double dVel = velocity[i] - s.trueVelocity;
+      double dBaro = lastBaro - s.trueAltitude;
+      double dDiff = diffVel - s.trueVelocity;
+      sumAlt += dAlt * dAlt;
+      sumVel += dVel * dVel;
+      sumBaroAlt += dBaro * dBaro;
+      sumDiffVel += dDiff * dDiff;
+      count++;
+
+      // Apogee = first velocity sign change after burnout
+      if (s.t > 5.0) {
+        if (trueApogee < 0 && s.trueVelocity <= 0) trueApogee = s.t;
+        if (kfApogee < 0 && velocity[i] <= 0) kfApogee = s.t;
+        if (baroApogee < 0 && diffVel <= 0) baroApogee = s.t;
+      }
+    }
+    apogeeErrKf += fabs(kfApogee - trueApogee);
+    apogeeErrBaro += fabs(baroApogee - trueApogee);
+  }
+
+  printf("Altitude KF on %d simulated flights (%.0f Hz IMU, %.0f Hz baro, 0.05 g noise, 0.02 g bias, 1 m baro noise)\n",
+         flights, 1.0 / FLIGHT_SIM_IMU_DT, 1.0 / (FLIGHT_SIM_IMU_DT * FLIGHT_SIM_BARO_EVERY));
+  printf("  step cost: %.1f ns (AHRS + predict + correct, host)\n", stepNs);
+  printf("  altitude RMS error: KF %.2f m, raw baro %.2f m\n", sqrt(sumAlt / count), sqrt(sumBaroAlt / count));
+  printf("  velocity RMS error: KF %.2f m/s, baro differencing %.2f m/s\n", sqrt(sumVel / count), sqrt(sumDiffVel / count));
+  printf("  apogee time error: KF %.0f ms, baro differencing %.0f ms\n",
+         1000.0 * apogeeErrKf / flights, 1000.0 * apogeeErrBaro / flights);
+  printf("  baro readings gated out: %lu (max-Q spike is %d readings per flight)\n",
+         (unsigned long)rejected, (int)(0.2 / (FLIGHT_SIM_IMU_DT * FLIGHT_SIM_BARO_EVERY)));
+  return 0;
+}
+
+// Replays an SD card flight log. Logs have no ground truth, so this reports
+// the filter's view of the flight and how far it sits from the raw baro.
+static int benchLog(const char* path) {
+  std::vector<FlightSample> samples;
+  if (!loadFlightLog(path, samples)) {
+    return 1;
+  }
+
+  std::vector<float> altitude, velocity;
+  AltitudeEstimator estimator;
+  runFilter(samples, altitude, velocity, estimator);
+
+  double residualSum = 0;
+  size_t residualCount = 0;
+  size_t maxAltIdx = 0, maxVelIdx = 0, minVelIdx = 0;
+  float maxBaro = -1e9f;
+  for (size_t i = 0; i < samples.size(); i++) {
+    if (samples[i].hasBaro) {
+      double r = samples[i].baroAltitude - altitude[i];
+      residualSum += r * r;
+      residualCount++;
+      if (samples[i].baroAltitude > maxBaro) maxBaro = samples[i].baroAltitude;
+    }
+    if (altitude[i] > altitude[maxAltIdx]) maxAltIdx = i;
+    if (velocity[i] > velocity[maxVelIdx]) maxVelIdx = i;
+    if (velocity[i] < velocity[minVelIdx]) minVelIdx = i;
+  }
+
+  printf("Altitude KF replay of %s: %lu rows, %lu baro readings, %.1f s\n", path,
+         (unsigned long)samples.size(), (unsigned long)residualCount, samples.back().t - samples[0].t);
+  printf("  step cost: %.1f ns (AHRS + predict + correct, host)\n", measureStepNs(samples));
+  printf("  apogee: KF %.1f m at t=%.2f s, raw baro max %.1f m\n",
+         altitude[maxAltIdx], samples[maxAltIdx].t, maxBaro);
+  printf("  velocity: max %.1f m/s at t=%.2f s, min %.1f m/s at t=%.2f s\n",
+         velocity[maxVelIdx], samples[maxVelIdx].t, velocity[minVelIdx], samples[minVelIdx].t);
+  printf("  baro residual RMS %.2f m, readings gated out %lu\n",
+         residualCount ? sqrt(residualSum / residualCount) : 0.0, (unsigned long)estimator.getRejectedCount());
+  return 0;
+}
+
+int runKfBench(int argc, char** argv) {
+  const char* logPath = NULL;
+  int flights = 20;
+
+  for (int i = 0; i < argc; i++) {
+    if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      logPath = argv[++i];
+    } else {
+      flights = atoi(argv[i]);
+    }
+  }
+
+  if (logPath) {
+    return benchLog(logPath);
+  }
+  if (flights <= 0) {
+    fprintf(stderr, "kf-bench: usage: kf-bench [flights] | kf-bench -f <flight.csv>\n");
+    return 1;
+  }
+  return benchSimulated(flights);
+}
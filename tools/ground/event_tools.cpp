@@ -0,0 +1,149 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "flight_events.h"
+#include "flight_replay.h"
+#include "ground_commands.h"
+
+// Host replay of the flight-event detector: the same estimator and
+// detector the sensor task runs, fed simulated flights with known event
+// times or an SD card flight log.
+
+struct DetectedEvent {
+  FlightEvent event;
+  double t;   // Sample time of detection (s)
+};
+
+// Runs the estimator and detector over samples like updateSensors does
+static std::vector<DetectedEvent> detectEvents(const std::vector<FlightSample>& samples) {
+  std::vector<DetectedEvent> events;
+  AltitudeEstimator estimator;
+  AttitudeEstimator attitude;
+  FlightEventDetector detector;
+  double lastT = samples.empty() ? 0 : samples[0].t;
+  double lastBaroT = lastT;
+  for (size_t i = 0; i < samples.size(); i++) {
+    const FlightSample& s = samples[i];
+    float verticalAccel = stepEstimator(estimator, attitude, s, s.t - lastT);
+    lastT = s.t;
+    if (s.hasBaro) {
+      lastBaroT = s.t;
+    }
+
+    FlightEventInput input;
+    input.timeMs = (uint32_t)(s.t * 1000.0 + 0.5);
+    input.imuValid = s.hasImu;
+    input.accelMagnitude = s.hasImu ? sqrtf(s.accel[0] * s.accel[0] + s.accel[1] * s.accel[1] + s.accel[2] * s.accel[2]) : 0.0f;
+    input.verticalAccel = verticalAccel;
+    input.estimatorValid = (s.t - lastBaroT) * 1000.0 <= ALT_KF_BARO_TIMEOUT;
+    input.altitude = estimator.getAltitude();
+    input.velocity = estimator.getVelocity();
+
+    DetectedEvent detected;
+    if (detector.update(input, detected.event)) {
+      detected.t = s.t;
+      events.push_back(detected);
+    }
+  }
+  return events;
+}
+
+static int replaySimulated(int flights) {
+  static const FlightEventType types[] = {EVENT_LAUNCH, EVENT_BURNOUT, EVENT_APOGEE, EVENT_LANDING};
+  const int typeCount = sizeof(types) / sizeof(types[0]);
+  double sumError[typeCount] = {0};
+  double maxError[typeCount] = {0};
+  double sumDebounce[typeCount] = {0};
+  double maxDebounce[typeCount] = {0};
+  int found[typeCount] = {0};
+  int misses = 0, early = 0;
+
+  for (int f = 0; f < flights; f++) {
+    SimulatedFlight flight = simulateFlight(2000 + f);
+    double truth[typeCount] = {flight.launchT, flight.burnoutT, flight.apogeeT, flight.landingT};
+    std::vector<DetectedEvent> events = detectEvents(flight.samples);
+
+    for (int k = 0; k < typeCount; k++) {
+      const DetectedEvent* match = NULL;
+      for (size_t e = 0; e < events.size(); e++) {
+        if (events[e].event.type == types[k]) {
+          match = &events[e];
+          break;
+        }
+      }
+      if (!match) {
+        misses++;
+        continue;
+      }
+      // Firing before the true event is a false positive (pad knock
+      // taken as launch, max-Q spike taken as apogee, ...)
+      if (match->t < truth[k]) {
+        early++;
+      }
+      double error = match->t - truth[k];
+      double debounce = (match->event.detectMs - match->event.onsetMs) / 1000.0;
+      sumError[k] += error;
+      if (fabs(error) > fabs(maxError[k])) maxError[k] = error;
+      sumDebounce[k] += debounce;
+      if (debounce > maxDebounce[k]) maxDebounce[k] = debounce;
+      found[k]++;
+    }
+  }
+
+  printf("Flight-event detector on %d simulated flights (%.0f Hz IMU, 3 g pad knock, max-Q baro spike)\n",
+         flights, 1.0 / FLIGHT_SIM_IMU_DT);
+  printf("  %-8s %6s %14s %14s %14s %14s\n", "event", "found", "mean err ms", "worst err ms", "debounce ms", "max debounce");
+  for (int k = 0; k < typeCount; k++) {
+    double n = found[k] ? found[k] : 1;
+    printf("  %-8s %3d/%-2d %14.0f %14.0f %14.0f %14.0f\n", FlightEventDetector::eventName(types[k]), found[k], flights,
+           1000.0 * sumError[k] / n, 1000.0 * maxError[k], 1000.0 * sumDebounce[k] / n, 1000.0 * maxDebounce[k]);
+  }
+  printf("  missed %d, fired before the true event %d\n", misses, early);
+  printf("  landing includes the %d ms FLIGHT_LANDED_HOLD\n", FLIGHT_LANDED_HOLD);
+  return misses || early ? 1 : 0;
+}
+
+static int replayLog(const char* path) {
+  std::vector<FlightSample> samples;
+  if (!loadFlightLog(path, samples)) {
+    return 1;
+  }
+  std::vector<DetectedEvent> events = detectEvents(samples);
+
+  printf("Flight-event replay of %s: %lu rows, %.1f s\n", path,
+         (unsigned long)samples.size(), samples.back().t - samples[0].t);
+  for (size_t e = 0; e < events.size(); e++) {
+    const FlightEvent& ev = events[e].event;
+    printf("  %-8s onset %8.2f s  detect %8.2f s  (+%lu ms)  alt %8.1f m  vel %7.1f m/s\n",
+           FlightEventDetector::eventName(ev.type), ev.onsetMs / 1000.0, ev.detectMs / 1000.0,
+           (unsigned long)(ev.detectMs - ev.onsetMs), ev.altitude, ev.velocity);
+  }
+  if (events.empty()) {
+    printf("  no events (launch not detected)\n");
+  }
+  return 0;
+}
+
+int runEvents(int argc, char** argv) {
+  const char* logPath = NULL;
+  int flights = 20;
+
+  for (int i = 0; i < argc; i++) {
+    if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      logPath = argv[++i];
+    } else {
+      flights = atoi(argv[i]);
+    }
+  }
+
+  if (logPath) {
+    return replayLog(logPath);
+  }
+  if (flights <= 0) {
+    fprintf(stderr, "events: usage: events [flights] | events -f <flight.csv>\n");
+    return 1;
+  }
+  return replaySimulated(flights);
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fec_codec.h"
+#include "ground_commands.h"
+#include "line_receiver.h"
+#include "serial_port.h"
+
+static void printLine(const char* line, bool fromFec, int corrected, void* context) {
+  (void)fromFec;
+  (void)context;
+  printf("%s\n", line);
+  if (corrected > 0) {
+    fprintf(stderr, "[fec] corrected %d bytes\n", corrected);
+  }
+}
+
+int runDecode(int argc, char** argv) {
+  if (argc < 1) {
+    fprintf(stderr, "decode: missing device or file\n");
+    return 1;
+  }
+
+  unsigned long baud = argc > 1 ? strtoul(argv[1], NULL, 10) : 57600;
+  SerialPort port;
+  if (!port.open(argv[0], baud)) {
+    fprintf(stderr, "decode: cannot open %s\n", argv[0]);
+    return 1;
+  }
+
+  LineReceiver receiver(printLine, NULL);
+
+  uint8_t buffer[256];
+  long n;
+  while ((n = port.read(buffer, sizeof(buffer), 1000)) >= 0) {
+    receiver.push(buffer, (size_t)n);
+    fflush(stdout);
+  }
+
+  const FecDeframer::Stats& stats = receiver.getFecStats();
+  fprintf(stderr, "frames decoded: %u, failed: %u, bytes corrected: %u, header errors: %u\n",
+          stats.framesDecoded, stats.framesFailed, stats.bytesCorrected, stats.headerErrors);
+  return 0;
+}
+
+// Representative telemetry line in the firmware's TELEM format
+static size_t makeSampleLine(char* line, size_t capacity, unsigned long t) {
+  return (size_t)snprintf(line, capacity,
+    "TELEM,%lu,1,%.6f,%.6f,%.2f,%.2f,%.2f,1,1,"
+    "%.3f,%.3f,%.3f,%.2f,%.2f,%.2f,%.1f,%.1f,%.1f,%.1f,1,"
+    "%.3f,%.2f,%.2f,1,-62\n",
+    t, 47.123456 + (rand() % 1000) * 1e-6, -122.654321 + (rand() % 1000) * 1e-6,
+    812.4 + (rand() % 100) * 0.1, 805.1 + (rand() % 100) * 0.1, 918.32,
+    (rand() % 2000) / 1000.0 - 1, (rand() % 2000) / 1000.0 - 1, (rand() % 8000) / 1000.0,
+    (rand() % 500) / 10.0, (rand() % 500) / 10.0, (rand() % 500) / 10.0,
+    21.3, -4.2, 40.8, 27.5, 11.874, 412.55, 4898.6);
+}
+
+static void injectBitErrors(uint8_t* data, size_t len, double ber) {
+  if (ber <= 0) {
+    return;
+  }
+  for (size_t i = 0; i < len; i++) {
+    for (int bit = 0; bit < 8; bit++) {
+      if ((double)rand() / RAND_MAX < ber) {
+        data[i] ^= (uint8_t)(1 << bit);
+      }
+    }
+  }
+}
+
+struct BenchContext {
+  const uint8_t* expected;
+  size_t expectedLen;
+  unsigned long recovered;
+};
+
+static void checkFrame(const uint8_t* payload, size_t len, int corrected, void* context) {
+  (void)corrected;
+  BenchContext* ctx = static_cast<BenchContext*>(context);
+  if (len == ctx->expectedLen && memcmp(payload, ctx->expected, len) == 0) {
+    ctx->recovered++;
+  }
+}
+
+int runFecBench(int argc, char** argv) {
+  unsigned long frames = argc > 0 ? strtoul(argv[0], NULL, 10) : 20000;
+  if (frames == 0) {
+    frames = 20000;
+  }
+  srand(1234);
+
+  // Encode cost per frame
+  char line[FEC_MAX_PAYLOAD];
+  uint8_t frame[FEC_MAX_FRAME_SIZE];
+  size_t lineLen = makeSampleLine(line, sizeof(line), 123456);
+  size_t frameLen = 0;
+
+  uint64_t start = groundMicros();
+  for (unsigned long i = 0; i < frames; i++) {
+    line[6] = (char)('0' + i % 10);
+    frameLen = FecCodec::encodeFrame((const uint8_t*)line, lineLen, frame, sizeof(frame));
+  }
+  uint64_t elapsed = groundMicros() - start;
+
+  printf("payload %zu bytes, frame %zu bytes (%.1f%% overhead), %zu codewords\n",
+         lineLen, frameLen, 100.0 * (frameLen - lineLen) / lineLen, FecCodec::codewordCount(lineLen));
+  printf("encode: %.3f us/frame on host (%lu frames)\n\n", (double)elapsed / frames, frames);
+
+  // Recovered-frame rate against raw lines at increasing bit error rates
+  const double bers[] = {0.0, 1e-4, 5e-4, 1e-3, 2e-3, 5e-3, 1e-2};
+  printf("%10s %12s %12s %14s\n", "BER", "raw ok %", "fec ok %", "fec decode us");
+
+  for (size_t b = 0; b < sizeof(bers) / sizeof(bers[0]); b++) {
+    unsigned long rawOk = 0;
+    BenchContext ctx;
+    ctx.recovered = 0;
+    FecDeframer deframer(checkFrame, NULL, &ctx);
+    uint64_t decodeTime = 0;
+
+    for (unsigned long i = 0; i < frames; i++) {
+      lineLen = makeSampleLine(line, sizeof(line), i);
+      frameLen = FecCodec::encodeFrame((const uint8_t*)line, lineLen, frame, sizeof(frame));
+
+      uint8_t raw[FEC_MAX_PAYLOAD];
+      memcpy(raw, line, lineLen);
+      injectBitErrors(raw, lineLen, bers[b]);
+      if (memcmp(raw, line, lineLen) == 0) {
+        rawOk++;
+      }
+
+      injectBitErrors(frame, frameLen, bers[b]);
+      ctx.expected = (const uint8_t*)line;
+      ctx.expectedLen = lineLen;
+      uint64_t t0 = groundMicros();
+      for (size_t k = 0; k < frameLen; k++) {
+        deframer.push(frame[k]);
+      }
+      decodeTime += groundMicros() - t0;
+    }
+
+    printf("%10.0e %12.2f %12.2f %14.3f\n", bers[b],
+           100.0 * rawOk / frames, 100.0 * ctx.recovered / frames, (double)decodeTime / frames);
+  }
+
+  return 0;
+}
@@ -0,0 +1,259 @@
+#include "flight_replay.h"
+#include "tagged_log.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <string>
+
+SimulatedFlight simulateFlight(unsigned seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> accelNoise(0.0f, 0.05f);  // g
+  std::normal_distribution<float> baroNoise(0.0f, 1.0f);    // m
+  const float accelBias = 0.02f;                            // g
+
+  SimulatedFlight flight;
+  flight.launchT = 2.0;
+  flight.burnoutT = 4.5;
+  flight.apogeeT = -1;
+  flight.landingT = -1;
+
+  double h = 0, v = 0;
+  for (int step = 0; ; step++) {
+    double t = step * FLIGHT_SIM_IMU_DT;
+
+    double a;
+    if (t < flight.launchT) {
+      a = 0;
+    } else if (t < flight.burnoutT) {
+      a = 80.0 - 0.0008 * v * fabs(v);
+    } else if (flight.apogeeT < 0) {
+      a = -STANDARD_GRAVITY - 0.0008 * v * fabs(v);
+    } else if (flight.landingT < 0) {
+      // Drogue: relax toward a 25 m/s descent
+      a = (-25.0 - v) * 2.0;
+    } else {
+      // Touchdown: stop at up to 10 g, then rest
+      a = fmin(-v / FLIGHT_SIM_IMU_DT, 10.0 * STANDARD_GRAVITY);
+    }
+
+    if (t > flight.launchT) {
+      v += a * FLIGHT_SIM_IMU_DT;
+      if (flight.landingT < 0) {
+        h += v * FLIGHT_SIM_IMU_DT - 0.5 * a * FLIGHT_SIM_IMU_DT * FLIGHT_SIM_IMU_DT;
+      }
+      if (flight.apogeeT < 0 && t > flight.burnoutT && v <= 0) {
+        flight.apogeeT = t;
+      }
+      if (flight.apogeeT >= 0 && flight.landingT < 0 && h <= 0) {
+        flight.landingT = t;
+        h = 0;
+      }
+    }
+    if (flight.landingT >= 0 && t > flight.landingT + 6.0) {
+      break;
+    }
+
+    // The accelerometer measures specific force: (a + g) / g along the
+    // thrust axis, which stays vertical in this simulation
+    float specificForce = (float)((a + STANDARD_GRAVITY) / STANDARD_GRAVITY) + accelBias + accelNoise(rng);
+    // A single-sample knock on the pad must not count as a launch
+    if (step == (int)(1.0 / FLIGHT_SIM_IMU_DT)) {
+      specificForce += 3.0f;
+    }
+
+    FlightSample s;
+    s.t = t;
+    s.hasImu = true;
+    s.accel[0] = accelNoise(rng);
+    s.accel[1] = accelNoise(rng);
+    s.accel[2] = specificForce;
+    s.gyro[0] = s.gyro[1] = s.gyro[2] = 0.5f * accelNoise(rng) / 0.05f;
+    s.hasBaro = step % FLIGHT_SIM_BARO_EVERY == 0;
+    s.baroAltitude = (float)h + baroNoise(rng);
+    // Pressure spike around max-Q, which the innovation gate should reject
+    if (t > 4.0 && t < 4.2) {
+      s.baroAltitude += 60.0f;
+    }
+    s.trueAltitude = h;
+    s.trueVelocity = v;
+    flight.samples.push_back(s);
+  }
+  return flight;
+}
+
+static int columnIndex(const std::vector<std::string>& header, const char* name) {
+  for (size_t i = 0; i < header.size(); i++) {
+    if (header[i] == name) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+static std::vector<std::string> splitCsv(const char* line) {
+  std::vector<std::string> fields;
+  std::string field;
+  for (const char* p = line; *p && *p != '\n' && *p != '\r'; p++) {
+    if (*p == ',') {
+      fields.push_back(field);
+      field.clear();
+    } else {
+      field += *p;
+    }
+  }
+  fields.push_back(field);
+  return fields;
+}
+
+// Tagged log (sd_record.h): a sample per record, with a baro reading where
+// the record has the pressure group
+static bool loadTaggedLog(const char* path, std::vector<FlightSample>& samples) {
+  std::vector<std::string> lines;
+  LogReadStats blockStats;
+  if (!readSdLog(path, lines, blockStats)) {
+    return false;
+  }
+  if (blockStats.badBlocks > 0 || blockStats.droppedLines > 0) {
+    fprintf(stderr, "%s: %lu bad blocks, %lu lines dropped\n", path, (unsigned long)blockStats.badBlocks,
+            (unsigned long)blockStats.droppedLines);
+  }
+  TaggedLogWidener widener;
+  int colTime = -1, colAlt = -1, colAx = -1, colGx = -1;
+  samples.clear();
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (!widener.addLine(lines[i].c_str())) {
+      continue;
+    }
+    if (colTime < 0) {
+      colTime = widener.getColumn("timestamp");
+      colAlt = widener.getColumn("alt_press");
+      colAx = widener.getColumn("accel_x");
+      colGx = widener.getColumn("gyro_x");
+      if (colTime < 0 || colAlt < 0 || colAx < 0 || colGx < 0) {
+        fprintf(stderr, "%s is not a flight log (missing columns)\n", path);
+        return false;
+      }
+    }
+    const std::vector<std::string>& row = widener.getRow();
+    FlightSample s;
+    memset(&s, 0, sizeof(s));
+    s.t = atof(row[colTime].c_str()) / 1000.0;
+    s.hasImu = widener.recordHas('I');
+    for (int axis = 0; axis < 3; axis++) {
+      s.accel[axis] = (float)atof(row[colAx + axis].c_str());
+      s.gyro[axis] = (float)atof(row[colGx + axis].c_str());
+    }
+    s.hasBaro = widener.recordHas('P');
+    s.baroAltitude = (float)atof(row[colAlt].c_str());
+    samples.push_back(s);
+  }
+  if (widener.getSkipped() > 0) {
+    fprintf(stderr, "%s: %lu records skipped\n", path, (unsigned long)widener.getSkipped());
+  }
+  return true;
+}
+
+bool loadFlightLog(const char* path, std::vector<FlightSample>& samples) {
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+
+  char line[1024];
+  if (!fgets(line, sizeof(line), f)) {
+    fclose(f);
+    fprintf(stderr, "%s is empty\n", path);
+    return false;
+  }
+  if (line[0] == '#') {
+    fclose(f);
+    bool loaded = loadTaggedLog(path, samples);
+    if (loaded && samples.size() < 2) {
+      fprintf(stderr, "%s has no samples\n", path);
+      return false;
+    }
+    return loaded;
+  }
+  std::vector<std::string> header = splitCsv(line);
+  int colTime = columnIndex(header, "timestamp");
+  int colAlt = columnIndex(header, "alt_press");
+  int colAltValid = columnIndex(header, "press_valid");
+  int colAx = columnIndex(header, "accel_x");
+  int colAy = columnIndex(header, "accel_y");
+  int colAz = columnIndex(header, "accel_z");
+  int colGx = columnIndex(header, "gyro_x");
+  int colGy = columnIndex(header, "gyro_y");
+  int colGz = columnIndex(header, "gyro_z");
+  int colImuValid = columnIndex(header, "imu_valid");
+  if (colTime < 0 || colAlt < 0 || colAx < 0 || colAy < 0 || colAz < 0 || colGx < 0 || colGy < 0 || colGz < 0) {
+    fclose(f);
+    fprintf(stderr, "%s is not a flight log (missing columns)\n", path);
+    return false;
+  }
+
+  // Rows are written whenever any sensor updates and repeat the last baro
+  // value, so a baro reading is a row where the altitude changed
+  samples.clear();
+  float lastAlt = NAN;
+  while (fgets(line, sizeof(line), f)) {
+    std::vector<std::string> row = splitCsv(line);
+    if ((int)row.size() < (int)header.size()) {
+      continue;
+    }
+    FlightSample s;
+    memset(&s, 0, sizeof(s));
+    s.t = atof(row[colTime].c_str()) / 1000.0;
+    s.hasImu = colImuValid < 0 || atoi(row[colImuValid].c_str()) != 0;
+    s.accel[0] = (float)atof(row[colAx].c_str());
+    s.accel[1] = (float)atof(row[colAy].c_str());
+    s.accel[2] = (float)atof(row[colAz].c_str());
+    s.gyro[0] = (float)atof(row[colGx].c_str());
+    s.gyro[1] = (float)atof(row[colGy].c_str());
+    s.gyro[2] = (float)atof(row[colGz].c_str());
+    float alt = (float)atof(row[colAlt].c_str());
+    bool altValid = colAltValid < 0 || atoi(row[colAltValid].c_str()) != 0;
+    s.hasBaro = altValid && alt != lastAlt;
+    s.baroAltitude = alt;
+    if (altValid) {
+      lastAlt = alt;
+    }
+    samples.push_back(s);
+  }
+  fclose(f);
+
+  if (samples.size() < 2) {
+    fprintf(stderr, "%s has no samples\n", path);
+    return false;
+  }
+  return true;
+}
+
+float stepEstimator(AltitudeEstimator& estimator, AttitudeEstimator& attitude, const FlightSample& s, double dt) {
+  float verticalAccel = 0.0f;
+  if (s.hasImu) {
+    if (!attitude.isAligned()) {
+      float magnitude = sqrtf(s.accel[0] * s.accel[0] + s.accel[1] * s.accel[1] + s.accel[2] * s.accel[2]);
+      if (fabsf(magnitude - 1.0f) < AHRS_ACCEL_GATE) {
+        attitude.align(s.accel[0], s.accel[1], s.accel[2]);
+      }
+    } else {
+      attitude.update(s.gyro[0], s.gyro[1], s.gyro[2], s.accel[0], s.accel[1], s.accel[2],
+                      (float)fmin(dt, AHRS_MAX_DT));
+    }
+
+    estimator.observeGravity(s.accel[0], s.accel[1], s.accel[2], s.gyro[0], s.gyro[1], s.gyro[2]);
+    if (attitude.isAligned()) {
+      verticalAccel = attitude.verticalAccel(s.accel[0], s.accel[1], s.accel[2]);
+    } else {
+      verticalAccel = estimator.verticalAccel(s.accel[0], s.accel[1], s.accel[2]);
+    }
+  }
+  estimator.predict(verticalAccel, (float)dt);
+  if (s.hasBaro) {
+    estimator.correct(s.baroAltitude);
+  }
+  return verticalAccel;
+}
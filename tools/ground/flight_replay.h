@@ -0,0 +1,48 @@
+#ifndef GROUND_FLIGHT_REPLAY_H
+#define GROUND_FLIGHT_REPLAY_H
+
+#include <vector>
+#include "altitude_estimator.h"
+#include "attitude_estimator.h"
+
+// Flight profiles for replaying the on-board estimators on the host:
+// simulated flights with known truth, or SD card flight logs.
+
+#define FLIGHT_SIM_IMU_DT 0.025    // Sensor task period (40 Hz)
+#define FLIGHT_SIM_BARO_EVERY 2    // Baro reading every N IMU steps (20 Hz)
+
+struct FlightSample {
+  double t;
+  bool hasImu;
+  float accel[3];        // Body frame (g)
+  float gyro[3];         // Body frame (deg/s)
+  bool hasBaro;
+  float baroAltitude;
+  double trueAltitude;   // Simulation only
+  double trueVelocity;
+};
+
+struct SimulatedFlight {
+  std::vector<FlightSample> samples;
+  // True event times (s)
+  double launchT;
+  double burnoutT;
+  double apogeeT;
+  double landingT;
+};
+
+// Pad with a handling bump, 2.5 s boost, ballistic coast with drag,
+// drogue descent and a few seconds on the ground after touchdown. Noise,
+// accelerometer bias and a max-Q pressure spike vary with the seed.
+SimulatedFlight simulateFlight(unsigned seed);
+
+// Loads an SD card flight log, tagged (sd_record.h) or a full-row CSV with
+// the firmware's header. Prints the reason and returns false if the file
+// can't be used.
+bool loadFlightLog(const char* path, std::vector<FlightSample>& samples);
+
+// Runs one sample through the attitude and altitude filters the way the
+// sensor task does. Returns the vertical acceleration fed to the filter.
+float stepEstimator(AltitudeEstimator& estimator, AttitudeEstimator& attitude, const FlightSample& sample, double dt);
+
+#endif
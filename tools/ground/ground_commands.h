@@ -0,0 +1,29 @@
+#ifndef GROUND_COMMANDS_H
+#define GROUND_COMMANDS_H
+
+// Each ground tool subcommand takes the arguments following its name
+// and returns the process exit code.
+
+int runDecode(int argc, char** argv);
+int runFecBench(int argc, char** argv);
+int runCommand(int argc, char** argv);
+int runDownload(int argc, char** argv);
+int runStats(int argc, char** argv);
+int runReceive(int argc, char** argv);
+int runKfBench(int argc, char** argv);
+int runEvents(int argc, char** argv);
+int runAhrsBench(int argc, char** argv);
+int runCalBench(int argc, char** argv);
+int runRangeBench(int argc, char** argv);
+int runDecimBench(int argc, char** argv);
+int runVibBench(int argc, char** argv);
+int runNavBench(int argc, char** argv);
+int runCoordBench(int argc, char** argv);
+int runTimeBench(int argc, char** argv);
+int runSdlogBench(int argc, char** argv);
+int runWiden(int argc, char** argv);
+int runLogCrash(int argc, char** argv);
+int runBlackBoxBench(int argc, char** argv);
+int runSdWriteBench(int argc, char** argv);
+
+#endif
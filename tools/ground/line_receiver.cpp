@@ -0,0 +1,54 @@
+#include "line_receiver.h"
+#include <string.h>
+
+LineReceiver::LineReceiver(LineCallback onLine, void* context) :
+  deframer(handleFrame, handleRaw, this),
+  rawLength(0),
+  onLine(onLine),
+  context(context) {
+}
+
+void LineReceiver::push(const uint8_t* data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    deframer.push(data[i]);
+  }
+}
+
+void LineReceiver::handleFrame(const uint8_t* payload, size_t len, int corrected, void* context) {
+  LineReceiver* self = static_cast<LineReceiver*>(context);
+
+  // A frame carries exactly one line; strip its terminator
+  char line[FEC_MAX_PAYLOAD + 1];
+  while (len > 0 && (payload[len - 1] == '\n' || payload[len - 1] == '\r')) {
+    len--;
+  }
+  memcpy(line, payload, len);
+  line[len] = '\0';
+
+  if (self->onLine) {
+    self->onLine(line, true, corrected, self->context);
+  }
+}
+
+void LineReceiver::handleRaw(uint8_t byte, void* context) {
+  LineReceiver* self = static_cast<LineReceiver*>(context);
+
+  if (byte == '\n' || byte == '\r') {
+    self->emitRawLine();
+  } else if (self->rawLength < FEC_MAX_PAYLOAD) {
+    self->rawLine[self->rawLength++] = (char)byte;
+  } else {
+    self->emitRawLine();
+  }
+}
+
+void LineReceiver::emitRawLine() {
+  if (rawLength == 0) {
+    return;
+  }
+  rawLine[rawLength] = '\0';
+  rawLength = 0;
+  if (onLine) {
+    onLine(rawLine, false, 0, context);
+  }
+}
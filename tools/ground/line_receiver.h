@@ -0,0 +1,31 @@
+#ifndef GROUND_LINE_RECEIVER_H
+#define GROUND_LINE_RECEIVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fec_codec.h"
+
+// Splits the downlink byte stream into text lines. FEC frames are decoded
+// and corrected; plain ASCII lines pass straight through.
+class LineReceiver {
+public:
+  typedef void (*LineCallback)(const char* line, bool fromFec, int corrected, void* context);
+
+  LineReceiver(LineCallback onLine, void* context);
+
+  void push(const uint8_t* data, size_t len);
+  const FecDeframer::Stats& getFecStats() const { return deframer.getStats(); }
+
+private:
+  static void handleFrame(const uint8_t* payload, size_t len, int corrected, void* context);
+  static void handleRaw(uint8_t byte, void* context);
+  void emitRawLine();
+
+  FecDeframer deframer;
+  char rawLine[FEC_MAX_PAYLOAD + 1];
+  size_t rawLength;
+  LineCallback onLine;
+  void* context;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "link_stats.h"
+#include <math.h>
+#include <string.h>
+
+LinkStats::LinkStats() :
+  haveFrame(false),
+  lastSeq(0),
+  framesReceived(0),
+  framesLost(0),
+  framesReordered(0),
+  ageCount(0),
+  ageSumMs(0),
+  ageMaxMs(0),
+  lastArrivalUs(0),
+  lastEnqueueMs(0),
+  jitterUs(0),
+  pingCount(0),
+  haveOffset(false),
+  offsetMs(0),
+  latencyCount(0),
+  latencySumMs(0),
+  latencyMinMs(0),
+  latencyMaxMs(0) {
+  memset(bursts, 0, sizeof(bursts));
+}
+
+void LinkStats::addFrame(const TelemetryData& data, const TelemetryFrameInfo& info, uint64_t arrivalUs) {
+  if (haveFrame) {
+    int32_t delta = (int32_t)(info.seq - lastSeq);
+    if (delta <= 0) {
+      // Late or duplicated frame: count it, but don't let it skew the gaps
+      framesReordered++;
+      framesReceived++;
+      return;
+    }
+    if (delta > 1) {
+      uint32_t burst = (uint32_t)delta - 1;
+      framesLost += burst;
+      bursts[burst < LINK_STATS_MAX_BURST ? burst : LINK_STATS_MAX_BURST]++;
+    }
+
+    double transit = (double)(arrivalUs - lastArrivalUs) -
+                     (double)(uint32_t)(info.enqueueMs - lastEnqueueMs) * 1000.0;
+    jitterUs += (fabs(transit) - jitterUs) / 16.0;
+  }
+
+  haveFrame = true;
+  lastSeq = info.seq;
+  lastArrivalUs = arrivalUs;
+  lastEnqueueMs = info.enqueueMs;
+  framesReceived++;
+
+  double ageMs = (double)(int32_t)(info.enqueueMs - data.timestamp);
+  ageCount++;
+  ageSumMs += ageMs;
+  if (ageMs > ageMaxMs) {
+    ageMaxMs = ageMs;
+  }
+
+  if (haveOffset) {
+    double latencyMs = arrivalUs / 1000.0 - ((double)info.enqueueMs - offsetMs);
+    if (latencyCount == 0 || latencyMs < latencyMinMs) {
+      latencyMinMs = latencyMs;
+    }
+    if (latencyCount == 0 || latencyMs > latencyMaxMs) {
+      latencyMaxMs = latencyMs;
+    }
+    latencyCount++;
+    latencySumMs += latencyMs;
+  }
+}
+
+void LinkStats::addPing(double rttMs, double boardMs, uint64_t ackedAtUs) {
+  PingSample sample;
+  sample.rttMs = rttMs;
+  sample.offsetMs = boardMs - (ackedAtUs / 1000.0 - rttMs / 2.0);
+  if (pingCount < LINK_STATS_PING_WINDOW) {
+    pings[pingCount++] = sample;
+  } else {
+    memmove(pings, pings + 1, sizeof(PingSample) * (LINK_STATS_PING_WINDOW - 1));
+    pings[LINK_STATS_PING_WINDOW - 1] = sample;
+  }
+
+  // The shortest round trip has the least queueing asymmetry
+  int best = 0;
+  for (int i = 1; i < pingCount; i++) {
+    if (pings[i].rttMs < pings[best].rttMs) {
+      best = i;
+    }
+  }
+  offsetMs = pings[best].offsetMs;
+  haveOffset = true;
+}
+
+void LinkStats::print(FILE* out) const {
+  uint64_t expected = framesReceived - framesReordered + framesLost;
+  double lossPct = expected ? 100.0 * framesLost / expected : 0.0;
+
+  fprintf(out, "  frames %llu, lost %llu (%.2f%%), reordered %llu\n",
+          (unsigned long long)framesReceived, (unsigned long long)framesLost,
+          lossPct, (unsigned long long)framesReordered);
+
+  fprintf(out, "  bursts:");
+  for (int len = 1; len <= LINK_STATS_MAX_BURST; len++) {
+    fprintf(out, " %d%s=%llu", len, len == LINK_STATS_MAX_BURST ? "+" : "", (unsigned long long)bursts[len]);
+  }
+  fprintf(out, "\n");
+
+  fprintf(out, "  age at tx: mean %.1f ms, max %.0f ms; jitter %.2f ms\n",
+          ageCount ? ageSumMs / ageCount : 0.0, ageMaxMs, jitterUs / 1000.0);
+
+  if (latencyCount) {
+    fprintf(out, "  latency (enqueue to ground): mean %.1f ms, min %.1f ms, max %.1f ms; offset %.1f ms\n",
+            latencySumMs / latencyCount, latencyMinMs, latencyMaxMs, offsetMs);
+  } else {
+    fprintf(out, "  latency: no clock offset (enable pings with -p)\n");
+  }
+}
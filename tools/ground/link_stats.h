@@ -0,0 +1,63 @@
+#ifndef GROUND_LINK_STATS_H
+#define GROUND_LINK_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "telemetry_codec.h"
+
+#define LINK_STATS_MAX_BURST 8    // Histogram bucket for bursts of this length or more
+#define LINK_STATS_PING_WINDOW 8  // Offset comes from the lowest-RTT ping in this window
+
+// Link quality from the TELEM frame stamps. Sequence gaps give loss and
+// burst lengths, enqueue_ms - timestamp gives the sample age at
+// transmission, and arrival vs. enqueue spacing gives interarrival jitter.
+// PING round trips estimate the board clock offset, which turns the
+// enqueue stamp into a one-way latency.
+class LinkStats {
+public:
+  LinkStats();
+
+  void addFrame(const TelemetryData& data, const TelemetryFrameInfo& info, uint64_t arrivalMicros);
+  // boardMs is the board clock reported in the PING ack
+  void addPing(double rttMs, double boardMs, uint64_t ackedAtMicros);
+  void print(FILE* out) const;
+
+  uint64_t getFramesReceived() const { return framesReceived; }
+  uint64_t getFramesLost() const { return framesLost; }
+  double getJitterMicros() const { return jitterUs; }
+  // Mean one-way latency, or -1 without a clock offset
+  double getMeanLatencyMs() const { return latencyCount ? latencySumMs / latencyCount : -1.0; }
+
+private:
+  struct PingSample {
+    double rttMs;
+    double offsetMs;  // Board clock minus ground clock
+  };
+
+  bool haveFrame;
+  uint32_t lastSeq;
+  uint64_t framesReceived;
+  uint64_t framesLost;
+  uint64_t framesReordered;
+  uint64_t bursts[LINK_STATS_MAX_BURST + 1];  // Index = burst length
+
+  uint64_t ageCount;
+  double ageSumMs;
+  double ageMaxMs;
+
+  // RFC 3550 interarrival jitter against the board's enqueue clock
+  uint64_t lastArrivalUs;
+  uint32_t lastEnqueueMs;
+  double jitterUs;
+
+  PingSample pings[LINK_STATS_PING_WINDOW];
+  int pingCount;
+  bool haveOffset;
+  double offsetMs;
+  uint64_t latencyCount;
+  double latencySumMs;
+  double latencyMinMs;
+  double latencyMaxMs;
+};
+
+#endif
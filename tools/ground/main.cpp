@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <string.h>
+#include "ground_commands.h"
+
+// Ground station tools for the rocket flight computer.
+// Build from the repository root, see README.md ("Ground Tools").
+
+struct GroundCommand {
+  const char* name;
+  int (*run)(int argc, char** argv);
+  const char* usage;
+};
+
+static const GroundCommand commands[] = {
+  {"decode", runDecode, "decode <device|file> [baud]       Print telemetry lines, correcting FEC frames"},
+  {"fec-bench", runFecBench, "fec-bench [frames]                Encode cost and recovered-frame rate vs. bit error rate"},
+  {"kf-bench", runKfBench, "kf-bench [flights] | -f <log.csv> Altitude filter step cost and accuracy (simulated or logged flight)"},
+  {"events", runEvents, "events [flights] | -f <log.csv>   Flight-event detection timing (simulated or logged flight)"},
+  {"ahrs-bench", runAhrsBench, "ahrs-bench [runs]                 Attitude filter update cost and tilt/yaw accuracy (simulated)"},
+  {"cal-bench", runCalBench, "cal-bench [runs]                  IMU calibration fit accuracy and correction cost (simulated)"},
+  {"range-bench", runRangeBench, "range-bench [flights]             IMU clipping and conversion error, fixed vs. auto-ranging (simulated)"},
+  {"decim-bench", runDecimBench, "decim-bench                       IMU decimation frequency response and bank throughput"},
+  {"vib-bench", runVibBench, "vib-bench [summaries]             Vibration FFT accuracy, tone recovery and cost per block"},
+  {"nav-bench", runNavBench, "nav-bench [flights]               GPS/INS filter position error vs. held fixes and step cost (simulated)"},
+  {"coord-bench", runCoordBench, "coord-bench [records]             Coordinate parse precision, float vs. 1e-7 degree integers, and formatting cost"},
+  {"time-bench", runTimeBench, "time-bench [seconds]              GPS time discipline error with/without PPS and in holdover vs. last-fix offset (simulated)"},
+  {"sdlog-bench", runSdlogBench, "sdlog-bench [repeats]             SD log bytes per phase, full rows vs. tagged records, and widen round trip (simulated)"},
+  {"widen", runWiden, "widen <log.csv> [-o wide.csv]     Rebuild the full-row CSV from a tagged SD log"},
+  {"log-crash", runLogCrash, "log-crash [blocks]                Cut a block-framed SD log at every byte and check the boot recovery scan"},
+  {"blackbox-bench", runBlackBoxBench, "blackbox-bench [flights]          Flash black box cost, stalls and wear with both SD cards down, and drain/reset checks (simulated)"},
+  {"sdwrite-bench", runSdWriteBench, "sdwrite-bench [KB per run]        SD log write throughput and latency per batch size, line writes vs. whole sectors (modeled card)"},
+  {"cmd", runCommand, "cmd <device> <NAME> [args]        Send a command, retransmitting until acked (-b baud -r attempts -t ms)"},
+  {"download", runDownload, "download <device> <file>          Fetch a log file over the radio, resumable (-o out -b baud -c link_bps)"},
+  {"receive", runReceive, "receive <device> | -r <rec.raw>    Live decode with record/replay and throughput stats (-w rec.raw -x speed -c csv -v)"},
+  {"stats", runStats, "stats <device>                    Telemetry loss, burst, age, jitter and latency (-p ping_s -i report_s -d s -m)"},
+};
+
+static void printUsage() {
+  printf("Usage: ground <command> [args]\n\nCommands:\n");
+  for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+    printf("  %s\n", commands[i].usage);
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printUsage();
+    return 1;
+  }
+
+  for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+    if (strcmp(argv[1], commands[i].name) == 0) {
+      return commands[i].run(argc - 2, argv + 2);
+    }
+  }
+
+  printUsage();
+  return 1;
+}
@@ -0,0 +1,235 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <vector>
+#include "ground_commands.h"
+#include "nav_filter.h"
+#include "serial_port.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define NAV_BENCH_HAVE_TSC 1
+#endif
+
+// Host check of the GPS/INS filter: simulated 3D flights (tilted boost,
+// drag, drifting under the parachute, landing impact) with 1 Hz GPS, 20 Hz
+// baro and the AHRS earth-frame acceleration at 100 Hz in a frame of
+// unknown heading.
+// Compares the position the telemetry would carry between fixes (the last
+// fix, as before, vs. the filter) and measures the step costs.
+
+#define NAV_BENCH_DT 0.01          // IMU / sensor task step (100 Hz, boost rate)
+#define NAV_BENCH_GPS_EVERY 100    // 1 Hz fixes
+#define NAV_BENCH_BARO_EVERY 5     // 20 Hz baro
+#define NAV_BENCH_PAD_TIME 10.0    // s before ignition
+#define NAV_BENCH_BURN_TIME 3.0
+#define NAV_BENCH_THRUST 80.0      // m/s^2
+#define NAV_BENCH_DRAG 0.0012      // Coast drag per (m/s)^2
+#define NAV_BENCH_DESCENT 7.0      // Parachute descent rate (m/s)
+#define NAV_BENCH_LANDED_TIME 10.0
+#define NAV_BENCH_REF_LAT 45.5
+#define NAV_BENCH_REF_LON -73.6
+#define NAV_BENCH_GPS_H 2.0        // Simulated receiver noise (m)
+#define NAV_BENCH_GPS_V 4.0
+#define NAV_BENCH_BARO 0.8
+#define NAV_BENCH_ACCEL_NOISE 0.3  // AHRS accel noise at rest (m/s^2), x5 under thrust
+
+struct NavErrors {
+  double holdSq;      // Horizontal, last fix held between fixes
+  double navSq;       // Horizontal, filter
+  double holdMax;
+  double navMax;
+  double velSq;       // Horizontal velocity, filter
+  double upSq;        // Vertical position, filter
+  unsigned long samples;
+  double yawErrSum;   // |heading error| at landing, degrees, aligned flights
+  int aligned;        // Flights whose heading was aligned during boost
+  unsigned long rejects;
+};
+
+static void toLatLon(double east, double north, int32_t& lat, int32_t& lon) {
+  double mPerDeg = NAV_EARTH_RADIUS * M_PI / 180.0;
+  lat = coordFromDegrees(NAV_BENCH_REF_LAT + north / mPerDeg);
+  lon = coordFromDegrees(NAV_BENCH_REF_LON + east / (mPerDeg * cos(NAV_BENCH_REF_LAT * M_PI / 180.0)));
+}
+
+static void toLocal(int32_t lat, int32_t lon, double& east, double& north) {
+  double mPerDeg = NAV_EARTH_RADIUS * M_PI / 180.0;
+  north = (coordToDegrees(lat) - NAV_BENCH_REF_LAT) * mPerDeg;
+  east = (coordToDegrees(lon) - NAV_BENCH_REF_LON) * mPerDeg * cos(NAV_BENCH_REF_LAT * M_PI / 180.0);
+}
+
+static double wrapAngle(double a) {
+  while (a > M_PI) a -= 2.0 * M_PI;
+  while (a < -M_PI) a += 2.0 * M_PI;
+  return a;
+}
+
+static void runFlight(unsigned seed, NavErrors& e) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> unit(0.0, 1.0);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  double tilt = (5.0 + 10.0 * uniform(rng)) * M_PI / 180.0;
+  double azimuth = 2.0 * M_PI * uniform(rng);
+  double yawTrue = 2.0 * M_PI * uniform(rng) - M_PI;   // AHRS x axis from east
+  double windE = 6.0 * unit(rng), windN = 6.0 * unit(rng);
+  double bias[3] = {0.1 * unit(rng), 0.1 * unit(rng), 0.05 * unit(rng)};
+  double dir[3] = {sin(tilt) * sin(azimuth), sin(tilt) * cos(azimuth), cos(tilt)};
+
+  double p[3] = {0, 0, 0}, v[3] = {0, 0, 0};
+  bool burnout = false, chute = false, landed = false;
+  double landedAt = 0;
+  NavigationFilter nav;
+  double holdE = 0, holdN = 0;
+  bool haveFix = false;
+
+  for (long step = 0;; step++) {
+    double t = step * NAV_BENCH_DT;
+    double a[3] = {0, 0, 0};
+    bool thrust = t >= NAV_BENCH_PAD_TIME && t < NAV_BENCH_PAD_TIME + NAV_BENCH_BURN_TIME;
+    if (thrust) {
+      for (int i = 0; i < 3; i++) a[i] = NAV_BENCH_THRUST * dir[i];
+      a[2] -= 9.80665;
+    } else if (t >= NAV_BENCH_PAD_TIME && !landed) {
+      burnout = true;
+      if (!chute && v[2] < 0) chute = true;
+      if (chute) {
+        double target[3] = {windE, windN, -NAV_BENCH_DESCENT};
+        for (int i = 0; i < 3; i++) a[i] = (target[i] - v[i]) / 1.0;
+      } else {
+        double speed = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        for (int i = 0; i < 3; i++) a[i] = -NAV_BENCH_DRAG * speed * v[i];
+        a[2] -= 9.80665;
+      }
+    }
+    for (int i = 0; i < 3; i++) {
+      p[i] += v[i] * NAV_BENCH_DT + 0.5 * a[i] * NAV_BENCH_DT * NAV_BENCH_DT;
+      v[i] += a[i] * NAV_BENCH_DT;
+    }
+    if (burnout && !landed && p[2] <= 0) {
+      // The IMU sees the impact as one large step
+      for (int i = 0; i < 3; i++) a[i] -= v[i] / NAV_BENCH_DT;
+      landed = true;
+      landedAt = t;
+      p[2] = 0;
+      v[0] = v[1] = v[2] = 0;
+    }
+    if (landed && t - landedAt > NAV_BENCH_LANDED_TIME) {
+      break;
+    }
+
+    // AHRS earth-frame accel: unknown heading, tilt-error bias, vibration
+    double noise = NAV_BENCH_ACCEL_NOISE * (thrust ? 5.0 : 1.0);
+    double c = cos(yawTrue), s = sin(yawTrue);
+    float measured[3] = {
+      (float)(c * a[0] + s * a[1] + bias[0] + noise * unit(rng)),
+      (float)(-s * a[0] + c * a[1] + bias[1] + noise * unit(rng)),
+      (float)(a[2] + bias[2] + noise * unit(rng))};
+    nav.predict(measured, (float)NAV_BENCH_DT);
+
+    if (step % NAV_BENCH_BARO_EVERY == 0) {
+      nav.correctBaro((float)(120.0 + p[2] + NAV_BENCH_BARO * unit(rng)));
+    }
+    if (step % NAV_BENCH_GPS_EVERY == 0) {
+      double fixE = p[0] + NAV_BENCH_GPS_H * unit(rng);
+      double fixN = p[1] + NAV_BENCH_GPS_H * unit(rng);
+      int32_t lat, lon;
+      toLatLon(fixE, fixN, lat, lon);
+      nav.correctGps(lat, lon, (float)(35.0 + p[2] + NAV_BENCH_GPS_V * unit(rng)));
+      holdE = fixE;
+      holdN = fixN;
+      haveFix = true;
+    }
+    if (!haveFix) {
+      continue;
+    }
+
+    int32_t lat, lon;
+    double navE, navN;
+    float alt;
+    nav.getPosition(lat, lon, alt);
+    toLocal(lat, lon, navE, navN);
+    double holdErr = hypot(holdE - p[0], holdN - p[1]);
+    double navErr = hypot(navE - p[0], navN - p[1]);
+    double velErr = hypot(nav.getState(NAV_VE) - v[0], nav.getState(NAV_VN) - v[1]);
+    double upErr = (alt - 35.0) - p[2];
+    e.holdSq += holdErr * holdErr;
+    e.navSq += navErr * navErr;
+    e.velSq += velErr * velErr;
+    e.upSq += upErr * upErr;
+    if (holdErr > e.holdMax) e.holdMax = holdErr;
+    if (navErr > e.navMax) e.navMax = navErr;
+    e.samples++;
+  }
+  if (nav.isHeadingAligned()) {
+    e.yawErrSum += fabs(wrapAngle(nav.getState(NAV_YAW) - yawTrue)) * 180.0 / M_PI;
+    e.aligned++;
+  }
+  e.rejects += nav.getRejectedCount();
+}
+
+static void measureCost(double& predictNs, double& predictCycles, double& gpsNs) {
+  NavigationFilter nav;
+  int32_t refLat = coordFromDegrees(NAV_BENCH_REF_LAT);
+  int32_t refLon = coordFromDegrees(NAV_BENCH_REF_LON);
+  nav.reset(refLat, refLon, 35.0f);
+  const int steps = 2000000;
+  float accel[3] = {0.3f, -0.2f, 0.1f};
+  uint64_t start = groundMicros();
+#ifdef NAV_BENCH_HAVE_TSC
+  uint64_t tscStart = __rdtsc();
+#endif
+  for (int i = 0; i < steps; i++) {
+    accel[0] = (float)((i & 7) - 3.5) * 0.1f;
+    nav.predict(accel, (float)NAV_BENCH_DT);
+    if ((i & 1023) == 0) nav.correctGps(refLat, refLon, 35.0f);
+  }
+#ifdef NAV_BENCH_HAVE_TSC
+  predictCycles = (double)(__rdtsc() - tscStart) / steps;
+#else
+  predictCycles = 0;
+#endif
+  predictNs = (groundMicros() - start) * 1000.0 / steps;
+
+  const int fixes = 200000;
+  start = groundMicros();
+  for (int i = 0; i < fixes; i++) {
+    nav.predict(accel, (float)NAV_BENCH_DT);
+    nav.correctGps(refLat + 10 * (i & 3), refLon, 35.0f);
+  }
+  gpsNs = (groundMicros() - start) * 1000.0 / fixes - predictNs;
+}
+
+int runNavBench(int argc, char** argv) {
+  int flights = argc > 0 ? atoi(argv[0]) : 20;
+  if (flights <= 0) {
+    fprintf(stderr, "nav-bench: usage: nav-bench [flights]\n");
+    return 1;
+  }
+
+  NavErrors e = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  for (int f = 0; f < flights; f++) {
+    runFlight(2000 + f, e);
+  }
+  double predictNs, predictCycles, gpsNs;
+  measureCost(predictNs, predictCycles, gpsNs);
+
+  double holdRms = sqrt(e.holdSq / e.samples);
+  double navRms = sqrt(e.navSq / e.samples);
+  printf("GPS/INS filter on %d simulated flights (%.0f Hz IMU, 1 Hz GPS %.0f m, 20 Hz baro, unknown AHRS heading)\n",
+         flights, 1.0 / NAV_BENCH_DT, NAV_BENCH_GPS_H);
+  printf("  horizontal position error at %.0f Hz:\n", 1.0 / NAV_BENCH_DT);
+  printf("    %-26s RMS %6.2f m  max %7.2f m\n", "last fix held (before)", holdRms, e.holdMax);
+  printf("    %-26s RMS %6.2f m  max %7.2f m\n", "filter", navRms, e.navMax);
+  printf("  filter horizontal velocity RMS error %.2f m/s, altitude RMS error %.2f m\n",
+         sqrt(e.velSq / e.samples), sqrt(e.upSq / e.samples));
+  printf("  heading aligned on %d/%d flights, error at landing (mean) %.1f deg, %lu gated measurements\n",
+         e.aligned, flights, e.aligned > 0 ? e.yawErrSum / e.aligned : 0.0, e.rejects);
+  printf("  cost (host): predict %.0f ns", predictNs);
+  if (predictCycles > 0) printf(" / %.0f TSC cycles", predictCycles);
+  printf(", GPS fix update %.0f ns\n", gpsNs);
+  printf("  on the board see perfMetrics.navStepCycles\n");
+
+  return navRms < holdRms ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "flight_replay.h"
+#include "ground_commands.h"
+#include "imu_range.h"
+#include "serial_port.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define RANGE_BENCH_HAVE_TSC 1
+#endif
+
+// Host check of IMU auto-ranging: quantizes simulated flights the way the
+// MPU9250 would in a fixed ±2 g/±250 deg/s setup, a fixed top range, and
+// with the firmware's range selector (including the re-read of a clipped
+// sample), then reports clipping, conversion error and the cost of the
+// per-sample range check.
+
+#define RANGE_BENCH_SPIN_RATE 700.0f  // Roll rate reached at burnout (deg/s)
+
+struct RangeMode {
+  const char* name;
+  uint8_t accelIndex;
+  uint8_t gyroIndex;
+  bool autoRange;
+};
+
+struct RangeResult {
+  unsigned long samples;
+  unsigned long clipped;
+  unsigned long thrustSamples;   // |a| >= FLIGHT_MODE_ACCEL_THRESHOLD as read
+  unsigned long switches;
+  unsigned long rereads;         // Clipped samples read again in the new range
+  double accelErrSum;
+  double accelErrMax;
+  double gyroErrMax;
+  double padResolution;          // mg per count on the pad
+};
+
+static int16_t quantize(float value, float unitsPerCount) {
+  float counts = roundf(value / unitsPerCount);
+  if (counts > 32767.0f) return 32767;
+  if (counts < -32768.0f) return -32768;
+  return (int16_t)counts;
+}
+
+// Roll spin-up during boost, decaying after burnout
+static float rollRate(double t, const SimulatedFlight& flight) {
+  if (t < flight.launchT) return 0.0f;
+  if (t < flight.burnoutT) return (float)(RANGE_BENCH_SPIN_RATE * (t - flight.launchT) / (flight.burnoutT - flight.launchT));
+  return (float)(RANGE_BENCH_SPIN_RATE * exp(-(t - flight.burnoutT) / 3.0));
+}
+
+static void runMode(const SimulatedFlight& flight, const RangeMode& mode, RangeResult& r) {
+  ImuRangeSelector accel(IMU_ACCEL_FULL_SCALES, mode.accelIndex, mode.autoRange);
+  ImuRangeSelector gyro(IMU_GYRO_FULL_SCALES, mode.gyroIndex, mode.autoRange);
+  r.padResolution = 1000.0 * accel.getUnitsPerCount();
+
+  for (size_t i = 0; i < flight.samples.size(); i++) {
+    const FlightSample& s = flight.samples[i];
+    float trueGyro[3] = {s.gyro[0], s.gyro[1], s.gyro[2] + rollRate(s.t, flight)};
+    float a[3], g[3];
+    bool clipped = false;
+    // A second pass only when a clip switched the range (the firmware's re-read)
+    for (int pass = 0; pass < 2; pass++) {
+      int16_t ra[3], rg[3];
+      for (int k = 0; k < 3; k++) {
+        ra[k] = quantize(s.accel[k], accel.getUnitsPerCount());
+        rg[k] = quantize(trueGyro[k], gyro.getUnitsPerCount());
+        a[k] = ra[k] * accel.getUnitsPerCount();
+        g[k] = rg[k] * gyro.getUnitsPerCount();
+      }
+      int32_t accelPeak = ImuRangeSelector::peak(ra[0], ra[1], ra[2]);
+      int32_t gyroPeak = ImuRangeSelector::peak(rg[0], rg[1], rg[2]);
+      clipped = accelPeak >= IMU_RANGE_RAIL || gyroPeak >= IMU_RANGE_RAIL;
+      bool accelChanged = accel.update(accelPeak);
+      bool gyroChanged = gyro.update(gyroPeak);
+      if (!accelChanged && !gyroChanged) {
+        break;
+      }
+      r.switches++;
+      if (!clipped || pass == 1) {
+        break;
+      }
+      r.rereads++;
+    }
+
+    for (int k = 0; k < 3; k++) {
+      double accelErr = fabs(a[k] - s.accel[k]);
+      double gyroErr = fabs(g[k] - trueGyro[k]);
+      r.accelErrSum += accelErr * accelErr;
+      if (accelErr > r.accelErrMax) r.accelErrMax = accelErr;
+      if (gyroErr > r.gyroErrMax) r.gyroErrMax = gyroErr;
+    }
+    if (clipped) {
+      r.clipped++;
+    }
+    if (sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]) >= FLIGHT_MODE_ACCEL_THRESHOLD) {
+      r.thrustSamples++;
+    }
+    r.samples++;
+  }
+}
+
+// Cost of the per-sample check (both peaks and both selector updates)
+static void measureCost(const SimulatedFlight& flight, double& ns, double& cycles) {
+  std::vector<int16_t> raw;
+  float unitsPerCount = IMU_ACCEL_FULL_SCALES[IMU_ACCEL_RANGE] / 32768.0f;
+  for (size_t i = 0; i < flight.samples.size(); i++) {
+    for (int k = 0; k < 3; k++) {
+      raw.push_back(quantize(flight.samples[i].accel[k], unitsPerCount));
+    }
+  }
+  size_t count = flight.samples.size();
+  const int runs = 200;
+  volatile unsigned long sink = 0;
+
+  uint64_t start = groundMicros();
+#ifdef RANGE_BENCH_HAVE_TSC
+  uint64_t tscStart = __rdtsc();
+#endif
+  for (int run = 0; run < runs; run++) {
+    ImuRangeSelector accel(IMU_ACCEL_FULL_SCALES, IMU_ACCEL_RANGE, true);
+    ImuRangeSelector gyro(IMU_GYRO_FULL_SCALES, IMU_GYRO_RANGE, true);
+    for (size_t i = 0; i < count; i++) {
+      const int16_t* v = &raw[i * 3];
+      bool changed = accel.update(ImuRangeSelector::peak(v[0], v[1], v[2]));
+      changed |= gyro.update(ImuRangeSelector::peak(v[1], v[2], v[0]));
+      sink = sink + changed;
+    }
+  }
+#ifdef RANGE_BENCH_HAVE_TSC
+  cycles = (double)(__rdtsc() - tscStart) / ((double)runs * count);
+#else
+  cycles = 0;
+#endif
+  ns = (groundMicros() - start) * 1000.0 / ((double)runs * count);
+  (void)sink;
+}
+
+int runRangeBench(int argc, char** argv) {
+  int flights = argc > 0 ? atoi(argv[0]) : 20;
+  if (flights <= 0) {
+    fprintf(stderr, "range-bench: usage: range-bench [flights]\n");
+    return 1;
+  }
+
+  const RangeMode modes[3] = {
+    {"fixed 2 g / 250 dps", 0, 0, false},
+    {"fixed 16 g / 2000 dps", 3, 3, false},
+    {"auto-range", IMU_ACCEL_RANGE, IMU_GYRO_RANGE, true},
+  };
+  RangeResult results[3];
+  memset(results, 0, sizeof(results));
+
+  SimulatedFlight flight;
+  unsigned long truthThrust = 0;
+  for (int f = 0; f < flights; f++) {
+    flight = simulateFlight(1000 + f);
+    for (size_t i = 0; i < flight.samples.size(); i++) {
+      const float* a = flight.samples[i].accel;
+      if (sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]) >= FLIGHT_MODE_ACCEL_THRESHOLD) {
+        truthThrust++;
+      }
+    }
+    for (int m = 0; m < 3; m++) {
+      runMode(flight, modes[m], results[m]);
+    }
+  }
+
+  double ns, cycles;
+  measureCost(flight, ns, cycles);
+
+  printf("IMU ranges on %d simulated flights (%.0f Hz, ~9 g boost, 3 g pad knock, 11 g touchdown, %.0f deg/s roll)\n",
+         flights, 1.0 / FLIGHT_SIM_IMU_DT, RANGE_BENCH_SPIN_RATE);
+  printf("  %-22s %9s %11s %11s %11s %10s %9s %8s\n", "", "clipped", "accel RMS", "accel max", "gyro max",
+         "pad res", "switches", "re-reads");
+  for (int m = 0; m < 3; m++) {
+    const RangeResult& r = results[m];
+    printf("  %-22s %9lu %9.4f g %9.3f g %7.1f dps %7.2f mg %9lu %8lu\n", modes[m].name, r.clipped,
+           sqrt(r.accelErrSum / (3.0 * r.samples)), r.accelErrMax, r.gyroErrMax, r.padResolution, r.switches,
+           r.rereads);
+  }
+  printf("  samples at or above the %.1f g launch threshold: truth %lu", FLIGHT_MODE_ACCEL_THRESHOLD, truthThrust);
+  for (int m = 0; m < 3; m++) {
+    printf(", %s %lu", modes[m].name, results[m].thrustSamples);
+  }
+  printf("\n  range check cost (host, accel + gyro): %.1f ns", ns);
+  if (cycles > 0) printf(" / %.0f TSC cycles", cycles);
+  printf("\n  on the board see perfMetrics.imuRangeCheckCycles; a switch adds two I2C register writes,\n"
+         "  a re-read adds IMU_RANGE_SETTLE_MS (%d ms) and one 14-byte read\n", IMU_RANGE_SETTLE_MS);
+
+  // Auto-ranging must not pass a clipped sample on below the top range
+  return results[2].clipped > 0 ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+#include "raw_recording.h"
+#include <string.h>
+
+static void putLe(uint8_t* out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static uint64_t getLe(const uint8_t* in, int bytes) {
+  uint64_t value = 0;
+  for (int i = bytes - 1; i >= 0; i--) {
+    value = (value << 8) | in[i];
+  }
+  return value;
+}
+
+RawRecorder::RawRecorder() : file(NULL), bytesWritten(0) {
+}
+
+RawRecorder::~RawRecorder() {
+  close();
+}
+
+bool RawRecorder::open(const char* path) {
+  close();
+  file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+  bytesWritten = 0;
+  return fwrite(RAW_RECORDING_MAGIC, 1, 8, file) == 8;
+}
+
+void RawRecorder::close() {
+  if (file) {
+    fclose(file);
+    file = NULL;
+  }
+}
+
+bool RawRecorder::write(uint64_t tMicros, const uint8_t* data, size_t len) {
+  if (!file || len == 0) {
+    return file != NULL;
+  }
+
+  while (len > 0) {
+    size_t n = len < RAW_RECORDING_MAX_CHUNK ? len : RAW_RECORDING_MAX_CHUNK;
+    uint8_t header[12];
+    putLe(header, tMicros, 8);
+    putLe(header + 8, n, 4);
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header) ||
+        fwrite(data, 1, n, file) != n) {
+      return false;
+    }
+    bytesWritten += n;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+RawPlayer::RawPlayer() : file(NULL) {
+}
+
+RawPlayer::~RawPlayer() {
+  close();
+}
+
+bool RawPlayer::open(const char* path) {
+  close();
+  file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+  char magic[8];
+  if (fread(magic, 1, 8, file) != 8 || memcmp(magic, RAW_RECORDING_MAGIC, 8) != 0) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void RawPlayer::close() {
+  if (file) {
+    fclose(file);
+    file = NULL;
+  }
+}
+
+long RawPlayer::next(uint64_t& tMicros, uint8_t* buffer) {
+  if (!file) {
+    return -1;
+  }
+
+  uint8_t header[12];
+  size_t got = fread(header, 1, sizeof(header), file);
+  if (got == 0) {
+    return 0;
+  }
+  if (got != sizeof(header)) {
+    return -1;
+  }
+
+  tMicros = getLe(header, 8);
+  size_t len = (size_t)getLe(header + 8, 4);
+  if (len == 0 || len > RAW_RECORDING_MAX_CHUNK || fread(buffer, 1, len, file) != len) {
+    return -1;
+  }
+  return (long)len;
+}
@@ -0,0 +1,47 @@
+#ifndef GROUND_RAW_RECORDING_H
+#define GROUND_RAW_RECORDING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Raw downlink recording: every serial read is stored as it arrived, so a
+// replay exercises the decoders with the original chunking and timing.
+//
+//   "RKTRAW01"                                   8-byte file magic
+//   [t_us u64][len u32][bytes...]  repeated      little endian, t_us from start
+
+#define RAW_RECORDING_MAGIC "RKTRAW01"
+#define RAW_RECORDING_MAX_CHUNK 4096
+
+class RawRecorder {
+public:
+  RawRecorder();
+  ~RawRecorder();
+
+  bool open(const char* path);
+  void close();
+  bool write(uint64_t tMicros, const uint8_t* data, size_t len);
+  uint64_t getBytesWritten() const { return bytesWritten; }
+
+private:
+  FILE* file;
+  uint64_t bytesWritten;
+};
+
+class RawPlayer {
+public:
+  RawPlayer();
+  ~RawPlayer();
+
+  bool open(const char* path);
+  void close();
+  // Reads the next chunk into buffer (RAW_RECORDING_MAX_CHUNK bytes).
+  // Returns its length, 0 at end of file, or -1 on a corrupt record.
+  long next(uint64_t& tMicros, uint8_t* buffer);
+
+private:
+  FILE* file;
+};
+
+#endif
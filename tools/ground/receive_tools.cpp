@@ -0,0 +1,264 @@
+#include <atomic>
+#include <chrono>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "ground_commands.h"
+#include "link_stats.h"
+#include "raw_recording.h"
+#include "serial_port.h"
+#include "spsc_ring.h"
+#include "telemetry_decoder.h"
+
+// Ground-station receiver. A reader thread pulls bytes from the serial port
+// (or a raw recording), optionally records them, decodes telemetry and hands
+// samples to the consumer through a lock-free SPSC ring. The consumer keeps
+// the in-memory time series and the link statistics.
+
+#define RECEIVE_RING_CAPACITY 65536
+#define RECEIVE_DEFAULT_SERIES 100000
+
+struct ReceiverShared {
+  SpscRing<TelemetrySample> ring;
+  std::atomic<uint64_t> bytesIn;
+  std::atomic<uint64_t> overruns;  // Samples dropped because the ring was full
+  std::atomic<bool> done;
+
+  ReceiverShared() : ring(RECEIVE_RING_CAPACITY), bytesIn(0), overruns(0), done(false) {}
+};
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handleInterrupt(int signum) {
+  (void)signum;
+  interrupted = 1;
+}
+
+static void pushSample(const TelemetrySample& sample, void* context) {
+  ReceiverShared* shared = static_cast<ReceiverShared*>(context);
+  if (!shared->ring.push(sample)) {
+    shared->overruns.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+static void readSerial(ReceiverShared* shared, SerialPort* port, RawRecorder* recorder, TelemetryDecoder* decoder) {
+  uint8_t buffer[RAW_RECORDING_MAX_CHUNK];
+  uint64_t start = groundMicros();
+
+  while (!interrupted) {
+    long n = port->read(buffer, sizeof(buffer), 100);
+    if (n < 0) {
+      break;
+    }
+    if (n == 0) {
+      continue;
+    }
+    uint64_t t = groundMicros() - start;
+    if (recorder && !recorder->write(t, buffer, (size_t)n)) {
+      fprintf(stderr, "receive: recording write failed, recording stopped\n");
+      recorder = NULL;
+    }
+    shared->bytesIn.fetch_add((uint64_t)n, std::memory_order_relaxed);
+    decoder->push(buffer, (size_t)n, t);
+  }
+  shared->done.store(true, std::memory_order_release);
+}
+
+static void readRecording(ReceiverShared* shared, RawPlayer* player, double speed, TelemetryDecoder* decoder) {
+  uint8_t buffer[RAW_RECORDING_MAX_CHUNK];
+  uint64_t wallStart = groundMicros();
+  uint64_t t = 0;
+
+  while (!interrupted) {
+    long n = player->next(t, buffer);
+    if (n <= 0) {
+      if (n < 0) {
+        fprintf(stderr, "receive: corrupt record in recording, stopping replay\n");
+      }
+      break;
+    }
+
+    // Hold each chunk until its recorded time, compressed by the speed factor
+    if (speed > 0) {
+      uint64_t due = wallStart + (uint64_t)(t / speed);
+      uint64_t now = groundMicros();
+      if (due > now) {
+        std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+      }
+    }
+
+    shared->bytesIn.fetch_add((uint64_t)n, std::memory_order_relaxed);
+    decoder->push(buffer, (size_t)n, t);
+  }
+  shared->done.store(true, std::memory_order_release);
+}
+
+static void writeSeries(const char* path, const std::vector<TelemetrySample>& series, size_t first) {
+  FILE* f = fopen(path, "w");
+  if (!f) {
+    fprintf(stderr, "receive: cannot write %s\n", path);
+    return;
+  }
+
+  fprintf(f, "rx_us," TELEM_FIELD_NAMES "\n");
+  char line[TELEM_LINE_MAX_LENGTH];
+  size_t prefixLen = strlen(TELEM_FRAME_PREFIX);
+  for (size_t i = 0; i < series.size(); i++) {
+    const TelemetrySample& s = series[(first + i) % series.size()];
+    if (TelemetryCodec::formatLine(line, sizeof(line), s.data, s.info) > 0) {
+      fprintf(f, "%llu,%s", (unsigned long long)s.rxMicros, line + prefixLen);
+    }
+  }
+  fclose(f);
+}
+
+int runReceive(int argc, char** argv) {
+  const char* device = NULL;
+  const char* replayPath = NULL;
+  const char* recordPath = NULL;
+  const char* seriesPath = NULL;
+  unsigned long baud = 57600;
+  double speed = 1.0;
+  int reportSeconds = 5;
+  size_t seriesCapacity = RECEIVE_DEFAULT_SERIES;
+  bool verbose = false;
+
+  for (int i = 0; i < argc; i++) {
+    if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      baud = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      replayPath = argv[++i];
+    } else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) {
+      speed = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      seriesPath = argv[++i];
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      seriesCapacity = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+      reportSeconds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else if (!device) {
+      device = argv[i];
+    }
+  }
+
+  if ((!device && !replayPath) || (device && replayPath) || reportSeconds <= 0 || seriesCapacity == 0) {
+    fprintf(stderr, "receive: usage: receive <device> [-b baud] [-w record.raw] | receive -r record.raw [-x speed]\n"
+                    "                [-c series.csv] [-n series_len] [-i report_s] [-v]\n");
+    return 1;
+  }
+
+  SerialPort port;
+  RawRecorder recorder;
+  RawPlayer player;
+  if (device && !port.open(device, baud)) {
+    fprintf(stderr, "receive: cannot open %s\n", device);
+    return 1;
+  }
+  if (recordPath && !recorder.open(recordPath)) {
+    fprintf(stderr, "receive: cannot create %s\n", recordPath);
+    return 1;
+  }
+  if (replayPath && !player.open(replayPath)) {
+    fprintf(stderr, "receive: %s is not a raw recording\n", replayPath);
+    return 1;
+  }
+
+  ReceiverShared shared;
+  AsciiTelemetryDecoder decoder(pushSample, &shared);
+
+  signal(SIGINT, handleInterrupt);
+
+  std::thread reader = replayPath ?
+    std::thread(readRecording, &shared, &player, speed, &decoder) :
+    std::thread(readSerial, &shared, &port, recordPath ? &recorder : NULL, &decoder);
+
+  // Consumer: time series is a fixed-size circular window of the newest samples
+  std::vector<TelemetrySample> series;
+  series.reserve(seriesCapacity < RECEIVE_DEFAULT_SERIES ? seriesCapacity : RECEIVE_DEFAULT_SERIES);
+  size_t seriesNext = 0;
+  LinkStats stats;
+  uint64_t samples = 0;
+  size_t maxDepth = 0;
+
+  uint64_t start = groundMicros();
+  uint64_t lastReport = start;
+  uint64_t lastBytes = 0;
+  uint64_t lastSamples = 0;
+
+  while (true) {
+    size_t depth = shared.ring.size();
+    if (depth > maxDepth) {
+      maxDepth = depth;
+    }
+
+    TelemetrySample sample;
+    bool gotAny = false;
+    while (shared.ring.pop(sample)) {
+      gotAny = true;
+      samples++;
+      stats.addFrame(sample.data, sample.info, sample.rxMicros);
+      if (series.size() < seriesCapacity) {
+        series.push_back(sample);
+      } else {
+        series[seriesNext] = sample;
+        seriesNext = (seriesNext + 1) % seriesCapacity;
+      }
+      if (verbose) {
+        printf("%10.3f  seq %lu  alt %.2f m  mode %d\n", sample.rxMicros / 1e6,
+               (unsigned long)sample.info.seq, sample.data.altitude_pressure, sample.data.mode);
+      }
+    }
+
+    uint64_t now = groundMicros();
+    if (now - lastReport >= (uint64_t)reportSeconds * 1000000ULL) {
+      double seconds = (now - lastReport) / 1e6;
+      uint64_t bytes = shared.bytesIn.load(std::memory_order_relaxed);
+      printf("[%.0f s] in %.0f B/s, %.1f frames/s, ring max %lu/%lu, overruns %llu\n",
+             (now - start) / 1e6, (bytes - lastBytes) / seconds, (samples - lastSamples) / seconds,
+             (unsigned long)maxDepth, (unsigned long)shared.ring.capacity(),
+             (unsigned long long)shared.overruns.load(std::memory_order_relaxed));
+      stats.print(stdout);
+      fflush(stdout);
+      lastReport = now;
+      lastBytes = bytes;
+      lastSamples = samples;
+    }
+
+    if (!gotAny) {
+      if (shared.done.load(std::memory_order_acquire) && shared.ring.size() == 0) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  reader.join();
+
+  double elapsed = (groundMicros() - start) / 1e6;
+  const TelemetryDecoder::Stats& decoded = decoder.getStats();
+  FecDeframer::Stats fec = decoder.getFecStats();
+  printf("\n%s decoder: %llu frames, %llu rejected, %llu other lines; fec ok %lu failed %lu\n",
+         decoder.name(), (unsigned long long)decoded.frames, (unsigned long long)decoded.rejected,
+         (unsigned long long)decoded.otherLines, (unsigned long)fec.framesDecoded,
+         (unsigned long)fec.framesFailed);
+  printf("%llu bytes, %llu samples in %.2f s (%.0f samples/s), ring max %lu, overruns %llu\n",
+         (unsigned long long)shared.bytesIn.load(), (unsigned long long)samples, elapsed,
+         elapsed > 0 ? samples / elapsed : 0.0, (unsigned long)maxDepth,
+         (unsigned long long)shared.overruns.load());
+  stats.print(stdout);
+  if (recordPath) {
+    printf("recorded %llu bytes to %s\n", (unsigned long long)recorder.getBytesWritten(), recordPath);
+  }
+
+  if (seriesPath) {
+    writeSeries(seriesPath, series, series.size() < seriesCapacity ? 0 : seriesNext);
+  }
+  return 0;
+}
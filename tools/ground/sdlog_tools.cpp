@@ -0,0 +1,1198 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "ground_commands.h"
+#include "sd_record.h"
+#include "log_block.h"
+#include "black_box.h"
+#include "sector_writer.h"
+#include "tagged_log.h"
+#include "serial_port.h"
+
+// SD log tools: widening a tagged log (sd_record.h) back to the full-row
+// CSV, and a check of the tagged format on a simulated flight. The bench
+// runs the sensor task's schedule at each phase's rates, logs the same
+// records both ways (tagged, and the full row the log had on every line
+// before), widens the tagged stream again and compares it with the rows.
+// log-crash cuts a block-framed log (log_block.h) at every byte and checks
+// the boot-time recovery the SD manager does on each cut.
+// blackbox-bench runs the flash black box (black_box.h) on a simulated
+// partition through flights with both cards down.
+// sdwrite-bench writes log blocks to a model of FatFs and the card, a
+// write per line against whole sectors through a SectorWriter
+// (sector_writer.h), at several batch sizes.
+
+#define SDLOG_BENCH_EPOCH_MS 1780315200000LL  // UTC at boot in the simulation
+#define SDLOG_BENCH_SYNC_MS 5000              // GPS time from then on
+
+static std::string joinRow(const std::vector<std::string>& row) {
+  std::string line;
+  for (size_t i = 0; i < row.size(); i++) {
+    if (i > 0) {
+      line += ',';
+    }
+    line += row[i];
+  }
+  return line;
+}
+
+int runWiden(int argc, char** argv) {
+  const char* inputPath = NULL;
+  const char* outputPath = NULL;
+  for (int i = 0; i < argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outputPath = argv[++i];
+    } else if (!inputPath) {
+      inputPath = argv[i];
+    }
+  }
+  if (!inputPath) {
+    fprintf(stderr, "widen: usage: widen <log.csv> [-o wide.csv]\n");
+    return 1;
+  }
+
+  std::string defaultOutput;
+  if (!outputPath) {
+    defaultOutput = inputPath;
+    size_t dot = defaultOutput.rfind(".csv");
+    defaultOutput = (dot != std::string::npos ? defaultOutput.substr(0, dot) : defaultOutput) + "_wide.csv";
+    outputPath = defaultOutput.c_str();
+  }
+
+  std::vector<std::string> lines;
+  LogReadStats blockStats;
+  if (!readSdLog(inputPath, lines, blockStats)) {
+    return 1;
+  }
+  FILE* out = fopen(outputPath, "w");
+  if (!out) {
+    fprintf(stderr, "widen: cannot create %s\n", outputPath);
+    return 1;
+  }
+
+  TaggedLogWidener widener;
+  unsigned long long bytesIn = 0, bytesOut = 0;
+  bool wroteHeader = false;
+  for (size_t i = 0; i < lines.size(); i++) {
+    bytesIn += lines[i].size() + 2;
+    if (!widener.addLine(lines[i].c_str())) {
+      continue;
+    }
+    if (!wroteHeader) {
+      std::string header = joinRow(widener.getColumns());
+      fprintf(out, "%s\n", header.c_str());
+      bytesOut += header.size() + 1;
+      wroteHeader = true;
+    }
+    std::string row = joinRow(widener.getRow());
+    fprintf(out, "%s\n", row.c_str());
+    bytesOut += row.size() + 1;
+  }
+  fclose(out);
+
+  if (!widener.hasHeader()) {
+    fprintf(stderr, "widen: %s has no record header (already a wide log?)\n", inputPath);
+    remove(outputPath);
+    return 1;
+  }
+  printf("%s -> %s\n", inputPath, outputPath);
+  printf("  %lu records (%lu keyframes), %lu skipped\n", (unsigned long)widener.getRecords(),
+         (unsigned long)widener.getKeyframes(), (unsigned long)widener.getSkipped());
+  if (blockStats.blocks > 0) {
+    printf("  %lu blocks, %lu bad, %lu lines dropped, %lu sequence gaps, %lu resumes, %lu seals\n",
+           (unsigned long)blockStats.blocks, (unsigned long)blockStats.badBlocks,
+           (unsigned long)blockStats.droppedLines, (unsigned long)blockStats.seqGaps,
+           (unsigned long)blockStats.resumes, (unsigned long)blockStats.seals);
+  }
+  printf("  %llu bytes tagged, %llu bytes wide (%.1fx)\n", bytesIn, bytesOut,
+         bytesIn > 0 ? (double)bytesOut / bytesIn : 0.0);
+  return widener.getSkipped() == 0 ? 0 : 1;
+}
+
+struct SdlogPhase {
+  const char* name;
+  FlightPhase phase;
+  SampleRates rates;
+  int durationMs;
+  float climbRate;          // m/s
+  float accelZ;             // g
+};
+
+// Fills in the sensors that are due at time t, the way updateSensors()
+// does, and returns their SdRecordGroup bits
+static uint8_t simulateCycle(TelemetryData& data, const SdlogPhase& phase, uint32_t t, uint32_t last[4],
+                             float& altitude, std::mt19937& rng) {
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+  uint8_t groups = 0;
+  altitude += phase.climbRate * phase.rates.imu / 1000.0f;
+  int64_t nowUs = (int64_t)t * 1000 + 137;
+
+  if (t - last[0] >= phase.rates.gps) {
+    last[0] = t;
+    data.latitude = 476062095 + (int32_t)(altitude * 3) + (int32_t)(noise(rng) * 20);
+    data.longitude = -1223320708 + (int32_t)(noise(rng) * 20);
+    data.altitude_gps = altitude + 3.0f * noise(rng);
+    data.gps_valid = true;
+    data.gps_time_us = nowUs - 180000;
+    groups |= SD_GROUP_GPS | SD_GROUP_NAV;
+  }
+  if (t - last[1] >= phase.rates.pressure) {
+    last[1] = t;
+    data.altitude_pressure = altitude + 0.5f * noise(rng);
+    data.pressure = 101325.0f - 12.0f * data.altitude_pressure;
+    data.pressure_valid = true;
+    data.pressure_time_us = nowUs - 9100;
+    groups |= SD_GROUP_PRESSURE | SD_GROUP_ALTITUDE;
+  }
+  if (t - last[2] >= phase.rates.power) {
+    last[2] = t;
+    data.bus_voltage = 7.4f + 0.01f * noise(rng);
+    data.current = -250.0f + 5.0f * noise(rng);
+    data.power = 1850.0f + 30.0f * noise(rng);
+    data.power_valid = true;
+    data.power_time_us = nowUs - 850;
+    groups |= SD_GROUP_POWER;
+  }
+
+  // IMU on every cycle, and the filters step with it. ALTITUDE and NAV
+  // are fresh above on a correction; otherwise sdDerivedGroups() decides
+  // when the record is logged.
+  data.accel_x = 0.02f * noise(rng);
+  data.accel_y = 0.02f * noise(rng);
+  data.accel_z = phase.accelZ + 0.05f * noise(rng);
+  data.gyro_x = 2.0f * noise(rng);
+  data.gyro_y = 2.0f * noise(rng);
+  data.gyro_z = 4.0f * noise(rng);
+  data.mag_x = 21.0f + noise(rng);
+  data.mag_y = -4.5f + noise(rng);
+  data.mag_z = -43.0f + noise(rng);
+  data.imu_temperature = 27.5f + 0.1f * noise(rng);
+  data.imu_valid = true;
+  data.accel_range = 16;
+  data.gyro_range = 2000;
+  data.imu_clipped = false;
+  data.imu_time_us = nowUs - 2500;
+  groups |= SD_GROUP_IMU;
+
+  // Filter outputs are smooth: each step moves them a fraction of the way
+  // towards a noisy target, as the filters' gains do
+  const float k = 0.02f;
+  if (!data.attitude_valid) {
+    data.yaw = 40.0f;  // Aligned from rest
+  }
+  if (!data.nav_valid && (groups & SD_GROUP_NAV)) {
+    data.nav_latitude = data.latitude;  // Starts at the first fix
+    data.nav_longitude = data.longitude;
+  }
+  data.roll += k * (3.0f * noise(rng) - data.roll);
+  data.pitch += k * (3.0f * noise(rng) - data.pitch);
+  data.yaw += k * (40.0f + 5.0f * noise(rng) - data.yaw);
+  float halfYaw = data.yaw * 0.5f * 0.0174533f;
+  data.quat_w = cosf(halfYaw);
+  data.quat_x = data.roll * 0.5f * 0.0174533f;
+  data.quat_y = data.pitch * 0.5f * 0.0174533f;
+  data.quat_z = sinf(halfYaw);
+  data.attitude_valid = true;
+  data.altitude_filtered += k * (altitude - data.altitude_filtered);
+  data.vertical_velocity += k * (phase.climbRate + 0.2f * noise(rng) - data.vertical_velocity);
+  data.estimator_valid = true;
+  data.flight_phase = phase.phase;
+  data.nav_latitude += (int32_t)(k * (data.latitude - data.nav_latitude));
+  data.nav_longitude += (int32_t)(k * (data.longitude - data.nav_longitude));
+  data.velocity_east += k * (3.0f + 0.3f * noise(rng) - data.velocity_east);
+  data.velocity_north += k * (-1.5f + 0.3f * noise(rng) - data.velocity_north);
+  data.nav_valid = data.nav_valid || (groups & SD_GROUP_NAV);
+
+  data.timestamp = t;
+  data.time_source = t >= SDLOG_BENCH_SYNC_MS ? 2 : 0;
+  data.utc_ms = t >= SDLOG_BENCH_SYNC_MS ? SDLOG_BENCH_EPOCH_MS + t : 0;
+  return groups;
+}
+
+// What a reader has of data after a record with these groups: the groups'
+// fields from this record, the rest carried from before
+static void applyGroups(TelemetryData& to, const TelemetryData& from, uint8_t groups) {
+  if (groups & SD_GROUP_KEYFRAME) {
+    to = from;
+    return;
+  }
+  to.timestamp = from.timestamp;
+  to.utc_ms = from.utc_ms;
+  if (groups & SD_GROUP_GPS) {
+    to.latitude = from.latitude;
+    to.longitude = from.longitude;
+    to.altitude_gps = from.altitude_gps;
+    to.gps_time_us = from.gps_time_us;
+    to.gps_valid = from.gps_valid;
+  }
+  if (groups & SD_GROUP_PRESSURE) {
+    to.altitude_pressure = from.altitude_pressure;
+    to.pressure = from.pressure;
+    to.pressure_time_us = from.pressure_time_us;
+    to.pressure_valid = from.pressure_valid;
+  }
+  if (groups & SD_GROUP_IMU) {
+    to.accel_x = from.accel_x;
+    to.accel_y = from.accel_y;
+    to.accel_z = from.accel_z;
+    to.gyro_x = from.gyro_x;
+    to.gyro_y = from.gyro_y;
+    to.gyro_z = from.gyro_z;
+    to.mag_x = from.mag_x;
+    to.mag_y = from.mag_y;
+    to.mag_z = from.mag_z;
+    to.imu_temperature = from.imu_temperature;
+    to.accel_range = from.accel_range;
+    to.gyro_range = from.gyro_range;
+    to.imu_clipped = from.imu_clipped;
+    to.imu_time_us = from.imu_time_us;
+    to.imu_valid = from.imu_valid;
+  }
+  if (groups & SD_GROUP_POWER) {
+    to.bus_voltage = from.bus_voltage;
+    to.current = from.current;
+    to.power = from.power;
+    to.power_time_us = from.power_time_us;
+    to.power_valid = from.power_valid;
+  }
+  if (groups & SD_GROUP_ALTITUDE) {
+    to.altitude_filtered = from.altitude_filtered;
+    to.vertical_velocity = from.vertical_velocity;
+    to.estimator_valid = from.estimator_valid;
+  }
+  if (groups & SD_GROUP_ATTITUDE) {
+    to.quat_w = from.quat_w;
+    to.quat_x = from.quat_x;
+    to.quat_y = from.quat_y;
+    to.quat_z = from.quat_z;
+    to.roll = from.roll;
+    to.pitch = from.pitch;
+    to.yaw = from.yaw;
+    to.attitude_valid = from.attitude_valid;
+  }
+  if (groups & SD_GROUP_NAV) {
+    to.nav_latitude = from.nav_latitude;
+    to.nav_longitude = from.nav_longitude;
+    to.velocity_east = from.velocity_east;
+    to.velocity_north = from.velocity_north;
+    to.nav_valid = from.nav_valid;
+  }
+}
+
+int runSdlogBench(int argc, char** argv) {
+  int scale = argc > 0 ? atoi(argv[0]) : 1;
+  if (scale <= 0) {
+    fprintf(stderr, "sdlog-bench: usage: sdlog-bench [repeats]\n");
+    return 1;
+  }
+
+  SdlogPhase phases[] = {
+    {"pad", PHASE_PAD, RATES_PAD, 30000, 0.0f, 1.0f},
+    {"boost", PHASE_BOOST, RATES_BOOST, 3000, 150.0f, 8.0f},
+    {"coast", PHASE_COAST, RATES_COAST, 15000, 120.0f, 0.0f},
+    {"apogee", PHASE_COAST, RATES_APOGEE, 4000, 5.0f, 0.0f},
+    {"descent", PHASE_DESCENT, RATES_DESCENT, 90000, -25.0f, 1.0f},
+    {"landed", PHASE_LANDED, RATES_LANDED, 30000, 0.0f, 1.0f},
+  };
+  int phaseCount = sizeof(phases) / sizeof(phases[0]);
+
+  std::mt19937 rng(43);
+  TelemetryData data;
+  memset(&data, 0, sizeof(data));
+  data.mode = MODE_FLIGHT;
+
+  // The log as the SD manager writes it: header, then records
+  TaggedLogWidener widener;
+  for (uint8_t i = 0; sdRecordHeaderLine(i) != NULL; i++) {
+    widener.addLine(sdRecordHeaderLine(i));
+  }
+
+  char tagged[SD_RECORD_MAX_LENGTH];
+  char wide[SD_RECORD_MAX_LENGTH];
+  char expected[SD_RECORD_MAX_LENGTH];
+  uint32_t t = 0;
+  uint32_t last[4] = {0, 0, 0, 0};
+  SdDerivedState derived = {};
+  TelemetryData held;  // The row a reader widens back to
+  memset(&held, 0, sizeof(held));
+  float heldAltitude = 0.0f, heldAttitude = 0.0f, heldVelocity = 0.0f;
+  uint32_t lastLog = 0;
+  float altitude = 0.0f;
+  uint8_t fresh = 0;
+  bool first = true;
+  uint32_t keyframeTime = 0;
+  FlightPhase keyframePhase = PHASE_PAD;
+  uint8_t keyframeTimeSource = 0;
+  unsigned long totalRecords = 0, mismatches = 0, widenFailures = 0;
+  unsigned long long totalWide = 0, totalTagged = 0;
+  double wideNs = 0.0, taggedNs = 0.0;
+
+  printf("SD log bytes, full rows vs. tagged records, simulated flight (%d keyframe ms)\n", SD_KEYFRAME_INTERVAL);
+  printf("  %-8s %8s %9s %12s %12s %7s\n", "phase", "records", "keyframes", "full B/s", "tagged B/s", "ratio");
+  for (int p = 0; p < phaseCount; p++) {
+    const SdlogPhase& phase = phases[p];
+    unsigned long records = 0, keyframes = 0;
+    unsigned long long wideBytes = 0, taggedBytes = 0;
+    uint32_t end = t + phase.durationMs;
+    for (; t < end; t += phase.rates.imu) {
+      fresh |= simulateCycle(data, phase, t, last, altitude, rng);
+      if (!first && t - lastLog < phase.rates.sdLog) {
+        continue;
+      }
+      lastLog = t;
+
+      // Keyframe rule of SDManager::addData(), plus the one opening the file
+      uint8_t groups = fresh;
+      fresh = 0;
+      if (first || data.flight_phase != keyframePhase || data.time_source != keyframeTimeSource ||
+          data.timestamp - keyframeTime >= SD_KEYFRAME_INTERVAL) {
+        groups |= SD_GROUP_KEYFRAME;
+        keyframeTime = data.timestamp;
+        keyframePhase = data.flight_phase;
+        keyframeTimeSource = data.time_source;
+        keyframes++;
+      }
+      first = false;
+      groups = sdDerivedGroups(data, groups, derived);
+
+      uint64_t start = groundMicros();
+      for (int r = 0; r < scale; r++) {
+        formatSdRow(wide, sizeof(wide), data);
+      }
+      wideNs += (groundMicros() - start) * 1000.0 / scale;
+      start = groundMicros();
+      size_t taggedLen = 0;
+      for (int r = 0; r < scale; r++) {
+        taggedLen = formatSdRecord(tagged, sizeof(tagged), data, groups);
+      }
+      taggedNs += (groundMicros() - start) * 1000.0 / scale;
+
+      // Both with the CRLF println() adds
+      wideBytes += strlen(wide) + 2;
+      taggedBytes += taggedLen + 2;
+      records++;
+
+      // Filter outputs inside their deadbands are carried from the last
+      // record that had them; the rest widens back exactly
+      applyGroups(held, data, groups);
+      formatSdRow(expected, sizeof(expected), held);
+      heldAltitude = fmaxf(heldAltitude, fabsf(data.altitude_filtered - held.altitude_filtered));
+      heldAttitude = fmaxf(heldAttitude, fmaxf(fabsf(data.roll - held.roll), fabsf(data.pitch - held.pitch)));
+      heldVelocity = fmaxf(heldVelocity, fmaxf(fabsf(data.vertical_velocity - held.vertical_velocity),
+                                               fabsf(data.velocity_east - held.velocity_east)));
+      if (!widener.addLine(tagged)) {
+        widenFailures++;
+      } else if (joinRow(widener.getRow()) != expected) {
+        if (mismatches == 0) {
+          printf("  first mismatch at %lu ms:\n    %s\n    %s\n", (unsigned long)t, expected,
+                 joinRow(widener.getRow()).c_str());
+        }
+        mismatches++;
+      }
+    }
+    double seconds = phase.durationMs / 1000.0;
+    printf("  %-8s %8lu %9lu %12.0f %12.0f %6.1fx\n", phase.name, records, keyframes, wideBytes / seconds,
+           taggedBytes / seconds, taggedBytes > 0 ? (double)wideBytes / taggedBytes : 0.0);
+    totalRecords += records;
+    totalWide += wideBytes;
+    totalTagged += taggedBytes;
+  }
+
+  printf("  %-8s %8lu %9s %11.0fK %11.0fK %6.1fx\n", "flight", totalRecords, "", totalWide / 1024.0,
+         totalTagged / 1024.0, totalTagged > 0 ? (double)totalWide / totalTagged : 0.0);
+  printf("  widened back: %lu rows differ, %lu records unreadable\n", mismatches, widenFailures);
+  printf("  filter outputs held within: altitude %.2f m, attitude %.2f deg, velocity %.2f m/s\n", heldAltitude,
+         heldAttitude, heldVelocity);
+  printf("  formatting per record (host): full row %.0f ns, tagged %.0f ns\n", wideNs / totalRecords,
+         taggedNs / totalRecords);
+
+  return mismatches == 0 && widenFailures == 0 && totalTagged < totalWide ? 0 : 1;
+}
+
+// A log held in memory, read through scanLogTail() like the card
+struct MemoryLog {
+  const char* data;
+  uint32_t size;
+};
+
+static size_t readMemoryLog(void* context, uint32_t offset, uint8_t* buffer, size_t len) {
+  const MemoryLog* log = (const MemoryLog*)context;
+  if (offset >= log->size) {
+    return 0;
+  }
+  size_t count = log->size - offset < len ? log->size - offset : len;
+  memcpy(buffer, log->data + offset, count);
+  return count;
+}
+
+static bool scanMemoryLog(const std::string& text, uint32_t size, LogScanResult& result) {
+  MemoryLog log = {text.data(), size};
+  return scanLogTail(readMemoryLog, &log, size, result);
+}
+
+// One block as SDManager::writeBatchToFile() writes it
+static void appendBlock(std::string& text, uint32_t seq, const std::vector<std::string>& lines) {
+  LogBlockWriter writer;
+  writer.begin(seq);
+  for (size_t i = 0; i < lines.size(); i++) {
+    std::string line = lines[i] + "\r\n";
+    text += line;
+    writer.add((const uint8_t*)line.data(), line.size());
+  }
+  char trailer[LOG_BLOCK_TRAILER_LENGTH];
+  text.append(trailer, writer.formatTrailer(trailer, sizeof(trailer)));
+}
+
+static void appendMarker(std::string& text, char type, uint32_t seq) {
+  char marker[LOG_BLOCK_TRAILER_LENGTH];
+  text.append(marker, formatLogMarker(marker, sizeof(marker), type, seq));
+}
+
+// Records of a simulated boost, 1 to 8 per block; the first is a keyframe
+static std::vector<std::vector<std::string> > simulateBlocks(int blocks, uint32_t& t, std::mt19937& rng) {
+  SdlogPhase boost = {"boost", PHASE_BOOST, RATES_BOOST, 0, 150.0f, 8.0f};
+  TelemetryData data;
+  memset(&data, 0, sizeof(data));
+  data.mode = MODE_FLIGHT;
+  uint32_t last[4] = {0, 0, 0, 0};
+  SdDerivedState derived = {};
+  float altitude = 0.0f;
+  char record[SD_RECORD_MAX_LENGTH];
+  std::vector<std::vector<std::string> > out(blocks);
+  for (int b = 0; b < blocks; b++) {
+    for (int r = 0; r <= b % 8; r++, t += boost.rates.imu) {
+      uint8_t groups = simulateCycle(data, boost, t, last, altitude, rng);
+      if (b == 0 && r == 0) {
+        groups |= SD_GROUP_KEYFRAME;
+      }
+      groups = sdDerivedGroups(data, groups, derived);
+      formatSdRecord(record, sizeof(record), data, groups);
+      out[b].push_back(record);
+    }
+  }
+  return out;
+}
+
+int runLogCrash(int argc, char** argv) {
+  int blockCount = argc > 0 ? atoi(argv[0]) : 12;
+  if (blockCount <= 0) {
+    fprintf(stderr, "log-crash: usage: log-crash [blocks]\n");
+    return 1;
+  }
+
+  std::mt19937 rng(44);
+  uint32_t t = 0;
+  std::vector<std::vector<std::string> > blocks;
+  std::vector<std::string> header;
+  for (uint8_t i = 0; sdRecordHeaderLine(i) != NULL; i++) {
+    header.push_back(sdRecordHeaderLine(i));
+  }
+  blocks.push_back(header);
+  std::vector<std::vector<std::string> > records = simulateBlocks(blockCount, t, rng);
+  blocks.insert(blocks.end(), records.begin(), records.end());
+  std::vector<std::vector<std::string> > after = simulateBlocks(2, t, rng);
+
+  // The log the SD manager writes: header as block 0, then the batches
+  std::string log;
+  std::vector<uint32_t> blockEnds;
+  for (size_t b = 0; b < blocks.size(); b++) {
+    appendBlock(log, (uint32_t)b, blocks[b]);
+    blockEnds.push_back((uint32_t)log.size());
+  }
+  uint32_t size = (uint32_t)log.size();
+
+  printf("Crash recovery of a %lu-block log (%lu bytes), cut at every byte\n",
+         (unsigned long)blocks.size(), (unsigned long)size);
+  unsigned long cuts = 0, scanFailures = 0, resumeFailures = 0, sealFailures = 0, noBlock = 0;
+  unsigned long long scanBytes = 0;
+  uint32_t maxScanBytes = 0;
+  for (uint32_t cut = 0; cut <= size; cut++) {
+    cuts++;
+    // A trailer cut after its CRC digits still holds: the marker's CRLF
+    // ends its line
+    int expected = -1;
+    for (size_t b = 0; b < blockEnds.size() && blockEnds[b] - 2 <= cut; b++) {
+      expected = (int)b;
+    }
+    LogScanResult scan;
+    bool found = scanMemoryLog(log, cut, scan);
+    scanBytes += scan.bytesRead;
+    if (scan.bytesRead > maxScanBytes) {
+      maxScanBytes = scan.bytesRead;
+    }
+    if (expected < 0) {
+      // Nothing to keep; the SD manager starts a new file
+      if (found) {
+        scanFailures++;
+      }
+      noBlock++;
+      continue;
+    }
+    uint32_t validEnd = blockEnds[expected] < cut ? blockEnds[expected] : cut;
+    if (!found || scan.lastSeq != (uint32_t)expected || scan.validEnd != validEnd || scan.sealed) {
+      if (scanFailures == 0) {
+        printf("  first scan failure at byte %lu: found %d seq %lu end %lu, expected seq %d end %lu\n",
+               (unsigned long)cut, found, (unsigned long)scan.lastSeq, (unsigned long)scan.validEnd,
+               expected, (unsigned long)validEnd);
+      }
+      scanFailures++;
+      continue;
+    }
+
+    std::vector<std::string> kept;
+    for (int b = 0; b <= expected; b++) {
+      kept.insert(kept.end(), blocks[b].begin(), blocks[b].end());
+    }
+
+    // Resumed: a marker and the next blocks go after the torn tail
+    std::string resumed = log.substr(0, cut);
+    appendMarker(resumed, 'R', expected + 1);
+    std::vector<std::string> expectedLines = kept;
+    for (size_t b = 0; b < after.size(); b++) {
+      appendBlock(resumed, expected + 1 + (uint32_t)b, after[b]);
+      expectedLines.insert(expectedLines.end(), after[b].begin(), after[b].end());
+    }
+    std::vector<std::string> lines;
+    LogReadStats stats;
+    readSdLogText(resumed, lines, stats);
+    if (lines != expectedLines || stats.seqGaps != 0 || stats.resumes != 1) {
+      resumeFailures++;
+    }
+
+    // Sealed: the file reads as the kept blocks, and a later boot sees
+    // the seal and leaves it alone
+    std::string sealed = log.substr(0, cut);
+    appendMarker(sealed, 'E', expected);
+    readSdLogText(sealed, lines, stats);
+    LogScanResult rescan;
+    if (lines != kept || stats.seals != 1 || !scanMemoryLog(sealed, (uint32_t)sealed.size(), rescan) ||
+        rescan.lastSeq != (uint32_t)expected || !rescan.sealed) {
+      sealFailures++;
+    }
+  }
+  printf("  %lu cuts: %lu before the first block, %lu scan, %lu resume, %lu seal failures\n",
+         cuts, noBlock, scanFailures, resumeFailures, sealFailures);
+  printf("  scan read %.0f bytes on average, %lu at most\n", (double)scanBytes / cuts,
+         (unsigned long)maxScanBytes);
+
+  // One flipped bit anywhere in the last block's lines: the scan falls
+  // back to the block before it
+  unsigned long flips = 0, flipFailures = 0;
+  uint32_t lastStart = blockEnds[blockEnds.size() - 2];
+  uint32_t lastTrailer = lastStart;
+  for (size_t i = 0; i < blocks.back().size(); i++) {
+    lastTrailer += (uint32_t)blocks.back()[i].size() + 2;
+  }
+  for (uint32_t offset = lastStart; offset < lastTrailer; offset++) {
+    for (int bit = 0; bit < 8; bit++) {
+      std::string flipped = log;
+      flipped[offset] ^= (char)(1 << bit);
+      LogScanResult scan;
+      flips++;
+      if (!scanMemoryLog(flipped, size, scan) || scan.lastSeq != blocks.size() - 2 ||
+          scan.validEnd != lastStart || scan.tailBytes != size - lastStart) {
+        flipFailures++;
+      }
+    }
+  }
+  printf("  %lu bit flips in the last block: %lu not caught\n", flips, flipFailures);
+
+  // Cost at boot on a long flight's log: the tail, not the whole file
+  std::string longLog;
+  appendBlock(longLog, 0, header);
+  std::vector<std::vector<std::string> > flight = simulateBlocks(4000, t, rng);
+  for (size_t b = 0; b < flight.size(); b++) {
+    appendBlock(longLog, (uint32_t)b + 1, flight[b]);
+  }
+  uint32_t longSize = (uint32_t)longLog.size() - 17;
+  LogScanResult longScan;
+  uint64_t start = groundMicros();
+  bool longFound = scanMemoryLog(longLog, longSize, longScan);
+  uint64_t elapsed = groundMicros() - start;
+  printf("  %lu KB log cut mid-block: block %lu found, %lu bytes read (%.2f%% of the file), %llu us host\n",
+         (unsigned long)(longSize / 1024), (unsigned long)longScan.lastSeq, (unsigned long)longScan.bytesRead,
+         100.0 * longScan.bytesRead / longSize, (unsigned long long)elapsed);
+
+  bool pass = scanFailures == 0 && resumeFailures == 0 && sealFailures == 0 && flipFailures == 0 &&
+              longFound && longScan.lastSeq == flight.size() - 1;
+  printf("  %s\n", pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
+
+// The black box partition in memory: erase sets a sector to 0xFF, a
+// program can only clear bits, and each operation is charged the typical
+// time of the board's flash. tearAfter cuts a program short, as a reset
+// during it would.
+#define SIM_FLASH_ERASE_MS 45.0   // 4 KB sector erase
+#define SIM_FLASH_PAGE_MS 0.6     // Program of (part of) one 256-byte page
+#define SIM_FLASH_CYCLES 100000   // Rated erase cycles per sector
+
+struct SimFlash {
+  std::vector<uint8_t> bytes;
+  std::vector<uint32_t> sectorErases;
+  double busyMs;
+  long tearAfter;   // Bytes programmed before the cut, -1 for none
+};
+
+static bool readSimFlash(void* context, uint32_t offset, void* buffer, size_t len) {
+  SimFlash* flash = (SimFlash*)context;
+  memcpy(buffer, &flash->bytes[offset], len);
+  return true;
+}
+
+static bool writeSimFlash(void* context, uint32_t offset, const void* data, size_t len) {
+  SimFlash* flash = (SimFlash*)context;
+  const uint8_t* bytes = (const uint8_t*)data;
+  flash->busyMs += SIM_FLASH_PAGE_MS * ((offset + len - 1) / 256 - offset / 256 + 1);
+  for (size_t i = 0; i < len; i++) {
+    if (flash->tearAfter >= 0 && (long)i >= flash->tearAfter) {
+      return false;
+    }
+    flash->bytes[offset + i] &= bytes[i];
+  }
+  return true;
+}
+
+static bool eraseSimFlash(void* context, uint32_t offset) {
+  SimFlash* flash = (SimFlash*)context;
+  memset(&flash->bytes[offset], 0xFF, BLACKBOX_SECTOR_SIZE);
+  flash->sectorErases[offset / BLACKBOX_SECTOR_SIZE]++;
+  flash->busyMs += SIM_FLASH_ERASE_MS;
+  return true;
+}
+
+static BlackBoxFlash simFlashAccess(SimFlash& flash) {
+  BlackBoxFlash access = {&flash, readSimFlash, writeSimFlash, eraseSimFlash, (uint32_t)flash.bytes.size()};
+  return access;
+}
+
+static std::string blackBoxLine(const TelemetryData& data, uint8_t groups) {
+  char line[SD_RECORD_MAX_LENGTH];
+  formatSdRecord(line, sizeof(line), data, groups | SD_GROUP_KEYFRAME);
+  return line;
+}
+
+// Everything pending, oldest first, the way SDManager::drainBlackBox()
+// copies it to the card
+static std::vector<std::string> drainAll(BlackBox& box) {
+  std::vector<std::string> lines;
+  BlackBoxEntry entry;
+  while (box.peekOldest(entry)) {
+    lines.push_back(blackBoxLine(entry.data, entry.groups));
+    box.markDrained();
+  }
+  return lines;
+}
+
+// What the background task does on the ground between flights
+static void eraseAll(BlackBox& box) {
+  while (box.eraseAhead(1) > 0) {
+  }
+}
+
+int runBlackBoxBench(int argc, char** argv) {
+  int flights = argc > 0 ? atoi(argv[0]) : 5;
+  if (flights <= 0) {
+    fprintf(stderr, "blackbox-bench: usage: blackbox-bench [flights]\n");
+    return 1;
+  }
+
+  SdlogPhase phases[] = {
+    {"pad", PHASE_PAD, RATES_PAD, 30000, 0.0f, 1.0f},
+    {"boost", PHASE_BOOST, RATES_BOOST, 3000, 150.0f, 8.0f},
+    {"coast", PHASE_COAST, RATES_COAST, 15000, 120.0f, 0.0f},
+    {"apogee", PHASE_COAST, RATES_APOGEE, 4000, 5.0f, 0.0f},
+    {"descent", PHASE_DESCENT, RATES_DESCENT, 90000, -25.0f, 1.0f},
+    {"landed", PHASE_LANDED, RATES_LANDED, 30000, 0.0f, 1.0f},
+  };
+  int phaseCount = sizeof(phases) / sizeof(phases[0]);
+
+  // The partition from partitions.csv
+  SimFlash flash;
+  flash.bytes.assign(0x100000, 0xFF);
+  flash.sectorErases.assign(flash.bytes.size() / BLACKBOX_SECTOR_SIZE, 0);
+  flash.busyMs = 0.0;
+  flash.tearAfter = -1;
+  BlackBox box;
+  if (!box.begin(simFlashAccess(flash))) {
+    fprintf(stderr, "blackbox-bench: black box didn't start\n");
+    return 1;
+  }
+  printf("Flash black box, %lu KB partition: %lu records of %lu bytes, %lu sectors\n",
+         (unsigned long)(flash.bytes.size() / 1024), (unsigned long)box.getCapacity(),
+         (unsigned long)sizeof(BlackBoxEntry), (unsigned long)box.getSectorCount());
+
+  // Cost of keeping one more record with no card, on the host CPU
+  const int inserts = 200000;
+  static TelemetryData batch[SD_BATCH_SIZE];
+  static uint8_t batchGroups[SD_BATCH_SIZE];
+  TelemetryData sample;
+  memset(&sample, 0, sizeof(sample));
+  uint64_t start = groundMicros();
+  for (int i = 0; i < inserts; i++) {
+    // The batch as it was: shift everything down one
+    memmove(&batch[0], &batch[1], (SD_BATCH_SIZE - 1) * sizeof(TelemetryData));
+    memmove(&batchGroups[0], &batchGroups[1], SD_BATCH_SIZE - 1);
+    sample.timestamp = i;
+    batch[SD_BATCH_SIZE - 1] = sample;
+    batchGroups[SD_BATCH_SIZE - 1] = (uint8_t)i;
+  }
+  double memmoveNs = (groundMicros() - start) * 1000.0 / inserts;
+  int batchStart = 0;
+  start = groundMicros();
+  for (int i = 0; i < inserts; i++) {
+    // Circular, the fallback without a black box
+    sample.timestamp = i;
+    batch[batchStart] = sample;
+    batchGroups[batchStart] = (uint8_t)i;
+    batchStart = (batchStart + 1) % SD_BATCH_SIZE;
+    batchGroups[batchStart] |= SD_GROUP_KEYFRAME;
+  }
+  double circularNs = (groundMicros() - start) * 1000.0 / inserts;
+  uint32_t sinkTime = batch[(batchStart + SD_BATCH_SIZE - 1) % SD_BATCH_SIZE].timestamp;
+  uint64_t appendUs = 0;
+  for (int i = 0; i < inserts;) {
+    // Half a ring at a time, drained and erased ahead untimed, so no
+    // append waits on an in-line erase
+    start = groundMicros();
+    for (uint32_t k = 0; k < box.getCapacity() / 2 && i < inserts; k++, i++) {
+      sample.timestamp = i;
+      box.append(sample, SD_GROUP_IMU);
+    }
+    appendUs += groundMicros() - start;
+    drainAll(box);
+    eraseAll(box);
+  }
+  double appendNs = appendUs * 1000.0 / inserts;
+  printf("  per record, host CPU: batch memmove %.0f ns, circular batch %.0f ns, black box append %.0f ns"
+         " (last t=%lu)\n", memmoveNs, circularNs, appendNs, (unsigned long)sinkTime);
+  drainAll(box);
+  eraseAll(box);
+  std::fill(flash.sectorErases.begin(), flash.sectorErases.end(), 0);
+
+  // Flights with both cards down from power-up. Between flights the cards
+  // are back: the ring drains and the ground erases ahead of the writer.
+  std::mt19937 rng(46);
+  unsigned long drainMismatches = 0, resumeMismatches = 0, inlineErases = 0;
+  unsigned long totalRecords = 0;
+  double maxStallMs = 0.0;
+  for (int f = 0; f < flights; f++) {
+    TelemetryData data;
+    memset(&data, 0, sizeof(data));
+    data.mode = MODE_FLIGHT;
+    uint32_t t = 0, lastLog = 0;
+    uint32_t last[4] = {0, 0, 0, 0};
+    SdDerivedState derived = {};
+    float altitude = 0.0f;
+    uint8_t fresh = 0;
+    bool first = true;
+    std::vector<std::string> expected;
+    uint32_t inlineBefore = box.getStats().inlineErases;
+    if (f == 0) {
+      printf("  flight with both cards down, modeled flash time (%.0f ms erase, %.1f ms page program):\n",
+             SIM_FLASH_ERASE_MS, SIM_FLASH_PAGE_MS);
+      printf("  %-8s %8s %8s %10s %10s\n", "phase", "records", "rec/s", "flash busy", "max stall");
+    }
+    for (int p = 0; p < phaseCount; p++) {
+      const SdlogPhase& phase = phases[p];
+      unsigned long records = 0;
+      double busy = 0.0, stall = 0.0;
+      uint32_t end = t + phase.durationMs;
+      for (; t < end; t += phase.rates.imu) {
+        fresh |= simulateCycle(data, phase, t, last, altitude, rng);
+        if (!first && t - lastLog < phase.rates.sdLog) {
+          continue;
+        }
+        first = false;
+        lastLog = t;
+        fresh = sdDerivedGroups(data, fresh, derived);
+        double before = flash.busyMs;
+        box.append(data, fresh);
+        double cost = flash.busyMs - before;
+        busy += cost;
+        stall = cost > stall ? cost : stall;
+        expected.push_back(blackBoxLine(data, fresh));
+        fresh = 0;
+        records++;
+
+        // A reset mid-coast on the first flight: the ring is rebuilt from
+        // flash and carries on
+        if (f == 0 && p == 2 && records == 100) {
+          BlackBox rebuilt;
+          if (!rebuilt.begin(simFlashAccess(flash)) || rebuilt.getPending() != expected.size()) {
+            resumeMismatches++;
+          }
+          inlineBefore -= box.getStats().inlineErases;
+          box = rebuilt;
+        }
+      }
+      if (f == 0) {
+        printf("  %-8s %8lu %8.0f %9.2f%% %8.2f ms\n", phase.name, records, records * 1000.0 / phase.durationMs,
+               100.0 * busy / phase.durationMs, stall);
+      }
+      maxStallMs = stall > maxStallMs ? stall : maxStallMs;
+      totalRecords += records;
+    }
+    inlineErases += box.getStats().inlineErases - inlineBefore;
+
+    std::vector<std::string> drained = drainAll(box);
+    if (drained != expected) {
+      if (drainMismatches == 0) {
+        printf("  flight %d: drained %lu records, expected %lu\n", f + 1, (unsigned long)drained.size(),
+               (unsigned long)expected.size());
+      }
+      drainMismatches++;
+    }
+    eraseAll(box);
+  }
+
+  uint32_t maxErases = 0;
+  unsigned long long totalErases = 0;
+  for (size_t s = 0; s < flash.sectorErases.size(); s++) {
+    maxErases = flash.sectorErases[s] > maxErases ? flash.sectorErases[s] : maxErases;
+    totalErases += flash.sectorErases[s];
+  }
+  printf("  %d flights, %lu records: %lu in-line erases, longest stall %.2f ms, %lu drained out of order,"
+         " %lu bad rebuilds\n", flights, totalRecords, inlineErases, maxStallMs, drainMismatches,
+         resumeMismatches);
+  printf("  wear: %.1f sector erases per flight, most-erased sector %lu; ~%.0f such flights to %d cycles\n",
+         (double)totalErases / flights, (unsigned long)maxErases,
+         maxErases > 0 ? (double)SIM_FLASH_CYCLES * flights / maxErases : 0.0, SIM_FLASH_CYCLES);
+
+  // A reset at every byte of one program: the ring comes back without the
+  // torn record and appends after it
+  unsigned long tears = 0, tearFailures = 0;
+  std::vector<std::string> before;
+  TelemetryData data;
+  memset(&data, 0, sizeof(data));
+  for (int i = 0; i < 20; i++) {
+    data.timestamp = 1000 + i;
+    box.append(data, SD_GROUP_IMU);
+    before.push_back(blackBoxLine(data, SD_GROUP_IMU));
+  }
+  std::vector<uint8_t> saved = flash.bytes;
+  for (long cut = 0; cut < (long)sizeof(BlackBoxEntry); cut++) {
+    flash.bytes = saved;
+    BlackBox torn = box;
+    flash.tearAfter = cut;
+    data.timestamp = 5000;
+    torn.append(data, SD_GROUP_IMU);
+    flash.tearAfter = -1;
+    BlackBox rebuilt;
+    std::vector<std::string> expected = before;
+    for (int i = 0; i < 3; i++) {
+      data.timestamp = 6000 + i;
+      expected.push_back(blackBoxLine(data, SD_GROUP_IMU));
+    }
+    bool ok = rebuilt.begin(simFlashAccess(flash));
+    for (int i = 0; i < 3 && ok; i++) {
+      data.timestamp = 6000 + i;
+      rebuilt.append(data, SD_GROUP_IMU);
+    }
+    tears++;
+    if (!ok || drainAll(rebuilt) != expected) {
+      tearFailures++;
+    }
+  }
+  flash.bytes = saved;
+  printf("  %lu programs cut short by a reset: %lu rings not rebuilt cleanly\n", tears, tearFailures);
+
+  // Cards down for longer than the ring holds: the newest records are kept,
+  // in order, and the oldest sectors go
+  BlackBox full;
+  full.begin(simFlashAccess(flash));
+  drainAll(full);
+  eraseAll(full);
+  uint32_t overflow = full.getCapacity() + full.getCapacity() / 2;
+  std::vector<std::string> written;
+  for (uint32_t i = 0; i < overflow; i++) {
+    data.timestamp = 100000 + i;
+    full.append(data, SD_GROUP_IMU);
+    written.push_back(blackBoxLine(data, SD_GROUP_IMU));
+  }
+  std::vector<std::string> kept = drainAll(full);
+  bool newestKept = kept.size() + full.getStats().overwritten == overflow &&
+                    kept.size() > full.getCapacity() - BLACKBOX_SECTOR_SIZE / sizeof(BlackBoxEntry) &&
+                    std::equal(kept.begin(), kept.end(), written.end() - kept.size());
+  printf("  %lu records into a %lu-record ring: newest %lu kept in order, %lu overwritten (%s)\n",
+         (unsigned long)overflow, (unsigned long)full.getCapacity(), (unsigned long)kept.size(),
+         (unsigned long)full.getStats().overwritten, newestKept ? "ok" : "wrong");
+
+  bool pass = drainMismatches == 0 && resumeMismatches == 0 && inlineErases == 0 && tearFailures == 0 &&
+              newestKept;
+  printf("  %s\n", pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
+
+// The card behind FatFs, holding one file. File data passes through
+// FatFs's one-sector window: a partial sector not in the window is read
+// first if it holds data, and the window goes back to the card when the
+// writer leaves it or the file closes. A run of whole sectors starting on
+// a boundary skips the window and goes to the card as one multi-block
+// write. Each call, command and block is charged a typical time at the
+// board's SPI clock.
+#define SIM_SD_CALL_US 15.0         // VFS, lock and FatFs per call
+#define SIM_SD_COMMAND_US 400.0     // Command, response and busy wait per card read or write
+#define SIM_SD_BLOCK_BUSY_US 150.0  // Programming per block written
+#define SIM_SD_CLUSTER 32768        // Cluster size: a FAT sector write per one allocated
+
+struct SimSdFile {
+  std::vector<uint8_t> data;
+  uint32_t position;
+  int64_t window;               // Sector in the window, -1 for none
+  bool dirty;
+  double busyUs;
+  unsigned long reads, writes, blocks, unaligned, calls;
+};
+
+static double simSdBlockUs() {
+  return SD_SECTOR_SIZE * 8 * 1e6 / SD_SPI_SPEED;
+}
+
+static void simSdRead(SimSdFile& file) {
+  file.busyUs += SIM_SD_COMMAND_US + simSdBlockUs();
+  file.reads++;
+}
+
+static void simSdWrite(SimSdFile& file, uint32_t count) {
+  file.busyUs += SIM_SD_COMMAND_US + count * (simSdBlockUs() + SIM_SD_BLOCK_BUSY_US);
+  file.writes++;
+  file.blocks += count;
+}
+
+static void simSdFlushWindow(SimSdFile& file) {
+  if (file.dirty) {
+    simSdWrite(file, 1);
+    file.dirty = false;
+  }
+}
+
+// Opens for appending (FILE_APPEND) or at the start ("r+"); FatFs loads
+// the last sector when the end is mid-sector
+static void simSdOpen(SimSdFile& file, bool append) {
+  file.busyUs += SIM_SD_CALL_US;
+  file.calls++;
+  file.window = -1;
+  file.dirty = false;
+  file.position = append ? (uint32_t)file.data.size() : 0;
+  if (append && file.position % SD_SECTOR_SIZE != 0) {
+    simSdRead(file);
+    file.window = file.position / SD_SECTOR_SIZE;
+  }
+}
+
+static void simSdWriteData(SimSdFile& file, const uint8_t* data, size_t len) {
+  file.busyUs += SIM_SD_CALL_US;
+  file.calls++;
+  if (file.position % SD_SECTOR_SIZE != 0) {
+    file.unaligned++;
+  }
+  uint32_t oldClusters = (uint32_t)((file.data.size() + SIM_SD_CLUSTER - 1) / SIM_SD_CLUSTER);
+  while (len > 0) {
+    uint32_t sector = file.position / SD_SECTOR_SIZE;
+    uint32_t offset = file.position % SD_SECTOR_SIZE;
+    if (offset == 0) {
+      if (file.window != (int64_t)sector) {
+        simSdFlushWindow(file);
+      }
+      if (len >= SD_SECTOR_SIZE) {
+        uint32_t count = (uint32_t)(len / SD_SECTOR_SIZE);
+        simSdWrite(file, count);
+        if (file.window >= sector && file.window < (int64_t)sector + count) {
+          file.dirty = false;
+        }
+        size_t bytes = (size_t)count * SD_SECTOR_SIZE;
+        if (file.position + bytes > file.data.size()) {
+          file.data.resize(file.position + bytes);
+        }
+        memcpy(&file.data[file.position], data, bytes);
+        file.position += (uint32_t)bytes;
+        data += bytes;
+        len -= bytes;
+        continue;
+      }
+    }
+    if (file.window != (int64_t)sector) {
+      simSdFlushWindow(file);
+      if (file.position < file.data.size()) {
+        simSdRead(file);
+      }
+      file.window = sector;
+    }
+    size_t count = SD_SECTOR_SIZE - offset < len ? SD_SECTOR_SIZE - offset : len;
+    if (file.position + count > file.data.size()) {
+      file.data.resize(file.position + count);
+    }
+    memcpy(&file.data[file.position], data, count);
+    file.position += (uint32_t)count;
+    file.dirty = true;
+    data += count;
+    len -= count;
+  }
+  uint32_t newClusters = (uint32_t)((file.data.size() + SIM_SD_CLUSTER - 1) / SIM_SD_CLUSTER);
+  for (; oldClusters < newClusters; oldClusters++) {
+    simSdWrite(file, 1);
+  }
+}
+
+// The window, then the directory entry with the new size
+static void simSdClose(SimSdFile& file) {
+  file.busyUs += SIM_SD_CALL_US;
+  file.calls++;
+  simSdFlushWindow(file);
+  simSdWrite(file, 1);
+}
+
+static bool writeSimSd(void* context, uint32_t offset, const uint8_t* data, size_t len) {
+  SimSdFile* file = (SimSdFile*)context;
+  if (file->position != offset) {
+    file->busyUs += SIM_SD_CALL_US;
+    file->calls++;
+    file->position = offset;
+  }
+  simSdWriteData(*file, data, len);
+  return true;
+}
+
+// Tagged records of a coast phase at full rate, as the log holds them
+static std::vector<std::string> simulateLogLines(size_t count) {
+  SdlogPhase phase = {"coast", PHASE_COAST, RATES_APOGEE, 0, 120.0f, 0.0f};
+  std::mt19937 rng(49);
+  TelemetryData data;
+  memset(&data, 0, sizeof(data));
+  data.mode = MODE_FLIGHT;
+  uint32_t last[4] = {0, 0, 0, 0};
+  SdDerivedState derived = {};
+  float altitude = 1000.0f;
+  uint32_t keyframeTime = 0;
+  std::vector<std::string> lines;
+  char line[SD_RECORD_MAX_LENGTH];
+  for (uint32_t t = 0; lines.size() < count; t += phase.rates.sdLog) {
+    uint8_t groups = simulateCycle(data, phase, t, last, altitude, rng);
+    if (lines.empty() || t - keyframeTime >= SD_KEYFRAME_INTERVAL) {
+      groups |= SD_GROUP_KEYFRAME;
+      keyframeTime = t;
+    }
+    groups = sdDerivedGroups(data, groups, derived);
+    formatSdRecord(line, sizeof(line), data, groups);
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+int runSdWriteBench(int argc, char** argv) {
+  int kilobytes = argc > 0 ? atoi(argv[0]) : 256;
+  if (kilobytes <= 0) {
+    fprintf(stderr, "sdwrite-bench: usage: sdwrite-bench [KB per run]\n");
+    return 1;
+  }
+
+  std::vector<std::string> lines = simulateLogLines(4096);
+  static const int batchSizes[] = SD_BENCH_BATCH_SIZES;
+  printf("SD log writes per block, a write per line vs. whole sectors (SectorWriter), modeled card at %d kHz SPI\n",
+         SD_SPI_SPEED / 1000);
+  printf("(%.0f us per call, %.0f us per command, %.0f us per block; %d KB per run)\n", SIM_SD_CALL_US,
+         SIM_SD_COMMAND_US, simSdBlockUs() + SIM_SD_BLOCK_BUSY_US, kilobytes);
+  printf("  %7s %-7s %9s %9s %9s %7s %7s %7s %9s\n", "records", "path", "B/s", "mean us", "max us", "calls",
+         "writes", "reads", "unaligned");
+
+  bool pass = true;
+  SimSdFile files[2] = {SimSdFile(), SimSdFile()};
+  for (size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); b++) {
+    double bytesPerSecond[2] = {0.0, 0.0};
+    for (int staging = 0; staging < 2; staging++) {
+      SimSdFile& file = files[staging];
+      file.data.clear();
+      file.busyUs = 0.0;
+      file.reads = file.writes = file.blocks = file.unaligned = file.calls = 0;
+      static SectorWriter writer;
+      writer.attach(writeSimSd, &file);
+      writer.begin(0, NULL);
+
+      size_t next = 0;
+      uint32_t seq = 0;
+      double maxUs = 0.0;
+      unsigned long batches = 0;
+      while (file.data.size() < (size_t)kilobytes * 1024) {
+        double start = file.busyUs;
+        LogBlockWriter block;
+        block.begin(seq++);
+        simSdOpen(file, !staging);
+        std::string text;
+        for (int i = 0; i < batchSizes[b]; i++) {
+          text = lines[next++ % lines.size()] + "\r\n";
+          block.add((const uint8_t*)text.data(), text.size());
+          if (staging) {
+            writer.write(text.data(), text.size());
+          } else {
+            // The line and its CRLF, as writeBlockLine() wrote them
+            simSdWriteData(file, (const uint8_t*)text.data(), text.size() - 2);
+            simSdWriteData(file, (const uint8_t*)"\r\n", 2);
+          }
+        }
+        char trailer[LOG_BLOCK_TRAILER_LENGTH];
+        size_t len = block.formatTrailer(trailer, sizeof(trailer));
+        if (staging) {
+          writer.write(trailer, len);
+          writer.flush();
+        } else {
+          simSdWriteData(file, (const uint8_t*)trailer, len);
+        }
+        simSdClose(file);
+        double elapsed = file.busyUs - start;
+        maxUs = elapsed > maxUs ? elapsed : maxUs;
+        batches++;
+      }
+      bytesPerSecond[staging] = file.data.size() * 1e6 / file.busyUs;
+      printf("  %7d %-7s %9.0f %9.0f %9.0f %7.1f %7.1f %7.2f %9.2f\n", batchSizes[b],
+             staging ? "sectors" : "lines", bytesPerSecond[staging], file.busyUs / batches, maxUs,
+             (double)file.calls / batches, (double)file.writes / batches, (double)file.reads / batches,
+             (double)file.unaligned / batches);
+      if (staging && file.unaligned > 0) {
+        pass = false;
+      }
+    }
+
+    // Same bytes on the card either way, and a log the boot scan reads to
+    // its last block
+    LogScanResult scan;
+    bool same = files[0].data == files[1].data;
+    std::string text(files[1].data.begin(), files[1].data.end());
+    bool scanned = scanMemoryLog(text, (uint32_t)text.size(), scan) && scan.validEnd == text.size();
+    if (!same || !scanned) {
+      printf("  %d records: files %s, last block %s\n", batchSizes[b], same ? "match" : "differ",
+             scanned ? "found" : "not found");
+      pass = false;
+    }
+    if (batchSizes[b] >= SD_BATCH_SIZE && bytesPerSecond[1] < bytesPerSecond[0]) {
+      pass = false;
+    }
+  }
+
+  // What staging costs the sensor task, on the host CPU
+  const int records = 200000;
+  SimSdFile sink = SimSdFile();
+  static SectorWriter cpuWriter;
+  cpuWriter.attach(writeSimSd, &sink);
+  uint64_t start = groundMicros();
+  for (int r = 0; r < records; r += SD_BATCH_SIZE) {
+    sink.data.clear();
+    sink.position = 0;
+    sink.window = -1;
+    cpuWriter.begin(0, NULL);
+    for (int i = 0; i < SD_BATCH_SIZE; i++) {
+      const std::string& line = lines[(r + i) % lines.size()];
+      cpuWriter.write(line.data(), line.size());
+      cpuWriter.write("\r\n", 2);
+    }
+    cpuWriter.flush();
+  }
+  uint64_t elapsed = groundMicros() - start;
+  printf("  staging per record, host CPU with the model's copy: %.0f ns\n", elapsed * 1000.0 / records);
+  printf("  %s\n", pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include "serial_port.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+static speed_t baudToSpeed(unsigned long baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return B57600;
+  }
+}
+
+SerialPort::SerialPort() : fd(-1), isTty(false) {
+}
+
+SerialPort::~SerialPort() {
+  close();
+}
+
+bool SerialPort::open(const char* path, unsigned long baud) {
+  close();
+
+  fd = ::open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    // Recordings may be read-only
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+  }
+
+  isTty = isatty(fd);
+  if (isTty) {
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+      cfmakeraw(&tio);
+      cfsetispeed(&tio, baudToSpeed(baud));
+      cfsetospeed(&tio, baudToSpeed(baud));
+      tio.c_cflag |= CLOCAL | CREAD;
+      tio.c_cc[VMIN] = 0;
+      tio.c_cc[VTIME] = 0;
+      tcsetattr(fd, TCSANOW, &tio);
+    }
+  }
+
+  return true;
+}
+
+void SerialPort::close() {
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+long SerialPort::read(uint8_t* buffer, size_t len, int timeoutMs) {
+  if (fd < 0) {
+    return -1;
+  }
+
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  int ready = poll(&pfd, 1, timeoutMs);
+  if (ready < 0) {
+    return -1;
+  }
+  if (ready == 0) {
+    return 0;
+  }
+
+  ssize_t n = ::read(fd, buffer, len);
+  if (n == 0) {
+    // End of file on a recording; a tty never reports 0 after poll
+    return isTty ? 0 : -1;
+  }
+  return n < 0 ? -1 : (long)n;
+}
+
+bool SerialPort::write(const uint8_t* data, size_t len) {
+  if (fd < 0) {
+    return false;
+  }
+
+  while (len > 0) {
+    ssize_t n = ::write(fd, data, len);
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+bool SerialPort::writeLine(const char* line) {
+  return write((const uint8_t*)line, strlen(line)) && write((const uint8_t*)"\n", 1);
+}
+
+uint64_t groundMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+uint64_t groundMillis() {
+  return groundMicros() / 1000ULL;
+}
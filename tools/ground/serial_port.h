@@ -0,0 +1,34 @@
+#ifndef GROUND_SERIAL_PORT_H
+#define GROUND_SERIAL_PORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal POSIX serial port wrapper for the ground tools.
+// Regular files and ptys are accepted too, which is how recordings and
+// simulated links are fed in.
+class SerialPort {
+private:
+  int fd;
+  bool isTty;
+
+public:
+  SerialPort();
+  ~SerialPort();
+
+  bool open(const char* path, unsigned long baud);
+  void close();
+  bool isOpen() const { return fd >= 0; }
+
+  // Reads up to len bytes, waiting at most timeoutMs. Returns bytes read,
+  // 0 on timeout, -1 on error or end of file.
+  long read(uint8_t* buffer, size_t len, int timeoutMs);
+  bool write(const uint8_t* data, size_t len);
+  bool writeLine(const char* line);
+};
+
+// Monotonic clock helpers shared by the ground tools
+uint64_t groundMicros();
+uint64_t groundMillis();
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef GROUND_SPSC_RING_H
+#define GROUND_SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <vector>
+
+// Bounded single-producer/single-consumer queue. The receive thread pushes
+// decoded samples and the consumer drains them without locks; each index is
+// written by one side only, so acquire/release ordering is sufficient.
+// Capacity is rounded up to a power of two.
+template <typename T>
+class SpscRing {
+public:
+  explicit SpscRing(size_t capacity) : head(0), tail(0) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    slots.resize(size);
+    mask = size - 1;
+  }
+
+  // Producer side. Returns false (and drops the item) when full.
+  bool push(const T& item) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) > mask) {
+      return false;
+    }
+    slots[h & mask] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when empty.
+  bool pop(T& item) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = slots[t & mask];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const { return mask + 1; }
+
+private:
+  std::vector<T> slots;
+  size_t mask;
+  // Separate cache lines so producer and consumer don't false-share
+  alignas(64) std::atomic<size_t> head;
+  alignas(64) std::atomic<size_t> tail;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command_link.h"
+#include "ground_commands.h"
+#include "link_stats.h"
+#include "telemetry_codec.h"
+
+// Live link statistics from the TELEM stream (see link_stats.h), with
+// optional PINGs for the clock offset and LINK_REPORT mirroring.
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handleInterrupt(int signum) {
+  (void)signum;
+  interrupted = 1;
+}
+
+static void handleTelemetry(const char* line, void* context) {
+  LinkStats* stats = static_cast<LinkStats*>(context);
+  uint64_t arrivalUs = groundMicros();
+
+  TelemetryData data;
+  TelemetryFrameInfo info;
+  if (TelemetryCodec::parseLine(line, data, info)) {
+    stats->addFrame(data, info, arrivalUs);
+  }
+}
+
+static void printStats(const LinkStats& stats, const FecDeframer::Stats& fec) {
+  stats.print(stdout);
+  if (fec.framesDecoded || fec.framesFailed) {
+    printf("  fec ok %lu, failed %lu, corrected %lu B\n",
+           (unsigned long)fec.framesDecoded, (unsigned long)fec.framesFailed,
+           (unsigned long)fec.bytesCorrected);
+  }
+  fflush(stdout);
+}
+
+int runStats(int argc, char** argv) {
+  const char* device = NULL;
+  unsigned long baud = 57600;
+  int pingSeconds = 0;
+  int reportSeconds = 5;
+  int durationSeconds = 0;
+  bool mirror = false;
+
+  for (int i = 0; i < argc; i++) {
+    if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      baud = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      pingSeconds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+      reportSeconds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+      durationSeconds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-m") == 0) {
+      mirror = true;
+    } else if (!device) {
+      device = argv[i];
+    }
+  }
+
+  if (!device || reportSeconds <= 0) {
+    fprintf(stderr, "stats: usage: stats <device> [-b baud] [-p ping_s] [-i report_s] [-d duration_s] [-m]\n");
+    return 1;
+  }
+
+  SerialPort port;
+  if (!port.open(device, baud)) {
+    fprintf(stderr, "stats: cannot open %s\n", device);
+    return 1;
+  }
+
+  LinkStats stats;
+
+  CommandLink link(port);
+  link.setRetryPolicy(1, 1000);
+  link.setLineHandler(handleTelemetry, &stats);
+
+  signal(SIGINT, handleInterrupt);
+
+  uint64_t start = groundMillis();
+  uint64_t lastPing = 0;
+  uint64_t lastReport = start;
+  bool pingPending = pingSeconds > 0;
+
+  while (!interrupted) {
+    if (!link.poll(100)) {
+      break;
+    }
+
+    uint64_t now = groundMillis();
+    if (durationSeconds > 0 && now - start >= (uint64_t)durationSeconds * 1000ULL) {
+      break;
+    }
+
+    if (pingSeconds > 0 && (pingPending || now - lastPing >= (uint64_t)pingSeconds * 1000ULL)) {
+      CommandLink::Result result;
+      if (link.execute(CMD_PING, "", result)) {
+        const char* ms = strstr(result.ack.detail, "ms=");
+        if (ms) {
+          stats.addPing(result.rttMs, strtod(ms + 3, NULL), groundMicros());
+        }
+      }
+      lastPing = groundMillis();
+      pingPending = false;
+    }
+
+    if (now - lastReport >= (uint64_t)reportSeconds * 1000ULL) {
+      printStats(stats, link.getFecStats());
+      lastReport = now;
+
+      if (mirror) {
+        char args[CMD_MAX_ARGS_LENGTH];
+        snprintf(args, sizeof(args), "%llu,%llu,%lu,%ld",
+                 (unsigned long long)stats.getFramesReceived(), (unsigned long long)stats.getFramesLost(),
+                 (unsigned long)stats.getJitterMicros(), (long)stats.getMeanLatencyMs());
+        CommandLink::Result result;
+        link.execute(CMD_LINK_REPORT, args, result);
+      }
+    }
+  }
+
+  printf("\n");
+  printStats(stats, link.getFecStats());
+  return 0;
+}
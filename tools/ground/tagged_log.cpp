@@ -0,0 +1,265 @@
+#include "tagged_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checksum.h"
+#include "log_block.h"
+
+static std::vector<std::string> splitFields(const char* line) {
+  std::vector<std::string> fields;
+  std::string field;
+  for (const char* p = line; *p && *p != '\n' && *p != '\r'; p++) {
+    if (*p == ',') {
+      fields.push_back(field);
+      field.clear();
+    } else {
+      field += *p;
+    }
+  }
+  fields.push_back(field);
+  return fields;
+}
+
+static int tagIndex(char tag) {
+  return tag >= 'A' && tag <= 'Z' ? tag - 'A' : -1;
+}
+
+TaggedLogWidener::TaggedLogWidener()
+  : haveKeyframe(false), timestampColumn(-1), utcColumn(-1), keyframeTimestamp(0), keyframeUtc(0),
+    records(0), keyframes(0), skipped(0) {
+  for (int i = 0; i < 26; i++) {
+    haveSpec[i] = false;
+  }
+}
+
+int TaggedLogWidener::getColumn(const char* name) const {
+  for (size_t i = 0; i < columns.size(); i++) {
+    if (columns[i] == name) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+void TaggedLogWidener::resolve(char tag, const std::vector<std::string>& fields) {
+  TagSpec& spec = specs[tagIndex(tag)];
+  spec.columns.clear();
+  spec.implied.clear();
+  for (size_t i = 1; i < fields.size(); i++) {
+    size_t eq = fields[i].find('=');
+    std::string name = fields[i].substr(0, eq);
+    int column = getColumn(name.c_str());
+    if (eq != std::string::npos) {
+      if (column >= 0) {
+        spec.implied.push_back(std::make_pair(column, fields[i].substr(eq + 1)));
+      }
+    } else {
+      // A column the keyframe doesn't have still takes its field
+      spec.columns.push_back(column);
+    }
+  }
+  haveSpec[tagIndex(tag)] = true;
+}
+
+void TaggedLogWidener::addHeader(const std::vector<std::string>& fields) {
+  if (fields[0].size() != 2 || tagIndex(fields[0][1]) < 0) {
+    return;
+  }
+  char tag = fields[0][1];
+  if (tag != 'K') {
+    if (hasHeader()) {
+      resolve(tag, fields);
+    } else {
+      pending[tagIndex(tag)] = fields;
+    }
+    return;
+  }
+
+  columns.assign(fields.begin() + 1, fields.end());
+  row.assign(columns.size(), "");
+  timestampColumn = getColumn("timestamp");
+  utcColumn = getColumn("utc_ms");
+  for (int i = 0; i < 26; i++) {
+    if (!pending[i].empty()) {
+      resolve((char)('A' + i), pending[i]);
+      pending[i].clear();
+    }
+  }
+}
+
+bool TaggedLogWidener::addLine(const char* line) {
+  if (line[0] == '\0' || line[0] == '\n' || line[0] == '\r') {
+    return false;
+  }
+  std::vector<std::string> fields = splitFields(line);
+  if (line[0] == '#') {
+    addHeader(fields);
+    return false;
+  }
+  if (!hasHeader() || fields.size() < 2) {
+    skipped++;
+    return false;
+  }
+
+  tags = fields[0];
+  if (recordHas('K')) {
+    if (fields.size() - 1 != columns.size()) {
+      skipped++;
+      return false;
+    }
+    row.assign(fields.begin() + 1, fields.end());
+    haveKeyframe = true;
+    keyframeTimestamp = timestampColumn >= 0 ? atoll(row[timestampColumn].c_str()) : 0;
+    keyframeUtc = utcColumn >= 0 ? atoll(row[utcColumn].c_str()) : 0;
+    keyframes++;
+    records++;
+    return true;
+  }
+
+  // Check the whole record against the header before touching the row
+  size_t expected = 2;
+  for (size_t i = 0; i < tags.size(); i++) {
+    int index = tagIndex(tags[i]);
+    if (index < 0 || !haveSpec[index]) {
+      skipped++;
+      return false;
+    }
+    expected += specs[index].columns.size();
+  }
+  if (!haveKeyframe || fields.size() != expected) {
+    skipped++;
+    return false;
+  }
+
+  if (timestampColumn >= 0) {
+    row[timestampColumn] = fields[1];
+  }
+  size_t next = 2;
+  for (size_t i = 0; i < tags.size(); i++) {
+    const TagSpec& spec = specs[tagIndex(tags[i])];
+    for (size_t c = 0; c < spec.columns.size(); c++, next++) {
+      if (spec.columns[c] >= 0) {
+        row[spec.columns[c]] = fields[next];
+      }
+    }
+    for (size_t c = 0; c < spec.implied.size(); c++) {
+      row[spec.implied[c].first] = spec.implied[c].second;
+    }
+  }
+
+  // UTC runs on from the keyframe with the timestamp (to within the
+  // crystal drift over a keyframe interval)
+  if (utcColumn >= 0 && keyframeUtc > 0) {
+    long long utc = keyframeUtc + atoll(fields[1].c_str()) - keyframeTimestamp;
+    row[utcColumn] = std::to_string(utc);
+  }
+  records++;
+  return true;
+}
+
+LogBlockReader::LogBlockReader() : pendingLength(0), pendingCrc(0), haveSeq(false), lastSeq(0) {
+  memset(&stats, 0, sizeof(stats));
+}
+
+void LogBlockReader::dropPending() {
+  stats.droppedLines += (uint32_t)pending.size();
+  pending.clear();
+  pendingLength = 0;
+  pendingCrc = 0;
+}
+
+void LogBlockReader::finish() {
+  dropPending();
+}
+
+bool LogBlockReader::addLine(const char* line, size_t len) {
+  size_t textLen = len;
+  while (textLen > 0 && (line[textLen - 1] == '\n' || line[textLen - 1] == '\r')) {
+    textLen--;
+  }
+
+  if (textLen > 0 && line[0] == '$') {
+    uint32_t seq, length, crc;
+    if (parseLogBlockTrailer(line, textLen, seq, length, crc)) {
+      if (length != pendingLength || crc != pendingCrc) {
+        stats.badBlocks++;
+        dropPending();
+        return false;
+      }
+      if (haveSeq && seq != lastSeq + 1) {
+        stats.seqGaps++;
+      }
+      haveSeq = true;
+      lastSeq = seq;
+      stats.blocks++;
+      blockLines.swap(pending);
+      pending.clear();
+      pendingLength = 0;
+      pendingCrc = 0;
+      return true;
+    }
+    // A marker (or a torn trailer) ends whatever came before it
+    if (textLen > 1 && line[1] == 'R') {
+      stats.resumes++;
+    } else if (textLen > 1 && line[1] == 'E') {
+      stats.seals++;
+    }
+    dropPending();
+    return false;
+  }
+
+  pending.push_back(std::string(line, textLen));
+  pendingLength += (uint32_t)len;
+  pendingCrc = crc32((const uint8_t*)line, len, pendingCrc);
+  return false;
+}
+
+void readSdLogText(const std::string& text, std::vector<std::string>& lines, LogReadStats& stats) {
+  LogBlockReader reader;
+  std::vector<std::string> all;
+  lines.clear();
+  bool framed = false;
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t newline = text.find('\n', start);
+    size_t end = newline == std::string::npos ? text.size() : newline + 1;
+    const char* line = text.data() + start;
+    if (line[0] == '$') {
+      framed = true;
+    }
+    if (!framed) {
+      size_t textLen = end - start;
+      while (textLen > 0 && (line[textLen - 1] == '\n' || line[textLen - 1] == '\r')) {
+        textLen--;
+      }
+      all.push_back(std::string(line, textLen));
+    }
+    if (reader.addLine(line, end - start)) {
+      lines.insert(lines.end(), reader.getBlockLines().begin(), reader.getBlockLines().end());
+    }
+    start = end;
+  }
+  reader.finish();
+  stats = reader.getStats();
+  if (!framed) {
+    lines.swap(all);
+    stats.droppedLines = 0;
+  }
+}
+
+bool readSdLog(const char* path, std::vector<std::string>& lines, LogReadStats& stats) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  std::string text;
+  char buffer[65536];
+  size_t got;
+  while ((got = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    text.append(buffer, got);
+  }
+  fclose(f);
+  readSdLogText(text, lines, stats);
+  return true;
+}
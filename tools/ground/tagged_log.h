@@ -0,0 +1,99 @@
+#ifndef GROUND_TAGGED_LOG_H
+#define GROUND_TAGGED_LOG_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Readers for SD card logs.
+//
+// LogBlockReader checks the block framing (log_block.h) and passes on the
+// lines of complete blocks only. readSdLog() does this for a whole file
+// and falls back to every line for logs written before the framing.
+
+struct LogReadStats {
+  uint32_t blocks;           // Valid blocks
+  uint32_t badBlocks;        // Trailers whose length or CRC didn't match
+  uint32_t droppedLines;     // Lines not covered by a valid block
+  uint32_t seqGaps;          // Valid blocks not following the previous one
+  uint32_t resumes;          // "$R" markers
+  uint32_t seals;            // "$E" markers
+};
+
+class LogBlockReader {
+public:
+  LogBlockReader();
+
+  // Feeds one line with its line ending. Returns true when it was the
+  // trailer of a valid block; getBlockLines() then holds that block's
+  // lines without their line endings.
+  bool addLine(const char* line, size_t len);
+
+  const std::vector<std::string>& getBlockLines() const { return blockLines; }
+  const LogReadStats& getStats() const { return stats; }
+  // Lines still waiting for a trailer count as dropped
+  void finish();
+
+private:
+  std::vector<std::string> pending;
+  std::vector<std::string> blockLines;
+  uint32_t pendingLength;
+  uint32_t pendingCrc;
+  bool haveSeq;
+  uint32_t lastSeq;
+  LogReadStats stats;
+
+  void dropPending();
+};
+
+// Splits log text into lines and keeps those of valid blocks; a log
+// without any block trailer is returned whole
+void readSdLogText(const std::string& text, std::vector<std::string>& lines, LogReadStats& stats);
+// Same for a file. Prints the reason and returns false if it can't be read.
+bool readSdLog(const char* path, std::vector<std::string>& lines, LogReadStats& stats);
+
+// Rebuilds the wide rows of a tagged SD log (sd_record.h) one line at a
+// time: the "#<tag>" header lines name each record type's columns, and
+// every record updates the columns of its groups on top of the last row.
+class TaggedLogWidener {
+public:
+  TaggedLogWidener();
+
+  // Feeds one line of the log. Returns true when it was a record and
+  // getRow() holds the wide row as of that record.
+  bool addLine(const char* line);
+
+  bool hasHeader() const { return !columns.empty(); }
+  const std::vector<std::string>& getColumns() const { return columns; }
+  const std::vector<std::string>& getRow() const { return row; }
+  int getColumn(const char* name) const;
+  bool recordHas(char tag) const { return tags.find(tag) != std::string::npos; }
+
+  uint32_t getRecords() const { return records; }
+  uint32_t getKeyframes() const { return keyframes; }
+  uint32_t getSkipped() const { return skipped; }   // Malformed, or before the first keyframe
+
+private:
+  struct TagSpec {
+    std::vector<int> columns;                          // Fields in record order
+    std::vector<std::pair<int, std::string> > implied; // Columns the group sets
+  };
+
+  std::vector<std::string> columns;  // Wide columns, from the keyframe line
+  std::vector<std::string> pending[26];  // Header lines seen before "#K"
+  TagSpec specs[26];
+  bool haveSpec[26];
+  std::vector<std::string> row;
+  std::string tags;                  // Tags of the last record
+  bool haveKeyframe;
+  int timestampColumn;
+  int utcColumn;
+  long long keyframeTimestamp;
+  long long keyframeUtc;
+  uint32_t records, keyframes, skipped;
+
+  void addHeader(const std::vector<std::string>& fields);
+  void resolve(char tag, const std::vector<std::string>& fields);
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "telemetry_decoder.h"
+#include <string.h>
+
+TelemetryDecoder::TelemetryDecoder(SampleCallback onSample, void* context) :
+  onSample(onSample),
+  context(context) {
+  memset(&stats, 0, sizeof(Stats));
+}
+
+void TelemetryDecoder::emit(const TelemetrySample& sample) {
+  stats.frames++;
+  if (onSample) {
+    onSample(sample, context);
+  }
+}
+
+AsciiTelemetryDecoder::AsciiTelemetryDecoder(SampleCallback onSample, void* context) :
+  TelemetryDecoder(onSample, context),
+  receiver(handleLine, this),
+  currentRxMicros(0) {
+}
+
+void AsciiTelemetryDecoder::push(const uint8_t* data, size_t len, uint64_t rxMicros) {
+  // Lines complete inside this chunk are stamped with its receive time
+  currentRxMicros = rxMicros;
+  receiver.push(data, len);
+}
+
+void AsciiTelemetryDecoder::handleLine(const char* line, bool fromFec, int corrected, void* context) {
+  (void)corrected;
+  AsciiTelemetryDecoder* self = static_cast<AsciiTelemetryDecoder*>(context);
+
+  if (strncmp(line, TELEM_FRAME_PREFIX, strlen(TELEM_FRAME_PREFIX)) != 0) {
+    self->stats.otherLines++;
+    return;
+  }
+
+  TelemetrySample sample;
+  if (!TelemetryCodec::parseLine(line, sample.data, sample.info)) {
+    self->stats.rejected++;
+    return;
+  }
+  sample.rxMicros = self->currentRxMicros;
+  sample.fromFec = fromFec;
+  self->emit(sample);
+}
@@ -0,0 +1,61 @@
+#ifndef GROUND_TELEMETRY_DECODER_H
+#define GROUND_TELEMETRY_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "line_receiver.h"
+#include "telemetry_codec.h"
+
+struct TelemetrySample {
+  uint64_t rxMicros;  // Ground receive time (recorded time during replay)
+  TelemetryData data;
+  TelemetryFrameInfo info;
+  bool fromFec;
+};
+
+// Turns downlink bytes into telemetry samples. The receiver only talks to
+// this interface, so a binary frame format can be added next to the ASCII
+// decoder without touching the record/replay or statistics code.
+class TelemetryDecoder {
+public:
+  typedef void (*SampleCallback)(const TelemetrySample& sample, void* context);
+
+  struct Stats {
+    uint64_t frames;        // Decoded telemetry samples
+    uint64_t rejected;      // Frames that looked like telemetry but failed to parse
+    uint64_t otherLines;    // Acks, events and other non-telemetry traffic
+  };
+
+  TelemetryDecoder(SampleCallback onSample, void* context);
+  virtual ~TelemetryDecoder() {}
+
+  virtual const char* name() const = 0;
+  virtual void push(const uint8_t* data, size_t len, uint64_t rxMicros) = 0;
+  virtual FecDeframer::Stats getFecStats() const = 0;
+  const Stats& getStats() const { return stats; }
+
+protected:
+  void emit(const TelemetrySample& sample);
+
+  Stats stats;
+  SampleCallback onSample;
+  void* context;
+};
+
+// TELEM,... text lines, plain or FEC framed (the current firmware format)
+class AsciiTelemetryDecoder : public TelemetryDecoder {
+public:
+  AsciiTelemetryDecoder(SampleCallback onSample, void* context);
+
+  const char* name() const { return "ascii"; }
+  void push(const uint8_t* data, size_t len, uint64_t rxMicros);
+  FecDeframer::Stats getFecStats() const { return receiver.getFecStats(); }
+
+private:
+  static void handleLine(const char* line, bool fromFec, int corrected, void* context);
+
+  LineReceiver receiver;
+  uint64_t currentRxMicros;
+};
+
+#endif
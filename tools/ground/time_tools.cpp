@@ -0,0 +1,197 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include "ground_commands.h"
+#include "time_discipline.h"
+#include "serial_port.h"
+
+// Host check of the GPS time discipline against a simulated board clock:
+// a crystal 23 ppm fast that warms up by another 4 ppm and wanders, polled
+// every sensor cycle like GPSModule::poll() (the NMEA burst is timestamped
+// half way between the poll that found it and the one before), with and
+// without a PPS, and with the receiver lost for the last ten minutes.
+// The reference is the simple mapping: the offset to the last NMEA time,
+// with the same latency assumption and no drift correction.
+
+#define TIME_BENCH_POLL_US 10000        // Sensor task period
+#define TIME_BENCH_FIRST_FIX 30         // s after boot
+#define TIME_BENCH_SETTLE 120           // s after boot before errors count
+#define TIME_BENCH_LATENCY_US 180000    // True NMEA burst delay after its epoch
+#define TIME_BENCH_NMEA_JITTER_US 3000
+#define TIME_BENCH_PPS_JITTER_US 2.0
+#define TIME_BENCH_EPOCH_MS 1780315200000LL  // 2026-06-01 12:00:00 UTC at boot
+#define TIME_BENCH_CONVERSIONS 10000000
+
+struct TimeScenario {
+  const char* name;
+  bool pps;
+  int lossAfter;                        // s after boot the receiver goes quiet, 0 = never
+};
+
+struct TimeResult {
+  double trackSq, trackMax;             // Discipline error while the receiver is heard (us)
+  double naiveSq, naiveMax;             // Offset-to-last-fix error over the same span
+  long trackCount;
+  double holdoverError, naiveHoldoverError;  // At the end, after the loss (us)
+  double driftPpm, trueDriftPpm;
+  double latencyMs;
+  uint32_t rejected;
+};
+
+static int64_t mappedUtcUs(const UtcMapping& mapping, int64_t localUs) {
+  int64_t d = localUs - mapping.localRefUs;
+  return mapping.utcRefUs + d + d * mapping.ratePpb / 1000000000LL;
+}
+
+static void runScenario(const TimeScenario& scenario, int durationS, std::mt19937& rng, TimeResult& r) {
+  std::normal_distribution<double> unit(0.0, 1.0);
+  TimeDiscipline discipline;
+  r = TimeResult();
+
+  // The board polls every TIME_BENCH_POLL_US of its own clock, so the
+  // polls slide slowly against the UTC seconds
+  std::uniform_real_distribution<double> phase(0.0, TIME_BENCH_POLL_US);
+  double t = phase(rng);                // True time since boot (us)
+  double local = t;
+  double wander = 0.0;
+  double drift = 23.0;
+  double prevPollLocal = 0.0;
+  bool haveNaive = false;
+  int64_t naiveOffsetUs = 0;
+  int64_t nextSecond = TIME_BENCH_FIRST_FIX;
+  double pendingPpsLocal = -1.0;
+  double pendingNmeaTrue = -1.0;
+  int64_t pendingEpochMs = 0;
+
+  while (t < durationS * 1e6) {
+    double tPrev = t;
+    double localPrev = local;
+    wander += 0.01 * sqrt(TIME_BENCH_POLL_US / 1e6) * unit(rng);
+    drift = 23.0 + 4.0 * (1.0 - exp(-tPrev / 300e6)) + wander;
+    local += TIME_BENCH_POLL_US;
+    t += TIME_BENCH_POLL_US / (1.0 + drift * 1e-6);
+
+    bool receiverHeard = scenario.lossAfter == 0 || t < scenario.lossAfter * 1e6;
+
+    // Epoch at each whole second: PPS edge now, NMEA burst after the latency
+    if (t >= nextSecond * 1e6) {
+      if (receiverHeard) {
+        double frac = (nextSecond * 1e6 - tPrev) / (t - tPrev);
+        if (scenario.pps) {
+          pendingPpsLocal = localPrev + frac * (local - localPrev) + TIME_BENCH_PPS_JITTER_US * unit(rng);
+        }
+        pendingNmeaTrue = nextSecond * 1e6 + TIME_BENCH_LATENCY_US + TIME_BENCH_NMEA_JITTER_US * fabs(unit(rng));
+        pendingEpochMs = TIME_BENCH_EPOCH_MS + nextSecond * 1000;
+      }
+      nextSecond++;
+    }
+
+    // This poll: the PPS interrupt already ran, the NMEA shows up once it
+    // has started arriving
+    if (pendingPpsLocal >= 0) {
+      discipline.addPps((int64_t)llround(pendingPpsLocal));
+      pendingPpsLocal = -1.0;
+    }
+    if (pendingNmeaTrue >= 0 && pendingNmeaTrue <= t) {
+      double arrival = (prevPollLocal + local) / 2.0;
+      float sigma = (float)((local - prevPollLocal) / sqrt(12.0));
+      discipline.addNmeaTime((int64_t)llround(arrival), pendingEpochMs, sigma);
+      naiveOffsetUs = pendingEpochMs * 1000 + TIME_NMEA_LATENCY_MS * 1000LL - (int64_t)llround(arrival);
+      haveNaive = true;
+      pendingNmeaTrue = -1.0;
+    }
+    prevPollLocal = local;
+
+    if (!discipline.isSynced() || !haveNaive || t < TIME_BENCH_SETTLE * 1e6) {
+      continue;
+    }
+    int64_t localUs = (int64_t)llround(local);
+    double truth = TIME_BENCH_EPOCH_MS * 1000.0 + t;
+    double error = fabs((double)mappedUtcUs(discipline.getMapping(), localUs) - truth);
+    double naiveError = fabs((double)(localUs + naiveOffsetUs) - truth);
+    if (receiverHeard) {
+      r.trackSq += error * error;
+      r.naiveSq += naiveError * naiveError;
+      if (error > r.trackMax) r.trackMax = error;
+      if (naiveError > r.naiveMax) r.naiveMax = naiveError;
+      r.trackCount++;
+    }
+    r.holdoverError = error;
+    r.naiveHoldoverError = naiveError;
+  }
+
+  r.driftPpm = discipline.getDriftPpm();
+  r.trueDriftPpm = -drift / (1.0 + drift * 1e-6);  // As the UTC rate against the local clock
+  r.latencyMs = discipline.getNmeaLatencyMs();
+  r.rejected = discipline.getRejectedCount();
+}
+
+int runTimeBench(int argc, char** argv) {
+  int durationS = argc > 0 ? atoi(argv[0]) : 1800;
+  if (durationS < 2 * TIME_BENCH_SETTLE) {
+    fprintf(stderr, "time-bench: usage: time-bench [seconds >= %d]\n", 2 * TIME_BENCH_SETTLE);
+    return 1;
+  }
+
+  TimeScenario scenarios[] = {
+    {"NMEA only", false, 0},
+    {"NMEA + PPS", true, 0},
+    {"NMEA + PPS, GPS lost", true, durationS - 600 > TIME_BENCH_SETTLE ? durationS - 600 : durationS / 2},
+  };
+  int scenarioCount = sizeof(scenarios) / sizeof(scenarios[0]);
+
+  std::mt19937 rng(41);
+  bool pass = true;
+  printf("UTC mapping on a simulated board clock (23 ppm + 4 ppm warm-up + wander), %d s, %d ms polls\n",
+         durationS, TIME_BENCH_POLL_US / 1000);
+  printf("  true NMEA latency %d ms (assumed %d ms until measured)\n", TIME_BENCH_LATENCY_US / 1000,
+         TIME_NMEA_LATENCY_MS);
+  printf("  %-22s %12s %12s %12s %12s %10s %10s\n", "", "RMS error", "max error", "ref RMS", "ref max",
+         "drift ppm", "latency");
+  for (int s = 0; s < scenarioCount; s++) {
+    TimeResult r;
+    runScenario(scenarios[s], durationS, rng, r);
+    double rms = r.trackCount > 0 ? sqrt(r.trackSq / r.trackCount) : 0.0;
+    double naiveRms = r.trackCount > 0 ? sqrt(r.naiveSq / r.trackCount) : 0.0;
+    printf("  %-22s %9.3f ms %9.3f ms %9.3f ms %9.3f ms %4.1f/%4.1f %7.1f ms\n", scenarios[s].name,
+           rms / 1000.0, r.trackMax / 1000.0, naiveRms / 1000.0, r.naiveMax / 1000.0,
+           r.driftPpm, r.trueDriftPpm, r.latencyMs);
+    if (scenarios[s].lossAfter > 0) {
+      printf("  %-22s after %d s without GPS: %.3f ms (ref %.3f ms)\n", "", durationS - scenarios[s].lossAfter,
+             r.holdoverError / 1000.0, r.naiveHoldoverError / 1000.0);
+      pass = pass && r.holdoverError < r.naiveHoldoverError;
+    }
+    if (r.rejected > 0) {
+      printf("  %-22s %lu samples gated out\n", "", (unsigned long)r.rejected);
+    }
+    // The half-normal jitter adds 0.8 sigma to the mean latency. Without a
+    // PPS the error can't beat the wrong latency assumption, but shouldn't
+    // add more than the jitter to it; with one, the latency is measured to
+    // within half a poll.
+    double meanLatencyMs = (TIME_BENCH_LATENCY_US + 0.8 * TIME_BENCH_NMEA_JITTER_US) / 1000.0;
+    if (scenarios[s].pps) {
+      pass = pass && r.trackMax < 100.0 && fabs(r.latencyMs - meanLatencyMs) < TIME_BENCH_POLL_US / 2000.0;
+    } else {
+      pass = pass && rms / 1000.0 < fabs(meanLatencyMs - TIME_NMEA_LATENCY_MS) + TIME_NMEA_JITTER_MS;
+    }
+  }
+
+  // Conversion cost, as every record pays it
+  TimeDiscipline discipline;
+  discipline.addNmeaTime(1000000, TIME_BENCH_EPOCH_MS, 3000.0f);
+  discipline.addNmeaTime(2000150, TIME_BENCH_EPOCH_MS + 1000, 3000.0f);
+  int64_t sink = 0;
+  uint64_t start = groundMicros();
+  for (int i = 0; i < TIME_BENCH_CONVERSIONS; i++) {
+    sink += discipline.toUtcMs(2000000 + (int64_t)i * 997);
+  }
+  double convertNs = (groundMicros() - start) * 1000.0 / TIME_BENCH_CONVERSIONS;
+
+  char stamp[UTC_STAMP_LENGTH];
+  formatUtcStamp(stamp, sizeof(stamp), discipline.toUtcMs(2000000));
+  printf("  local -> UTC ms %.1f ns per record (host); file stamp at sync %s\n", convertNs, stamp);
+  if (sink == 0) printf("\n");
+
+  return pass ? 0 : 1;
+}
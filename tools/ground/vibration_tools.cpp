@@ -0,0 +1,273 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "ground_commands.h"
+#include "serial_port.h"
+#include "vibration_analyzer.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define VIB_BENCH_HAVE_TSC 1
+#endif
+
+// Host reference build of the vibration analyzer: FFT accuracy against a
+// double-precision DFT, recovery of known tones from a simulated 1 kHz
+// vibration record, and the cost of the FFT and of a whole block.
+
+#define VIB_BENCH_RATE 1000.0          // Hz, the boost FIFO rate
+#define VIB_BENCH_HZ_TOLERANCE 1.0     // Peak frequency error allowed (bins)
+#define VIB_BENCH_AMP_TOLERANCE 0.10   // Relative peak amplitude error allowed
+
+struct VibTone {
+  bool gyro;
+  float amplitude[3];   // Per axis, g or deg/s
+  double hz;
+};
+
+// Motor buzz, a structural mode shared by two axes and a weak high mode;
+// the gyro sees the body rocking at its own frequency and the buzz
+static const VibTone tones[] = {
+  {false, {1.5f, 0.0f, 0.0f}, 137.3},
+  {false, {0.0f, 0.4f, 0.4f}, 41.7},
+  {false, {0.0f, 0.0f, 0.15f}, 312.4},
+  {true, {8.0f, 0.0f, 0.0f}, 73.1},
+  {true, {0.0f, 0.0f, 3.0f}, 137.3},
+};
+#define TONE_COUNT (sizeof(tones) / sizeof(tones[0]))
+#define ACCEL_NOISE 0.02   // g RMS per axis
+#define GYRO_NOISE 0.2     // deg/s RMS per axis
+
+static double vectorAmplitude(const VibTone& tone) {
+  return sqrt(tone.amplitude[0] * tone.amplitude[0] + tone.amplitude[1] * tone.amplitude[1] +
+              tone.amplitude[2] * tone.amplitude[2]);
+}
+
+// Plain radix-2 DIT with the same tables, for the cost comparison
+static void radix2Fft(float* re, float* im, const float* wr, const float* wi, const uint16_t* rev) {
+  for (int i = 0; i < VIB_FFT_SIZE; i++) {
+    int j = rev[i];
+    if (i < j) {
+      float t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+  for (int h = 1; h < VIB_FFT_SIZE; h *= 2) {
+    int stride = VIB_FFT_SIZE / (2 * h);
+    for (int k = 0; k < h; k++) {
+      float cr = wr[k * stride], ci = wi[k * stride];
+      for (int i = k; i < VIB_FFT_SIZE; i += 2 * h) {
+        float tr = re[i + h] * cr - im[i + h] * ci;
+        float ti = re[i + h] * ci + im[i + h] * cr;
+        re[i + h] = re[i] - tr;
+        im[i + h] = im[i] - ti;
+        re[i] += tr;
+        im[i] += ti;
+      }
+    }
+  }
+}
+
+// Worst error of the transform against a double DFT, relative to the
+// output RMS, over several random inputs
+static double fftError(const VibrationFft& fft) {
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> u(-1.0, 1.0);
+  double worst = 0;
+  for (int run = 0; run < 8; run++) {
+    std::vector<double> xr(VIB_FFT_SIZE), xi(VIB_FFT_SIZE);
+    float re[VIB_FFT_SIZE], im[VIB_FFT_SIZE];
+    for (int i = 0; i < VIB_FFT_SIZE; i++) {
+      xr[i] = u(rng);
+      xi[i] = u(rng);
+      re[i] = (float)xr[i];
+      im[i] = (float)xi[i];
+    }
+    fft.transform(re, im);
+    double errSq = 0, refSq = 0;
+    for (int k = 0; k < VIB_FFT_SIZE; k++) {
+      double sr = 0, si = 0;
+      for (int n = 0; n < VIB_FFT_SIZE; n++) {
+        double a = -2.0 * M_PI * (double)k * n / VIB_FFT_SIZE;
+        sr += xr[n] * cos(a) - xi[n] * sin(a);
+        si += xr[n] * sin(a) + xi[n] * cos(a);
+      }
+      errSq = fmax(errSq, (re[k] - sr) * (re[k] - sr) + (im[k] - si) * (im[k] - si));
+      refSq += sr * sr + si * si;
+    }
+    worst = fmax(worst, sqrt(errSq / (refSq / VIB_FFT_SIZE)));
+  }
+  return worst;
+}
+
+static void simulateRecord(int samples, std::vector<int32_t>& out) {
+  std::mt19937 rng(11);
+  std::normal_distribution<double> accelNoise(0.0, ACCEL_NOISE);
+  std::normal_distribution<double> gyroNoise(0.0, GYRO_NOISE);
+  out.assign((size_t)samples * DECIM_AXES, 0);
+  for (int n = 0; n < samples; n++) {
+    double t = n / VIB_BENCH_RATE;
+    double value[DECIM_AXES] = {0.0, 0.0, 1.0, 0.5, -0.3, 0.2};  // Gravity and gyro bias
+    for (int a = 0; a < 3; a++) {
+      value[a] += accelNoise(rng);
+      value[3 + a] += gyroNoise(rng);
+    }
+    for (size_t i = 0; i < TONE_COUNT; i++) {
+      double s = sin(2.0 * M_PI * tones[i].hz * t + 0.7 * i);
+      for (int a = 0; a < 3; a++) {
+        value[(tones[i].gyro ? 3 : 0) + a] += tones[i].amplitude[a] * s;
+      }
+    }
+    for (int a = 0; a < DECIM_AXES; a++) {
+      double unit = a < 3 ? DECIM_ACCEL_UNIT : DECIM_GYRO_UNIT;
+      out[(size_t)n * DECIM_AXES + a] = (int32_t)lround(value[a] / unit);
+    }
+  }
+}
+
+// Finds the summary peak nearest a tone; false if none is within tolerance
+static bool matchPeak(const VibrationSpectrum& spectrum, const VibTone& tone, double& hz, double& amplitude) {
+  double binHz = VIB_BENCH_RATE / VIB_FFT_SIZE;
+  for (int p = 0; p < VIB_PEAK_COUNT; p++) {
+    if (fabs(spectrum.peakHz[p] - tone.hz) <= VIB_BENCH_HZ_TOLERANCE * binHz) {
+      hz = spectrum.peakHz[p];
+      amplitude = spectrum.peakAmplitude[p];
+      return true;
+    }
+  }
+  return false;
+}
+
+int runVibBench(int argc, char** argv) {
+  int summaries = argc > 0 ? atoi(argv[0]) : 10;
+  if (summaries <= 0) {
+    fprintf(stderr, "vib-bench: usage: vib-bench [summaries]\n");
+    return 1;
+  }
+  int failures = 0;
+
+  VibrationFft fft;
+  double err = fftError(fft);
+  printf("Vibration FFT, %d points (radix-%s)\n", VIB_FFT_SIZE, (VIB_FFT_LOG2 & 1) ? "2 + radix-4" : "4");
+  printf("  max bin error vs double DFT: %.2e of the output RMS\n", err);
+  if (err > 1e-5) failures++;
+
+  // Tone recovery
+  VibrationAnalyzer analyzer;
+  analyzer.reset(VIB_BENCH_RATE);
+  int blockSamples = VIB_FFT_SIZE * (int)ceil(VIB_SUMMARY_INTERVAL / (VIB_FFT_SIZE * 1000.0 / VIB_BENCH_RATE));
+  std::vector<int32_t> record;
+  simulateRecord(blockSamples * summaries, record);
+  const int batch = 10;
+  VibrationSummary summary, last;
+  memset(&last, 0, sizeof(last));
+  int produced = 0;
+  for (int n = 0; n < blockSamples * summaries; n += batch) {
+    if (analyzer.process(&record[(size_t)n * DECIM_AXES], batch, false, (uint32_t)n, summary)) {
+      last = summary;
+      produced++;
+    }
+  }
+  if (produced != summaries) {
+    printf("FAIL: %d summaries from %d summary intervals\n", produced, summaries);
+    return 1;
+  }
+
+  printf("Simulated %.0f Hz record, %d summaries of %u blocks (%.2f Hz bins), last summary:\n", VIB_BENCH_RATE,
+         produced, (unsigned)last.blocks, VIB_BENCH_RATE / VIB_FFT_SIZE);
+  printf("  %-6s %9s %9s %11s %11s\n", "sensor", "true Hz", "found Hz", "true amp", "found amp");
+  for (size_t i = 0; i < TONE_COUNT; i++) {
+    const VibrationSpectrum& spectrum = tones[i].gyro ? last.gyro : last.accel;
+    double hz = 0, amplitude = 0, truth = vectorAmplitude(tones[i]);
+    bool found = matchPeak(spectrum, tones[i], hz, amplitude);
+    const char* unit = tones[i].gyro ? "dps" : "g";
+    if (found) {
+      printf("  %-6s %9.1f %9.1f %7.3f %-3s %7.3f %-3s\n", tones[i].gyro ? "gyro" : "accel", tones[i].hz, hz, truth,
+             unit, amplitude, unit);
+    } else {
+      printf("  %-6s %9.1f %9s %7.3f %-3s %11s\n", tones[i].gyro ? "gyro" : "accel", tones[i].hz, "missed", truth,
+             unit, "-");
+    }
+    if (!found || fabs(amplitude - truth) > VIB_BENCH_AMP_TOLERANCE * truth) failures++;
+  }
+
+  for (int s = 0; s < 2; s++) {
+    const VibrationSpectrum& spectrum = s == 0 ? last.accel : last.gyro;
+    double noise = s == 0 ? ACCEL_NOISE : GYRO_NOISE;
+    double truthSq = 3.0 * noise * noise;
+    for (size_t i = 0; i < TONE_COUNT; i++) {
+      if (tones[i].gyro == (s == 1)) truthSq += vectorAmplitude(tones[i]) * vectorAmplitude(tones[i]) / 2.0;
+    }
+    printf("  %s RMS %.3f (true %.3f), bands", s == 0 ? "accel" : "gyro", spectrum.rms, sqrt(truthSq));
+    for (int b = 0; b < VIB_BAND_COUNT; b++) {
+      printf(" %.0f-%.0f Hz: %.3f", VIB_BAND_EDGES[b], VIB_BAND_EDGES[b + 1], spectrum.bandRms[b]);
+    }
+    printf("\n");
+    if (fabs(spectrum.rms - sqrt(truthSq)) > 0.05 * sqrt(truthSq)) failures++;
+  }
+
+  char line[CMD_MAX_LINE_LENGTH];
+  size_t len = VibrationAnalyzer::formatDownlink(line, sizeof(line), last);
+  printf("  downlink (%zu bytes): %s", len, len ? line : "too long\n");
+  if (len == 0) failures++;
+
+  // Cost: FFT alone (radix-4 vs plain radix-2) and a whole block
+  float wr[VIB_FFT_SIZE], wi[VIB_FFT_SIZE];
+  uint16_t rev[VIB_FFT_SIZE];
+  for (int k = 0; k < VIB_FFT_SIZE; k++) {
+    wr[k] = (float)cos(-2.0 * M_PI * k / VIB_FFT_SIZE);
+    wi[k] = (float)sin(-2.0 * M_PI * k / VIB_FFT_SIZE);
+    rev[k] = 0;
+    for (int b = 0; b < VIB_FFT_LOG2; b++) rev[k] |= ((k >> b) & 1) << (VIB_FFT_LOG2 - 1 - b);
+  }
+  float re[VIB_FFT_SIZE], im[VIB_FFT_SIZE];
+  for (int i = 0; i < VIB_FFT_SIZE; i++) {
+    re[i] = (float)sin(0.1 * i);
+    im[i] = (float)cos(0.3 * i);
+  }
+  const int runs = 20000;
+  double cost[3][2];  // ns, cycles
+  for (int which = 0; which < 3; which++) {
+    uint64_t start = groundMicros();
+#ifdef VIB_BENCH_HAVE_TSC
+    uint64_t tscStart = __rdtsc();
+#endif
+    for (int r = 0; r < runs; r++) {
+      if (which == 0) {
+        fft.transform(re, im);
+      } else if (which == 1) {
+        radix2Fft(re, im, wr, wi, rev);
+      } else {
+        analyzer.process(&record[(size_t)(r % summaries) * blockSamples * DECIM_AXES], VIB_FFT_SIZE, false, 0,
+                         summary);
+      }
+      // Keep the values bounded across repeated transforms
+      re[r & (VIB_FFT_SIZE - 1)] = 0.5f;
+      if (which < 2 && fabsf(re[1]) > 1e6f) {
+        for (int i = 0; i < VIB_FFT_SIZE; i++) re[i] = im[i] = 1e-3f * i;
+      }
+    }
+#ifdef VIB_BENCH_HAVE_TSC
+    cost[which][1] = (double)(__rdtsc() - tscStart) / runs;
+#else
+    cost[which][1] = 0;
+#endif
+    cost[which][0] = (groundMicros() - start) * 1000.0 / runs;
+  }
+  static const char* const names[3] = {"FFT radix-4", "FFT radix-2 (reference)", "block (6 axes, 3 FFTs)"};
+  printf("Cost per call (host, one core):\n");
+  for (int which = 0; which < 3; which++) {
+    printf("  %-24s %8.0f ns", names[which], cost[which][0]);
+    if (cost[which][1] > 0) printf(" %9.0f TSC cycles", cost[which][1]);
+    printf("\n");
+  }
+  printf("  a block arrives every %.0f ms at %.0f Hz; on the board see perfMetrics.vibrationBlockCycles\n",
+         VIB_FFT_SIZE * 1000.0 / VIB_BENCH_RATE, VIB_BENCH_RATE);
+
+  if (failures > 0) {
+    printf("FAIL: %d checks outside the limits\n", failures);
+    return 1;
+  }
+  return 0;
+}